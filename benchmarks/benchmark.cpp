@@ -0,0 +1,132 @@
+/*
+ * Native throughput benchmark of the libsamplerate converters.
+ *
+ * Measures src_process on preallocated buffers, per converter type, channel
+ * count and block size, without any Python or binding overhead. Build it
+ * with the `samplerate-benchmark` target:
+ *
+ *   cmake -S . -B build -DSAMPLERATE_BUILD_BENCHMARK=ON
+ *   cmake --build build --target samplerate-benchmark
+ *   ./build/samplerate-benchmark --min-time 0.1 > native.json
+ *
+ * The results are printed as one JSON document, to compare between builds
+ * and with the output of `samplerate.benchmark()`, whose results have the
+ * same `converter_type`, `channels` and `block_frames` keys. Only the five
+ * libsamplerate converters are measured: the polyphase and halfband
+ * converters that `samplerate.benchmark()` also reports are implemented in
+ * the extension module, not in libsamplerate.
+ *
+ * Options:
+ *   --min-time SECONDS  minimum duration of each timing run (default: 0.05)
+ *   --ratio RATIO       conversion ratio (default: 48000 / 44100)
+ */
+
+#include <samplerate.h>
+
+#include "noise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const char *const converter_names[] = {"sinc_best", "sinc_medium",
+                                       "sinc_fastest", "zero_order_hold",
+                                       "linear"};
+const int converter_types[] = {SRC_SINC_BEST_QUALITY, SRC_SINC_MEDIUM_QUALITY,
+                               SRC_SINC_FASTEST, SRC_ZERO_ORDER_HOLD,
+                               SRC_LINEAR};
+const int channel_counts[] = {1, 2, 8};
+const long block_sizes[] = {64, 512, 4096};
+
+// Best time per block in nanoseconds over 3 runs of at least 3 blocks and
+// `min_time` seconds each, streaming the same block through `state`.
+double time_per_block(SRC_STATE *state, std::vector<float> &input,
+                      std::vector<float> &output, long frames, long max_frames,
+                      double ratio, double min_time) {
+  double best = std::numeric_limits<double>::infinity();
+  for (int run = 0; run < 3; ++run) {
+    long blocks = 0;
+    double ns = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    do {
+      SRC_DATA data = {input.data(), output.data(), frames, max_frames, 0, 0,
+                       0, ratio};
+      const int err = src_process(state, &data);
+      if (err != 0) {
+        std::fprintf(stderr, "src_process failed: %s\n", src_strerror(err));
+        std::exit(1);
+      }
+      ++blocks;
+      ns = std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now() - start)
+               .count();
+    } while (blocks < 3 || ns < min_time * 1e9);
+    best = std::min(best, ns / blocks);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  double min_time = 0.05;
+  double ratio = 48000.0 / 44100.0;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+      min_time = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--ratio") == 0 && i + 1 < argc) {
+      ratio = std::atof(argv[++i]);
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--min-time SECONDS] [--ratio RATIO]\n",
+                   argv[0]);
+      return 2;
+    }
+  }
+  if (!src_is_valid_ratio(ratio)) {
+    std::fprintf(stderr, "invalid conversion ratio %g\n", ratio);
+    return 2;
+  }
+
+  std::printf("{\n  \"libsamplerate_version\": \"%s\",\n", src_get_version());
+  std::printf("  \"ratio\": %.17g,\n  \"min_time\": %g,\n", ratio, min_time);
+  std::printf("  \"results\": [");
+  bool first = true;
+  for (size_t t = 0; t < sizeof(converter_types) / sizeof(int); ++t) {
+    for (int channels : channel_counts) {
+      for (long frames : block_sizes) {
+        int err = 0;
+        SRC_STATE *state = src_new(converter_types[t], channels, &err);
+        if (state == nullptr) {
+          std::fprintf(stderr, "src_new failed: %s\n", src_strerror(err));
+          return 1;
+        }
+        std::vector<float> input(static_cast<size_t>(frames * channels));
+        samplerate::fill_noise(input);
+        const long max_frames = static_cast<long>(frames * ratio) + 64;
+        std::vector<float> output(static_cast<size_t>(max_frames * channels));
+
+        const double ns = time_per_block(state, input, output, frames,
+                                         max_frames, ratio, min_time);
+        src_delete(state);
+
+        std::printf(
+            "%s\n    {\"converter_type\": \"%s\", \"channels\": %d, "
+            "\"block_frames\": %ld, \"native_ns\": %.1f, "
+            "\"native_frames_per_second\": %.1f}",
+            first ? "" : ",", converter_names[t], channels, frames, ns,
+            frames * 1e9 / ns);
+        first = false;
+      }
+    }
+  }
+  std::printf("\n  ]\n}\n");
+  return 0;
+}
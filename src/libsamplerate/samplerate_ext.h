@@ -0,0 +1,72 @@
+// Extensions built from libsamplerate's private sources, which this project
+// fetches and builds from source, see external/CMakeLists.txt. They work on
+// the SRC_STATE of libsamplerate's public API.
+
+#ifndef SAMPLERATE_EXT_H
+#define SAMPLERATE_EXT_H
+
+#include <samplerate.h>
+#include <stddef.h>
+
+// The libsamplerate version whose private sources these extensions are
+// written against, checked against the one built, see samplerate.cpp.
+#define SAMPLERATE_EXT_LIBSAMPLERATE_VERSION "0.2.2"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// libsamplerate's sinc converters compiled for AVX2 and FMA, see
+// sinc_isa.c. Takes the arguments of src_new for the sinc converter types,
+// and may only run on CPUs with AVX2 and FMA.
+SRC_STATE *sinc_isa_state_new_avx2(int converter_type, int channels,
+                                   int *error);
+
+// Layout of SINC_FILTER, the private state of libsamplerate's sinc
+// converters, taken from the private sinc build of sinc_isa.c so that
+// src_state.c does not compile the sinc converters once more.
+typedef struct {
+  int magic_marker;
+  // offsets of the int fields
+  size_t magic_marker_offset, b_current_offset, b_end_offset,
+      b_real_end_offset, b_len_offset;
+  // of the double fields
+  size_t src_ratio_offset, input_index_offset;
+  // of the float * field
+  size_t buffer_offset;
+} SINC_FILTER_LAYOUT;
+
+extern const SINC_FILTER_LAYOUT sinc_filter_layout;
+
+// Position of a converter, saved by src_state_save along with the samples
+// it buffers, see src_state.c.
+typedef struct {
+  double last_ratio, last_position;
+  // the sinc converters
+  double src_ratio, input_index;
+  long b_current, b_end, b_real_end;
+  // the linear and zero order hold converters
+  int dirty;
+} SRC_STATE_POSITION;
+
+// Number of samples src_state_save copies from `state`, a converter of
+// `converter_type`, or -1 if it is not one.
+long src_state_samples(const SRC_STATE *state, int converter_type);
+
+// Save the position of `state` and its src_state_samples() samples into
+// `samples`, which need not be aligned. Returns an error code.
+int src_state_save(const SRC_STATE *state, int converter_type,
+                   SRC_STATE_POSITION *position, void *samples);
+
+// Restore `state` to the position and `count` samples saved from a
+// converter of the same type and channels, without allocating. Returns an
+// error code, leaving `state` as it was, if they do not fit `state`.
+int src_state_restore(SRC_STATE *state, int converter_type,
+                      const SRC_STATE_POSITION *position, const void *samples,
+                      long count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SAMPLERATE_EXT_H
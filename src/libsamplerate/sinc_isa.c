@@ -0,0 +1,67 @@
+// libsamplerate's sinc converters compiled again for the instruction set
+// named by SINC_ISA, e.g. -DSINC_ISA=avx2 along with -mavx2 -mfma. Their
+// convolution loops are the hot path of the default converters. The module
+// creates its sinc states from the build matching the SIMD kernels selected
+// at import, see new_src_state() in samplerate.cpp. The states are used
+// through libsamplerate's public API like any other, they only carry their
+// own process functions.
+//
+// This is the only private build of the sinc converters: off x86 it is
+// compiled with SINC_ISA=generic and no flags, for sinc_filter_layout alone.
+
+#ifndef SINC_ISA
+#error "SINC_ISA must name the instruction set, see CMakeLists.txt"
+#endif
+
+#define SINC_ISA_NAME_(name, isa) name##_##isa
+#define SINC_ISA_NAME(name, isa) SINC_ISA_NAME_(name, isa)
+
+// keep the public symbols of src_sinc.c apart from libsamplerate's own
+#define sinc_state_new SINC_ISA_NAME(sinc_state_new_internal, SINC_ISA)
+#define sinc_get_name SINC_ISA_NAME(sinc_get_name, SINC_ISA)
+#define sinc_get_description SINC_ISA_NAME(sinc_get_description, SINC_ISA)
+
+#include "src_sinc.c"
+
+#include "samplerate_ext.h"
+
+// the types src_state.c accesses the fields with
+#define SINC_FIELD_IS(name, type)                                  \
+  typedef char sinc_field_##name##_check                           \
+      [sizeof(((SINC_FILTER *)0)->name) == sizeof(type) ? 1 : -1]
+SINC_FIELD_IS(sinc_magic_marker, int);
+SINC_FIELD_IS(b_current, int);
+SINC_FIELD_IS(b_end, int);
+SINC_FIELD_IS(b_real_end, int);
+SINC_FIELD_IS(b_len, int);
+SINC_FIELD_IS(src_ratio, double);
+SINC_FIELD_IS(input_index, double);
+SINC_FIELD_IS(buffer, float *);
+
+const SINC_FILTER_LAYOUT sinc_filter_layout = {
+    SINC_MAGIC_MARKER,
+    offsetof(SINC_FILTER, sinc_magic_marker),
+    offsetof(SINC_FILTER, b_current),
+    offsetof(SINC_FILTER, b_end),
+    offsetof(SINC_FILTER, b_real_end),
+    offsetof(SINC_FILTER, b_len),
+    offsetof(SINC_FILTER, src_ratio),
+    offsetof(SINC_FILTER, input_index),
+    offsetof(SINC_FILTER, buffer),
+};
+
+SRC_STATE *SINC_ISA_NAME(sinc_isa_state_new, SINC_ISA)(int converter_type,
+                                                       int channels,
+                                                       int *error) {
+  SRC_ERROR temp_error = SRC_ERR_NO_ERROR;
+  SRC_STATE *state;
+
+  // checked by src_new before it calls sinc_state_new
+  if (channels < 1) {
+    *error = SRC_ERR_BAD_CHANNEL_COUNT;
+    return NULL;
+  }
+  state = sinc_state_new(converter_type, channels, &temp_error);
+  *error = (int)temp_error;
+  return state;
+}
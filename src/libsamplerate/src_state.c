@@ -0,0 +1,151 @@
+// Save and restore the state of libsamplerate's converters in place, see
+// samplerate_ext.h. libsamplerate only copies a state into a new one with
+// src_clone, so the private structs of its converters are taken from their
+// sources. The sinc converters are not compiled again here, their layout
+// comes from the private sinc build, see sinc_filter_layout in sinc_isa.c.
+// The small linear and zero order hold converters are compiled once more
+// with their public symbols renamed, like sinc_isa.c does.
+
+// keep the public symbols of the converters apart from libsamplerate's own
+#define linear_state_new linear_state_new_src_state
+#define linear_get_name linear_get_name_src_state
+#define linear_get_description linear_get_description_src_state
+#define zoh_state_new zoh_state_new_src_state
+#define zoh_get_name zoh_get_name_src_state
+#define zoh_get_description zoh_get_description_src_state
+
+#include "src_linear.c"
+#include "src_zoh.c"
+
+#include <math.h>
+
+#include "samplerate_ext.h"
+
+static int is_sinc(int converter_type) {
+  return converter_type == SRC_SINC_BEST_QUALITY ||
+         converter_type == SRC_SINC_MEDIUM_QUALITY ||
+         converter_type == SRC_SINC_FASTEST;
+}
+
+// The field `name` of type `type` of the SINC_FILTER at `filter`.
+#define SINC_FIELD(filter, type, name) \
+  (*(type *)((filter) + sinc_filter_layout.name##_offset))
+
+static char *sinc_filter(const SRC_STATE *state) {
+  char *filter = (char *)state->private_data;
+  return filter != NULL && SINC_FIELD(filter, int, magic_marker) ==
+                               sinc_filter_layout.magic_marker
+             ? filter
+             : NULL;
+}
+
+static LINEAR_DATA *linear_data(const SRC_STATE *state) {
+  LINEAR_DATA *priv = (LINEAR_DATA *)state->private_data;
+  return priv != NULL && priv->linear_magic_marker == LINEAR_MAGIC_MARKER
+             ? priv
+             : NULL;
+}
+
+static ZOH_DATA *zoh_data(const SRC_STATE *state) {
+  ZOH_DATA *priv = (ZOH_DATA *)state->private_data;
+  return priv != NULL && priv->zoh_magic_marker == ZOH_MAGIC_MARKER ? priv
+                                                                     : NULL;
+}
+
+long src_state_samples(const SRC_STATE *state, int converter_type) {
+  if (state == NULL) return -1;
+  if (is_sinc(converter_type)) {
+    char *filter = sinc_filter(state);
+    return filter != NULL ? SINC_FIELD(filter, int, b_end) : -1;
+  }
+  if (converter_type == SRC_LINEAR)
+    return linear_data(state) != NULL ? state->channels : -1;
+  if (converter_type == SRC_ZERO_ORDER_HOLD)
+    return zoh_data(state) != NULL ? state->channels : -1;
+  return -1;
+}
+
+int src_state_save(const SRC_STATE *state, int converter_type,
+                   SRC_STATE_POSITION *position, void *samples) {
+  const long count = src_state_samples(state, converter_type);
+  if (count < 0) return SRC_ERR_BAD_STATE;
+
+  memset(position, 0, sizeof(*position));
+  position->last_ratio = state->last_ratio;
+  position->last_position = state->last_position;
+  if (is_sinc(converter_type)) {
+    // the buffer past b_end is written before it is read again
+    char *filter = sinc_filter(state);
+    position->src_ratio = SINC_FIELD(filter, double, src_ratio);
+    position->input_index = SINC_FIELD(filter, double, input_index);
+    position->b_current = SINC_FIELD(filter, int, b_current);
+    position->b_end = SINC_FIELD(filter, int, b_end);
+    position->b_real_end = SINC_FIELD(filter, int, b_real_end);
+    memcpy(samples, SINC_FIELD(filter, float *, buffer),
+           (size_t)count * sizeof(float));
+  } else if (converter_type == SRC_LINEAR) {
+    const LINEAR_DATA *priv = linear_data(state);
+    position->dirty = priv->dirty ? 1 : 0;
+    memcpy(samples, priv->last_value, (size_t)count * sizeof(float));
+  } else {
+    const ZOH_DATA *priv = zoh_data(state);
+    position->dirty = priv->dirty ? 1 : 0;
+    memcpy(samples, priv->last_value, (size_t)count * sizeof(float));
+  }
+  return SRC_ERR_NO_ERROR;
+}
+
+int src_state_restore(SRC_STATE *state, int converter_type,
+                      const SRC_STATE_POSITION *position, const void *samples,
+                      long count) {
+  if (src_state_samples(state, converter_type) < 0) return SRC_ERR_BAD_STATE;
+  // the converters check the ratio and index into their buffers by the
+  // position, so anything out of range is rejected before the state changes
+  if (!(position->last_ratio == 0.0 ||
+        src_is_valid_ratio(position->last_ratio)) ||
+      !(position->last_position >= 0.0) || !isfinite(position->last_position))
+    return SRC_ERR_BAD_INTERNAL_STATE;
+
+  if (is_sinc(converter_type)) {
+    char *filter = sinc_filter(state);
+    if (count != position->b_end ||
+        position->b_end > SINC_FIELD(filter, int, b_len) ||
+        position->b_current < 0 || position->b_current > position->b_end ||
+        position->b_real_end < -1 || position->b_real_end > position->b_end ||
+        position->last_position > 1.0 || !isfinite(position->src_ratio) ||
+        !isfinite(position->input_index))
+      return SRC_ERR_BAD_INTERNAL_STATE;
+    if (count == 0) {
+      // the first call expects the zeros the reset puts before its input,
+      // through the converter's own reset for either build
+      src_reset(state);
+    } else {
+      memcpy(SINC_FIELD(filter, float *, buffer), samples,
+             (size_t)count * sizeof(float));
+    }
+    SINC_FIELD(filter, double, src_ratio) = position->src_ratio;
+    SINC_FIELD(filter, double, input_index) = position->input_index;
+    SINC_FIELD(filter, int, b_current) = (int)position->b_current;
+    SINC_FIELD(filter, int, b_end) = (int)position->b_end;
+    SINC_FIELD(filter, int, b_real_end) = (int)position->b_real_end;
+  } else {
+    float *last_value;
+    if (count != state->channels) return SRC_ERR_BAD_INTERNAL_STATE;
+    if (converter_type == SRC_LINEAR) {
+      LINEAR_DATA *priv = linear_data(state);
+      priv->dirty = position->dirty != 0;
+      last_value = priv->last_value;
+    } else {
+      ZOH_DATA *priv = zoh_data(state);
+      priv->dirty = position->dirty != 0;
+      last_value = priv->last_value;
+    }
+    memcpy(last_value, samples, (size_t)count * sizeof(float));
+  }
+  state->last_ratio = position->last_ratio;
+  state->last_position = position->last_position;
+  state->saved_data = NULL;
+  state->saved_frames = 0;
+  state->error = SRC_ERR_NO_ERROR;
+  return SRC_ERR_NO_ERROR;
+}
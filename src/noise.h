@@ -0,0 +1,24 @@
+// Reproducible white noise, shared by samplerate.benchmark(), the GIL
+// threshold calibration and the native benchmark in benchmarks/, so that
+// their timings are taken on the same input.
+
+#ifndef SAMPLERATE_NOISE_H
+#define SAMPLERATE_NOISE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace samplerate {
+
+// Fill `samples` with reproducible white noise in [-1, 1).
+inline void fill_noise(std::vector<float> &samples) {
+  uint32_t seed = 1;
+  for (auto &sample : samples) {
+    seed = seed * 1664525u + 1013904223u;
+    sample = static_cast<float>(seed >> 8) / 8388608.0f - 1.0f;
+  }
+}
+
+}  // namespace samplerate
+
+#endif  // SAMPLERATE_NOISE_H
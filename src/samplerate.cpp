@@ -29,13 +29,70 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <samplerate.h>
+#include <samplerate_ext.h>
 
+#include "noise.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <typeinfo>
 #include <vector>
 
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <immintrin.h>
+#define SAMPLERATE_HAVE_SSE 1
+// AVX2 and AVX-512 kernels are compiled for every x86 build and selected at
+// runtime, see select_kernels().
+#if defined(__GNUC__) || defined(__clang__)
+#define SAMPLERATE_HAVE_AVX 1
+#define SAMPLERATE_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define SAMPLERATE_HAVE_AVX 1
+#define SAMPLERATE_TARGET(isa)
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAMPLERATE_HAVE_NEON 1
+#endif
+
 #ifndef VERSION_INFO
 #define VERSION_INFO "nightly"
 #endif
@@ -65,12 +122,62 @@
 #ifndef LIBSAMPLERATE_VERSION
 #define LIBSAMPLERATE_VERSION "unknown"
 #endif
+
+namespace {
+constexpr bool same_text(const char *a, const char *b) {
+  return *a == *b && (*a == '\0' || same_text(a + 1, b + 1));
+}
+}  // namespace
+
+// src/libsamplerate reads the private state of libsamplerate's converters,
+// whose layout and meaning may change with any release.
+static_assert(same_text(LIBSAMPLERATE_VERSION,
+                        SAMPLERATE_EXT_LIBSAMPLERATE_VERSION),
+              "src/libsamplerate is written against another libsamplerate "
+              "version than LIBSAMPLERATE_VERSION, see samplerate_ext.h");
 #ifndef LTO_ENABLED
 #define LTO_ENABLED 0
 #endif
 
-// This value was empirically and somewhat arbitrarily chosen; increase it for further safety.
-#define END_OF_INPUT_EXTRA_OUTPUT_FRAMES 10000
+// Extra output frames added on top of the computed output bound to absorb
+// the rounding of the fractional input position inside libsamplerate.
+#define OUTPUT_FRAMES_SLACK 4
+
+// Largest conversion ratio accepted by libsamplerate (see common.h there).
+#define SRC_MAX_RATIO 256.0
+
+// libsamplerate error codes (see common.h there) returned by the converters
+// implemented in this module, or for a missing state.
+#define SRC_ERR_MALLOC_FAILED 1
+#define SRC_ERR_BAD_STATE 2
+#define SRC_ERR_BAD_SRC_RATIO 6
+#define SRC_ERR_BAD_CHANNEL_COUNT 11
+
+// Converter types implemented in this module, numbered after libsamplerate's
+// own, see PolyphaseConverter and HalfbandConverter.
+#define POLYPHASE_BEST_QUALITY 5
+#define POLYPHASE_FAST 6
+#define HALFBAND_BEST_QUALITY 7
+#define HALFBAND_FAST 8
+
+// Number of converter types, libsamplerate's and the ones above.
+#define NUM_CONVERTER_TYPES 9
+
+// Largest channel count with its own GIL release thresholds, see
+// gil_release_threshold().
+#define GIL_THRESHOLD_CHANNELS 8
+
+// Largest number of filter phases, i.e. the numerator L of a ratio L / M,
+// and largest M, for which a polyphase filter bank is built.
+#define MAX_POLYPHASE_PHASES 1024
+
+// A ratio is treated as exactly L / M if the output position drifts by less
+// than 1e-6 frames over this many input frames.
+#define POLYPHASE_EXACT_FRAMES 100000000L
+
+// Largest number of half-band stages of a HalfbandConverter, i.e. ratios
+// from 1 / 16 to 16.
+#define MAX_HALFBAND_STAGES 4
 
 // Minimum number of input frames before releasing the GIL during resampling
 // when using automatic GIL management. Releasing and re-acquiring the GIL has
@@ -80,51 +187,168 @@
 // with multi-threaded performance (allowing parallelism for large data).
 // Empirically chosen based on benchmarks showing that at 1000 frames, the GIL
 // overhead is < 1% of total execution time for even the fastest converter types.
-long gil_release_threshold_frames = 1000;
+std::atomic<long> gil_release_threshold_frames{1000};
 
 namespace py = pybind11;
 using namespace pybind11::literals;
 
-using callback_t =
-    std::function<py::array_t<float, py::array::c_style | py::array::forcecast>(
-        void)>;
+using callback_t = std::function<py::object(void)>;
 using np_array_f32 =
     py::array_t<float, py::array::c_style | py::array::forcecast>;
 
 namespace samplerate {
 
+// GIL release thresholds in frames overriding gil_release_threshold_frames,
+// per converter type, for any number of channels at index 0 and for c
+// channels at index c. Negative when not set.
+std::atomic<long>
+    gil_release_thresholds[NUM_CONVERTER_TYPES][GIL_THRESHOLD_CHANNELS + 1];
+
+void clear_gil_release_thresholds() {
+  for (auto &per_type : gil_release_thresholds)
+    for (auto &threshold : per_type)
+      threshold.store(-1, std::memory_order_relaxed);
+}
+
+// The GIL release threshold of a converter type and channel count, falling
+// back to the type's, then to the global threshold. A negative type or a
+// zero channel count skips the corresponding lookup.
+long gil_release_threshold(int converter_type, int channels) {
+  if (converter_type >= 0 && converter_type < NUM_CONVERTER_TYPES) {
+    const auto &per_type = gil_release_thresholds[converter_type];
+    if (channels > 0 && channels <= GIL_THRESHOLD_CHANNELS) {
+      const long threshold =
+          per_type[channels].load(std::memory_order_relaxed);
+      if (threshold >= 0) return threshold;
+    }
+    const long threshold = per_type[0].load(std::memory_order_relaxed);
+    if (threshold >= 0) return threshold;
+  }
+  return gil_release_threshold_frames.load(std::memory_order_relaxed);
+}
+
 // Helper to determine if GIL should be released based on user preference
 // and data size. The release_gil parameter can be:
-//   - py::none() or "auto": Release GIL only for large data (>= threshold)
+//   - py::none() or "auto": Release GIL only for large data (>= threshold of
+//     the converter type and channel count)
 //   - True: Always release GIL (good for multi-threaded applications)
 //   - False: Never release GIL (good for single-threaded, small data)
-bool should_release_gil(const py::object &release_gil, long num_frames) {
+bool should_release_gil(const py::object &release_gil, long num_frames,
+                        int converter_type = -1, int channels = 0) {
   if (release_gil.is_none()) {
     // "auto" mode: release GIL only for large data sizes
-    return num_frames >= gil_release_threshold_frames;
+    return num_frames >= gil_release_threshold(converter_type, channels);
   } else if (py::isinstance<py::bool_>(release_gil)) {
     return release_gil.cast<bool>();
   } else if (py::isinstance<py::str>(release_gil)) {
     std::string s = release_gil.cast<std::string>();
     if (s == "auto") {
-      return num_frames >= gil_release_threshold_frames;
+      return num_frames >= gil_release_threshold(converter_type, channels);
     }
     throw std::domain_error("Invalid release_gil value. Use True, False, None, or 'auto'.");
   }
   throw std::domain_error("Invalid release_gil type. Use True, False, None, or 'auto'.");
 }
 
+// should_release_gil for a conversion on `threads` threads. Worker threads
+// are only useful if other Python threads can run meanwhile, so the GIL is
+// always released for more than one thread.
+bool should_release_gil_parallel(const py::object &release_gil,
+                                 size_t threads, long num_frames,
+                                 int converter_type = -1, int channels = 0) {
+  return threads > 1 || should_release_gil(release_gil, num_frames,
+                                           converter_type, channels);
+}
+
+// Nanoseconds elapsed since `start`.
+uint64_t elapsed_ns(const std::chrono::steady_clock::time_point &start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+// Performance counters of a resampler, or of the module-level functions.
+// Relaxed atomics keep them cheap enough to stay enabled, and let worker
+// threads and concurrent calls update them without a lock.
+struct Stats {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> input_frames{0};
+  std::atomic<uint64_t> output_frames{0};
+  std::atomic<uint64_t> process_ns{0};
+  std::atomic<uint64_t> max_process_ns{0};
+  std::atomic<uint64_t> gil_released{0};
+  std::atomic<uint64_t> gil_held{0};
+  std::atomic<uint64_t> callback_calls{0};
+  std::atomic<uint64_t> callback_ns{0};
+
+  void count_call() { calls.fetch_add(1, std::memory_order_relaxed); }
+
+  // Account for one conversion run of `ns` nanoseconds.
+  void record(long frames_in, long frames_out, uint64_t ns, bool released) {
+    input_frames.fetch_add(static_cast<uint64_t>(frames_in),
+                           std::memory_order_relaxed);
+    output_frames.fetch_add(static_cast<uint64_t>(frames_out),
+                            std::memory_order_relaxed);
+    process_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max_ns = max_process_ns.load(std::memory_order_relaxed);
+    while (ns > max_ns &&
+           !max_process_ns.compare_exchange_weak(max_ns, ns,
+                                                 std::memory_order_relaxed)) {
+    }
+    (released ? gil_released : gil_held)
+        .fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void record_callback(uint64_t ns) {
+    callback_calls.fetch_add(1, std::memory_order_relaxed);
+    callback_ns.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  void reset() {
+    for (auto counter : {&calls, &input_frames, &output_frames, &process_ns,
+                         &max_process_ns, &gil_released, &gil_held,
+                         &callback_calls, &callback_ns})
+      counter->store(0, std::memory_order_relaxed);
+  }
+
+  py::dict to_dict(bool with_callback = false) const {
+    py::dict stats;
+    stats["calls"] = calls.load(std::memory_order_relaxed);
+    stats["input_frames"] = input_frames.load(std::memory_order_relaxed);
+    stats["output_frames"] = output_frames.load(std::memory_order_relaxed);
+    stats["process_ns"] = process_ns.load(std::memory_order_relaxed);
+    stats["max_process_ns"] = max_process_ns.load(std::memory_order_relaxed);
+    stats["gil_released"] = gil_released.load(std::memory_order_relaxed);
+    stats["gil_held"] = gil_held.load(std::memory_order_relaxed);
+    if (with_callback) {
+      stats["callback_calls"] = callback_calls.load(std::memory_order_relaxed);
+      stats["callback_ns"] = callback_ns.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+};
+
+// counters of `resample` and `resample_batch`
+Stats global_stats;
+
 enum class ConverterType {
   sinc_best,
   sinc_medium,
   sinc_fastest,
   zero_order_hold,
-  linear
+  linear,
+  polyphase_best,
+  polyphase_fast,
+  halfband_best,
+  halfband_fast
 };
 
 class ResamplingException : public std::exception {
  public:
   explicit ResamplingException(int err_num) : message{src_strerror(err_num)} {}
+  // an error passed on from another process, see SharedMemoryResampler
+  explicit ResamplingException(const std::string &what) : message{what} {}
   const char *what() const noexcept override { return message.c_str(); }
 
  private:
@@ -145,6 +369,14 @@ int get_converter_type(const py::object &obj) {
       return 3;
     } else if (s.compare("linear") == 0) {
       return 4;
+    } else if (s.compare("polyphase_best") == 0) {
+      return POLYPHASE_BEST_QUALITY;
+    } else if (s.compare("polyphase_fast") == 0) {
+      return POLYPHASE_FAST;
+    } else if (s.compare("halfband_best") == 0) {
+      return HALFBAND_BEST_QUALITY;
+    } else if (s.compare("halfband_fast") == 0) {
+      return HALFBAND_FAST;
     }
   } else if (py::isinstance<py::int_>(obj)) {
     py::int_ val = obj;
@@ -158,6 +390,12 @@ int get_converter_type(const py::object &obj) {
   return -1;
 }
 
+// Names of the converter types, as accepted by get_converter_type.
+const char *const converter_type_names[NUM_CONVERTER_TYPES] = {
+    "sinc_best",      "sinc_medium",    "sinc_fastest",
+    "zero_order_hold", "linear",        "polyphase_best",
+    "polyphase_fast",  "halfband_best", "halfband_fast"};
+
 void error_handler(int errnum) {
   if (errnum > 0 && errnum < 24) {
     throw ResamplingException(errnum);
@@ -168,433 +406,7248 @@ void error_handler(int errnum) {
   }
 }
 
-class Resampler {
- private:
-  SRC_STATE *_state = nullptr;
-
- public:
-  int _converter_type = 0;
-  int _channels = 0;
-
- public:
-  Resampler(const py::object &converter_type, int channels)
-      : _converter_type(get_converter_type(converter_type)),
-        _channels(channels) {
-    int _err_num = 0;
-    _state = src_new(_converter_type, _channels, &_err_num);
-    error_handler(_err_num);
-  }
-
-  // copy constructor
-  Resampler(const Resampler &r)
-      : _converter_type(r._converter_type), _channels(r._channels) {
-    int _err_num = 0;
-    _state = src_clone(r._state, &_err_num);
-    error_handler(_err_num);
-  }
+// Filter design of a polyphase converter: a Kaiser windowed sinc with `taps`
+// taps per phase at ratios >= 1 and its cutoff in cycles per input sample.
+// Downsampling scales the cutoff by the ratio and the taps by its inverse.
+struct PolyphaseDesign {
+  int taps;
+  double cutoff;
+  double beta;        // Kaiser window parameter
+  int fallback_type;  // libsamplerate converter used for other ratios
+};
 
-  // move constructor
-  Resampler(Resampler &&r)
-      : _state(r._state),
-        _converter_type(r._converter_type),
-        _channels(r._channels) {
-    r._state = nullptr;
-    r._converter_type = 0;
-    r._channels = 0;
-  }
+bool is_polyphase(int converter_type) {
+  return converter_type == POLYPHASE_BEST_QUALITY ||
+         converter_type == POLYPHASE_FAST;
+}
 
-  ~Resampler() { src_delete(_state); }  // src_delete handles nullptr case
+const PolyphaseDesign &polyphase_design(int converter_type) {
+  // passband up to 90% of the Nyquist frequency, ~140 dB stopband
+  static const PolyphaseDesign best = {192, 0.475, 14.5,
+                                       SRC_SINC_BEST_QUALITY};
+  // passband up to 80% of the Nyquist frequency, ~100 dB stopband
+  static const PolyphaseDesign fast = {64, 0.45, 10.0, SRC_SINC_FASTEST};
+  return converter_type == POLYPHASE_BEST_QUALITY ? best : fast;
+}
 
-  py::array_t<float, py::array::c_style> process(
-      const py::array_t<float, py::array::c_style | py::array::forcecast> &input,
-      double sr_ratio, bool end_of_input,
-      const py::object &release_gil = py::none()) {
-    // accessors for the arrays
-    py::buffer_info inbuf = input.request();
+// Taps per phase of a polyphase filter, a multiple of 8 for the SIMD kernel.
+int polyphase_taps(const PolyphaseDesign &design, double ratio) {
+  double taps = design.taps;
+  if (ratio > 0.0 && ratio < 1.0) taps /= ratio;
+  return static_cast<int>(std::ceil(taps / 8.0)) * 8;
+}
 
-    // set the number of channels
-    int channels = 1;
-    if (inbuf.ndim == 2)
-      channels = inbuf.shape[1];
-    else if (inbuf.ndim > 2)
-      throw std::domain_error("Input array should have at most 2 dimensions");
+// Filter design of a half-band cascade: the passband as a fraction of the
+// Nyquist frequency of the lower rate, and the stopband attenuation in dB.
+// Each stage gets the shortest filter meeting both, so the stages next to
+// the higher rate, which have a wider transition band, are much shorter.
+struct HalfbandDesign {
+  double passband;
+  double attenuation;
+  int fallback_type;  // polyphase converter used for other ratios
+};
 
-    if (channels != _channels || channels == 0)
-      throw std::domain_error("Invalid number of channels in input data.");
+bool is_halfband(int converter_type) {
+  return converter_type == HALFBAND_BEST_QUALITY ||
+         converter_type == HALFBAND_FAST;
+}
 
-    // Add a "fudge factor" to the size. This is because the actual number of
-    // output samples generated on the last call when input is terminated can
-    // be more than the expected number of output samples during mid-stream
-    // steady-state processing. (Also, when the stream is started, the number
-    // of output samples generated will generally be zero or otherwise less
-    // than the number of samples in mid-stream processing.)
-    const auto new_size =
-        static_cast<size_t>(std::ceil(inbuf.shape[0] * sr_ratio))
-        + END_OF_INPUT_EXTRA_OUTPUT_FRAMES;
+const HalfbandDesign &halfband_design(int converter_type) {
+  // the passband and stopband of the polyphase converters
+  static const HalfbandDesign best = {0.9, 140.0, POLYPHASE_BEST_QUALITY};
+  static const HalfbandDesign fast = {0.8, 100.0, POLYPHASE_FAST};
+  return converter_type == HALFBAND_BEST_QUALITY ? best : fast;
+}
 
-    // allocate output array
-    std::vector<size_t> out_shape{new_size};
-    if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(channels));
-    auto output = py::array_t<float, py::array::c_style>(out_shape);
-    py::buffer_info outbuf = output.request();
+// Nonzero taps of the half-band filter of cascade level `level`, 1 for the
+// stage next to the lower rate, a multiple of 8 for the SIMD kernel. The
+// Kaiser estimate of the filter length is halved, as every other tap of a
+// half-band filter is zero.
+int halfband_taps(const HalfbandDesign &design, int level) {
+  const double transition = 0.5 - design.passband / (1 << level);
+  const double length = (design.attenuation - 8.0) /
+                        (2.285 * 2.0 * 3.14159265358979323846 * transition);
+  return std::max(8, static_cast<int>(std::ceil(length / 16.0)) * 8);
+}
 
-    // libsamplerate struct
-    SRC_DATA src_data = {
-        static_cast<float *>(inbuf.ptr),   // data_in
-        static_cast<float *>(outbuf.ptr),  // data_out
-        static_cast<long>(inbuf.shape[0]), // input_frames
-        long(new_size),                    // output_frames
-        0,             // input_frames_used, filled by libsamplerate
-        0,             // output_frames_gen, filled by libsamplerate
-        end_of_input,  // end_of_input, not used by src_simple ?
-        sr_ratio       // src_ratio, sampling rate conversion ratio
-    };
+// Number of half-band stages converting by `ratio`, 0 if it is not a power
+// of two covered by a cascade.
+int halfband_stages(double ratio) {
+  int exponent;
+  if (!(ratio > 0.0) || std::frexp(ratio, &exponent) != 0.5) return 0;
+  const int stages = std::abs(exponent - 1);
+  return stages <= MAX_HALFBAND_STAGES ? stages : 0;
+}
 
-    // Perform resampling with optional GIL release
-    auto do_resample = [&]() {
-      return src_process(_state, &src_data);
-    };
+// The libsamplerate converter backing a converter type.
+int src_converter_type(int converter_type) {
+  if (is_halfband(converter_type))
+    converter_type = halfband_design(converter_type).fallback_type;
+  return is_polyphase(converter_type)
+             ? polyphase_design(converter_type).fallback_type
+             : converter_type;
+}
 
-    int err_code;
-    if (should_release_gil(release_gil, inbuf.shape[0])) {
-      py::gil_scoped_release release;
-      err_code = do_resample();
+// Number of input frames a converter may hold back before they show up in
+// the output, i.e. the half length of its filter. For the sinc converters
+// this is (coeff_half_len + 2) / index_inc (+1) as computed in libsamplerate's
+// src_sinc.c from the coefficient tables, rounded up. The filter is widened
+// by 1 / ratio when downsampling. The zero order hold and linear converters
+// only keep the last frame. The polyphase converters may fall back to a sinc
+// converter, so the larger of both counts, and likewise the half-band
+// cascades, whose stages hold back their half length at their own rate.
+long converter_history_frames(int converter_type, double min_ratio) {
+  if (is_halfband(converter_type)) {
+    const HalfbandDesign &design = halfband_design(converter_type);
+    long frames = 0;
+    if (min_ratio > 0.0 && min_ratio < 1.0) {
+      const int stages = std::min<int>(
+          MAX_HALFBAND_STAGES,
+          static_cast<int>(std::ceil(-std::log2(min_ratio))));
+      for (int level = 1; level <= stages; ++level)
+        frames += halfband_taps(design, level) << (stages - level);
     } else {
-      err_code = do_resample();
-    }
-    long output_frames_gen = src_data.output_frames_gen;
-    error_handler(err_code);
-
-    // create a shorter view of the array
-    if ((size_t)output_frames_gen < new_size) {
-      out_shape[0] = output_frames_gen;
-      output.resize(out_shape);
-    } else if ((size_t)output_frames_gen >= new_size) {
-      // This means our fudge factor is too small.
-      throw std::runtime_error("Generated more output samples than expected!");
+      frames = halfband_taps(design, 1);
     }
-
-    return output;
+    return std::max<long>(
+        frames + 1, converter_history_frames(design.fallback_type, min_ratio));
+  }
+  if (is_polyphase(converter_type)) {
+    const PolyphaseDesign &design = polyphase_design(converter_type);
+    return std::max<long>(
+        polyphase_taps(design, min_ratio) / 2 + 1,
+        converter_history_frames(design.fallback_type, min_ratio));
   }
 
-  void set_ratio(double new_ratio) {
-    error_handler(src_set_ratio(_state, new_ratio));
+  double half_len;
+  switch (converter_type) {
+    case SRC_SINC_BEST_QUALITY:
+      half_len = 145.0;
+      break;
+    case SRC_SINC_MEDIUM_QUALITY:
+      half_len = 48.0;
+      break;
+    case SRC_SINC_FASTEST:
+      half_len = 21.0;
+      break;
+    default:
+      return 1;
   }
+  if (min_ratio > 0.0 && min_ratio < 1.0) half_len /= min_ratio;
+  return static_cast<long>(std::ceil(half_len));
+}
 
-  void reset() { error_handler(src_reset(_state)); }
+// Upper bound on the number of output frames one call to src_process can
+// generate from `input_frames` new frames. In steady state a converter emits
+// about `input_frames * ratio` frames per call. The frames it holds back are
+// only released on the end-of-input flush, or when a ratio change narrows
+// the filter, so only then is the filter history added. `last_ratio` is the
+// ratio of the previous call, or 0 if unknown.
+long max_output_frames(long input_frames, double ratio, double last_ratio,
+                       int converter_type, bool end_of_input) {
+  if (last_ratio <= 0.0) last_ratio = ratio;
+  double max_ratio = std::max(ratio, last_ratio);
+  const double min_ratio = std::min(ratio, last_ratio);
 
-  Resampler clone() const { return Resampler(*this); }
-};
+  // invalid ratios are rejected by libsamplerate, just keep the bound sane
+  if (!(max_ratio > 0.0)) max_ratio = 0.0;
+  if (max_ratio > SRC_MAX_RATIO) max_ratio = SRC_MAX_RATIO;
 
-namespace {
+  double frames = static_cast<double>(std::max(input_frames, 0L));
+  if (end_of_input || ratio != last_ratio)
+    frames += converter_history_frames(converter_type, min_ratio);
 
-long the_callback_func(void *cb_data, float **data);
+  return static_cast<long>(std::ceil(frames * max_ratio)) + OUTPUT_FRAMES_SLACK;
+}
 
-}  // namespace
+// Find integers p / q == ratio with q <= max_denominator using continued
+// fractions. The approximation must be close enough that the phase of the
+// last of `input_frames` frames is off by less than 1e-6 frames.
+bool rational_ratio(double ratio, long input_frames, long max_denominator,
+                    long *p, long *q) {
+  if (!(ratio > 0.0)) return false;
+  long p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+  double x = ratio;
+  for (int i = 0; i < 64; ++i) {
+    const double a = std::floor(x);
+    if (a > 1e9) break;
+    const long p2 = static_cast<long>(a) * p1 + p0;
+    const long q2 = static_cast<long>(a) * q1 + q0;
+    if (q2 > max_denominator) break;
+    p0 = p1, q0 = q1, p1 = p2, q1 = q2;
+    const double error =
+        p1 > 0 ? std::fabs(1.0 / ratio - double(q1) / double(p1)) : 1.0;
+    if (error * input_frames < 1e-6) {
+      *p = p1;
+      *q = q1;
+      return true;
+    }
+    if (x - a < 1e-12) break;
+    x = 1.0 / (x - a);
+  }
+  return false;
+}
 
-class CallbackResampler {
- private:
-  SRC_STATE *_state = nullptr;
-  callback_t _callback = nullptr;
-  np_array_f32 _current_buffer;
-  size_t _buffer_ndim = 0;
-  std::string _callback_error_msg = "";
+struct ConverterSnapshot;
 
+// A streaming sample rate converter. The methods mirror libsamplerate's
+// src_process, src_set_ratio, src_reset and src_clone and return its error
+// codes, so every converter type is driven the same way.
+class Converter {
  public:
-  double _ratio = 0.0;
-  int _converter_type = 0;
-  size_t _channels = 0;
+  virtual ~Converter() {}
+  virtual int process(SRC_DATA *data) = 0;
+  virtual int set_ratio(double new_ratio) = 0;
+  virtual int reset() = 0;
+  // returns nullptr and sets `error` on failure
+  virtual Converter *clone(int *error) const = 0;
+  // Save the state into `snapshot`, reusing its buffers, and restore the
+  // state saved by a converter of the same type and channels. Both raise
+  // on failure.
+  virtual void save(ConverterSnapshot &snapshot) const = 0;
+  virtual void restore(const ConverterSnapshot &snapshot) = 0;
+};
+
+[[noreturn]] void invalid_snapshot() {
+  throw std::domain_error("Invalid snapshot for this resampler.");
+}
 
+// Writes a state as fixed size values and float samples in native byte
+// order, see ConverterSnapshot.
+class StateWriter {
  private:
-  void _create() {
-    int _err_num = 0;
-    _state = src_callback_new(the_callback_func, _converter_type, (int)_channels,
-                              &_err_num, static_cast<void *>(this));
-    if (_state == nullptr) error_handler(_err_num);
-  }
+  std::vector<char> &_data;
 
-  void _destroy() {
-    if (_state != nullptr) {
-      src_delete(_state);
-      _state = nullptr;
-    }
+  void _append(const void *bytes, size_t size) {
+    const char *first = static_cast<const char *>(bytes);
+    _data.insert(_data.end(), first, first + size);
   }
 
  public:
-  CallbackResampler(const callback_t &callback_func, double ratio,
-                    const py::object &converter_type, size_t channels)
-      : _callback(callback_func),
-        _ratio(ratio),
-        _converter_type(get_converter_type(converter_type)),
-        _channels(channels) {
-    _create();
+  // Starts over, keeping the capacity of `data`.
+  explicit StateWriter(std::vector<char> &data) : _data(data) {
+    _data.clear();
   }
 
-  // copy constructor
-  CallbackResampler(const CallbackResampler &r)
-      : _callback(r._callback),
-        _ratio(r._ratio),
-        _converter_type(r._converter_type),
-        _channels(r._channels) {
-    int _err_num = 0;
-    _state = src_clone(r._state, &_err_num);
-    if (_state == nullptr) error_handler(_err_num);
+  template <typename T>
+  void put(T value) {
+    _append(&value, sizeof(T));
   }
 
-  // move constructor
-  CallbackResampler(CallbackResampler &&r)
-      : _state(r._state),
-        _callback(r._callback),
-        _current_buffer(std::move(r._current_buffer)),
-        _buffer_ndim(r._buffer_ndim),
-        _callback_error_msg(std::move(r._callback_error_msg)),
-        _ratio(r._ratio),
-        _converter_type(r._converter_type),
-        _channels(r._channels) {
-    r._state = nullptr;
-    r._callback = nullptr;
-    r._buffer_ndim = 0;
-    r._ratio = 0.0;
-    r._converter_type = 0;
-    r._channels = 0;
+  void put_samples(const float *samples, long count) {
+    _append(samples, static_cast<size_t>(count) * sizeof(float));
   }
 
-  ~CallbackResampler() { _destroy(); }
-
-  void set_buffer(const np_array_f32 &new_buf) { _current_buffer = new_buf; }
-  size_t get_channels() { return _channels; }
-  void set_callback_error(const std::string &error_msg) {
-    _callback_error_msg = error_msg;
+  // Room for `count` samples, filled by the caller before the next put.
+  void *put_samples(long count) {
+    const size_t size = _data.size();
+    _data.resize(size + static_cast<size_t>(count) * sizeof(float));
+    return _data.data() + size;
   }
-  std::string get_callback_error() const { return _callback_error_msg; }
-  void clear_callback_error() { _callback_error_msg = ""; }
 
-  np_array_f32 callback(void) {
-    auto input = _callback();
+  void put_bytes(const std::vector<char> &bytes) {
+    put<uint64_t>(bytes.size());
+    _append(bytes.data(), bytes.size());
+  }
+};
 
-    auto inbuf = input.request();
-    if (_buffer_ndim == 0) _buffer_ndim = inbuf.ndim;
+// Reads a state written by StateWriter, raising on truncated input.
+class StateReader {
+ private:
+  const std::vector<char> &_data;
+  size_t _position = 0;
 
-    _current_buffer = input;
-    return input;
+  const char *_take(size_t size) {
+    if (size > _data.size() - _position) invalid_snapshot();
+    const char *first = _data.data() + _position;
+    _position += size;
+    return first;
   }
 
-  py::array_t<float, py::array::c_style> read(
-      size_t frames, const py::object &release_gil = py::none()) {
-    // allocate output array
-    std::vector<size_t> out_shape{frames, _channels};
-    auto output = py::array_t<float, py::array::c_style>(out_shape);
-    py::buffer_info outbuf = output.request();
-
-    if (_state == nullptr) _create();
+ public:
+  explicit StateReader(const std::vector<char> &data) : _data(data) {}
 
-    // clear any previous callback error
-    clear_callback_error();
+  template <typename T>
+  T get() {
+    T value;
+    std::memcpy(&value, _take(sizeof(T)), sizeof(T));
+    return value;
+  }
 
-    // Perform callback resampling with optional GIL release.
-    // Note: the_callback_func will acquire GIL when calling Python callback.
-    auto do_callback_read = [&]() {
-      size_t gen = src_callback_read(_state, _ratio, (long)frames,
-                                     static_cast<float *>(outbuf.ptr));
-      return std::make_pair(gen, gen == 0 ? src_error(_state) : 0);
-    };
+  // A count of items of `item_size` bytes that must follow it.
+  long get_count(size_t item_size) {
+    const int64_t count = get<int64_t>();
+    if (count < 0 || static_cast<uint64_t>(count) >
+                         (_data.size() - _position) / item_size)
+      invalid_snapshot();
+    return static_cast<long>(count);
+  }
 
-    size_t output_frames_gen;
-    int err_code;
-    if (should_release_gil(release_gil, (long)frames)) {
-      py::gil_scoped_release release;
-      auto result = do_callback_read();
-      output_frames_gen = result.first;
-      err_code = result.second;
-    } else {
-      auto result = do_callback_read();
-      output_frames_gen = result.first;
-      err_code = result.second;
-    }
+  void get_samples(float *samples, long count) {
+    const size_t size = static_cast<size_t>(count) * sizeof(float);
+    std::memcpy(samples, _take(size), size);
+  }
 
-    // check if callback had an error
-    std::string callback_error = get_callback_error();
-    if (!callback_error.empty()) {
-      throw std::domain_error(callback_error);
-    }
+  // The next `count` samples in place, which need not be aligned.
+  const void *get_samples(long count) {
+    return _take(static_cast<size_t>(count) * sizeof(float));
+  }
 
-    // check error status
-    if (output_frames_gen == 0) {
-      error_handler(err_code);
-    }
+  void get_bytes(std::vector<char> &bytes) {
+    const uint64_t size = get<uint64_t>();
+    if (size > _data.size() - _position) invalid_snapshot();
+    const char *first = _take(static_cast<size_t>(size));
+    bytes.assign(first, first + size);
+  }
 
-    // if there is only one channel and the input array had only on dimension
-    // we also output a 1D array
-    if (_channels == 1 && _buffer_ndim == 1) {
-      out_shape.pop_back();
-      output = py::array_t<float, py::array::c_style>(
-          out_shape, static_cast<float *>(outbuf.ptr));
-    }
+  // Raise if anything is left over.
+  void finish() const {
+    if (_position != _data.size()) invalid_snapshot();
+  }
+};
 
-    // create a shorter view of the array
-    if (output_frames_gen < frames) {
-      out_shape[0] = output_frames_gen;
-      output.resize(out_shape);
-    }
+// State of a converter saved by Converter::save. Each converter writes its
+// own state to `data`, and that of the converters it falls back to or
+// wraps to `inner`, in order.
+struct ConverterSnapshot {
+  std::vector<char> data;
+  // the first `inner_count` are used, the others kept for reuse
+  std::vector<std::unique_ptr<ConverterSnapshot>> inner;
+  size_t inner_count = 0;
 
-    return output;
+  // Start a new save, keeping the buffers.
+  void clear() {
+    data.clear();
+    inner_count = 0;
   }
 
-  void set_starting_ratio(double new_ratio) {
-    error_handler(src_set_ratio(_state, new_ratio));
-    _ratio = new_ratio;
+  // The next inner snapshot to save into.
+  ConverterSnapshot &inner_snapshot() {
+    if (inner_count == inner.size()) inner.emplace_back(new ConverterSnapshot);
+    return *inner[inner_count++];
   }
 
-  void reset() { error_handler(src_reset(_state)); }
+  void serialize(StateWriter &out) const {
+    out.put_bytes(data);
+    out.put<uint8_t>(static_cast<uint8_t>(inner_count));
+    for (size_t i = 0; i < inner_count; ++i) inner[i]->serialize(out);
+  }
 
-  CallbackResampler clone() const { return CallbackResampler(*this); }
-  CallbackResampler &__enter__() { return *this; }
-  void __exit__(const py::object &/*exc_type*/, const py::object &/*exc*/,
-                const py::object &/*exc_tb*/) {
-    _destroy();
+  void deserialize(StateReader &in) {
+    clear();
+    in.get_bytes(data);
+    const int count = in.get<uint8_t>();
+    for (int i = 0; i < count; ++i) inner_snapshot().deserialize(in);
   }
 };
 
-namespace {
-
-long the_callback_func(void *cb_data, float **data) {
-  CallbackResampler *cb = static_cast<CallbackResampler *>(cb_data);
-  int cb_channels = cb->get_channels();
+// One of libsamplerate's converters of type `converter_type`.
+class SrcConverter : public Converter {
+ private:
+  SRC_STATE *_state;
+  int _converter_type;
 
-  py::buffer_info inbuf;
-  {
-    py::gil_scoped_acquire acquire;
+ public:
+  SrcConverter(SRC_STATE *state, int converter_type)
+      : _state(state), _converter_type(converter_type) {}
+  SrcConverter(const SrcConverter &) = delete;
+  SrcConverter &operator=(const SrcConverter &) = delete;
+  ~SrcConverter() override { src_delete(_state); }
 
-    // get the data as a numpy array
-    auto input = cb->callback();
-    inbuf = input.request();
+  int process(SRC_DATA *data) override { return src_process(_state, data); }
+  int set_ratio(double new_ratio) override {
+    return src_set_ratio(_state, new_ratio);
+  }
+  int reset() override { return src_reset(_state); }
+  Converter *clone(int *error) const override {
+    SRC_STATE *state = src_clone(_state, error);
+    return state == nullptr ? nullptr : new SrcConverter(state, _converter_type);
   }
 
-  // end of stream is signaled by a None, which is cast to a ndarray with ndim
-  // == 0
-  if (inbuf.ndim == 0) return 0;
+  // The state is the position of the converter and the samples it buffers,
+  // copied in place by src_state_save, see src/libsamplerate/src_state.c.
+  void save(ConverterSnapshot &snapshot) const override {
+    snapshot.clear();
+    const long count = src_state_samples(_state, _converter_type);
+    if (count < 0) error_handler(SRC_ERR_BAD_STATE);
+    StateWriter out(snapshot.data);
+    out.put<int32_t>(_converter_type);
+    out.put<int32_t>(src_get_channels(_state));
+    out.put<int64_t>(count);
+    SRC_STATE_POSITION position;
+    error_handler(src_state_save(_state, _converter_type, &position,
+                                 out.put_samples(count)));
+    out.put(position.last_ratio);
+    out.put(position.last_position);
+    out.put(position.src_ratio);
+    out.put(position.input_index);
+    out.put<int64_t>(position.b_current);
+    out.put<int64_t>(position.b_end);
+    out.put<int64_t>(position.b_real_end);
+    out.put<int32_t>(position.dirty);
+  }
 
-  // set the number of channels
-  int channels = 1;
-  if (inbuf.ndim == 2)
-    channels = inbuf.shape[1];
-  else if (inbuf.ndim > 2) {
-    // Cannot throw exception in C callback - store error and return 0
-    cb->set_callback_error("Input array should have at most 2 dimensions");
-    return 0;
+  void restore(const ConverterSnapshot &snapshot) override {
+    StateReader in(snapshot.data);
+    const int converter_type = in.get<int32_t>();
+    const int channels = in.get<int32_t>();
+    if (converter_type != _converter_type ||
+        channels != src_get_channels(_state))
+      invalid_snapshot();
+    const long count = in.get_count(sizeof(float));
+    const void *samples = in.get_samples(count);
+    SRC_STATE_POSITION position;
+    position.last_ratio = in.get<double>();
+    position.last_position = in.get<double>();
+    position.src_ratio = in.get<double>();
+    position.input_index = in.get<double>();
+    position.b_current = static_cast<long>(in.get<int64_t>());
+    position.b_end = static_cast<long>(in.get<int64_t>());
+    position.b_real_end = static_cast<long>(in.get<int64_t>());
+    position.dirty = in.get<int32_t>();
+    in.finish();
+    if (src_state_restore(_state, _converter_type, &position, samples,
+                          count) != 0)
+      invalid_snapshot();
   }
+};
 
-  if (channels != cb_channels || channels == 0) {
-    // Cannot throw exception in C callback - store error and return 0
-    cb->set_callback_error("Invalid number of channels in input data.");
-    return 0;
+// Zeroth order modified Bessel function of the first kind, for the Kaiser
+// window.
+double bessel_i0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 100 && term > sum * 1e-17; ++k) {
+    const double t = x / (2.0 * k);
+    term *= t * t;
+    sum += term;
   }
+  return sum;
+}
 
-  *data = static_cast<float *>(inbuf.ptr);
+// Polyphase filter bank for a ratio of L / M. Output frame k lies at input
+// position k * M / L, i.e. `phase` = k * M % L steps of 1 / L past input frame
+// n = k * M / L. Row `phase` of `coeffs` holds the `taps` coefficients applied
+// to input frames n - taps / 2 + 1 ... n + taps / 2.
+struct PolyphaseFilter {
+  long L;
+  long M;
+  int taps;
+  std::vector<float> coeffs;
+};
+
+std::shared_ptr<const PolyphaseFilter> design_polyphase_filter(
+    const PolyphaseDesign &design, long L, long M) {
+  const double ratio = double(L) / double(M);
+  const double cutoff = design.cutoff * std::min(1.0, ratio);
+  const int taps = polyphase_taps(design, ratio);
+  const int half = taps / 2;
+  const double i0_beta = bessel_i0(design.beta);
 
-  return (long)inbuf.shape[0];
+  auto filter = std::make_shared<PolyphaseFilter>();
+  filter->L = L;
+  filter->M = M;
+  filter->taps = taps;
+  filter->coeffs.resize(static_cast<size_t>(L) * taps);
+  std::vector<double> row(taps);
+  for (long phase = 0; phase < L; ++phase) {
+    double sum = 0.0;
+    for (int j = 0; j < taps; ++j) {
+      // distance from the output position to the input frame
+      const double x = double(phase) / double(L) + half - 1 - j;
+      const double u = x / half;
+      const double window =
+          u * u < 1.0 ? bessel_i0(design.beta * std::sqrt(1.0 - u * u)) / i0_beta
+                      : 0.0;
+      const double arg = 2.0 * 3.14159265358979323846 * cutoff * x;
+      const double sinc = arg == 0.0 ? 1.0 : std::sin(arg) / arg;
+      row[j] = 2.0 * cutoff * sinc * window;
+      sum += row[j];
+    }
+    // unity gain at DC for every phase
+    float *coeffs = filter->coeffs.data() + phase * taps;
+    for (int j = 0; j < taps; ++j) coeffs[j] = static_cast<float>(row[j] / sum);
+  }
+  return filter;
 }
 
-}  // namespace
+// Number of recently used polyphase filter banks the cache keeps alive
+// after their last converter is gone, so that streams torn down and created
+// again at the same ratio, e.g. on reconnects, do not design them again.
+#define POLYPHASE_RECENT_FILTERS 8
 
-py::array_t<float, py::array::c_style> resample(
-    const py::array_t<float, py::array::c_style | py::array::forcecast> &input,
-    double sr_ratio, const py::object &converter_type, bool verbose,
-    const py::object &release_gil = py::none()) {
-  // input array has shape (n_samples, n_channels)
-  int converter_type_int = get_converter_type(converter_type);
+// Process-wide cache of the immutable polyphase filter banks keyed by
+// design and ratio, so converters with the same ratio share one table and
+// only hold their own history. It keeps weak references to every table in
+// use, and strong references to the POLYPHASE_RECENT_FILTERS most recently
+// requested ones.
+class PolyphaseFilterCache {
+ public:
+  std::shared_ptr<const PolyphaseFilter> get(const PolyphaseDesign &design,
+                                             long L, long M) {
+    const Key key(&design, L, M);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto it = _filters.find(key);
+      if (it != _filters.end()) {
+        if (auto filter = it->second.lock()) {
+          _touch(filter);
+          return filter;
+        }
+      }
+    }
 
-  // accessors for the arrays
-  py::buffer_info inbuf = input.request();
+    // designed without holding the lock, the first insertion wins a race
+    std::shared_ptr<const PolyphaseFilter> filter =
+        design_polyphase_filter(design, L, M);
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_designs;
+    for (auto it = _filters.begin(); it != _filters.end();) {
+      if (it->second.expired())
+        it = _filters.erase(it);
+      else
+        ++it;
+    }
+    auto inserted = _filters.emplace(key, filter);
+    if (!inserted.second) {
+      if (auto existing = inserted.first->second.lock()) filter = existing;
+      inserted.first->second = filter;
+    }
+    _touch(filter);
+    return filter;
+  }
 
-  // set the number of channels
-  int channels = 1;
-  if (inbuf.ndim == 2)
-    channels = inbuf.shape[1];
-  else if (inbuf.ndim > 2)
-    throw std::domain_error("Input array should have at most 2 dimensions");
+  // Number of filter banks designed so far, and of those still alive.
+  std::pair<unsigned long, size_t> info() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t alive = 0;
+    for (const auto &entry : _filters)
+      if (!entry.second.expired()) ++alive;
+    return {_designs, alive};
+  }
 
-  if (channels == 0)
-    throw std::domain_error("Invalid number of channels (0) in input data.");
+ private:
+  using Key = std::tuple<const PolyphaseDesign *, long, long>;
 
-  // Add buffer space to match Resampler.process() behavior with end_of_input=True
-  // src_simple internally behaves like end_of_input=True, so it may generate
-  // extra samples from buffer flushing, especially for certain converters
-  const auto new_size =
-      static_cast<size_t>(std::ceil(inbuf.shape[0] * sr_ratio))
-      + END_OF_INPUT_EXTRA_OUTPUT_FRAMES;
-
-  // allocate output array
-  std::vector<size_t> out_shape{new_size};
-  if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(channels));
-  auto output = py::array_t<float, py::array::c_style>(out_shape);
-  py::buffer_info outbuf = output.request();
-
-  // libsamplerate struct
-  SRC_DATA src_data = {
-      static_cast<float *>(inbuf.ptr),   // data_in
-      static_cast<float *>(outbuf.ptr),  // data_out
-      static_cast<long>(inbuf.shape[0]), // input_frames
-      long(new_size),                    // output_frames
-      0,        // input_frames_used, filled by libsamplerate
-      0,        // output_frames_gen, filled by libsamplerate
-      0,        // end_of_input, not used by src_simple ?
-      sr_ratio  // src_ratio, sampling rate conversion ratio
-  };
+  // Move `filter` to the back of the recently used tables, evicting the
+  // least recently used one when full. Called with the lock held.
+  void _touch(const std::shared_ptr<const PolyphaseFilter> &filter) {
+    auto it = std::find(_recent.begin(), _recent.end(), filter);
+    if (it != _recent.end()) _recent.erase(it);
+    _recent.push_back(filter);
+    if (_recent.size() > POLYPHASE_RECENT_FILTERS) _recent.pop_front();
+  }
 
-  // Perform resampling with optional GIL release
-  auto do_resample = [&]() {
-    return src_simple(&src_data, converter_type_int, channels);
-  };
+  std::mutex _mutex;
+  std::map<Key, std::weak_ptr<const PolyphaseFilter>> _filters;
+  std::deque<std::shared_ptr<const PolyphaseFilter>> _recent;
+  unsigned long _designs = 0;
+};
 
-  int err_code;
-  if (should_release_gil(release_gil, inbuf.shape[0])) {
-    py::gil_scoped_release release;
-    err_code = do_resample();
+PolyphaseFilterCache &polyphase_filter_cache() {
+  static PolyphaseFilterCache cache;
+  return cache;
+}
+
+std::shared_ptr<const PolyphaseFilter> get_polyphase_filter(
+    const PolyphaseDesign &design, long L, long M) {
+  return polyphase_filter_cache().get(design, L, M);
+}
+
+// SIMD kernels of the hot loops: the polyphase dot product, the
+// conversions between float and integer samples and the silence scan. Every
+// build has the scalar kernels and the SSE or NEON ones of its baseline, x86
+// builds also have AVX2 and AVX-512 kernels. The best kernels the CPU
+// supports are selected once at import, or those named by the
+// SAMPLERATE_SIMD environment variable.
+enum class SimdIsa { scalar, sse, neon, avx2, avx512 };
+
+const char *const simd_isa_names[] = {"scalar", "sse", "neon", "avx2",
+                                      "avx512"};
+
+// Dot product of `n` coefficients and samples, n a multiple of 8. This is
+// the inner loop of the polyphase converters.
+float dot_product_scalar(const float *coeffs, const float *x, int n) {
+  // independent lanes, which compilers turn into vector instructions
+  float acc[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < n; i += 8)
+    for (int k = 0; k < 8; ++k) acc[k] += coeffs[i + k] * x[i + k];
+  return ((acc[0] + acc[1]) + (acc[2] + acc[3])) +
+         ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+#if defined(SAMPLERATE_HAVE_SSE)
+float dot_product_sse(const float *coeffs, const float *x, int n) {
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  for (int i = 0; i < n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(coeffs + i),
+                                       _mm_loadu_ps(x + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(coeffs + i + 4),
+                                       _mm_loadu_ps(x + i + 4)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+#if defined(SAMPLERATE_HAVE_NEON)
+float dot_product_neon(const float *coeffs, const float *x, int n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+  for (int i = 0; i < n; i += 8) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(coeffs + i), vld1q_f32(x + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(coeffs + i + 4), vld1q_f32(x + i + 4));
+  }
+  const float32x4_t acc = vaddq_f32(acc0, acc1);
+  return (vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1)) +
+         (vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3));
+}
+#endif
+
+// Round and saturate float samples to an integer type. Samples keep their
+// values, as for a float32 conversion of integer input, so integer signals
+// round trip unchanged.
+template <typename T>
+void float_to_pcm_scalar(const float *src, T *dst, size_t count) {
+  const double lo = std::numeric_limits<T>::min();
+  const double hi = std::numeric_limits<T>::max();
+  for (size_t i = 0; i < count; ++i) {
+    const double value = src[i];
+    dst[i] = value >= hi   ? std::numeric_limits<T>::max()
+             : value <= lo ? std::numeric_limits<T>::min()
+                           : static_cast<T>(std::lrint(value));
+  }
+}
+
+template <typename T>
+void pcm_to_float_scalar(const T *src, float *dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) dst[i] = static_cast<float>(src[i]);
+}
+
+// Largest absolute value of `count` samples, the silence test of the
+// resamplers.
+float peak_scalar(const float *x, size_t count) {
+  float acc[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    for (int k = 0; k < 8; ++k) acc[k] = std::max(acc[k], std::fabs(x[i + k]));
+  for (; i < count; ++i) acc[0] = std::max(acc[0], std::fabs(x[i]));
+  return std::max(std::max(std::max(acc[0], acc[1]), std::max(acc[2], acc[3])),
+                  std::max(std::max(acc[4], acc[5]), std::max(acc[6], acc[7])));
+}
+
+#if defined(SAMPLERATE_HAVE_SSE)
+float peak_sse(const float *x, size_t count) {
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    acc0 = _mm_max_ps(acc0, _mm_andnot_ps(sign, _mm_loadu_ps(x + i)));
+    acc1 = _mm_max_ps(acc1, _mm_andnot_ps(sign, _mm_loadu_ps(x + i + 4)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_max_ps(acc0, acc1));
+  return std::max(std::max(std::max(lanes[0], lanes[1]),
+                           std::max(lanes[2], lanes[3])),
+                  peak_scalar(x + i, count - i));
+}
+#endif
+
+#if defined(SAMPLERATE_HAVE_NEON)
+float peak_neon(const float *x, size_t count) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    acc0 = vmaxq_f32(acc0, vabsq_f32(vld1q_f32(x + i)));
+    acc1 = vmaxq_f32(acc1, vabsq_f32(vld1q_f32(x + i + 4)));
+  }
+  const float32x4_t acc = vmaxq_f32(acc0, acc1);
+  return std::max(std::max(std::max(vgetq_lane_f32(acc, 0),
+                                    vgetq_lane_f32(acc, 1)),
+                           std::max(vgetq_lane_f32(acc, 2),
+                                    vgetq_lane_f32(acc, 3))),
+                  peak_scalar(x + i, count - i));
+}
+#endif
+
+#if defined(SAMPLERATE_HAVE_AVX)
+SAMPLERATE_TARGET("avx2,fma")
+float dot_product_avx2(const float *coeffs, const float *x, int n) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(coeffs + i), _mm256_loadu_ps(x + i),
+                           acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(coeffs + i + 8),
+                           _mm256_loadu_ps(x + i + 8), acc1);
+  }
+  if (i < n)
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(coeffs + i), _mm256_loadu_ps(x + i),
+                           acc0);
+  const __m256 acc = _mm256_add_ps(acc0, acc1);
+  const __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+                                 _mm256_extractf128_ps(acc, 1));
+  float lanes[4];
+  _mm_storeu_ps(lanes, half);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+SAMPLERATE_TARGET("avx512f,avx2,fma")
+float dot_product_avx512(const float *coeffs, const float *x, int n) {
+  __m512 acc = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16)
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(coeffs + i), _mm512_loadu_ps(x + i),
+                          acc);
+  float wide[16];
+  _mm512_storeu_ps(wide, acc);
+  __m256 rest = _mm256_add_ps(_mm256_loadu_ps(wide), _mm256_loadu_ps(wide + 8));
+  if (i < n)
+    rest = _mm256_fmadd_ps(_mm256_loadu_ps(coeffs + i), _mm256_loadu_ps(x + i),
+                           rest);
+  const __m128 half = _mm_add_ps(_mm256_castps256_ps128(rest),
+                                 _mm256_extractf128_ps(rest, 1));
+  float lanes[4];
+  _mm_storeu_ps(lanes, half);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// The conversions round with the current rounding mode like std::lrint and
+// saturate like float_to_pcm_scalar().
+SAMPLERATE_TARGET("avx2")
+void float_to_int16_avx2(const float *src, int16_t *dst, size_t count) {
+  const __m256 lo = _mm256_set1_ps(-32768.0f), hi = _mm256_set1_ps(32767.0f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m256 a =
+        _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+    const __m256 b =
+        _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), lo), hi);
+    // packs works per 128-bit lane, the permute restores the sample order
+    const __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b)), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+  }
+  float_to_pcm_scalar(src + i, dst + i, count - i);
+}
+
+SAMPLERATE_TARGET("avx2")
+void float_to_int32_avx2(const float *src, int32_t *dst, size_t count) {
+  // out of range conversions give INT32_MIN, which is right for negative
+  // samples only
+  const __m256 limit = _mm256_set1_ps(2147483648.0f);
+  const __m256i max = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 x = _mm256_loadu_ps(src + i);
+    const __m256i over =
+        _mm256_castps_si256(_mm256_cmp_ps(x, limit, _CMP_GE_OQ));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        _mm256_blendv_epi8(_mm256_cvtps_epi32(x), max, over));
+  }
+  float_to_pcm_scalar(src + i, dst + i, count - i);
+}
+
+SAMPLERATE_TARGET("avx2")
+void int16_to_float_avx2(const int16_t *src, float *dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(dst + i,
+                     _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(
+                         reinterpret_cast<const __m128i *>(src + i)))));
+  pcm_to_float_scalar(src + i, dst + i, count - i);
+}
+
+SAMPLERATE_TARGET("avx2")
+void int32_to_float_avx2(const int32_t *src, float *dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_loadu_si256(
+                                  reinterpret_cast<const __m256i *>(src + i))));
+  pcm_to_float_scalar(src + i, dst + i, count - i);
+}
+
+// The scan is bound by memory bandwidth, so AVX-512 builds use it as well.
+SAMPLERATE_TARGET("avx2")
+float peak_avx2(const float *x, size_t count) {
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    acc0 = _mm256_max_ps(acc0, _mm256_andnot_ps(sign, _mm256_loadu_ps(x + i)));
+    acc1 = _mm256_max_ps(acc1,
+                         _mm256_andnot_ps(sign, _mm256_loadu_ps(x + i + 8)));
+  }
+  const __m256 acc = _mm256_max_ps(acc0, acc1);
+  const __m128 half = _mm_max_ps(_mm256_castps256_ps128(acc),
+                                 _mm256_extractf128_ps(acc, 1));
+  float lanes[4];
+  _mm_storeu_ps(lanes, half);
+  return std::max(std::max(std::max(lanes[0], lanes[1]),
+                           std::max(lanes[2], lanes[3])),
+                  peak_scalar(x + i, count - i));
+}
+
+// Whether the CPU and the operating system support AVX2 with FMA, and
+// AVX-512F, the only AVX-512 subset used.
+bool cpu_supports(SimdIsa isa) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  if (isa == SimdIsa::avx2)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return isa == SimdIsa::avx512 && __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+  __cpuid(info, 1);
+  const bool fma = (info[2] & (1 << 12)) != 0;
+  if ((info[2] & (1 << 27)) == 0) return false;  // no OSXSAVE
+  const unsigned long long xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  const bool avx2 = fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+  if (isa == SimdIsa::avx2) return avx2;
+  return isa == SimdIsa::avx512 && avx2 && (info[1] & (1 << 16)) != 0 &&
+         (xcr0 & 0xE6) == 0xE6;
+#endif
+}
+#endif
+
+struct Kernels {
+  SimdIsa isa;
+  float (*dot_product)(const float *coeffs, const float *x, int n);
+  void (*float_to_int16)(const float *src, int16_t *dst, size_t count);
+  void (*float_to_int32)(const float *src, int32_t *dst, size_t count);
+  void (*int16_to_float)(const int16_t *src, float *dst, size_t count);
+  void (*int32_to_float)(const int32_t *src, float *dst, size_t count);
+  float (*peak)(const float *x, size_t count);
+};
+
+// The ISAs with kernels on this CPU, from the slowest.
+std::vector<SimdIsa> available_simd_isas() {
+  std::vector<SimdIsa> isas = {SimdIsa::scalar};
+#if defined(SAMPLERATE_HAVE_SSE)
+  isas.push_back(SimdIsa::sse);
+#elif defined(SAMPLERATE_HAVE_NEON)
+  isas.push_back(SimdIsa::neon);
+#endif
+#if defined(SAMPLERATE_HAVE_AVX)
+  if (cpu_supports(SimdIsa::avx2)) isas.push_back(SimdIsa::avx2);
+  if (cpu_supports(SimdIsa::avx512)) isas.push_back(SimdIsa::avx512);
+#endif
+  return isas;
+}
+
+Kernels make_kernels(SimdIsa isa) {
+  Kernels k = {isa,
+               dot_product_scalar,
+               float_to_pcm_scalar<int16_t>,
+               float_to_pcm_scalar<int32_t>,
+               pcm_to_float_scalar<int16_t>,
+               pcm_to_float_scalar<int32_t>,
+               peak_scalar};
+  switch (isa) {
+    case SimdIsa::scalar:
+      break;
+#if defined(SAMPLERATE_HAVE_SSE)
+    case SimdIsa::sse:
+      k.dot_product = dot_product_sse;
+      k.peak = peak_sse;
+      break;
+#endif
+#if defined(SAMPLERATE_HAVE_NEON)
+    case SimdIsa::neon:
+      k.dot_product = dot_product_neon;
+      k.peak = peak_neon;
+      break;
+#endif
+#if defined(SAMPLERATE_HAVE_AVX)
+    case SimdIsa::avx2:
+    case SimdIsa::avx512:
+      k.dot_product =
+          isa == SimdIsa::avx512 ? dot_product_avx512 : dot_product_avx2;
+      k.float_to_int16 = float_to_int16_avx2;
+      k.float_to_int32 = float_to_int32_avx2;
+      k.int16_to_float = int16_to_float_avx2;
+      k.int32_to_float = int32_to_float_avx2;
+      k.peak = peak_avx2;
+      break;
+#endif
+    default:
+      break;
+  }
+  return k;
+}
+
+// The kernels in use, set at import by select_kernels().
+Kernels kernels = make_kernels(SimdIsa::scalar);
+
+// Select the fastest kernels, or the ones named by `requested` if not empty.
+// Returns a warning when `requested` is unknown or not supported by the CPU,
+// in which case the fastest kernels are used.
+std::string select_kernels(const std::string &requested) {
+  const auto isas = available_simd_isas();
+  SimdIsa isa = isas.back();
+  std::string warning;
+  if (!requested.empty() && requested != "auto") {
+    auto match = isas.end();
+    for (auto it = isas.begin(); it != isas.end(); ++it)
+      if (requested == simd_isa_names[static_cast<int>(*it)]) match = it;
+    if (match != isas.end())
+      isa = *match;
+    else
+      warning = "SAMPLERATE_SIMD=" + requested +
+                " is not supported on this CPU, using " +
+                simd_isa_names[static_cast<int>(isa)] + ".";
+  }
+  kernels = make_kernels(isa);
+  return warning;
+}
+
+// Whether the sinc converters come from their AVX2 build, which follows
+// the selected kernels, see new_src_state().
+bool sinc_avx2_selected() {
+#if defined(SAMPLERATE_HAVE_AVX) && defined(SAMPLERATE_HAVE_SINC_AVX2)
+  return kernels.isa == SimdIsa::avx2 || kernels.isa == SimdIsa::avx512;
+#else
+  return false;
+#endif
+}
+
+// Create one of libsamplerate's converters, like src_new. With the AVX2 or
+// AVX-512 kernels selected, the sinc converters come from the AVX2 build of
+// libsamplerate's sinc converters, see src/libsamplerate/sinc_isa.c.
+SRC_STATE *new_src_state(int converter_type, int channels, int *error) {
+#if defined(SAMPLERATE_HAVE_AVX) && defined(SAMPLERATE_HAVE_SINC_AVX2)
+  if (sinc_avx2_selected() && (converter_type == SRC_SINC_BEST_QUALITY ||
+                               converter_type == SRC_SINC_MEDIUM_QUALITY ||
+                               converter_type == SRC_SINC_FASTEST))
+    return sinc_isa_state_new_avx2(converter_type, channels, error);
+#endif
+  return src_new(converter_type, channels, error);
+}
+
+// Converter for fixed rational ratios L / M with small L and M. Its output
+// frames fall on a grid of L phases between input frames, so it applies
+// precomputed filter coefficients instead of interpolating them like
+// libsamplerate's sinc converters do. Like those, the output is aligned with
+// the input and the filter is flushed with zeros at the end of input.
+//
+// A change to another small rational ratio continues from the current
+// position with the new filter bank. Any other ratio switches the converter
+// to a libsamplerate sinc converter of similar quality until reset; that
+// switch starts the sinc converter from scratch.
+class PolyphaseConverter : public Converter {
+ private:
+  const PolyphaseDesign *_design;
+  int _channels;
+  std::shared_ptr<const PolyphaseFilter> _filter;
+  double _ratio = 0.0;  // the ratio of `_filter`
+  std::unique_ptr<Converter> _fallback;
+  bool _use_fallback = false;
+
+  // planar input history, frame i of channel c at _history[c * _capacity + i]
+  std::vector<float> _history;
+  long _capacity = 0;
+  long _length = 0;     // frames in the history
+  long _input_end = 0;  // one past the last input frame, before the flush
+  long _frame = 0;      // input frame at or before the next output position
+  long _phase = 0;      // offset of the next output position, in 1 / L
+  bool _flushed = false;
+
+  void _grow(long length) {
+    if (length <= _capacity) return;
+    const long capacity = std::max(length, std::max(2 * _capacity, 1024L));
+    std::vector<float> history(static_cast<size_t>(capacity) * _channels);
+    for (int c = 0; c < _channels; ++c)
+      std::copy(_history.begin() + c * _capacity,
+                _history.begin() + c * _capacity + _length,
+                history.begin() + c * capacity);
+    _history.swap(history);
+    _capacity = capacity;
+  }
+
+  // Make sure the filter window of `half` frames before the next output
+  // position is in the history, padding with zeros at the start.
+  void _pad_front(int half) {
+    const long missing = half - 1 - _frame;
+    if (missing <= 0) return;
+    _grow(_length + missing);
+    for (int c = 0; c < _channels; ++c) {
+      float *channel = _history.data() + c * _capacity;
+      std::copy_backward(channel, channel + _length,
+                         channel + _length + missing);
+      std::fill(channel, channel + missing, 0.0f);
+    }
+    _length += missing;
+    _input_end += missing;
+    _frame += missing;
+  }
+
+  void _append(const float *data_in, long frames) {
+    _grow(_length + frames);
+    for (int c = 0; c < _channels; ++c) {
+      float *channel = _history.data() + c * _capacity + _length;
+      for (long f = 0; f < frames; ++f)
+        channel[f] = data_in[f * _channels + c];
+    }
+    _length += frames;
+  }
+
+  void _append_zeros(long frames) {
+    _grow(_length + frames);
+    for (int c = 0; c < _channels; ++c) {
+      float *channel = _history.data() + c * _capacity + _length;
+      std::fill(channel, channel + frames, 0.0f);
+    }
+    _length += frames;
+  }
+
+  // Drop the frames before the filter window once they are at least half of
+  // the history.
+  void _compact() {
+    const long first = _frame - _filter->taps / 2 + 1;
+    if (first <= 0 || 2 * first < _length) return;
+    for (int c = 0; c < _channels; ++c) {
+      float *channel = _history.data() + c * _capacity;
+      std::copy(channel + first, channel + _length, channel);
+    }
+    _length -= first;
+    _input_end -= first;
+    _frame -= first;
+  }
+
+  // Select the filter bank for `ratio`, false if it is not a small rational.
+  bool _configure(double ratio) {
+    long L, M;
+    if (!rational_ratio(ratio, POLYPHASE_EXACT_FRAMES, MAX_POLYPHASE_PHASES,
+                        &L, &M) ||
+        L > MAX_POLYPHASE_PHASES)
+      return false;
+
+    if (!_filter || _filter->L != L || _filter->M != M) {
+      auto filter = get_polyphase_filter(*_design, L, M);
+      if (_filter) {
+        // continue from the nearest phase of the new filter bank
+        _phase = std::lround(double(_phase) * L / _filter->L);
+        if (_phase >= L) {
+          _phase -= L;
+          ++_frame;
+        }
+      }
+      _filter = filter;
+    }
+    _ratio = ratio;
+    _pad_front(_filter->taps / 2);
+    return true;
+  }
+
+  int _create_fallback() {
+    int err_num = 0;
+    SRC_STATE *state =
+        new_src_state(_design->fallback_type, _channels, &err_num);
+    if (state == nullptr) return err_num;
+    _fallback.reset(new SrcConverter(state, _design->fallback_type));
+    return 0;
+  }
+
+  int _start_fallback() {
+    _use_fallback = true;
+    return _fallback ? _fallback->reset() : _create_fallback();
+  }
+
+ public:
+  PolyphaseConverter(int converter_type, int channels)
+      : _design(&polyphase_design(converter_type)), _channels(channels) {}
+
+  PolyphaseConverter(const PolyphaseConverter &other)
+      : _design(other._design),
+        _channels(other._channels),
+        _filter(other._filter),
+        _ratio(other._ratio),
+        _use_fallback(other._use_fallback),
+        _history(other._history),
+        _capacity(other._capacity),
+        _length(other._length),
+        _input_end(other._input_end),
+        _frame(other._frame),
+        _phase(other._phase),
+        _flushed(other._flushed) {}
+
+  int process(SRC_DATA *data) override {
+    if (!src_is_valid_ratio(data->src_ratio)) return SRC_ERR_BAD_SRC_RATIO;
+    if (!_use_fallback && (!_filter || data->src_ratio != _ratio) &&
+        !_configure(data->src_ratio)) {
+      int err_num = _start_fallback();
+      if (err_num != 0) return err_num;
+    }
+    if (_use_fallback) return _fallback->process(data);
+
+    const PolyphaseFilter &filter = *_filter;
+    const int half = filter.taps / 2;
+    try {
+      if (data->input_frames > 0) {
+        _append(data->data_in, data->input_frames);
+        _input_end = _length;
+        _flushed = false;
+      }
+      if (data->end_of_input && !_flushed) {
+        _append_zeros(half);
+        _flushed = true;
+      }
+    } catch (const std::bad_alloc &) {
+      return SRC_ERR_MALLOC_FAILED;
+    }
+    data->input_frames_used = data->input_frames;
+
+    // output positions need `half` frames of input after them
+    const long last = std::min(_input_end, _length - half);
+    long gen = 0;
+    while (gen < data->output_frames && _frame < last) {
+      const float *coeffs = filter.coeffs.data() + _phase * filter.taps;
+      const float *window = _history.data() + (_frame - half + 1);
+      float *out = data->data_out + gen * _channels;
+      for (int c = 0; c < _channels; ++c)
+        out[c] = kernels.dot_product(coeffs, window + c * _capacity,
+                                     filter.taps);
+      ++gen;
+      _phase += filter.M;
+      _frame += _phase / filter.L;
+      _phase %= filter.L;
+    }
+    data->output_frames_gen = gen;
+
+    _compact();
+    return 0;
+  }
+
+  int set_ratio(double new_ratio) override {
+    if (!src_is_valid_ratio(new_ratio)) return SRC_ERR_BAD_SRC_RATIO;
+    if (!_use_fallback && !_configure(new_ratio)) {
+      int err_num = _start_fallback();
+      if (err_num != 0) return err_num;
+    }
+    return _use_fallback ? _fallback->set_ratio(new_ratio) : 0;
+  }
+
+  int reset() override {
+    _use_fallback = false;
+    _length = _input_end = _frame = _phase = 0;
+    _flushed = false;
+    if (_filter) _pad_front(_filter->taps / 2);
+    return _fallback ? _fallback->reset() : 0;
+  }
+
+  Converter *clone(int *error) const override {
+    auto clone = new PolyphaseConverter(*this);
+    if (_fallback) {
+      clone->_fallback.reset(_fallback->clone(error));
+      if (!clone->_fallback) {
+        delete clone;
+        return nullptr;
+      }
+    }
+    return clone;
+  }
+
+  // Saves the history from the filter window of the next output frame on,
+  // as `_compact` would keep it.
+  void save(ConverterSnapshot &snapshot) const override {
+    snapshot.clear();
+    long first = _filter ? _frame - _filter->taps / 2 + 1 : 0;
+    first = std::max(0L, std::min(first, _length));
+    StateWriter out(snapshot.data);
+    out.put(_ratio);
+    out.put<uint8_t>(_use_fallback);
+    out.put<uint8_t>(_flushed);
+    out.put<int64_t>(_length - first);
+    out.put<int64_t>(_input_end - first);
+    out.put<int64_t>(_frame - first);
+    out.put<int64_t>(_phase);
+    for (int c = 0; c < _channels; ++c)
+      out.put_samples(_history.data() + c * _capacity + first,
+                      _length - first);
+    if (_fallback) _fallback->save(snapshot.inner_snapshot());
+  }
+
+  void restore(const ConverterSnapshot &snapshot) override {
+    StateReader in(snapshot.data);
+    const double ratio = in.get<double>();
+    const bool use_fallback = in.get<uint8_t>() != 0;
+    const bool flushed = in.get<uint8_t>() != 0;
+    const long length = in.get_count(_channels * sizeof(float));
+    const long input_end = static_cast<long>(in.get<int64_t>());
+    const long frame = static_cast<long>(in.get<int64_t>());
+    const long phase = static_cast<long>(in.get<int64_t>());
+    if (input_end < 0 || input_end > length || frame < 0 || frame > length ||
+        phase < 0)
+      invalid_snapshot();
+    if (ratio == 0.0) {
+      _filter.reset();
+    } else {
+      long L, M;
+      if (!rational_ratio(ratio, POLYPHASE_EXACT_FRAMES, MAX_POLYPHASE_PHASES,
+                          &L, &M) ||
+          L > MAX_POLYPHASE_PHASES || phase >= L)
+        invalid_snapshot();
+      if (!_filter || _filter->L != L || _filter->M != M)
+        _filter = get_polyphase_filter(*_design, L, M);
+    }
+
+    _length = 0;
+    _grow(length);
+    for (int c = 0; c < _channels; ++c)
+      in.get_samples(_history.data() + c * _capacity, length);
+    in.finish();
+    _ratio = ratio;
+    _use_fallback = use_fallback;
+    _flushed = flushed;
+    _length = length;
+    _input_end = input_end;
+    _frame = frame;
+    _phase = phase;
+    if (_filter) _pad_front(_filter->taps / 2);
+
+    if (snapshot.inner_count != 0) {
+      if (!_fallback) error_handler(_create_fallback());
+      _fallback->restore(*snapshot.inner[0]);
+    } else if (_use_fallback) {
+      invalid_snapshot();
+    }
+  }
+};
+
+// Half-band lowpass filter of one cascade level. The taps at even offsets
+// from the center are zero apart from the center tap of 1 / 2, so only the
+// `taps` coefficients at the odd offsets -(taps - 1) ... taps - 1 are kept,
+// scaled for decimation and, doubled, for interpolation.
+struct HalfbandFilter {
+  int taps;
+  std::vector<float> decimate;
+  std::vector<float> interpolate;
+};
+
+HalfbandFilter design_halfband_filter(const HalfbandDesign &design,
+                                      int level) {
+  const int taps = halfband_taps(design, level);
+  const double beta = 0.1102 * (design.attenuation - 8.7);
+  const double i0_beta = bessel_i0(beta);
+
+  std::vector<double> row(taps);
+  double sum = 0.0;
+  for (int j = 0; j < taps; ++j) {
+    const double m = 2 * j - taps + 1;  // odd offset from the center tap
+    const double u = m / taps;
+    const double window = bessel_i0(beta * std::sqrt(1.0 - u * u)) / i0_beta;
+    const double arg = 3.14159265358979323846 * m / 2.0;
+    row[j] = std::sin(arg) / arg * window;
+    sum += row[j];
+  }
+  HalfbandFilter filter = {taps, std::vector<float>(taps),
+                           std::vector<float>(taps)};
+  for (int j = 0; j < taps; ++j) {
+    // unity gain at DC, with the center tap for decimation
+    filter.decimate[j] = static_cast<float>(0.5 * row[j] / sum);
+    filter.interpolate[j] = static_cast<float>(row[j] / sum);
+  }
+  return filter;
+}
+
+// The filters of all cascade levels of a converter type, at index level - 1.
+const std::vector<HalfbandFilter> &halfband_filters(int converter_type) {
+  auto design_all = [](int type) {
+    std::vector<HalfbandFilter> filters;
+    for (int level = 1; level <= MAX_HALFBAND_STAGES; ++level)
+      filters.push_back(design_halfband_filter(halfband_design(type), level));
+    return filters;
+  };
+  static const std::vector<HalfbandFilter> best =
+      design_all(HALFBAND_BEST_QUALITY);
+  static const std::vector<HalfbandFilter> fast = design_all(HALFBAND_FAST);
+  return converter_type == HALFBAND_BEST_QUALITY ? best : fast;
+}
+
+// One stage of a half-band cascade, converting by 1 / 2 or 2 in polyphase
+// form. A decimator keeps its even and odd input frames in separate planes:
+// output frame n is half of even frame n plus the filter applied to the odd
+// frames n - taps / 2 ... n + taps / 2 - 1 around it. An interpolator
+// passes input frame n through as output frame 2 n, and output frame 2 n + 1
+// is the filter applied to input frames n - taps / 2 + 1 ... n + taps / 2.
+// Like PolyphaseConverter, the output is aligned with the input, the start
+// is padded and the end flushed with zeros.
+class HalfbandStage {
+ private:
+  const HalfbandFilter *_filter;
+  bool _decimate;
+  int _channels;
+
+  // planar history, of the even input frames in planes 0 ... channels - 1
+  // and the odd ones in the planes after them for a decimator
+  std::vector<float> _history;
+  long _capacity = 0;
+  long _lengths[2] = {0, 0};  // frames in the even and odd planes
+  long _base = 0;             // frames dropped from the front of the planes
+  long _received = 0;         // input frames, including the padding
+  long _input_end = 0;        // input frames before the flush
+  long _next = 0;             // the next output frame
+  bool _flushed = false;
+
+  int _num_planes() const { return _decimate ? 2 * _channels : _channels; }
+
+  float *_plane(int p) { return _history.data() + p * _capacity; }
+
+  void _grow(long length) {
+    if (length <= _capacity) return;
+    const long capacity = std::max(length, std::max(2 * _capacity, 256L));
+    std::vector<float> history(static_cast<size_t>(capacity) * _num_planes());
+    for (int p = 0; p < _num_planes(); ++p) {
+      const long plane_length = _lengths[p < _channels ? 0 : 1];
+      std::copy(_history.begin() + p * _capacity,
+                _history.begin() + p * _capacity + plane_length,
+                history.begin() + p * capacity);
+    }
+    _history.swap(history);
+    _capacity = capacity;
+  }
+
+  // Append `frames` frames, frame f of channel c at data[f * frame_stride +
+  // c * channel_stride], or zeros if `data` is null.
+  void _append(const float *data, long frames, long frame_stride,
+               long channel_stride) {
+    _grow(std::max(_lengths[0], _lengths[1]) + frames);
+    for (long f = 0; f < frames; ++f, ++_received) {
+      const int parity = _decimate ? static_cast<int>(_received & 1) : 0;
+      float *out = _plane(parity * _channels) + _lengths[parity];
+      for (int c = 0; c < _channels; ++c)
+        out[c * _capacity] =
+            data ? data[f * frame_stride + c * channel_stride] : 0.0f;
+      ++_lengths[parity];
+    }
+  }
+
+  // Drop the frames before the filter window of the next output frame once
+  // they are at least half of the history.
+  void _compact() {
+    const long first = (_decimate ? _next : _next / 2) - _base;
+    if (first <= 0 || 2 * first < std::max(_lengths[0], _lengths[1])) return;
+    for (int p = 0; p < _num_planes(); ++p) {
+      float *plane = _plane(p);
+      std::copy(plane + first, plane + _lengths[p < _channels ? 0 : 1], plane);
+    }
+    _lengths[0] -= first;
+    if (_decimate) _lengths[1] -= first;
+    _base += first;
+  }
+
+ public:
+  HalfbandStage(const HalfbandFilter *filter, bool decimate, int channels)
+      : _filter(filter), _decimate(decimate), _channels(channels) {
+    reset();
+  }
+
+  void reset() {
+    _lengths[0] = _lengths[1] = 0;
+    _base = _received = _input_end = _next = 0;
+    _flushed = false;
+    // the filter window of the first output frame starts before the input
+    const long padding = _decimate ? _filter->taps / 2 : _filter->taps / 2 - 1;
+    _grow(padding);
+    for (int p = _decimate ? _channels : 0; p < _num_planes(); ++p)
+      std::fill(_plane(p), _plane(p) + padding, 0.0f);
+    _lengths[_decimate ? 1 : 0] = padding;
+  }
+
+  void append(const float *data, long frames, long frame_stride,
+              long channel_stride) {
+    if (frames <= 0) return;
+    _append(data, frames, frame_stride, channel_stride);
+    _input_end = _received;
+    _flushed = false;
+  }
+
+  // Append the zeros releasing the output frames of the last input frames.
+  void flush() {
+    if (_flushed) return;
+    _append(nullptr, _decimate ? _filter->taps : _filter->taps / 2, 0, 0);
+    _flushed = true;
+  }
+
+  // Write up to `max_frames` output frames, frame f of channel c to
+  // out[f * frame_stride + c * channel_stride]. Returns the number written.
+  long produce(float *out, long max_frames, long frame_stride,
+               long channel_stride) {
+    const int taps = _filter->taps;
+    long gen = 0;
+    if (_decimate) {
+      // output frame n needs odd frames up to n + taps / 2 - 1
+      const long last = std::min(
+          {_base + _lengths[0], _base + _lengths[1] - taps + 1,
+           (_input_end + 1) / 2});
+      const float *coeffs = _filter->decimate.data();
+      for (; gen < max_frames && _next < last; ++gen, ++_next) {
+        const long i = _next - _base;
+        for (int c = 0; c < _channels; ++c)
+          out[gen * frame_stride + c * channel_stride] =
+              0.5f * _plane(c)[i] +
+              kernels.dot_product(coeffs, _plane(_channels + c) + i, taps);
+      }
+    } else {
+      // input frames up to `available` - 1 are in the history
+      const long available = _base + _lengths[0] - taps / 2 + 1;
+      const long last = std::min(available, _input_end);
+      const float *coeffs = _filter->interpolate.data();
+      for (; gen < max_frames; ++gen, ++_next) {
+        const long n = _next / 2;
+        const long i = n - _base;
+        if (n >= last) break;
+        if ((_next & 1) == 0) {
+          for (int c = 0; c < _channels; ++c)
+            out[gen * frame_stride + c * channel_stride] =
+                _plane(c)[i + taps / 2 - 1];
+        } else {
+          if (n + taps / 2 >= available) break;
+          for (int c = 0; c < _channels; ++c)
+            out[gen * frame_stride + c * channel_stride] =
+                kernels.dot_product(coeffs, _plane(c) + i, taps);
+        }
+      }
+    }
+    _compact();
+    return gen;
+  }
+
+  bool flushed() const { return _flushed; }
+
+  // Saves the history from the filter window of the next output frame on,
+  // as `_compact` would keep it.
+  void save(StateWriter &out) const {
+    long first = (_decimate ? _next : _next / 2) - _base;
+    first = std::max(
+        0L, std::min(first, _decimate ? std::min(_lengths[0], _lengths[1])
+                                      : _lengths[0]));
+    const long lengths[2] = {_lengths[0] - first,
+                             _decimate ? _lengths[1] - first : 0};
+    out.put<uint8_t>(_flushed);
+    out.put<int64_t>(lengths[0]);
+    out.put<int64_t>(lengths[1]);
+    out.put<int64_t>(_base + first);
+    out.put<int64_t>(_received);
+    out.put<int64_t>(_input_end);
+    out.put<int64_t>(_next);
+    for (int p = 0; p < _num_planes(); ++p)
+      out.put_samples(_history.data() + p * _capacity + first,
+                      lengths[p < _channels ? 0 : 1]);
+  }
+
+  void restore(StateReader &in) {
+    const bool flushed = in.get<uint8_t>() != 0;
+    long lengths[2];
+    lengths[0] = in.get_count(_channels * sizeof(float));
+    lengths[1] = in.get_count(_channels * sizeof(float));
+    const long base = static_cast<long>(in.get<int64_t>());
+    const long received = static_cast<long>(in.get<int64_t>());
+    const long input_end = static_cast<long>(in.get<int64_t>());
+    const long next = static_cast<long>(in.get<int64_t>());
+    const long offset = (_decimate ? next : next / 2) - base;
+    if ((!_decimate && lengths[1] != 0) || base < 0 || next < 0 ||
+        offset < 0 || offset > lengths[0] ||
+        (_decimate && offset > lengths[1]))
+      invalid_snapshot();
+
+    _lengths[0] = _lengths[1] = 0;
+    _grow(std::max(lengths[0], lengths[1]));
+    for (int p = 0; p < _num_planes(); ++p)
+      in.get_samples(_plane(p), lengths[p < _channels ? 0 : 1]);
+    _lengths[0] = lengths[0];
+    _lengths[1] = lengths[1];
+    _base = base;
+    _received = received;
+    _input_end = input_end;
+    _next = next;
+    _flushed = flushed;
+  }
+};
+
+// Converter for power of two ratios from 1 / 16 to 16, a cascade of
+// half-band stages each converting by 1 / 2 or 2. A half-band filter has
+// every other tap zero, and all but the stage next to the lower rate have a
+// wide transition band and a short filter, so the cascade costs a fraction
+// of a polyphase filter bank of the same quality.
+//
+// Any other ratio, or a ratio change after the first input, switches the
+// converter to the polyphase converter of similar quality until reset; that
+// switch starts the polyphase converter from scratch.
+class HalfbandConverter : public Converter {
+ private:
+  int _converter_type;
+  int _channels;
+  std::vector<HalfbandStage> _stages;
+  double _ratio = 0.0;  // the ratio of `_stages`
+  bool _started = false;
+  std::unique_ptr<Converter> _fallback;
+  bool _use_fallback = false;
+  std::vector<float> _scratch;  // planar output of an intermediate stage
+
+  // Build the cascade for `ratio`, false if it is not a power of two or the
+  // conversion has already started at another ratio.
+  bool _configure(double ratio) {
+    if (!_stages.empty() && ratio == _ratio) return true;
+    const int stages = halfband_stages(ratio);
+    if (_started || stages == 0) return false;
+
+    const auto &filters = halfband_filters(_converter_type);
+    const bool decimate = ratio < 1.0;
+    _stages.clear();
+    for (int s = 0; s < stages; ++s) {
+      // the sharpest filter next to the lower rate
+      const int level = decimate ? stages - s : s + 1;
+      _stages.emplace_back(&filters[level - 1], decimate, _channels);
+    }
+    _ratio = ratio;
+    return true;
+  }
+
+  void _create_fallback() {
+    _fallback.reset(new PolyphaseConverter(
+        halfband_design(_converter_type).fallback_type, _channels));
+  }
+
+  int _start_fallback() {
+    _use_fallback = true;
+    if (_fallback) return _fallback->reset();
+    _create_fallback();
+    return 0;
+  }
+
+ public:
+  HalfbandConverter(int converter_type, int channels)
+      : _converter_type(converter_type), _channels(channels) {}
+
+  HalfbandConverter(const HalfbandConverter &other)
+      : _converter_type(other._converter_type),
+        _channels(other._channels),
+        _stages(other._stages),
+        _ratio(other._ratio),
+        _started(other._started),
+        _use_fallback(other._use_fallback) {}
+
+  int process(SRC_DATA *data) override {
+    if (!src_is_valid_ratio(data->src_ratio)) return SRC_ERR_BAD_SRC_RATIO;
+    if (!_use_fallback && !_configure(data->src_ratio)) {
+      int err_num = _start_fallback();
+      if (err_num != 0) return err_num;
+    }
+    if (_use_fallback) return _fallback->process(data);
+
+    try {
+      HalfbandStage &first = _stages.front();
+      if (data->input_frames > 0) _started = true;
+      first.append(data->data_in, data->input_frames, _channels, 1);
+      if (data->end_of_input) first.flush();
+
+      // intermediate stages convert everything they can, in chunks
+      const long chunk = 1024;
+      _scratch.resize(static_cast<size_t>(chunk) * _channels);
+      for (size_t s = 0; s + 1 < _stages.size(); ++s) {
+        long frames;
+        do {
+          frames = _stages[s].produce(_scratch.data(), chunk, 1, chunk);
+          _stages[s + 1].append(_scratch.data(), frames, 1, chunk);
+        } while (frames == chunk);
+        if (_stages[s].flushed()) _stages[s + 1].flush();
+      }
+    } catch (const std::bad_alloc &) {
+      return SRC_ERR_MALLOC_FAILED;
+    }
+    data->input_frames_used = data->input_frames;
+    data->output_frames_gen = _stages.back().produce(
+        data->data_out, data->output_frames, _channels, 1);
+    return 0;
+  }
+
+  int set_ratio(double new_ratio) override {
+    if (!src_is_valid_ratio(new_ratio)) return SRC_ERR_BAD_SRC_RATIO;
+    if (!_use_fallback && !_configure(new_ratio)) {
+      int err_num = _start_fallback();
+      if (err_num != 0) return err_num;
+    }
+    return _use_fallback ? _fallback->set_ratio(new_ratio) : 0;
+  }
+
+  int reset() override {
+    _use_fallback = _started = false;
+    for (auto &stage : _stages) stage.reset();
+    return _fallback ? _fallback->reset() : 0;
+  }
+
+  Converter *clone(int *error) const override {
+    auto clone = new HalfbandConverter(*this);
+    if (_fallback) {
+      clone->_fallback.reset(_fallback->clone(error));
+      if (!clone->_fallback) {
+        delete clone;
+        return nullptr;
+      }
+    }
+    return clone;
+  }
+
+  void save(ConverterSnapshot &snapshot) const override {
+    snapshot.clear();
+    StateWriter out(snapshot.data);
+    out.put(_ratio);
+    out.put<uint8_t>(_started);
+    out.put<uint8_t>(_use_fallback);
+    out.put<int64_t>(static_cast<int64_t>(_stages.size()));
+    for (const auto &stage : _stages) stage.save(out);
+    if (_fallback) _fallback->save(snapshot.inner_snapshot());
+  }
+
+  // Rebuilds the cascade only if the ratio differs.
+  void restore(const ConverterSnapshot &snapshot) override {
+    StateReader in(snapshot.data);
+    const double ratio = in.get<double>();
+    const bool started = in.get<uint8_t>() != 0;
+    const bool use_fallback = in.get<uint8_t>() != 0;
+    const int64_t stages = in.get<int64_t>();
+    _started = false;
+    if (ratio == 0.0) {
+      _stages.clear();
+      _ratio = 0.0;
+    } else if (!_configure(ratio)) {
+      invalid_snapshot();
+    }
+    if (stages != static_cast<int64_t>(_stages.size())) invalid_snapshot();
+    for (auto &stage : _stages) stage.restore(in);
+    in.finish();
+    _started = started;
+    _use_fallback = use_fallback;
+
+    if (snapshot.inner_count != 0) {
+      if (!_fallback) _create_fallback();
+      _fallback->restore(*snapshot.inner[0]);
+    } else if (_use_fallback) {
+      invalid_snapshot();
+    }
+  }
+};
+
+// Create a converter of any type, like src_new. Returns nullptr and sets
+// `error` on failure.
+Converter *converter_new(int converter_type, int channels, int *error) {
+  if (is_polyphase(converter_type)) {
+    if (channels < 1) {
+      *error = SRC_ERR_BAD_CHANNEL_COUNT;
+      return nullptr;
+    }
+    return new PolyphaseConverter(converter_type, channels);
+  }
+  if (is_halfband(converter_type)) {
+    if (channels < 1) {
+      *error = SRC_ERR_BAD_CHANNEL_COUNT;
+      return nullptr;
+    }
+    return new HalfbandConverter(converter_type, channels);
+  }
+  SRC_STATE *state = new_src_state(converter_type, channels, error);
+  return state == nullptr ? nullptr
+                         : new SrcConverter(state, converter_type);
+}
+
+// Number of input frames a converter holds back at a constant `ratio`
+// before its output catches up with the input, the lookahead of its
+// filter. Measured on a fresh single channel converter fed with silence, as
+// a stream starts.
+long converter_latency_frames(int converter_type, double ratio) {
+  if (!src_is_valid_ratio(ratio)) error_handler(SRC_ERR_BAD_SRC_RATIO);
+  int error = 0;
+  std::unique_ptr<Converter> probe(converter_new(converter_type, 1, &error));
+  if (!probe) error_handler(error);
+  const long frames = 2 * converter_history_frames(converter_type, ratio) + 64;
+  const std::vector<float> input(static_cast<size_t>(frames), 0.0f);
+  std::vector<float> output(static_cast<size_t>(frames * ratio) + 64);
+  long used = 0;
+  long gen = 0;
+  while (used < frames) {
+    SRC_DATA data = {input.data() + used, output.data(), frames - used,
+                     static_cast<long>(output.size()), 0, 0, 0, ratio};
+    error_handler(probe->process(&data));
+    if (data.input_frames_used == 0 && data.output_frames_gen == 0) break;
+    used += data.input_frames_used;
+    gen += data.output_frames_gen;
+  }
+  return std::max<long>(
+      0, static_cast<long>(std::ceil(used - gen / ratio - 1e-6)));
+}
+
+// Number of output frames over which an adaptive converter crossfades from
+// one sinc converter to the next.
+#define ADAPTIVE_CROSSFADE_FRAMES 256
+
+// One of libsamplerate's sinc converters, switching to another one of them
+// mid-stream on request, see the adaptive mode of Resampler. The next
+// converter starts on the recent input, early enough for its output to line
+// up with the previous one, and both run while their outputs are
+// crossfaded. Output converted ahead of what the caller can take is queued,
+// so the stream latency follows the converter in use.
+class AdaptiveConverter : public Converter {
+ private:
+  int _converter_type;
+  int _channels;
+  std::unique_ptr<Converter> _state;
+  std::unique_ptr<Converter> _fading;  // the previous converter
+  int _fading_type = 0;                // and its type
+  std::vector<float> _queue;           // output of _state not returned yet
+  std::vector<float> _fading_queue;    // output of _fading not returned yet
+  long _faded = 0;                     // crossfaded frames returned
+  long _skip = 0;  // output frames of _state before the switch point
+  std::vector<float> _history;  // the last input frames
+  long _input_frames = 0;       // input frames used since the start
+  double _position = 0.0;  // input time of the next output frame of _state
+  double _ratio = 0.0;     // ratio of the last call, 0 before the first one
+
+  long _frames(const std::vector<float> &samples) const {
+    return static_cast<long>(samples.size() / _channels);
+  }
+
+  void _drop(std::vector<float> &samples, long frames) {
+    samples.erase(samples.begin(), samples.begin() + frames * _channels);
+  }
+
+  // Convert all of `frames` input frames with `state`, appending its output
+  // to `queue`. Returns the number of output frames through `gen`.
+  int _convert_all(Converter *state, const float *in, long frames,
+                   bool end_of_input, double ratio, std::vector<float> &queue,
+                   long *gen) {
+    long used = 0;
+    *gen = 0;
+    while (true) {
+      const long room = static_cast<long>((frames - used) * ratio) + 64;
+      const size_t size = queue.size();
+      queue.resize(size + static_cast<size_t>(room * _channels));
+      SRC_DATA data = {in + used * _channels, queue.data() + size,
+                       frames - used, room, 0, 0, end_of_input, ratio};
+      const int err_num = state->process(&data);
+      queue.resize(size + static_cast<size_t>(data.output_frames_gen * _channels));
+      if (err_num != 0) return err_num;
+      used += data.input_frames_used;
+      *gen += data.output_frames_gen;
+      if (data.output_frames_gen < room && used == frames) return 0;
+      if (data.input_frames_used == 0 && data.output_frames_gen == 0) return 0;
+    }
+  }
+
+  // Account for `used` input frames and `gen` output frames of _state.
+  void _record(const float *in, long used, long gen, double ratio) {
+    _history.insert(_history.end(), in, in + used * _channels);
+    const long keep =
+        3 * converter_history_frames(SRC_SINC_BEST_QUALITY, ratio) + 64;
+    if (_frames(_history) > 2 * keep)
+      _drop(_history, _frames(_history) - keep);
+    _input_frames += used;
+    // libsamplerate ramps the ratio over a call, about its mean
+    _position += gen / (_ratio > 0.0 ? 0.5 * (_ratio + ratio) : ratio);
+    _ratio = ratio;
+  }
+
+  // Return up to `max_frames` queued frames into `out`, crossfaded while
+  // the previous converter is fading out.
+  long _emit(float *out, long max_frames) {
+    long emitted = 0;
+    if (_fading) {
+      emitted = std::min({max_frames, _frames(_queue), _frames(_fading_queue),
+                          ADAPTIVE_CROSSFADE_FRAMES - _faded});
+      for (long f = 0; f < emitted; ++f) {
+        const float w = (_faded + f + 0.5f) / ADAPTIVE_CROSSFADE_FRAMES;
+        for (int c = 0; c < _channels; ++c) {
+          const size_t i = static_cast<size_t>(f * _channels + c);
+          out[i] = _fading_queue[i] + w * (_queue[i] - _fading_queue[i]);
+        }
+      }
+      _drop(_queue, emitted);
+      _drop(_fading_queue, emitted);
+      _faded += emitted;
+      if (_faded < ADAPTIVE_CROSSFADE_FRAMES) return emitted;
+      _fading.reset();
+      _fading_queue.clear();
+    }
+    const long frames = std::min(max_frames - emitted, _frames(_queue));
+    std::copy(_queue.begin(), _queue.begin() + frames * _channels,
+              out + emitted * _channels);
+    _drop(_queue, frames);
+    return emitted + frames;
+  }
+
+ public:
+  AdaptiveConverter(int converter_type, int channels, int *error)
+      : _converter_type(converter_type), _channels(channels) {
+    _state.reset(converter_new(converter_type, channels, error));
+  }
+
+  AdaptiveConverter(const AdaptiveConverter &other)
+      : _converter_type(other._converter_type),
+        _channels(other._channels),
+        _fading_type(other._fading_type),
+        _queue(other._queue),
+        _fading_queue(other._fading_queue),
+        _faded(other._faded),
+        _skip(other._skip),
+        _history(other._history),
+        _input_frames(other._input_frames),
+        _position(other._position),
+        _ratio(other._ratio) {}
+
+  AdaptiveConverter &operator=(AdaptiveConverter &&) = default;
+
+  bool valid() const { return static_cast<bool>(_state); }
+
+  // Whether `switch_to` may be called: the stream has started, and all
+  // output of the last switch was returned.
+  bool can_switch() const {
+    return _ratio > 0.0 && !_fading && _queue.empty() && _skip == 0;
+  }
+
+  // Switch to the sinc converter `converter_type`, needs can_switch().
+  int switch_to(int converter_type) {
+    int err_num = 0;
+    std::unique_ptr<Converter> next(
+        converter_new(converter_type, _channels, &err_num));
+    if (!next) return err_num;
+
+    // Start the next converter a filter length before the next output
+    // frame, so that frame gets a full filter, and drop its output up to
+    // there. Both outputs then line up to within half an output frame.
+    // The position never passes the input, unless restored from a forged
+    // snapshot.
+    const long first_kept = _input_frames - _frames(_history);
+    const long start = std::max<long>(
+        first_kept,
+        static_cast<long>(std::min(std::floor(_position),
+                                   static_cast<double>(_input_frames))) -
+            converter_history_frames(converter_type, _ratio) - 1);
+    std::vector<float> output;
+    long gen = 0;
+    try {
+      err_num = _convert_all(next.get(),
+                             _history.data() + (start - first_kept) * _channels,
+                             _input_frames - start, false, _ratio, output, &gen);
+    } catch (const std::bad_alloc &) {
+      return SRC_ERR_MALLOC_FAILED;
+    }
+    if (err_num != 0) return err_num;
+    _skip = std::lround((_position - start) * _ratio);
+    const long skipped = std::min(_skip, gen);
+    _drop(output, skipped);
+    _skip -= skipped;
+
+    _fading = std::move(_state);
+    _fading_type = _converter_type;
+    _state = std::move(next);
+    _queue = std::move(output);
+    _fading_queue.clear();
+    _faded = 0;
+    _position = start + gen / _ratio;
+    _converter_type = converter_type;
+    return 0;
+  }
+
+  int process(SRC_DATA *data) override {
+    if (!src_is_valid_ratio(data->src_ratio)) return SRC_ERR_BAD_SRC_RATIO;
+    if (!_fading && _queue.empty() && _skip == 0) {
+      // steady state, straight into the caller's buffer
+      const int err_num = _state->process(data);
+      if (err_num != 0) return err_num;
+      _record(data->data_in, data->input_frames_used, data->output_frames_gen,
+              data->src_ratio);
+      return 0;
+    }
+
+    try {
+      long gen = 0;
+      int err_num =
+          _convert_all(_state.get(), data->data_in, data->input_frames,
+                       data->end_of_input, data->src_ratio, _queue, &gen);
+      if (err_num != 0) return err_num;
+      if (_fading) {
+        long fading_gen = 0;
+        err_num = _convert_all(_fading.get(), data->data_in,
+                               data->input_frames, data->end_of_input,
+                               data->src_ratio, _fading_queue, &fading_gen);
+        if (err_num != 0) return err_num;
+      }
+      const long skipped = std::min(_skip, _frames(_queue));
+      _drop(_queue, skipped);
+      _skip -= skipped;
+      _record(data->data_in, data->input_frames, gen, data->src_ratio);
+    } catch (const std::bad_alloc &) {
+      return SRC_ERR_MALLOC_FAILED;
+    }
+    data->input_frames_used = data->input_frames;
+    data->output_frames_gen = _emit(data->data_out, data->output_frames);
+    return 0;
+  }
+
+  int set_ratio(double new_ratio) override {
+    if (!src_is_valid_ratio(new_ratio)) return SRC_ERR_BAD_SRC_RATIO;
+    if (_fading) {
+      const int err_num = _fading->set_ratio(new_ratio);
+      if (err_num != 0) return err_num;
+    }
+    if (_ratio > 0.0) _ratio = new_ratio;
+    return _state->set_ratio(new_ratio);
+  }
+
+  int reset() override {
+    _fading.reset();
+    _queue.clear();
+    _fading_queue.clear();
+    _history.clear();
+    _faded = _skip = _input_frames = 0;
+    _position = _ratio = 0.0;
+    return _state->reset();
+  }
+
+  Converter *clone(int *error) const override {
+    std::unique_ptr<AdaptiveConverter> clone(new AdaptiveConverter(*this));
+    clone->_state.reset(_state->clone(error));
+    if (!clone->_state) return nullptr;
+    if (_fading) {
+      clone->_fading.reset(_fading->clone(error));
+      if (!clone->_fading) return nullptr;
+    }
+    return clone.release();
+  }
+
+  // The state is the positions and the samples queued or kept as history,
+  // followed by the states of the converter and of the one fading out.
+  void save(ConverterSnapshot &snapshot) const override {
+    snapshot.clear();
+    StateWriter out(snapshot.data);
+    out.put<int32_t>(_converter_type);
+    out.put<int32_t>(_fading ? _fading_type : -1);
+    out.put<int64_t>(_faded);
+    out.put<int64_t>(_skip);
+    out.put<int64_t>(_input_frames);
+    out.put(_position);
+    out.put(_ratio);
+    for (const auto *samples : {&_queue, &_fading_queue, &_history}) {
+      out.put<int64_t>(_frames(*samples));
+      out.put_samples(samples->data(), static_cast<long>(samples->size()));
+    }
+    _state->save(snapshot.inner_snapshot());
+    if (_fading) _fading->save(snapshot.inner_snapshot());
+  }
+
+  // Restores into the current converters if they have the saved types.
+  void restore(const ConverterSnapshot &snapshot) override {
+    StateReader in(snapshot.data);
+    const int converter_type = in.get<int32_t>();
+    const int fading_type = in.get<int32_t>();
+    const long faded = static_cast<long>(in.get<int64_t>());
+    const long skip = static_cast<long>(in.get<int64_t>());
+    const long input_frames = static_cast<long>(in.get<int64_t>());
+    const double position = in.get<double>();
+    const double ratio = in.get<double>();
+    long frames[3];
+    const void *samples[3];
+    for (int i = 0; i < 3; ++i) {
+      frames[i] = in.get_count(_channels * sizeof(float));
+      samples[i] = in.get_samples(frames[i] * _channels);
+    }
+    in.finish();
+    const auto is_sinc = [](int type) {
+      return type >= SRC_SINC_BEST_QUALITY && type <= SRC_SINC_FASTEST;
+    };
+    const bool fading = fading_type != -1;
+    if (!is_sinc(converter_type) || (fading && !is_sinc(fading_type)) ||
+        snapshot.inner_count != (fading ? 2u : 1u) || faded < 0 ||
+        faded > ADAPTIVE_CROSSFADE_FRAMES || skip < 0 ||
+        frames[2] > input_frames || !std::isfinite(position) ||
+        position < 0.0 || !(ratio == 0.0 || src_is_valid_ratio(ratio)))
+      invalid_snapshot();
+
+    const auto restore_into = [this](std::unique_ptr<Converter> &state,
+                                     int &type, int saved_type,
+                                     const ConverterSnapshot &saved) {
+      if (!state || type != saved_type) {
+        int err_num = 0;
+        std::unique_ptr<Converter> created(
+            converter_new(saved_type, _channels, &err_num));
+        if (!created) error_handler(err_num);
+        state = std::move(created);
+        type = saved_type;
+      }
+      state->restore(saved);
+    };
+    const auto assign = [this](std::vector<float> &to, const void *from,
+                               long frames) {
+      to.resize(static_cast<size_t>(frames * _channels));
+      if (!to.empty()) std::memcpy(to.data(), from, to.size() * sizeof(float));
+    };
+    try {
+      restore_into(_state, _converter_type, converter_type,
+                   *snapshot.inner[0]);
+      if (fading) {
+        restore_into(_fading, _fading_type, fading_type, *snapshot.inner[1]);
+      } else {
+        _fading.reset();
+      }
+      assign(_queue, samples[0], frames[0]);
+      assign(_fading_queue, samples[1], frames[1]);
+      assign(_history, samples[2], frames[2]);
+    } catch (...) {
+      reset();
+      throw;
+    }
+    _faded = faded;
+    _skip = skip;
+    _input_frames = input_frames;
+    _position = position;
+    _ratio = ratio;
+  }
+
+  int converter_type() const { return _converter_type; }
+};
+
+// Maximum number of converter states kept per thread by the one-shot
+// `resample` function, see StateCache.
+std::atomic<size_t> state_cache_size{4};
+// Bumped by clear_state_cache() to invalidate the caches of all threads.
+std::atomic<unsigned long> state_cache_generation{0};
+
+// Cache of reusable converter states for the one-shot `resample` function.
+// src_simple allocates (src_new) and frees (src_delete) the whole filter
+// state on every call, which is expensive for the sinc converters. Each
+// thread keeps its own small LRU list of states keyed by (converter type,
+// channels), so no locking is needed even while the GIL is released.
+class StateCache {
+ private:
+  struct Entry {
+    int converter_type;
+    int channels;
+    Converter *state;
+  };
+
+  // most recently used entries are at the back
+  std::vector<Entry> _entries;
+  unsigned long _generation = 0;
+
+  void _check_generation() {
+    unsigned long generation = state_cache_generation.load();
+    if (generation != _generation) {
+      clear();
+      _generation = generation;
+    }
+  }
+
+ public:
+  ~StateCache() { clear(); }
+
+  void clear() {
+    for (auto &entry : _entries) delete entry.state;
+    _entries.clear();
+  }
+
+  // Take a reset state out of the cache, or create a new one.
+  Converter *acquire(int converter_type, int channels) {
+    _check_generation();
+    for (auto it = _entries.rbegin(); it != _entries.rend(); ++it) {
+      if (it->converter_type == converter_type && it->channels == channels) {
+        std::unique_ptr<Converter> state(it->state);
+        _entries.erase(std::next(it).base());
+        error_handler(state->reset());
+        return state.release();
+      }
+    }
+
+    int err_num = 0;
+    Converter *state = converter_new(converter_type, channels, &err_num);
+    error_handler(err_num);
+    return state;
+  }
+
+  // Hand a state back to the cache, evicting the least recently used ones.
+  void release(int converter_type, int channels, Converter *state) {
+    _check_generation();
+    const size_t max_size = state_cache_size.load();
+    if (max_size == 0) {
+      delete state;
+      return;
+    }
+    _entries.push_back({converter_type, channels, state});
+    while (_entries.size() > max_size) {
+      delete _entries.front().state;
+      _entries.erase(_entries.begin());
+    }
+  }
+};
+
+thread_local StateCache state_cache;
+
+// Scoped checkout of a converter state from the calling thread's cache.
+class CachedState {
+ private:
+  int _converter_type;
+  int _channels;
+  Converter *_state;
+
+ public:
+  CachedState(int converter_type, int channels)
+      : _converter_type(converter_type),
+        _channels(channels),
+        _state(state_cache.acquire(converter_type, channels)) {}
+  CachedState(const CachedState &) = delete;
+  CachedState &operator=(const CachedState &) = delete;
+  ~CachedState() { state_cache.release(_converter_type, _channels, _state); }
+
+  Converter *get() const { return _state; }
+};
+
+// Mutex of one resampler object, see ObjectLock, with the thread holding it.
+struct ObjectMutex {
+  std::mutex mutex;
+  std::atomic<std::thread::id> owner{};
+};
+
+// Scoped lock of the state of one resampler object, which Python threads may
+// share: without the GIL on free-threaded builds, and with the GIL released
+// during conversions otherwise. A thread holding the GIL releases it while
+// waiting, since the owner of the lock may need the GIL to finish. Taking
+// the lock again from the thread holding it, e.g. from the callback of a
+// read, raises instead of deadlocking.
+class ObjectLock {
+ private:
+  ObjectMutex &_mutex;
+  std::unique_lock<std::mutex> _lock;
+
+ public:
+  explicit ObjectLock(ObjectMutex &mutex)
+      : _mutex(mutex), _lock(mutex.mutex, std::defer_lock) {
+    const std::thread::id self = std::this_thread::get_id();
+    // only this thread can have stored its own id
+    if (_mutex.owner.load() == self)
+      throw std::runtime_error(
+          "The resampler is busy in this thread, e.g. calling its callback, "
+          "and cannot be used from there.");
+    if (!_lock.try_lock()) {
+      if (PyGILState_Check()) {
+        py::gil_scoped_release release;
+        _lock.lock();
+      } else {
+        _lock.lock();
+      }
+    }
+    _mutex.owner.store(self);
+  }
+
+  ~ObjectLock() { _mutex.owner.store(std::thread::id()); }
+};
+
+// Persistent pool of native worker threads. It runs resampling work in
+// parallel while the GIL is released, so jobs must never touch a Python
+// object. The pool grows on demand and its threads live until the process
+// exits.
+class ThreadPool {
+ private:
+  std::vector<std::thread> _workers;
+  std::deque<std::function<void()>> _jobs;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  size_t _idle = 0;  // workers waiting for a job
+
+  void _work() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_idle;
+        _cv.wait(lock, [this] { return !_jobs.empty(); });
+        --_idle;
+        job = std::move(_jobs.front());
+        _jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+ public:
+  size_t size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _workers.size();
+  }
+
+  // Queue `count` copies of `job`, starting workers until at least `count`
+  // of them exist.
+  void submit(size_t count, const std::function<void()> &job) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      while (_workers.size() < count) {
+        _workers.emplace_back(&ThreadPool::_work, this);
+        _workers.back().detach();
+      }
+      for (size_t i = 0; i < count; ++i) _jobs.push_back(job);
+    }
+    _cv.notify_all();
+  }
+
+  // Queue one independent job, starting a worker if none is idle and fewer
+  // than `max_workers` exist.
+  void post(std::function<void()> job, size_t max_workers) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _jobs.push_back(std::move(job));
+      if (_idle < _jobs.size() && _workers.size() < max_workers) {
+        _workers.emplace_back(&ThreadPool::_work, this);
+        _workers.back().detach();
+      }
+    }
+    _cv.notify_one();
+  }
+};
+
+// The process-wide pool. It is intentionally never destroyed, so no worker
+// has to be joined during interpreter shutdown. After a fork() the child has
+// no worker threads, so a fresh pool is created there.
+ThreadPool &thread_pool() {
+  static std::mutex pool_mutex;
+  static ThreadPool *pool = nullptr;
+#ifndef _WIN32
+  static pid_t pool_pid = 0;
+#endif
+  std::lock_guard<std::mutex> lock(pool_mutex);
+#ifndef _WIN32
+  if (pool != nullptr && pool_pid != getpid()) pool = nullptr;
+  pool_pid = getpid();
+#endif
+  if (pool == nullptr) pool = new ThreadPool();
+  return *pool;
+}
+
+// Number of hardware threads, at least 1.
+size_t hardware_threads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Call `fn(i)` for every i in [0, n) using up to `num_threads` threads, the
+// calling thread included. Tasks are claimed from a shared counter, so the
+// calling thread finishes the work on its own if all workers are busy, e.g.
+// in nested calls. The first exception thrown by a task is rethrown here
+// once all claimed tasks have completed.
+void parallel_for(size_t n, size_t num_threads,
+                  const std::function<void(size_t)> &fn) {
+  if (num_threads == 0) num_threads = hardware_threads();
+  const size_t helpers = std::min(num_threads, n) - (n > 0 ? 1 : 0);
+  if (helpers == 0) {
+    for (size_t i = 0; i < n; ++i) fn(i);
+    return;
+  }
+
+  struct Shared {
+    const std::function<void(size_t)> *fn;
+    size_t n;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr error;
+  };
+  auto shared = std::make_shared<Shared>();
+  shared->fn = &fn;
+  shared->n = n;
+
+  // helpers may start after all tasks are taken; they then return without
+  // touching `fn`, which only lives as long as this call
+  auto run_tasks = [shared]() {
+    size_t i;
+    while ((i = shared->next.fetch_add(1)) < shared->n) {
+      try {
+        (*shared->fn)(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        if (!shared->error) shared->error = std::current_exception();
+      }
+      if (shared->done.fetch_add(1) + 1 == shared->n) {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->cv.notify_all();
+      }
+    }
+  };
+
+  thread_pool().submit(helpers, run_tasks);
+  run_tasks();
+
+  std::unique_lock<std::mutex> lock(shared->mutex);
+  shared->cv.wait(lock, [&] { return shared->done.load() == n; });
+  if (shared->error) std::rethrow_exception(shared->error);
+}
+
+// Runs the asynchronous calls of one resampler one at a time on the thread
+// pool, in the order they were made, since each continues from the state
+// left by the previous one.
+class SerialQueue : public std::enable_shared_from_this<SerialQueue> {
+ private:
+  std::deque<std::function<void()>> _jobs;
+  std::mutex _mutex;
+  bool _running = false;
+  std::atomic<size_t> _pending{0};
+
+  void _drain() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_jobs.empty()) {
+          _running = false;
+          return;
+        }
+        job = std::move(_jobs.front());
+        _jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+ public:
+  // Number of queued calls whose work has not finished yet.
+  size_t pending() const { return _pending.load(); }
+
+  void post(std::function<void()> job) {
+    ++_pending;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _jobs.push_back(std::move(job));
+      if (_running) return;
+      _running = true;
+    }
+    auto self = shared_from_this();
+    thread_pool().post([self]() { self->_drain(); }, hardware_threads());
+  }
+
+  // Called by a job once it no longer touches the resampler.
+  void done() { --_pending; }
+};
+
+// An asynchronous call: `work` runs on the thread pool without the GIL, then
+// `finish` runs on the event loop's thread with the GIL held, and its result
+// or the exception thrown by either completes `future`. The Python objects
+// of a call are only released with the GIL held.
+struct AsyncCall {
+  std::function<void()> work;
+  std::function<py::object()> finish;
+  py::object loop;
+  py::object future;
+  std::exception_ptr error;
+  std::shared_ptr<SerialQueue> queue;
+};
+
+// Complete the future of `call` on the event loop's thread, unless it was
+// cancelled meanwhile.
+void complete_async_call(AsyncCall &call) {
+  if (!call.future.attr("cancelled")().cast<bool>()) {
+    try {
+      if (call.error) std::rethrow_exception(call.error);
+      call.future.attr("set_result")(call.finish());
+    } catch (py::error_already_set &e) {
+      call.future.attr("set_exception")(e.value());
+    } catch (...) {
+      // raised through a Python call, so the future gets the exception a
+      // synchronous call would raise
+      const auto error = std::current_exception();
+      try {
+        py::cpp_function([error]() { std::rethrow_exception(error); })();
+      } catch (py::error_already_set &e) {
+        call.future.attr("set_exception")(e.value());
+      }
+    }
+  }
+  call.work = nullptr;
+  call.finish = nullptr;
+}
+
+// Run `work` on the thread pool, after the earlier calls of `queue` if
+// given, and return an asyncio future of the result of `finish`. Must be
+// called from a coroutine, or a callback of the running event loop. The
+// future is completed with a single `loop.call_soon_threadsafe`, without
+// any Python thread or executor involved.
+py::object run_async(std::function<void()> work,
+                     std::function<py::object()> finish,
+                     const std::shared_ptr<SerialQueue> &queue = nullptr) {
+  auto call = std::make_shared<AsyncCall>();
+  call->loop = py::module_::import("asyncio").attr("get_running_loop")();
+  call->future = call->loop.attr("create_future")();
+  call->work = std::move(work);
+  call->finish = std::move(finish);
+  call->queue = queue;
+  py::object future = call->future;
+
+  std::function<void()> job = [call]() mutable {
+    try {
+      call->work();
+    } catch (...) {
+      call->error = std::current_exception();
+    }
+    if (call->queue) call->queue->done();
+    py::gil_scoped_acquire acquire;
+    try {
+      call->loop.attr("call_soon_threadsafe")(
+          py::cpp_function([call]() { complete_async_call(*call); }));
+    } catch (py::error_already_set &) {
+      // the loop was closed, nobody waits for the result
+    }
+    call.reset();
+  };
+  if (queue)
+    queue->post(job);
+  else
+    thread_pool().post(job, hardware_threads());
+  return future;
+}
+
+// Number of threads used when a `num_threads` argument is not given, see
+// set_num_threads().
+std::atomic<size_t> default_num_threads{1};
+
+// Resolve a `num_threads` argument: None selects the default set with
+// set_num_threads(), and 0 selects one thread per CPU core.
+size_t get_num_threads(const py::object &num_threads) {
+  long n = num_threads.is_none() ? static_cast<long>(default_num_threads.load())
+                                 : num_threads.cast<long>();
+  if (n < 0) throw std::domain_error("num_threads must not be negative.");
+  return n == 0 ? hardware_threads() : static_cast<size_t>(n);
+}
+
+// Split `channels` interleaved channels into up to `num_threads` groups of
+// adjacent channels. Returns the first channel of every group followed by
+// `channels`, so group g covers [offsets[g], offsets[g + 1]).
+std::vector<int> split_channels(int channels, size_t num_threads) {
+  const int groups =
+      std::max(1, static_cast<int>(std::min<size_t>(num_threads, channels)));
+  std::vector<int> offsets(groups + 1);
+  for (int g = 0; g <= groups; ++g) offsets[g] = g * channels / groups;
+  return offsets;
+}
+
+// Run a converter whose channels are split into groups with one state each
+// (see split_channels). Every group is converted on its own thread, reading
+// its channels from the interleaved input and writing them to the interleaved
+// output of `data`. With a single group this is a plain process call. Does
+// not touch any Python object.
+SRC_DATA process_channel_groups(Converter *const *states,
+                                const std::vector<int> &offsets,
+                                SRC_DATA data) {
+  const size_t groups = offsets.size() - 1;
+  if (groups == 1) {
+    error_handler(states[0]->process(&data));
+    return data;
+  }
+
+  const int channels = offsets.back();
+  std::vector<SRC_DATA> results(groups, data);
+  parallel_for(groups, groups, [&](size_t g) {
+    const int first = offsets[g];
+    const int width = offsets[g + 1] - first;
+
+    // deinterleaving buffers, reused by every call on this thread
+    thread_local std::vector<float> group_in, group_out;
+    group_in.resize(static_cast<size_t>(data.input_frames * width));
+    group_out.resize(static_cast<size_t>(data.output_frames * width));
+
+    for (long f = 0; f < data.input_frames; ++f)
+      std::copy(data.data_in + f * channels + first,
+                data.data_in + f * channels + first + width,
+                group_in.data() + f * width);
+
+    results[g].data_in = group_in.data();
+    results[g].data_out = group_out.data();
+    error_handler(states[g]->process(&results[g]));
+
+    for (long f = 0; f < results[g].output_frames_gen; ++f)
+      std::copy(group_out.data() + f * width,
+                group_out.data() + (f + 1) * width,
+                data.data_out + f * channels + first);
+  });
+
+  // all groups see the same input at the same ratio, so they advance alike
+  for (size_t g = 1; g < groups; ++g) {
+    if (results[g].output_frames_gen != results[0].output_frames_gen ||
+        results[g].input_frames_used != results[0].input_frames_used)
+      throw std::runtime_error("Channel groups went out of sync.");
+  }
+  data.input_frames_used = results[0].input_frames_used;
+  data.output_frames_gen = results[0].output_frames_gen;
+  return data;
+}
+
+// Validate a caller-provided output buffer for the `*_into` methods and
+// return its capacity in frames. The array is bound without conversion, so
+// it is guaranteed to be float32 and C-contiguous at this point.
+long check_output_array(py::array_t<float, py::array::c_style> &out,
+                        size_t channels) {
+  if (!out.writeable())
+    throw std::domain_error("Output array must be writeable.");
+
+  if (out.ndim() == 1) {
+    if (channels != 1)
+      throw std::domain_error("Invalid number of channels in output array.");
+  } else if (out.ndim() == 2) {
+    if ((size_t)out.shape(1) != channels)
+      throw std::domain_error("Invalid number of channels in output array.");
+  } else {
+    throw std::domain_error("Output array should have 1 or 2 dimensions");
+  }
+
+  return static_cast<long>(out.shape(0));
+}
+
+// Read a conversion ratio that is either shared by `n` signals or given as
+// a sequence with one ratio per signal.
+std::vector<double> get_ratios(const py::object &ratio, size_t n) {
+  std::vector<double> ratios;
+  if (py::isinstance<py::sequence>(ratio) && !py::isinstance<py::str>(ratio)) {
+    ratios = ratio.cast<std::vector<double>>();
+    if (ratios.size() != n)
+      throw std::domain_error("Expected one ratio per input array.");
+  } else {
+    ratios.assign(n, ratio.cast<double>());
+  }
+  return ratios;
+}
+
+// Whether input that would have to be converted to a new float32 array
+// raises instead, see set_strict_input().
+std::atomic<bool> strict_input{false};
+
+// Number of frames of non-contiguous or integer input gathered per
+// converter call, and of integer output converted at once.
+#define INPUT_CHUNK_FRAMES 2048
+
+// Sample types read and written without a temporary copy of the signal.
+enum class SampleFormat { float32, int16, int32 };
+
+// Parse a `dtype` argument, anything accepted by `numpy.dtype`.
+SampleFormat get_sample_format(const py::object &dtype) {
+  if (dtype.is_none()) return SampleFormat::float32;
+  const auto name = py::module_::import("numpy")
+                        .attr("dtype")(dtype)
+                        .attr("name")
+                        .cast<std::string>();
+  if (name == "float32") return SampleFormat::float32;
+  if (name == "int16") return SampleFormat::int16;
+  if (name == "int32") return SampleFormat::int32;
+  throw std::domain_error("Unsupported dtype. Use float32, int16 or int32.");
+}
+
+// Round and saturate float samples to an integer type, see
+// float_to_pcm_scalar().
+inline void float_to_pcm(const float *src, int16_t *dst, size_t count) {
+  kernels.float_to_int16(src, dst, count);
+}
+
+inline void float_to_pcm(const float *src, int32_t *dst, size_t count) {
+  kernels.float_to_int32(src, dst, count);
+}
+
+// float32 samples are copied as they are.
+inline void float_to_pcm(const float *src, float *dst, size_t count) {
+  std::copy(src, src + count, dst);
+}
+
+// An input signal viewed as (frames, channels) samples with arbitrary
+// strides. Numpy arrays, buffer protocol objects and DLPack producers are
+// used in place as long as they hold aligned float32, int16 or int32 data.
+// Anything else is converted to a new C-contiguous float32 array, or raises
+// in strict input mode. Must be created and destroyed with the GIL held,
+// `gather` does not need it.
+class InputBuffer {
+ private:
+  py::object _owner;  // keeps the viewed buffer alive
+  const char *_data = nullptr;
+  ssize_t _frame_stride = 0;    // in bytes
+  ssize_t _channel_stride = 0;  // in bytes
+  SampleFormat _format = SampleFormat::float32;
+
+  static bool _usable(const py::array &array, SampleFormat *format) {
+    if (py::isinstance<py::array_t<float>>(array))
+      *format = SampleFormat::float32;
+    else if (py::isinstance<py::array_t<int16_t>>(array))
+      *format = SampleFormat::int16;
+    else if (py::isinstance<py::array_t<int32_t>>(array))
+      *format = SampleFormat::int32;
+    else
+      return false;
+    const ssize_t size = array.itemsize();
+    if (reinterpret_cast<uintptr_t>(array.data()) % size != 0) return false;
+    for (ssize_t i = 0; i < array.ndim(); ++i)
+      if (array.strides(i) % size != 0) return false;
+    return true;
+  }
+
+  template <typename T>
+  void _gather(long first, long count, float *dst) const {
+    for (long f = 0; f < count; ++f) {
+      const char *frame = _data + (first + f) * _frame_stride;
+      for (int c = 0; c < channels; ++c)
+        dst[f * channels + c] = static_cast<float>(
+            *reinterpret_cast<const T *>(frame + c * _channel_stride));
+    }
+  }
+
+ public:
+  long frames = 0;
+  int channels = 1;
+  int ndim = 1;
+
+  // `planar` reads a 2D input as (channels, frames).
+  explicit InputBuffer(const py::object &input, bool planar = false) {
+    py::object obj;
+    if (py::isinstance<py::array>(input)) {
+      obj = input;
+    } else {
+      if (py::hasattr(input, "__dlpack__") &&
+          !PyObject_CheckBuffer(input.ptr())) {
+        try {
+          obj = py::module_::import("numpy").attr("from_dlpack")(input);
+        } catch (const py::error_already_set &) {
+          // e.g. a device tensor, go through the array interface instead
+        }
+      }
+      if (!obj) obj = py::array::ensure(input);
+      if (!obj) throw py::type_error("Input cannot be converted to an array.");
+    }
+    auto array = py::reinterpret_borrow<py::array>(obj);
+
+    if (!_usable(array, &_format)) {
+      if (strict_input.load())
+        throw std::domain_error(
+            "Input would be copied to a new float32 array, which is disabled "
+            "by set_strict_input(True).");
+      auto converted = np_array_f32::ensure(array);
+      if (!converted)
+        throw py::type_error("Input cannot be converted to a float32 array.");
+      array = converted;
+      _format = SampleFormat::float32;
+    }
+
+    ndim = static_cast<int>(array.ndim());
+    if (ndim > 2)
+      throw std::domain_error("Input array should have at most 2 dimensions");
+    if (ndim == 0)
+      throw std::domain_error("Input array should have 1 or 2 dimensions");
+
+    const int frame_axis = planar && ndim == 2 ? 1 : 0;
+    _owner = array;
+    _data = static_cast<const char *>(array.data());
+    frames = static_cast<long>(array.shape(frame_axis));
+    _frame_stride = array.strides(frame_axis);
+    if (ndim == 2) {
+      channels = static_cast<int>(array.shape(1 - frame_axis));
+      _channel_stride = array.strides(1 - frame_axis);
+    } else {
+      _channel_stride = array.itemsize();
+    }
+  }
+
+  // View of interleaved float32 frames owned by the caller, e.g. input
+  // gathered once and shared by several conversions. Needs no GIL.
+  InputBuffer(const float *samples, long num_frames, int num_channels,
+              int num_dims)
+      : _data(reinterpret_cast<const char *>(samples)),
+        _frame_stride(static_cast<ssize_t>(num_channels * sizeof(float))),
+        _channel_stride(sizeof(float)),
+        frames(num_frames),
+        channels(num_channels),
+        ndim(num_dims) {}
+
+  // Whether the samples are interleaved and contiguous.
+  bool dense() const {
+    const ssize_t size = _format == SampleFormat::int16 ? 2 : 4;
+    return (channels <= 1 || _channel_stride == size) &&
+           (frames <= 1 || _frame_stride == channels * size);
+  }
+
+  // Whether the samples are float32, interleaved and contiguous, so `data`
+  // can be passed to a converter directly.
+  bool contiguous() const {
+    return _format == SampleFormat::float32 && dense();
+  }
+
+  const float *data() const { return reinterpret_cast<const float *>(_data); }
+
+  // Copy frames [first, first + count) interleaved to `dst`, converting
+  // integer samples to float.
+  void gather(long first, long count, float *dst) const {
+    if (contiguous()) {
+      std::copy(data() + first * channels, data() + (first + count) * channels,
+                dst);
+      return;
+    }
+    if (dense()) {
+      const size_t offset = static_cast<size_t>(first) * channels;
+      const size_t samples = static_cast<size_t>(count) * channels;
+      if (_format == SampleFormat::int16) {
+        kernels.int16_to_float(
+            reinterpret_cast<const int16_t *>(_data) + offset, dst, samples);
+        return;
+      }
+      if (_format == SampleFormat::int32) {
+        kernels.int32_to_float(
+            reinterpret_cast<const int32_t *>(_data) + offset, dst, samples);
+        return;
+      }
+    }
+    switch (_format) {
+      case SampleFormat::float32:
+        _gather<float>(first, count, dst);
+        break;
+      case SampleFormat::int16:
+        _gather<int16_t>(first, count, dst);
+        break;
+      case SampleFormat::int32:
+        _gather<int32_t>(first, count, dst);
+        break;
+    }
+  }
+
+  // Largest absolute sample of frames [first, first + count), as float.
+  float peak(long first, long count) const {
+    if (contiguous())
+      return kernels.peak(data() + first * channels,
+                          static_cast<size_t>(count * channels));
+    thread_local std::vector<float> scratch;
+    scratch.resize(static_cast<size_t>(INPUT_CHUNK_FRAMES * channels));
+    float result = 0.0f;
+    for (long done = 0; done < count; done += INPUT_CHUNK_FRAMES) {
+      const long frames = std::min<long>(INPUT_CHUNK_FRAMES, count - done);
+      gather(first + done, frames, scratch.data());
+      result = std::max(
+          result, kernels.peak(scratch.data(),
+                               static_cast<size_t>(frames * channels)));
+    }
+    return result;
+  }
+};
+
+// Interleaved float32 frames of `input`: its own data if contiguous,
+// otherwise all frames gathered once into `storage`. Does not touch any
+// Python object.
+const float *shared_input(const InputBuffer &input,
+                          std::vector<float> &storage) {
+  if (input.contiguous()) return input.data();
+  storage.resize(static_cast<size_t>(input.frames * input.channels));
+  input.gather(0, input.frames, storage.data());
+  return storage.data();
+}
+
+// Pass frames [first, last) of `input` to `step(data_in, frames,
+// end_of_input)`, which returns the number of frames it used. Contiguous
+// input is passed in one piece, other layouts in chunks gathered into a
+// scratch buffer. Stops early when `step` leaves frames unused, and returns
+// the number of frames used. Does not touch any Python object.
+template <typename Step>
+long feed_input(const InputBuffer &input, long first, long last,
+                bool end_of_input, Step step) {
+  if (input.contiguous())
+    return step(input.data() + first * input.channels, last - first,
+                end_of_input);
+
+  thread_local std::vector<float> scratch;
+  scratch.resize(static_cast<size_t>(INPUT_CHUNK_FRAMES * input.channels));
+  long used = 0;
+  do {
+    const long count = std::min<long>(INPUT_CHUNK_FRAMES, last - first - used);
+    input.gather(first + used, count, scratch.data());
+    const long chunk_used = step(scratch.data(), count,
+                                 end_of_input && first + used + count == last);
+    used += chunk_used;
+    if (chunk_used < count) break;
+  } while (first + used < last);
+  return used;
+}
+
+// Drain the output a converter still holds after it filled an output
+// buffer, e.g. output left pending by an earlier call with a small output
+// buffer, or by a ratio change flushed with end_of_input.
+// `run(first, data_out, frames)` converts the input from frame `first` and
+// returns its SRC_DATA. The output is appended to `extra` in chunks of
+// `chunk_frames` frames until a chunk is not filled. Returns the number of
+// frames appended.
+template <typename Run>
+long drain_output(Run run, long input_frames_used, long chunk_frames,
+                  int channels, std::vector<float> &extra) {
+  long extra_frames = 0;
+  while (true) {
+    extra.resize(static_cast<size_t>((extra_frames + chunk_frames) * channels));
+    SRC_DATA src_data = run(input_frames_used,
+                            extra.data() + extra_frames * channels,
+                            chunk_frames);
+    input_frames_used += src_data.input_frames_used;
+    extra_frames += src_data.output_frames_gen;
+    if (src_data.output_frames_gen < chunk_frames) break;
+  }
+  return extra_frames;
+}
+
+// A new array holding the first `frames` frames of `output` followed by the
+// first `extra_frames` frames of `extra`.
+py::array_t<float, py::array::c_style> append_frames(
+    const py::array_t<float, py::array::c_style> &output, long frames,
+    const std::vector<float> &extra, long extra_frames) {
+  const long channels = output.ndim() == 2 ? output.shape(1) : 1;
+  std::vector<size_t> shape{static_cast<size_t>(frames + extra_frames)};
+  if (output.ndim() == 2) shape.push_back(static_cast<size_t>(channels));
+  auto full_output = py::array_t<float, py::array::c_style>(shape);
+  float *full_ptr = full_output.mutable_data();
+  std::copy(output.data(), output.data() + frames * channels, full_ptr);
+  std::copy(extra.begin(), extra.begin() + extra_frames * channels,
+            full_ptr + frames * channels);
+  return full_output;
+}
+
+// Parse a `layout` argument, true for planar (channels, frames) data.
+bool is_planar(const std::string &layout) {
+  if (layout == "interleaved") return false;
+  if (layout == "planar") return true;
+  throw std::domain_error("Invalid layout. Use 'interleaved' or 'planar'.");
+}
+
+// Transpose an interleaved (frames, channels) output to planar
+// (channels, frames). 1D outputs are returned as they are.
+template <typename T>
+py::array_t<T, py::array::c_style> to_planar(
+    const py::array_t<T, py::array::c_style> &output) {
+  if (output.ndim() != 2) return output;
+  const size_t frames = static_cast<size_t>(output.shape(0));
+  const size_t channels = static_cast<size_t>(output.shape(1));
+  auto planar = py::array_t<T, py::array::c_style>(
+      std::vector<size_t>{channels, frames});
+  const T *src = output.data();
+  T *dst = planar.mutable_data();
+  for (size_t f = 0; f < frames; ++f)
+    for (size_t c = 0; c < channels; ++c)
+      dst[c * frames + f] = src[f * channels + c];
+  return planar;
+}
+
+// Gain, channel selection and downmix applied to the converted frames on
+// their way to the output array. The gain of each input channel is applied
+// first, then `channel_map` picks the input channel of each output channel
+// and `downmix` averages the picked channels to one.
+struct PostProcess {
+  std::vector<float> gain;       // one for all channels, or one per channel
+  std::vector<int> channel_map;  // empty for all channels in order
+  bool downmix;
+
+  PostProcess(const py::object &gain_, const py::object &channel_map_,
+              bool downmix_)
+      : downmix(downmix_) {
+    if (PyFloat_Check(gain_.ptr()) || PyLong_Check(gain_.ptr()))
+      gain.push_back(gain_.cast<float>());
+    else
+      gain = gain_.cast<std::vector<float>>();
+    if (gain.empty()) throw std::domain_error("gain must not be empty.");
+    for (float g : gain)
+      if (!std::isfinite(g)) throw std::domain_error("gain must be finite.");
+    if (!channel_map_.is_none()) {
+      channel_map = channel_map_.cast<std::vector<int>>();
+      if (channel_map.empty())
+        throw std::domain_error("channel_map must not be empty.");
+      for (int c : channel_map)
+        if (c < 0)
+          throw std::domain_error("channel_map indices must be at least 0.");
+    }
+  }
+};
+
+// Number of frames mixed at once before their conversion to integers.
+#define MIX_BLOCK_FRAMES 256
+
+// A PostProcess resolved for a number of input channels, as a matrix of
+// (output channel, input channel) weights.
+class Mixer {
+ public:
+  Mixer(const PostProcess &post, int channels) : _channels(channels) {
+    if (post.gain.size() != 1 &&
+        post.gain.size() != static_cast<size_t>(channels))
+      throw std::domain_error("gain must be a number or one value per channel.");
+    std::vector<int> map = post.channel_map;
+    if (map.empty())
+      for (int c = 0; c < channels; ++c) map.push_back(c);
+    for (int c : map)
+      if (c >= channels)
+        throw std::domain_error("channel_map index out of range for " +
+                                std::to_string(channels) + " channels.");
+    auto gain = [&](int c) {
+      return post.gain.size() == 1 ? post.gain[0] : post.gain[c];
+    };
+
+    _out_channels = post.downmix ? 1 : static_cast<int>(map.size());
+    _diagonal = !post.downmix && post.channel_map.empty();
+    if (_diagonal) {
+      for (int c = 0; c < channels; ++c) _weights.push_back(gain(c));
+      return;
+    }
+    _weights.assign(static_cast<size_t>(_out_channels * channels), 0.0f);
+    const float scale = post.downmix ? 1.0f / map.size() : 1.0f;
+    for (size_t o = 0; o < map.size(); ++o) {
+      const size_t row = post.downmix ? 0 : o;
+      _weights[row * channels + map[o]] += gain(map[o]) * scale;
+    }
+  }
+
+  int input_channels() const { return _channels; }
+  int output_channels() const { return _out_channels; }
+
+  // Mix `frames` interleaved frames from `in` to `out`, which must not
+  // overlap.
+  void mix(const float *in, float *out, long frames) const {
+    const int channels = _channels;
+    if (_diagonal) {
+      const float *gain = _weights.data();
+      for (long f = 0; f < frames; ++f, in += channels, out += channels)
+        for (int c = 0; c < channels; ++c) out[c] = in[c] * gain[c];
+      return;
+    }
+    for (long f = 0; f < frames; ++f, in += channels) {
+      const float *row = _weights.data();
+      for (int o = 0; o < _out_channels; ++o, row += channels) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; ++c) sum += row[c] * in[c];
+        *out++ = sum;
+      }
+    }
+  }
+
+ private:
+  int _channels;
+  int _out_channels;
+  bool _diagonal;
+  std::vector<float> _weights;  // per channel gains if _diagonal
+};
+
+// The Mixer of a `post` argument for `channels` input channels, null for
+// None.
+std::unique_ptr<Mixer> get_mixer(const py::object &post, int channels) {
+  if (post.is_none()) return nullptr;
+  if (!py::isinstance<PostProcess>(post))
+    throw std::domain_error("post must be a PostProcess or None.");
+  return std::unique_ptr<Mixer>(
+      new Mixer(post.cast<const PostProcess &>(), channels));
+}
+
+// Shape of a float32 output mixed by `mixer`, 1D outputs stay 1D when mixed
+// to one channel.
+std::vector<size_t> mixed_shape(
+    const py::array_t<float, py::array::c_style> &output, const Mixer &mixer) {
+  std::vector<size_t> shape{static_cast<size_t>(output.shape(0))};
+  if (output.ndim() == 2 || mixer.output_channels() > 1)
+    shape.push_back(static_cast<size_t>(mixer.output_channels()));
+  return shape;
+}
+
+// Mix `frames` interleaved frames from `src` to `dst`, converting each
+// block of frames to integers while it is still in cache.
+template <typename T>
+void mix_frames(const Mixer &mixer, const float *src, T *dst, long frames) {
+  const long channels = mixer.input_channels();
+  const long out_channels = mixer.output_channels();
+  thread_local std::vector<float> block;
+  block.resize(static_cast<size_t>(MIX_BLOCK_FRAMES * out_channels));
+  for (long first = 0; first < frames; first += MIX_BLOCK_FRAMES) {
+    const long count = std::min<long>(MIX_BLOCK_FRAMES, frames - first);
+    mixer.mix(src + first * channels, block.data(), count);
+    float_to_pcm(block.data(), dst + first * out_channels,
+                 static_cast<size_t>(count * out_channels));
+  }
+}
+
+template <>
+void mix_frames<float>(const Mixer &mixer, const float *src, float *dst,
+                       long frames) {
+  mixer.mix(src, dst, frames);
+}
+
+// Mix a float32 output into a new array of T.
+template <typename T>
+py::array_t<T, py::array::c_style> mix_output(
+    const py::array_t<float, py::array::c_style> &output, const Mixer &mixer) {
+  auto mixed = py::array_t<T, py::array::c_style>(mixed_shape(output, mixer));
+  mix_frames(mixer, output.data(), mixed.mutable_data(),
+             static_cast<long>(output.shape(0)));
+  return mixed;
+}
+
+// Convert a float32 output to `format`, in the requested layout, applying
+// `mixer` on the way if given.
+py::array finish_output(const py::array_t<float, py::array::c_style> &output,
+                        SampleFormat format, bool planar,
+                        const Mixer *mixer = nullptr) {
+  if (mixer != nullptr) {
+    if (format == SampleFormat::int16) {
+      auto mixed = mix_output<int16_t>(output, *mixer);
+      return planar ? to_planar(mixed) : mixed;
+    }
+    if (format == SampleFormat::int32) {
+      auto mixed = mix_output<int32_t>(output, *mixer);
+      return planar ? to_planar(mixed) : mixed;
+    }
+    auto mixed = mix_output<float>(output, *mixer);
+    return planar ? to_planar(mixed) : mixed;
+  }
+  if (format == SampleFormat::float32)
+    return planar ? to_planar(output) : output;
+  std::vector<size_t> shape(output.shape(), output.shape() + output.ndim());
+  const size_t count = static_cast<size_t>(output.size());
+  if (format == SampleFormat::int16) {
+    auto converted = py::array_t<int16_t, py::array::c_style>(shape);
+    float_to_pcm(output.data(), converted.mutable_data(), count);
+    return planar ? to_planar(converted) : converted;
+  }
+  auto converted = py::array_t<int32_t, py::array::c_style>(shape);
+  float_to_pcm(output.data(), converted.mutable_data(), count);
+  return planar ? to_planar(converted) : converted;
+}
+
+// A (frames, channels) float32 array, or (frames,) for 1D input, taking
+// over interleaved `samples` without a copy.
+py::array_t<float, py::array::c_style> vector_array(
+    std::vector<float> &&samples, int channels, int ndim) {
+  auto owned = new std::vector<float>(std::move(samples));
+  if (owned->capacity() == 0) owned->reserve(1);  // a non-null data pointer
+  py::capsule owner(owned, [](void *p) {
+    delete static_cast<std::vector<float> *>(p);
+  });
+  std::vector<size_t> shape{owned->size() / static_cast<size_t>(channels)};
+  if (ndim == 2) shape.push_back(static_cast<size_t>(channels));
+  return py::array_t<float, py::array::c_style>(shape, owned->data(), owner);
+}
+
+// Number of output frames converted per ratio step of a ratio schedule.
+#define RATIO_STEP_FRAMES 128
+
+// A conversion ratio changing within one call: a constant, a linear ramp
+// (start, end) over `frames` frames, or an array of (frame_offset, ratio)
+// breakpoints interpolated linearly and held before the first and after the
+// last one.
+class RatioSchedule {
+ private:
+  std::vector<std::pair<double, double>> _points;  // (frame, ratio)
+
+ public:
+  explicit RatioSchedule(double ratio) : _points{{0.0, ratio}} {}
+
+  RatioSchedule(const py::object &ratio, long frames) {
+    if (py::isinstance<py::float_>(ratio) || py::isinstance<py::int_>(ratio)) {
+      _points.emplace_back(0.0, ratio.cast<double>());
+      return;
+    }
+    auto array = py::array_t<double, py::array::c_style |
+                                         py::array::forcecast>::ensure(ratio);
+    if (!array) throw py::type_error("Invalid ratio schedule.");
+    const double *values = array.data();
+    if (array.ndim() == 0) {
+      _points.emplace_back(0.0, values[0]);
+    } else if (array.ndim() == 1 && array.shape(0) == 2) {
+      _points.emplace_back(0.0, values[0]);
+      _points.emplace_back(static_cast<double>(frames), values[1]);
+    } else if (array.ndim() == 2 && array.shape(0) > 0 &&
+               array.shape(1) == 2) {
+      for (ssize_t i = 0; i < array.shape(0); ++i) {
+        if (values[2 * i] < 0.0 ||
+            (i > 0 && values[2 * i] < _points.back().first))
+          throw std::domain_error(
+              "Ratio breakpoint offsets must be non-negative and sorted.");
+        _points.emplace_back(values[2 * i], values[2 * i + 1]);
+      }
+    } else {
+      throw std::domain_error(
+          "Ratio must be a number, a (start, end) pair or an array of "
+          "(frame_offset, ratio) breakpoints.");
+    }
+  }
+
+  bool constant() const { return _points.size() == 1; }
+
+  double front() const { return _points.front().second; }
+
+  double max() const {
+    double result = _points.front().second;
+    for (const auto &point : _points) result = std::max(result, point.second);
+    return result;
+  }
+
+  double at(double frame) const {
+    if (frame <= _points.front().first) return _points.front().second;
+    if (frame >= _points.back().first) return _points.back().second;
+    auto next = std::upper_bound(
+        _points.begin(), _points.end(), frame,
+        [](double f, const std::pair<double, double> &p) { return f < p.first; });
+    auto prev = std::prev(next);
+    const double t = (frame - prev->first) / (next->first - prev->first);
+    return prev->second + t * (next->second - prev->second);
+  }
+};
+
+// Number of input frames scanned at once by the silence fast path.
+#define SILENCE_BLOCK_FRAMES 512
+
+// Parse a `silence_threshold` argument: None disables the silence fast
+// path, given as -1.
+float get_silence_threshold(const py::object &threshold) {
+  if (threshold.is_none()) return -1.0f;
+  const double value = threshold.cast<double>();
+  if (!(value >= 0.0))
+    throw std::domain_error("silence_threshold must be at least 0.");
+  return static_cast<float>(value);
+}
+
+// Silence fast path of a streaming resampler. Once the converter has been
+// fed enough silent input that its whole filter history is silent, and it
+// holds no pending output, more silent input only adds silent output. Such
+// input can then skip the converter and be replaced by the zero frames it
+// would have produced. With a ratio p / q of small integers, whole multiples
+// of q frames are skipped for p output frames each, which leaves the phase
+// of the converter as it was, so the output is the same as without the fast
+// path. Other ratios skip whole blocks and round the output frames with a
+// carry, which shifts the signal after the silence by less than one frame.
+// Samples up to `threshold` in magnitude count as silent. The resampler
+// reports each input block and each converter call.
+class SilenceSkipper {
+ private:
+  float _threshold = -1.0f;  // disabled if negative
+  long _silent_frames = 0;   // consecutive silent input frames
+  double _call_ratio = 0.0;  // ratio of the last converter call
+  double _ratio = 0.0;       // ratio of `_p` / `_q`, 0 if not computed yet
+  long _p = 0, _q = 0;       // q is 0 if the ratio has no small fraction
+  double _carry = 0.0;       // output fraction left over, if q is 0
+  uint64_t _skipped = 0;     // input frames skipped since the stats reset
+
+ public:
+  SilenceSkipper() = default;
+  explicit SilenceSkipper(float threshold) : _threshold(threshold) {}
+
+  bool enabled() const { return _threshold >= 0.0f; }
+
+  float threshold() const { return _threshold; }
+
+  bool silent(float peak) const { return peak <= _threshold; }
+
+  // Whether silent input can skip a converter whose filter history spans
+  // `history` frames, at `ratio`.
+  bool ready(long history, double ratio) const {
+    return _silent_frames >= history && _call_ratio == ratio;
+  }
+
+  // The number of frames of a silent block of `frames` frames to skip, and
+  // the number of zero output frames standing for them. Call `skip` if the
+  // frames are skipped.
+  long plan(long frames, double ratio, long *zeros) {
+    if (ratio != _ratio) {
+      _ratio = ratio;
+      _carry = 0.0;
+      if (!rational_ratio(ratio, POLYPHASE_EXACT_FRAMES, MAX_POLYPHASE_PHASES,
+                          &_p, &_q))
+        _q = 0;
+    }
+    if (_q > 0) {
+      const long skipped = frames / _q * _q;
+      *zeros = static_cast<long>(static_cast<long long>(skipped / _q) * _p);
+      return skipped;
+    }
+    *zeros = static_cast<long>(std::floor(_carry + frames * ratio));
+    return frames;
+  }
+
+  void skip(long frames, long zeros, double ratio) {
+    if (_q == 0) _carry += frames * ratio - zeros;
+    _skipped += static_cast<uint64_t>(frames);
+  }
+
+  // Account for an input block passed on or skipped.
+  void count(long frames, bool silent) {
+    _silent_frames =
+        silent ? std::min<long>(_silent_frames + frames, 1L << 30) : 0;
+  }
+
+  // Account for a converter call at `ratio`. A full output buffer may leave
+  // output pending inside the converter.
+  void converted(double ratio, bool full) {
+    _call_ratio = ratio;
+    if (full) _silent_frames = 0;
+  }
+
+  // Forget the silence seen, e.g. when frames that were counted are not
+  // passed on after all.
+  void interrupt() { _silent_frames = 0; }
+
+  void reset() {
+    _silent_frames = 0;
+    _call_ratio = 0.0;
+    _carry = 0.0;
+  }
+
+  uint64_t skipped() const { return _skipped; }
+
+  void reset_stats() { _skipped = 0; }
+
+  // The state, without the threshold and the stats.
+  void save(StateWriter &out) const {
+    out.put<int64_t>(_silent_frames);
+    out.put(_call_ratio);
+    out.put(_ratio);
+    out.put(_carry);
+  }
+
+  void restore(StateReader &in) {
+    _silent_frames = static_cast<long>(in.get<int64_t>());
+    _call_ratio = in.get<double>();
+    _ratio = in.get<double>();
+    _carry = in.get<double>();
+    if (_ratio != 0.0 &&
+        !rational_ratio(_ratio, POLYPHASE_EXACT_FRAMES, MAX_POLYPHASE_PHASES,
+                        &_p, &_q))
+      _q = 0;
+  }
+};
+
+// An adaptive Resampler steps down to a faster sinc converter when its
+// average call takes longer than the budget, and back up when it takes less
+// than this share of the budget, ADAPTIVE_HOLD_CALLS calls after the last
+// switch at the earliest.
+#define ADAPTIVE_UPGRADE_SHARE 0.25
+#define ADAPTIVE_HOLD_CALLS 32
+
+// Whether a `converter_type` argument asks for an adaptive Resampler.
+bool is_adaptive(const py::object &converter_type) {
+  return py::isinstance<py::str>(converter_type) &&
+         converter_type.cast<std::string>() == "adaptive";
+}
+
+// Version of the state saved by Resampler::snapshot.
+#define RESAMPLER_SNAPSHOT_VERSION 2
+
+// State of a Resampler saved by `snapshot`: its own state in `data`, and
+// that of the converter of each channel group. Saving into the same
+// snapshot again reuses its buffers.
+struct ResamplerSnapshot {
+  std::vector<char> data;
+  std::vector<ConverterSnapshot> states;
+
+  // move-only, as are the converter snapshots
+  ResamplerSnapshot() = default;
+  ResamplerSnapshot(ResamplerSnapshot &&) = default;
+  ResamplerSnapshot &operator=(ResamplerSnapshot &&) = default;
+
+  // The serialized form, for pickling.
+  py::bytes serialize() const {
+    std::vector<char> bytes;
+    StateWriter out(bytes);
+    out.put_bytes(data);
+    out.put<int64_t>(static_cast<int64_t>(states.size()));
+    for (const auto &state : states) state.serialize(out);
+    return py::bytes(bytes.data(), bytes.size());
+  }
+
+  void deserialize(const py::bytes &serialized) {
+    const std::string text = serialized;
+    const std::vector<char> bytes(text.begin(), text.end());
+    StateReader in(bytes);
+    in.get_bytes(data);
+    states.resize(static_cast<size_t>(in.get_count(1)));
+    for (auto &state : states) state.deserialize(in);
+    in.finish();
+  }
+};
+
+class Resampler {
+ private:
+  // one state per group of channels, see split_channels
+  std::vector<Converter *> _states;
+  std::vector<int> _group_offsets;
+  Stats _stats;
+  std::shared_ptr<SerialQueue> _queue;  // asynchronous calls
+  mutable ObjectMutex _mutex;           // see ObjectLock
+
+  void _destroy() {
+    for (auto state : _states) delete state;
+    _states.clear();
+  }
+
+  long _max_output_frames(long input_frames, double sr_ratio,
+                          bool end_of_input) const {
+    return samplerate::max_output_frames(input_frames, sr_ratio, _last_ratio,
+                                         _converter_type, end_of_input);
+  }
+
+  // Synchronous calls would race with the asynchronous ones still running.
+  void _check_idle() const {
+    if (_queue && _queue->pending() > 0)
+      throw std::runtime_error(
+          "The resampler has pending asynchronous calls.");
+  }
+
+  void _set_ratio(double new_ratio) {
+    for (auto state : _states) error_handler(state->set_ratio(new_ratio));
+    _last_ratio = new_ratio;
+  }
+
+  void _check_channels(const InputBuffer &input) const {
+    if (input.channels != _channels || input.channels == 0)
+      throw std::domain_error("Invalid number of channels in input data.");
+  }
+
+  // Step the sinc converter of an adaptive resampler from the time spent
+  // converting during the previous call. Called before each call, so that
+  // switches happen between calls. Calls crossfading after a switch are not
+  // counted.
+  void _adapt() {
+    if (_budget_ns <= 0.0 || _call_ns == 0) return;
+    const double ns = static_cast<double>(_call_ns);
+    _call_ns = 0;
+    for (auto state : _states)
+      if (!static_cast<AdaptiveConverter *>(state)->can_switch()) return;
+    _cost_ns = _level_calls > 0 ? 0.75 * _cost_ns + 0.25 * ns : ns;
+    ++_level_calls;
+
+    int next = _converter_type;
+    if (_cost_ns > _budget_ns && next < SRC_SINC_FASTEST)
+      ++next;
+    else if (_cost_ns < ADAPTIVE_UPGRADE_SHARE * _budget_ns &&
+             _level_calls >= ADAPTIVE_HOLD_CALLS &&
+             next > SRC_SINC_BEST_QUALITY)
+      --next;
+    if (next == _converter_type) return;
+    for (auto state : _states)
+      error_handler(static_cast<AdaptiveConverter *>(state)->switch_to(next));
+    _converter_type = next;
+    _level_calls = 0;
+    ++_switches;
+  }
+
+  // `feed_input` with the silence fast path. Frames [first, last) are
+  // scanned in blocks of SILENCE_BLOCK_FRAMES frames, the silent blocks the
+  // converter may skip are replaced by zero frames written to `data_out` at
+  // `gen`, and the other frames go to `step` as usual. Stops early like
+  // `feed_input`, and when the zero frames do not fit in `output_frames`.
+  template <typename Step>
+  long _feed_silence(const InputBuffer &input, long first, long last,
+                     bool end_of_input, double sr_ratio, float *data_out,
+                     long output_frames, long &gen, Step step) {
+    // adaptive converters may still be fading out the best sinc converter
+    const long history =
+        2 * converter_history_frames(
+                _budget_ns > 0.0 ? SRC_SINC_BEST_QUALITY : _converter_type,
+                sr_ratio) +
+        2;
+    long position = first;  // the frames before were passed on or skipped
+    for (long block = first; block < last;) {
+      const long count = std::min<long>(SILENCE_BLOCK_FRAMES, last - block);
+      const bool silent = _silence.silent(input.peak(block, count));
+      if (silent && _silence.ready(history, sr_ratio)) {
+        if (position < block) {
+          position += feed_input(input, position, block, false, step);
+          if (position < block) {
+            _silence.interrupt();
+            return position - first;
+          }
+        }
+        long zeros = 0;
+        const long skipped = _silence.ready(history, sr_ratio)
+                                 ? _silence.plan(count, sr_ratio, &zeros)
+                                 : 0;
+        if (skipped > 0) {
+          if (gen + zeros > output_frames) {
+            _silence.interrupt();
+            return position - first;
+          }
+          std::fill(data_out + gen * _channels,
+                    data_out + (gen + zeros) * _channels, 0.0f);
+          gen += zeros;
+          position += skipped;
+          _silence.skip(skipped, zeros, sr_ratio);
+        }
+      }
+      _silence.count(count, silent);
+      block += count;
+    }
+    if (position < last || end_of_input) {
+      const long used = feed_input(input, position, last, end_of_input, step);
+      if (used < last - position) _silence.interrupt();
+      position += used;
+    }
+    return position - first;
+  }
+
+  // Convert the input from frame `first` on, shared by `process` and
+  // `process_into`.
+  SRC_DATA _run(const InputBuffer &input, long first, float *data_out,
+                long output_frames, const RatioSchedule &schedule,
+                bool end_of_input, const py::object &release_gil) {
+    // Perform resampling with optional GIL release. Channel groups are
+    // converted on worker threads.
+    const bool released = should_release_gil_parallel(
+        release_gil, _states.size(), input.frames - first, _converter_type,
+        _channels);
+    auto run = [&]() {
+      const auto start = std::chrono::steady_clock::now();
+      SRC_DATA src_data =
+          schedule.constant()
+              ? process_input(input, first, data_out, output_frames,
+                              schedule.front(), end_of_input)
+              : process_schedule(input, first, data_out, output_frames,
+                                 schedule, end_of_input);
+      const uint64_t ns = elapsed_ns(start);
+      _stats.record(src_data.input_frames_used, src_data.output_frames_gen, ns,
+                    released);
+      _call_ns += ns;
+      return src_data;
+    };
+    if (released) {
+      py::gil_scoped_release release;
+      return run();
+    }
+    return run();
+  }
+
+  // Parse the ratio argument of `process` and `process_into`. A schedule
+  // starts at its first ratio rather than ramping to it.
+  RatioSchedule _schedule(const py::object &ratio, long input_frames) {
+    RatioSchedule schedule(ratio, input_frames);
+    _adapt();
+    if (!schedule.constant() && _last_ratio != schedule.front())
+      _set_ratio(schedule.front());
+    return schedule;
+  }
+
+  // Convert all of `input` following `schedule` into `output`, which grows
+  // as needed. Does not touch any Python object, see `process_async`.
+  void _process_all(const InputBuffer &input, const RatioSchedule &schedule,
+                    bool end_of_input, std::vector<float> &output) {
+    _adapt();
+    if (!schedule.constant() && _last_ratio != schedule.front())
+      _set_ratio(schedule.front());
+    const long chunk_frames =
+        _max_output_frames(input.frames, schedule.max(), end_of_input);
+    long input_frames_used = 0;
+    long output_frames_gen = 0;
+    while (true) {
+      output.resize(
+          static_cast<size_t>((output_frames_gen + chunk_frames) * _channels));
+      float *data_out = output.data() + output_frames_gen * _channels;
+      const auto start = std::chrono::steady_clock::now();
+      SRC_DATA src_data =
+          schedule.constant()
+              ? process_input(input, input_frames_used, data_out,
+                              chunk_frames, schedule.front(), end_of_input)
+              : process_schedule(input, input_frames_used, data_out,
+                                 chunk_frames, schedule, end_of_input);
+      const uint64_t ns = elapsed_ns(start);
+      _stats.record(src_data.input_frames_used, src_data.output_frames_gen, ns,
+                    true);
+      _call_ns += ns;
+      input_frames_used += src_data.input_frames_used;
+      output_frames_gen += src_data.output_frames_gen;
+      if (src_data.output_frames_gen < chunk_frames) break;
+    }
+    output.resize(static_cast<size_t>(output_frames_gen * _channels));
+  }
+
+ public:
+  // the sinc converter in use if adaptive
+  int _converter_type = 0;
+  int _channels = 0;
+  // ratio libsamplerate will ramp from on the next call, 0 if unknown
+  double _last_ratio = 0.0;
+  // adaptive mode, see _adapt: the budget of a call, 0 if not adaptive, the
+  // time spent converting during the current call, its moving average over
+  // the calls since the last switch, and the number of switches
+  double _budget_ns = 0.0;
+  uint64_t _call_ns = 0;
+  double _cost_ns = 0.0;
+  long _level_calls = 0;
+  uint64_t _switches = 0;
+  SilenceSkipper _silence;
+
+ public:
+  Resampler(const py::object &converter_type, int channels,
+            const py::object &num_threads = py::none(),
+            const py::object &budget_us = py::none(),
+            const py::object &silence_threshold = py::none())
+      : _group_offsets(split_channels(channels, get_num_threads(num_threads))),
+        _converter_type(is_adaptive(converter_type)
+                            ? SRC_SINC_BEST_QUALITY
+                            : get_converter_type(converter_type)),
+        _channels(channels),
+        _silence(get_silence_threshold(silence_threshold)) {
+    const bool adaptive = is_adaptive(converter_type);
+    if (adaptive == budget_us.is_none())
+      throw std::domain_error(
+          "budget_us is required by, and only used with, "
+          "converter_type='adaptive'.");
+    if (adaptive) {
+      _budget_ns = budget_us.cast<double>() * 1000.0;
+      if (!(_budget_ns > 0.0))
+        throw std::domain_error("budget_us must be positive.");
+    }
+    for (size_t g = 0; g + 1 < _group_offsets.size(); ++g) {
+      int _err_num = 0;
+      const int width = _group_offsets[g + 1] - _group_offsets[g];
+      Converter *state = nullptr;
+      if (adaptive) {
+        std::unique_ptr<AdaptiveConverter> adaptive_state(
+            new AdaptiveConverter(_converter_type, width, &_err_num));
+        if (adaptive_state->valid()) state = adaptive_state.release();
+      } else {
+        state = converter_new(_converter_type, width, &_err_num);
+      }
+      if (state == nullptr) {
+        _destroy();
+        error_handler(_err_num);
+      }
+      _states.push_back(state);
+    }
+  }
+
+  // copy constructor
+  Resampler(const Resampler &r)
+      : _group_offsets(r._group_offsets),
+        _converter_type(r._converter_type),
+        _channels(r._channels),
+        _last_ratio(r._last_ratio),
+        _budget_ns(r._budget_ns),
+        _call_ns(r._call_ns),
+        _cost_ns(r._cost_ns),
+        _level_calls(r._level_calls),
+        _silence(r._silence) {
+    _silence.reset_stats();
+    for (auto orig : r._states) {
+      int _err_num = 0;
+      Converter *state = orig->clone(&_err_num);
+      if (state == nullptr) {
+        _destroy();
+        error_handler(_err_num);
+      }
+      _states.push_back(state);
+    }
+  }
+
+  // move constructor
+  Resampler(Resampler &&r)
+      : _states(std::move(r._states)),
+        _group_offsets(std::move(r._group_offsets)),
+        _converter_type(r._converter_type),
+        _channels(r._channels),
+        _last_ratio(r._last_ratio),
+        _budget_ns(r._budget_ns),
+        _call_ns(r._call_ns),
+        _cost_ns(r._cost_ns),
+        _level_calls(r._level_calls),
+        _switches(r._switches),
+        _silence(r._silence) {
+    r._states.clear();
+    r._converter_type = 0;
+    r._channels = 0;
+    r._last_ratio = 0.0;
+  }
+
+  ~Resampler() { _destroy(); }
+
+  // Run src_process on raw buffers. This does not touch any Python object,
+  // so it may be called with the GIL released or from a worker thread.
+  SRC_DATA process_frames(const float *data_in, long input_frames,
+                          float *data_out, long output_frames, double sr_ratio,
+                          bool end_of_input) {
+    // libsamplerate struct
+    SRC_DATA src_data = {
+        data_in,        // data_in
+        data_out,       // data_out
+        input_frames,   // input_frames
+        output_frames,  // output_frames
+        0,             // input_frames_used, filled by libsamplerate
+        0,             // output_frames_gen, filled by libsamplerate
+        end_of_input,  // end_of_input, not used by src_simple ?
+        sr_ratio       // src_ratio, sampling rate conversion ratio
+    };
+    src_data = process_channel_groups(_states.data(), _group_offsets, src_data);
+    _silence.converted(sr_ratio, src_data.output_frames_gen >= output_frames);
+
+    // libsamplerate ramps the ratio linearly over the requested output
+    // frames, so a ratio change may only be partially applied
+    if (_last_ratio <= 0.0) {
+      _last_ratio = sr_ratio;
+    } else if (_last_ratio != sr_ratio && output_frames > 0) {
+      _last_ratio += src_data.output_frames_gen * (sr_ratio - _last_ratio) /
+                     output_frames;
+    }
+
+    return src_data;
+  }
+
+  // Convert frames [first, input.frames) of `input`, the same as
+  // `process_frames` for any input layout. Each converter call only gets
+  // about the input needed to fill the remaining output, so that small
+  // output buffers do not make channel groups and strided input copy the
+  // whole remaining input on every call. Does not touch any Python object.
+  SRC_DATA process_input(const InputBuffer &input, long first,
+                         float *data_out, long output_frames, double sr_ratio,
+                         bool end_of_input) {
+    SRC_DATA total = {nullptr, data_out, input.frames - first, output_frames,
+                      0, 0, end_of_input, sr_ratio};
+    auto step = [&](const float *data_in, long frames,
+                    bool chunk_end_of_input) {
+      SRC_DATA src_data = process_frames(
+          data_in, frames, data_out + total.output_frames_gen * _channels,
+          output_frames - total.output_frames_gen, sr_ratio,
+          chunk_end_of_input);
+      total.output_frames_gen += src_data.output_frames_gen;
+      return src_data.input_frames_used;
+    };
+    while (true) {
+      const long position = first + total.input_frames_used;
+      const double ratio =
+          _last_ratio > 0.0 ? std::min(sr_ratio, _last_ratio) : sr_ratio;
+      const double needed =
+          (output_frames - total.output_frames_gen) / ratio + 64.0;
+      const long last = ratio > 0.0 && needed < input.frames - position
+                            ? position + static_cast<long>(needed)
+                            : input.frames;
+      const bool last_end_of_input = end_of_input && last == input.frames;
+      const long used =
+          _silence.enabled()
+              ? _feed_silence(input, position, last, last_end_of_input,
+                              sr_ratio, data_out, output_frames,
+                              total.output_frames_gen, step)
+              : feed_input(input, position, last, last_end_of_input, step);
+      total.input_frames_used += used;
+      // done when the output is full or all input is used
+      if (used < last - position || last == input.frames) break;
+    }
+    return total;
+  }
+
+  // Convert all of `input` into `data_out`, like `process_input`. When the
+  // `output_frames` frames of `data_out` are filled, the rest of the output
+  // is drained into `extra` as `process` does, and its frame count stored in
+  // `extra_frames`. Returns the number of frames written to `data_out`.
+  // Does not touch any Python object.
+  long process_drain(const InputBuffer &input, float *data_out,
+                     long output_frames, double sr_ratio, bool end_of_input,
+                     std::vector<float> &extra, long *extra_frames) {
+    SRC_DATA src_data = process_input(input, 0, data_out, output_frames,
+                                      sr_ratio, end_of_input);
+    *extra_frames = 0;
+    if (src_data.output_frames_gen >= output_frames)
+      *extra_frames = drain_output(
+          [&](long first, float *chunk_out, long frames) {
+            return process_input(input, first, chunk_out, frames, sr_ratio,
+                                 end_of_input);
+          },
+          src_data.input_frames_used, output_frames, _channels, extra);
+    return src_data.output_frames_gen;
+  }
+
+  // Convert frames [first, input.frames) of `input` following `schedule`,
+  // whose frame offsets count from the first input frame. The output is
+  // converted in steps of RATIO_STEP_FRAMES frames, each targeting the
+  // ratio scheduled where the step is expected to end in the input, and
+  // libsamplerate ramps the ratio linearly over each step. Does not touch
+  // any Python object.
+  SRC_DATA process_schedule(const InputBuffer &input, long first,
+                            float *data_out, long output_frames,
+                            const RatioSchedule &schedule,
+                            bool end_of_input) {
+    SRC_DATA total = {nullptr, data_out, input.frames - first, output_frames,
+                      0, 0, end_of_input, schedule.front()};
+    while (total.output_frames_gen < output_frames) {
+      const long step = std::min<long>(RATIO_STEP_FRAMES,
+                                       output_frames - total.output_frames_gen);
+      const long position = first + total.input_frames_used;
+      const double current = _last_ratio > 0.0 ? _last_ratio : schedule.front();
+      total.src_ratio = schedule.at(position + step / current);
+      SRC_DATA src_data = process_input(
+          input, position, data_out + total.output_frames_gen * _channels,
+          step, total.src_ratio, end_of_input);
+      total.input_frames_used += src_data.input_frames_used;
+      total.output_frames_gen += src_data.output_frames_gen;
+      if (src_data.output_frames_gen < step) break;
+    }
+    return total;
+  }
+
+  // Convert to integer samples, or mix through `mixer` if given, through a
+  // float buffer of INPUT_CHUNK_FRAMES frames rather than a full size float
+  // output. Each chunk goes straight to the output array while in cache.
+  template <typename T>
+  py::array _process_chunked(const InputBuffer &inbuf,
+                             const RatioSchedule &schedule, bool end_of_input,
+                             const py::object &release_gil, bool planar,
+                             const Mixer *mixer) {
+    const int out_channels = mixer ? mixer->output_channels() : _channels;
+    std::vector<size_t> out_shape{static_cast<size_t>(
+        _max_output_frames(inbuf.frames, schedule.max(), end_of_input))};
+    // 1D outputs stay 1D when mixed to one channel, see mixed_shape
+    if (inbuf.ndim == 2 || out_channels != _channels)
+      out_shape.push_back(static_cast<size_t>(out_channels));
+    auto output = py::array_t<T, py::array::c_style>(out_shape);
+
+    thread_local std::vector<float> chunk;
+    chunk.resize(static_cast<size_t>(INPUT_CHUNK_FRAMES * _channels));
+    long input_frames_used = 0;
+    long output_frames_gen = 0;
+    while (true) {
+      SRC_DATA src_data =
+          _run(inbuf, input_frames_used, chunk.data(), INPUT_CHUNK_FRAMES,
+               schedule, end_of_input, release_gil);
+      input_frames_used += src_data.input_frames_used;
+      const long total = output_frames_gen + src_data.output_frames_gen;
+      if (total > static_cast<long>(out_shape[0])) {
+        // output left pending inside the converter, see `process`
+        out_shape[0] = std::max<size_t>(2 * out_shape[0], total);
+        output.resize(out_shape);
+      }
+      T *data_out = output.mutable_data() + output_frames_gen * out_channels;
+      if (mixer)
+        mix_frames(*mixer, chunk.data(), data_out, src_data.output_frames_gen);
+      else
+        float_to_pcm(
+            chunk.data(), data_out,
+            static_cast<size_t>(src_data.output_frames_gen * _channels));
+      output_frames_gen = total;
+      if (src_data.output_frames_gen < INPUT_CHUNK_FRAMES) break;
+    }
+
+    out_shape[0] = static_cast<size_t>(output_frames_gen);
+    output.resize(out_shape);
+    return planar ? py::array(to_planar(output)) : py::array(output);
+  }
+
+  py::array process(const py::object &input, const py::object &ratio,
+                    bool end_of_input,
+                    const py::object &release_gil = py::none(),
+                    const std::string &layout = "interleaved",
+                    const py::object &dtype = py::none(),
+                    const py::object &post = py::none()) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    const bool planar = is_planar(layout);
+    const SampleFormat format = get_sample_format(dtype);
+    InputBuffer inbuf(input, planar);
+    _check_channels(inbuf);
+    const int channels = _channels;
+    const RatioSchedule schedule = _schedule(ratio, inbuf.frames);
+    const std::unique_ptr<Mixer> mixer = get_mixer(post, channels);
+    _stats.count_call();
+
+    // integer and mixed outputs are converted chunk by chunk
+    if (format == SampleFormat::int16)
+      return _process_chunked<int16_t>(inbuf, schedule, end_of_input,
+                                       release_gil, planar, mixer.get());
+    if (format == SampleFormat::int32)
+      return _process_chunked<int32_t>(inbuf, schedule, end_of_input,
+                                       release_gil, planar, mixer.get());
+    if (mixer)
+      return _process_chunked<float>(inbuf, schedule, end_of_input,
+                                     release_gil, planar, mixer.get());
+
+    // Size the output from the converter's filter length. The actual number
+    // of output samples generated on the last call when input is terminated
+    // can be more than the expected number of output samples during
+    // mid-stream steady-state processing. (Also, when the stream is started,
+    // the number of output samples generated will generally be zero or
+    // otherwise less than the number of samples in mid-stream processing.)
+    const long input_frames = inbuf.frames;
+    const long new_size =
+        _max_output_frames(input_frames, schedule.max(), end_of_input);
+
+    // allocate output array
+    std::vector<size_t> out_shape{static_cast<size_t>(new_size)};
+    if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(channels));
+    auto output = py::array_t<float, py::array::c_style>(out_shape);
+    py::buffer_info outbuf = output.request();
+
+    SRC_DATA src_data =
+        _run(inbuf, 0, static_cast<float *>(outbuf.ptr), new_size, schedule,
+             end_of_input, release_gil);
+    long output_frames_gen = src_data.output_frames_gen;
+
+    if (output_frames_gen < new_size) {
+      // create a shorter view of the array
+      out_shape[0] = output_frames_gen;
+      output.resize(out_shape);
+      return finish_output(output, format, planar);
+    }
+
+    // The output bound was reached, which can only happen when output was
+    // left pending inside the converter, e.g. by a `process_into` call with a
+    // small output buffer. Drain the rest into a temporary buffer.
+    std::vector<float> extra;
+    const long extra_frames = drain_output(
+        [&](long first, float *data_out, long frames) {
+          return _run(inbuf, first, data_out, frames, schedule, end_of_input,
+                      release_gil);
+        },
+        src_data.input_frames_used, new_size, channels, extra);
+    auto full_output = append_frames(output, new_size, extra, extra_frames);
+
+    return finish_output(full_output, format, planar);
+  }
+
+  long max_output_frames(long input_frames, double sr_ratio,
+                         bool end_of_input) const {
+    ObjectLock lock(_mutex);
+    return _max_output_frames(input_frames, sr_ratio, end_of_input);
+  }
+
+  long latency_frames(double sr_ratio) const {
+    return converter_latency_frames(_converter_type, sr_ratio);
+  }
+
+  // Feed `frames` frames of silence, by default the latency at `sr_ratio`,
+  // and drop their output, so that the next call returns its full share of
+  // output. Returns the number of frames fed.
+  long prime(double sr_ratio, const py::object &frames) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    const long count = frames.is_none()
+                           ? converter_latency_frames(_converter_type, sr_ratio)
+                           : frames.cast<long>();
+    if (count < 0) throw std::domain_error("frames must be at least 0.");
+    const std::vector<float> silence(static_cast<size_t>(count * _channels),
+                                     0.0f);
+    const InputBuffer inbuf(silence.data(), count, _channels, 2);
+    const long output_frames = _max_output_frames(count, sr_ratio, false);
+    std::vector<float> output(static_cast<size_t>(output_frames * _channels));
+    long used = 0;
+    while (used < count) {
+      SRC_DATA src_data = process_input(inbuf, used, output.data(),
+                                        output_frames, sr_ratio, false);
+      used += src_data.input_frames_used;
+      if (src_data.output_frames_gen < output_frames) break;
+    }
+    return count;
+  }
+
+  py::tuple process_into(const py::object &input,
+                         py::array_t<float, py::array::c_style> out,
+                         const py::object &ratio, bool end_of_input,
+                         const py::object &release_gil = py::none()) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    InputBuffer inbuf(input);
+    _check_channels(inbuf);
+    long capacity = check_output_array(out, _channels);
+    const RatioSchedule schedule = _schedule(ratio, inbuf.frames);
+    _stats.count_call();
+
+    SRC_DATA src_data = _run(inbuf, 0, out.mutable_data(), capacity, schedule,
+                             end_of_input, release_gil);
+
+    return py::make_tuple(src_data.output_frames_gen,
+                          src_data.input_frames_used);
+  }
+
+  // Asynchronous `process`, returning an asyncio future of its output. The
+  // conversion runs on the thread pool after the earlier asynchronous calls
+  // of this resampler, `self` keeps it alive meanwhile.
+  py::object process_async(const py::object &self, const py::object &input,
+                           const py::object &ratio, bool end_of_input,
+                           const std::string &layout,
+                           const py::object &dtype) {
+    const bool planar = is_planar(layout);
+    const SampleFormat format = get_sample_format(dtype);
+    auto inbuf = std::make_shared<InputBuffer>(input, planar);
+    _check_channels(*inbuf);
+    const RatioSchedule schedule(ratio, inbuf->frames);
+    auto output = std::make_shared<std::vector<float>>();
+    _stats.count_call();
+    ObjectLock lock(_mutex);
+    if (!_queue) _queue = std::make_shared<SerialQueue>();
+
+    const int channels = _channels;
+    return run_async(
+        [this, inbuf, schedule, end_of_input, output]() {
+          ObjectLock lock(_mutex);
+          _process_all(*inbuf, schedule, end_of_input, *output);
+        },
+        [self, inbuf, output, channels, format, planar]() {
+          return finish_output(
+              vector_array(std::move(*output), channels, inbuf->ndim), format,
+              planar);
+        },
+        _queue);
+  }
+
+  void set_ratio(double new_ratio) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    _set_ratio(new_ratio);
+  }
+
+  void reset() {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    for (auto state : _states) error_handler(state->reset());
+    _last_ratio = 0.0;
+    _call_ns = 0;
+    _level_calls = 0;
+    _silence.reset();
+  }
+
+  size_t num_threads() const { return _states.size(); }
+
+  py::object budget_us() const {
+    if (_budget_ns <= 0.0) return py::none();
+    return py::float_(_budget_ns / 1000.0);
+  }
+
+  py::object silence_threshold() const {
+    if (!_silence.enabled()) return py::none();
+    return py::float_(_silence.threshold());
+  }
+
+  // Adaptive resamplers also report their converter and its switches, and
+  // those with the silence fast path the input frames it skipped.
+  py::dict stats() const {
+    py::dict stats = _stats.to_dict();
+    if (_budget_ns > 0.0 || _silence.enabled()) {
+      ObjectLock lock(_mutex);
+      if (_budget_ns > 0.0) {
+        stats["converter_type"] = _converter_type;
+        stats["converter_switches"] = _switches;
+      }
+      if (_silence.enabled()) stats["silent_frames"] = _silence.skipped();
+    }
+    return stats;
+  }
+
+  void reset_stats() {
+    _stats.reset();
+    ObjectLock lock(_mutex);
+    _switches = 0;
+    _silence.reset_stats();
+  }
+
+  Resampler clone() const {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    return Resampler(*this);
+  }
+
+  // Save the state into `saved`, without the stats.
+  void snapshot(ResamplerSnapshot &saved) const {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    StateWriter out(saved.data);
+    out.put<uint32_t>(RESAMPLER_SNAPSHOT_VERSION);
+    out.put<int32_t>(_channels);
+    out.put<uint8_t>(_budget_ns > 0.0);
+    out.put<int32_t>(_converter_type);
+    out.put(_last_ratio);
+    out.put<uint64_t>(_call_ns);
+    out.put(_cost_ns);
+    out.put<int64_t>(_level_calls);
+    _silence.save(out);
+    saved.states.resize(_states.size());
+    for (size_t g = 0; g < _states.size(); ++g)
+      _states[g]->save(saved.states[g]);
+  }
+
+  // Restore the state saved by a resampler of the same converter type,
+  // channels and number of threads, keeping the stats. A failed restore
+  // resets the resampler.
+  void restore(const ResamplerSnapshot &saved) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    const bool adaptive = _budget_ns > 0.0;
+    StateReader in(saved.data);
+    if (in.get<uint32_t>() != RESAMPLER_SNAPSHOT_VERSION ||
+        in.get<int32_t>() != _channels ||
+        (in.get<uint8_t>() != 0) != adaptive ||
+        saved.states.size() != _states.size())
+      invalid_snapshot();
+    const int converter_type = in.get<int32_t>();
+    if (adaptive ? converter_type < SRC_SINC_BEST_QUALITY ||
+                       converter_type > SRC_SINC_FASTEST
+                 : converter_type != _converter_type)
+      invalid_snapshot();
+    const double last_ratio = in.get<double>();
+    const uint64_t call_ns = in.get<uint64_t>();
+    const double cost_ns = in.get<double>();
+    const long level_calls = static_cast<long>(in.get<int64_t>());
+    SilenceSkipper silence(_silence);
+    silence.restore(in);
+    in.finish();
+
+    try {
+      for (size_t g = 0; g < _states.size(); ++g)
+        _states[g]->restore(saved.states[g]);
+    } catch (...) {
+      for (auto state : _states) state->reset();
+      _last_ratio = 0.0;
+      _silence.reset();
+      throw;
+    }
+    _converter_type = converter_type;
+    _last_ratio = last_ratio;
+    _call_ns = call_ns;
+    _cost_ns = cost_ns;
+    _level_calls = level_calls;
+    _silence = silence;
+  }
+
+  // Pickled as the constructor arguments and a serialized snapshot.
+  py::tuple getstate() const {
+    ResamplerSnapshot saved;
+    snapshot(saved);
+    const py::object converter_type =
+        _budget_ns > 0.0 ? py::object(py::str("adaptive"))
+                         : py::object(py::int_(_converter_type));
+    return py::make_tuple(converter_type, _channels, _states.size(),
+                          budget_us(), silence_threshold(),
+                          saved.serialize());
+  }
+
+  static Resampler setstate(const py::tuple &state) {
+    if (state.size() != 6)
+      throw std::domain_error("Invalid pickled Resampler state.");
+    Resampler resampler(state[0], state[1].cast<int>(), state[2], state[3],
+                        state[4]);
+    ResamplerSnapshot saved;
+    saved.deserialize(state[5].cast<py::bytes>());
+    resampler.restore(saved);
+    return resampler;
+  }
+};
+
+// `n` Resamplers of `converter_type` with `channels` channels, reserved up
+// front since Resampler's copy constructor clones the state.
+std::vector<Resampler> make_streams(size_t n, int converter_type,
+                                    int channels) {
+  std::vector<Resampler> streams;
+  streams.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    streams.emplace_back(py::int_(converter_type), channels, py::int_(1));
+  return streams;
+}
+
+// Independent Resamplers stepped by one call. The streams are whole
+// Resamplers, not converter states laid out contiguously, so each keeps its
+// own statistics, silence skipper and separately allocated converter.
+class ResamplerBank {
+ private:
+  std::vector<Resampler> _streams;
+  mutable ObjectMutex _mutex;  // see ObjectLock
+
+ public:
+  int _converter_type = 0;
+  int _channels = 0;
+
+ public:
+  ResamplerBank(size_t num_streams, const py::object &converter_type,
+                int channels)
+      : _converter_type(get_converter_type(converter_type)),
+        _channels(channels) {
+    _streams = make_streams(num_streams, _converter_type, _channels);
+  }
+
+  // copy constructor
+  ResamplerBank(const ResamplerBank &b)
+      : _converter_type(b._converter_type), _channels(b._channels) {
+    ObjectLock lock(b._mutex);
+    _streams.reserve(b._streams.size());
+    for (const auto &stream : b._streams) _streams.push_back(stream.clone());
+  }
+
+  py::list process(const py::object &inputs, const py::object &ratio,
+                   bool end_of_input,
+                   const py::object &num_threads = py::none(),
+                   const py::object &release_gil = py::none()) {
+    ObjectLock lock(_mutex);
+    const size_t n = _streams.size();
+    const size_t threads = get_num_threads(num_threads);
+    std::vector<double> ratios = get_ratios(ratio, n);
+
+    // Either a single array with one block per stream, or one array per
+    // stream. The channel axis may be omitted for single channel streams.
+    std::vector<InputBuffer> blocks;
+    blocks.reserve(n);
+    if (py::isinstance<py::array>(inputs)) {
+      auto all_blocks = py::reinterpret_borrow<py::array>(inputs);
+      const bool has_channel_axis = all_blocks.ndim() == 3;
+      if (!has_channel_axis && !(all_blocks.ndim() == 2 && _channels == 1))
+        throw std::domain_error(
+            "Input array should have shape (num_streams, num_frames, "
+            "num_channels).");
+      if ((size_t)all_blocks.shape(0) != n)
+        throw std::domain_error("Expected one input block per stream.");
+      // every block is a view into the array
+      for (size_t i = 0; i < n; ++i)
+        blocks.emplace_back(all_blocks[py::int_(i)]);
+    } else {
+      for (const auto &block : inputs.cast<std::vector<py::object>>())
+        blocks.emplace_back(block);
+      if (blocks.size() != n)
+        throw std::domain_error("Expected one input block per stream.");
+    }
+
+    struct Job {
+      long output_frames;
+      float *data_out;
+      long output_frames_gen;
+      std::vector<float> extra;  // output past `output_frames`, see below
+      long extra_frames;
+    };
+
+    std::vector<py::array_t<float, py::array::c_style>> outputs;
+    std::vector<Job> jobs(n);
+    outputs.reserve(n);
+    long total_frames = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (blocks[i].channels != _channels)
+        throw std::domain_error("Invalid number of channels in input data.");
+
+      jobs[i].output_frames = _streams[i].max_output_frames(
+          blocks[i].frames, ratios[i], end_of_input);
+      std::vector<size_t> out_shape{static_cast<size_t>(jobs[i].output_frames)};
+      if (blocks[i].ndim == 2)
+        out_shape.push_back(static_cast<size_t>(_channels));
+      outputs.emplace_back(out_shape);
+      jobs[i].data_out = outputs.back().mutable_data();
+      total_frames += blocks[i].frames;
+    }
+
+    auto run_jobs = [&]() {
+      parallel_for(n, threads, [&](size_t i) {
+        jobs[i].output_frames_gen = _streams[i].process_drain(
+            blocks[i], jobs[i].data_out, jobs[i].output_frames, ratios[i],
+            end_of_input, jobs[i].extra, &jobs[i].extra_frames);
+      });
+    };
+
+    if (should_release_gil_parallel(release_gil, threads, total_frames,
+                                    _converter_type, _channels)) {
+      py::gil_scoped_release release;
+      run_jobs();
+    } else {
+      run_jobs();
+    }
+
+    py::list result;
+    for (size_t i = 0; i < n; ++i) {
+      if (jobs[i].extra_frames > 0) {
+        result.append(append_frames(outputs[i], jobs[i].output_frames_gen,
+                                    jobs[i].extra, jobs[i].extra_frames));
+        continue;
+      }
+      std::vector<size_t> out_shape{
+          static_cast<size_t>(jobs[i].output_frames_gen)};
+      if (outputs[i].ndim() == 2)
+        out_shape.push_back(static_cast<size_t>(_channels));
+      outputs[i].resize(out_shape);
+      result.append(outputs[i]);
+    }
+    return result;
+  }
+
+  void set_ratio(const py::object &ratio) {
+    ObjectLock lock(_mutex);
+    std::vector<double> ratios = get_ratios(ratio, _streams.size());
+    for (size_t i = 0; i < _streams.size(); ++i)
+      _streams[i].set_ratio(ratios[i]);
+  }
+
+  void reset() {
+    ObjectLock lock(_mutex);
+    for (auto &stream : _streams) stream.reset();
+  }
+
+  void reset_stream(size_t index) {
+    ObjectLock lock(_mutex);
+    if (index >= _streams.size())
+      throw std::out_of_range("Stream index out of range.");
+    _streams[index].reset();
+  }
+
+  size_t num_streams() const { return _streams.size(); }
+
+  ResamplerBank clone() const { return ResamplerBank(*this); }
+};
+
+// Check the ratios of a multi-rate conversion.
+void check_multi_ratios(const std::vector<double> &ratios) {
+  if (ratios.empty())
+    throw std::domain_error("Expected at least one conversion ratio.");
+}
+
+// Resampler converting one stream to several conversion ratios at once, e.g.
+// a capture feeding a monitor output and lower rate analysis outputs. Each
+// input block is validated and converted to float32 only once, then shared
+// by one converter state per ratio, which run in parallel.
+class MultiRateResampler {
+ private:
+  std::vector<Resampler> _streams;
+  std::vector<double> _ratios;
+  size_t _num_threads;
+  mutable ObjectMutex _mutex;  // see ObjectLock
+
+ public:
+  int _converter_type = 0;
+  int _channels = 0;
+
+ public:
+  MultiRateResampler(const std::vector<double> &ratios,
+                     const py::object &converter_type, int channels,
+                     const py::object &num_threads = py::none())
+      : _ratios(ratios),
+        _num_threads(get_num_threads(num_threads)),
+        _converter_type(get_converter_type(converter_type)),
+        _channels(channels) {
+    check_multi_ratios(ratios);
+    _streams = make_streams(ratios.size(), _converter_type, _channels);
+  }
+
+  // copy constructor
+  MultiRateResampler(const MultiRateResampler &r)
+      : _converter_type(r._converter_type), _channels(r._channels) {
+    ObjectLock lock(r._mutex);
+    _ratios = r._ratios;
+    _num_threads = r._num_threads;
+    _streams.reserve(r._streams.size());
+    for (const auto &stream : r._streams) _streams.push_back(stream.clone());
+  }
+
+  py::list process(const py::object &input, bool end_of_input,
+                   const py::object &release_gil = py::none()) {
+    ObjectLock lock(_mutex);
+    InputBuffer inbuf(input);
+    if (inbuf.channels != _channels || inbuf.channels == 0)
+      throw std::domain_error("Invalid number of channels in input data.");
+    const size_t n = _streams.size();
+
+    struct Job {
+      long output_frames;
+      float *data_out;
+      long output_frames_gen;
+      std::vector<float> extra;  // output past `output_frames`, see below
+      long extra_frames;
+    };
+
+    std::vector<py::array_t<float, py::array::c_style>> outputs;
+    std::vector<Job> jobs(n);
+    outputs.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      jobs[i].output_frames = _streams[i].max_output_frames(
+          inbuf.frames, _ratios[i], end_of_input);
+      std::vector<size_t> out_shape{static_cast<size_t>(jobs[i].output_frames)};
+      if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(_channels));
+      outputs.emplace_back(out_shape);
+      jobs[i].data_out = outputs.back().mutable_data();
+    }
+
+    std::vector<float> storage;
+    auto run_jobs = [&]() {
+      const InputBuffer view(shared_input(inbuf, storage), inbuf.frames,
+                             _channels, inbuf.ndim);
+      parallel_for(n, _num_threads, [&](size_t i) {
+        jobs[i].output_frames_gen = _streams[i].process_drain(
+            view, jobs[i].data_out, jobs[i].output_frames, _ratios[i],
+            end_of_input, jobs[i].extra, &jobs[i].extra_frames);
+      });
+    };
+
+    if (should_release_gil_parallel(release_gil, _num_threads,
+                                    inbuf.frames * static_cast<long>(n),
+                                    _converter_type, _channels)) {
+      py::gil_scoped_release release;
+      run_jobs();
+    } else {
+      run_jobs();
+    }
+
+    py::list result;
+    for (size_t i = 0; i < n; ++i) {
+      if (jobs[i].extra_frames > 0) {
+        result.append(append_frames(outputs[i], jobs[i].output_frames_gen,
+                                    jobs[i].extra, jobs[i].extra_frames));
+        continue;
+      }
+      std::vector<size_t> out_shape{
+          static_cast<size_t>(jobs[i].output_frames_gen)};
+      if (outputs[i].ndim() == 2)
+        out_shape.push_back(static_cast<size_t>(_channels));
+      outputs[i].resize(out_shape);
+      result.append(outputs[i]);
+    }
+    return result;
+  }
+
+  std::vector<double> ratios() const {
+    ObjectLock lock(_mutex);
+    return _ratios;
+  }
+
+  // Change the ratios, one per output, for the next `process` call.
+  void set_ratios(const std::vector<double> &ratios) {
+    ObjectLock lock(_mutex);
+    if (ratios.size() != _streams.size())
+      throw std::domain_error("Expected one ratio per output.");
+    for (size_t i = 0; i < _streams.size(); ++i)
+      _streams[i].set_ratio(ratios[i]);
+    _ratios = ratios;
+  }
+
+  void reset() {
+    ObjectLock lock(_mutex);
+    for (auto &stream : _streams) stream.reset();
+  }
+
+  size_t num_outputs() const { return _streams.size(); }
+
+  MultiRateResampler clone() const { return MultiRateResampler(*this); }
+};
+
+// Resampler handing out its output in blocks of exactly `block_size`
+// frames. Output beyond the last complete block is queued in a FIFO for the
+// next calls, at the end of input the last partial block is padded with
+// zeros.
+class FixedBlockResampler {
+ private:
+  Resampler _resampler;
+  // queued output frames, starting at frame _fifo_start
+  std::vector<float> _fifo;
+  size_t _fifo_start = 0;
+  size_t _fifo_frames = 0;
+  mutable ObjectMutex _mutex;  // see ObjectLock
+
+  // Convert into the FIFO. Does not touch any Python object.
+  void _convert(const InputBuffer &input, double sr_ratio, bool end_of_input) {
+    const size_t channels = _channels;
+    if (_fifo_start > 0) {
+      std::copy(_fifo.begin() + _fifo_start * channels,
+                _fifo.begin() + (_fifo_start + _fifo_frames) * channels,
+                _fifo.begin());
+      _fifo_start = 0;
+    }
+
+    // reaching the bound means output was left pending, convert once more
+    long input_frames_used = 0;
+    while (true) {
+      const long bound = _resampler.max_output_frames(
+          input.frames - input_frames_used, sr_ratio, end_of_input);
+      _fifo.resize((_fifo_frames + bound) * channels);
+      SRC_DATA src_data = _resampler.process_input(
+          input, input_frames_used, _fifo.data() + _fifo_frames * channels,
+          bound, sr_ratio, end_of_input);
+      input_frames_used += src_data.input_frames_used;
+      _fifo_frames += src_data.output_frames_gen;
+      if (src_data.output_frames_gen < bound) break;
+    }
+
+    if (end_of_input && _fifo_frames % _block_size != 0) {
+      const size_t padded =
+          (_fifo_frames / _block_size + 1) * _block_size;
+      _fifo.resize(padded * channels);
+      std::fill(_fifo.begin() + _fifo_frames * channels, _fifo.end(), 0.0f);
+      _fifo_frames = padded;
+    }
+  }
+
+  // Convert the input and pop the next block into `data_out` if there is
+  // one.
+  bool _process(const InputBuffer &input, float *data_out, double sr_ratio,
+                bool end_of_input, const py::object &release_gil) {
+    ObjectLock lock(_mutex);
+    if (input.channels != _channels || input.channels == 0)
+      throw std::domain_error("Invalid number of channels in input data.");
+    if (_resampler.num_threads() > 1 ||
+        should_release_gil(release_gil, input.frames, _converter_type,
+                           _channels)) {
+      py::gil_scoped_release release;
+      _convert(input, sr_ratio, end_of_input);
+    } else {
+      _convert(input, sr_ratio, end_of_input);
+    }
+
+    if (_fifo_frames < _block_size) return false;
+    const size_t channels = _channels;
+    std::copy(_fifo.begin() + _fifo_start * channels,
+              _fifo.begin() + (_fifo_start + _block_size) * channels,
+              data_out);
+    _fifo_start += _block_size;
+    _fifo_frames -= _block_size;
+    return true;
+  }
+
+ public:
+  size_t _block_size = 0;
+  int _converter_type = 0;
+  int _channels = 0;
+
+ public:
+  FixedBlockResampler(size_t block_size, const py::object &converter_type,
+                      int channels, const py::object &num_threads = py::none())
+      : _resampler(converter_type, channels, num_threads),
+        _block_size(block_size),
+        _converter_type(_resampler._converter_type),
+        _channels(channels) {
+    if (block_size == 0)
+      throw std::domain_error("The block size must be positive.");
+  }
+
+  py::object process(const py::object &input, double sr_ratio,
+                     bool end_of_input,
+                     const py::object &release_gil = py::none()) {
+    InputBuffer inbuf(input);
+    std::vector<size_t> out_shape{_block_size};
+    if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(_channels));
+    auto output = py::array_t<float, py::array::c_style>(out_shape);
+    if (!_process(inbuf, output.mutable_data(), sr_ratio, end_of_input,
+                  release_gil))
+      return py::none();
+    return std::move(output);
+  }
+
+  bool process_into(const py::object &input,
+                    py::array_t<float, py::array::c_style> out,
+                    double sr_ratio, bool end_of_input,
+                    const py::object &release_gil = py::none()) {
+    if (static_cast<size_t>(check_output_array(out, _channels)) != _block_size)
+      throw std::domain_error("Output array must hold exactly one block.");
+    InputBuffer inbuf(input);
+    return _process(inbuf, out.mutable_data(), sr_ratio, end_of_input,
+                    release_gil);
+  }
+
+  // Number of queued output frames.
+  size_t available() const {
+    ObjectLock lock(_mutex);
+    return _fifo_frames;
+  }
+
+  void set_ratio(double new_ratio) {
+    ObjectLock lock(_mutex);
+    _resampler.set_ratio(new_ratio);
+  }
+
+  void reset() {
+    ObjectLock lock(_mutex);
+    _resampler.reset();
+    _fifo_start = 0;
+    _fifo_frames = 0;
+  }
+};
+
+namespace {
+
+long the_callback_func(void *cb_data, float **data);
+
+}  // namespace
+
+// Input blocks fetched ahead from the Python callback of a
+// CallbackResampler on a background thread, up to `capacity` blocks, so the
+// converter finds them ready instead of waiting for the GIL and the
+// callback. Each block is copied to interleaved float32 on that thread, and
+// its Python object released right away. The thread stops after the
+// callback returned None or failed, on destruction, and at interpreter exit,
+// see stop_all.
+class CallbackPrefetcher {
+ public:
+  struct Block {
+    std::vector<float> samples;
+    long frames = 0;
+    size_t ndim = 0;
+    std::string error;  // set if the callback failed
+    bool end = false;   // the callback returned None or failed
+  };
+
+ private:
+  callback_t _callback;
+  int _channels;
+  size_t _capacity;
+  std::deque<Block> _blocks;
+  bool _done = false;  // the end block was queued
+  bool _stop = false;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::thread _thread;
+
+  // The live prefetchers, whose threads stop_all stops. Its mutex is only
+  // taken without the GIL, as a thread being joined may wait for the GIL.
+  struct Registry {
+    std::mutex mutex;
+    std::vector<CallbackPrefetcher *> live;
+    bool closed = false;  // stop_all ran, no thread is started anymore
+  };
+
+  static Registry &_registry() {
+    // never destroyed, it is used by the threads of other modules at exit
+    static Registry *registry = new Registry;
+    return *registry;
+  }
+
+  // Stop the thread and wait for a callback in progress, without the GIL.
+  void _join() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable()) _thread.join();
+  }
+
+  Block _fetch() {
+    py::gil_scoped_acquire acquire;
+    Block block;
+    try {
+      // end of stream is signaled by a None
+      py::object input = _callback();
+      if (input.is_none()) {
+        block.end = true;
+        return block;
+      }
+      InputBuffer inbuf(input);
+      if (inbuf.channels != _channels || inbuf.channels == 0)
+        throw std::domain_error("Invalid number of channels in input data.");
+      block.frames = inbuf.frames;
+      block.ndim = inbuf.ndim;
+      block.samples.resize(static_cast<size_t>(inbuf.frames * _channels));
+      inbuf.gather(0, inbuf.frames, block.samples.data());
+    } catch (const std::exception &e) {
+      block.error = e.what();
+      block.end = true;
+    }
+    return block;
+  }
+
+  void _run() {
+    bool end = false;
+    while (!end) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return _stop || _blocks.size() < _capacity; });
+        if (_stop) return;
+      }
+      Block block = _fetch();
+      end = block.end;
+      std::lock_guard<std::mutex> lock(_mutex);
+      _blocks.push_back(std::move(block));
+      _done = end;
+      _cv.notify_all();
+    }
+  }
+
+ public:
+  // Needs the GIL, for the copy of `callback`.
+  CallbackPrefetcher(const callback_t &callback, int channels,
+                     size_t capacity)
+      : _callback(callback), _channels(channels), _capacity(capacity) {
+    py::gil_scoped_release release;
+    Registry &registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.closed) {
+      // the interpreter is exiting, the stream ends instead
+      _stop = true;
+      return;
+    }
+    registry.live.push_back(this);
+    _thread = std::thread([this] { _run(); });
+  }
+
+  CallbackPrefetcher(const CallbackPrefetcher &) = delete;
+  CallbackPrefetcher &operator=(const CallbackPrefetcher &) = delete;
+
+  // Needs the GIL, which is released while the thread finishes a callback.
+  ~CallbackPrefetcher() {
+    py::gil_scoped_release release;
+    Registry &registry = _registry();
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.live.erase(
+          std::remove(registry.live.begin(), registry.live.end(), this),
+          registry.live.end());
+    }
+    _join();
+  }
+
+  // Stop the threads of all prefetchers, registered with atexit: past it
+  // they would call their callbacks in a finalized interpreter. Their
+  // streams end after the blocks already fetched. Needs the GIL.
+  static void stop_all() {
+    py::gil_scoped_release release;
+    Registry &registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.closed = true;
+    for (CallbackPrefetcher *prefetcher : registry.live) prefetcher->_join();
+    registry.live.clear();
+  }
+
+  // Move the next block to `block`, waiting for it without holding the
+  // GIL. Returns false once the thread has stopped and all blocks are taken.
+  bool pop(Block *block) {
+    auto wait = [this, block]() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this] { return !_blocks.empty() || _done || _stop; });
+      if (_blocks.empty()) return false;
+      *block = std::move(_blocks.front());
+      _blocks.pop_front();
+      _cv.notify_all();
+      return true;
+    };
+    if (PyGILState_Check()) {
+      py::gil_scoped_release release;
+      return wait();
+    }
+    return wait();
+  }
+};
+
+// State of a CallbackResampler saved by `snapshot`: its own state and the
+// input left over from the last read in `data`, and that of its converter.
+// Saving into the same snapshot again reuses its buffers.
+struct CallbackResamplerSnapshot {
+  std::vector<char> data;
+  ConverterSnapshot state;
+
+  // The serialized form, for pickling.
+  py::bytes serialize() const {
+    std::vector<char> bytes;
+    StateWriter out(bytes);
+    out.put_bytes(data);
+    state.serialize(out);
+    return py::bytes(bytes.data(), bytes.size());
+  }
+
+  void deserialize(const py::bytes &serialized) {
+    const std::string text = serialized;
+    const std::vector<char> bytes(text.begin(), text.end());
+    StateReader in(bytes);
+    in.get_bytes(data);
+    state.deserialize(in);
+    in.finish();
+  }
+};
+
+class CallbackResampler {
+ private:
+  std::unique_ptr<Converter> _state;  // a SrcConverter, see _create
+  callback_t _callback = nullptr;
+  py::object _callback_object;  // the Python callable, for pickling
+  Stats _stats;
+  // the last input block, kept alive while libsamplerate reads it
+  std::unique_ptr<InputBuffer> _current_buffer;
+  std::vector<float> _staging;  // non-contiguous input blocks, interleaved
+  size_t _buffer_ndim = 0;
+  std::string _callback_error_msg = "";
+  std::shared_ptr<SerialQueue> _queue;  // asynchronous calls
+  size_t _prefetch = 0;                 // blocks fetched ahead, 0 for none
+  std::unique_ptr<CallbackPrefetcher> _prefetcher;
+  std::vector<float> _prefetched;  // the last prefetched block
+  long _prime_frames = 0;          // silent frames to feed, see `prime`
+  std::vector<float> _silence;
+  // input left over from the last read, see _callback_read
+  const float *_saved_data = nullptr;
+  long _saved_frames = 0;
+  SilenceSkipper _skipper;
+  long _pending_zeros = 0;  // zero frames of skipped silence not read yet
+  mutable ObjectMutex _mutex;  // see ObjectLock
+
+ public:
+  double _ratio = 0.0;
+  int _converter_type = 0;
+  size_t _channels = 0;
+
+ private:
+  void _create() {
+    int _err_num = 0;
+    // the reads follow libsamplerate's callback API, so the polyphase
+    // converters use their sinc fallback
+    SRC_STATE *state = new_src_state(src_converter_type(_converter_type),
+                                     (int)_channels, &_err_num);
+    if (state == nullptr) error_handler(_err_num);
+    _state.reset(
+        new SrcConverter(state, src_converter_type(_converter_type)));
+    _saved_data = nullptr;
+    _saved_frames = 0;
+  }
+
+  void _destroy() {
+    _prefetcher.reset();
+    _state.reset();
+  }
+
+  // Start the prefetch thread if enabled and not running. Needs the GIL.
+  void _start_prefetch() {
+    if (_prefetch > 0 && !_prefetcher)
+      _prefetcher.reset(new CallbackPrefetcher(
+          _callback, static_cast<int>(_channels), _prefetch));
+  }
+
+  // Synchronous calls would race with the asynchronous ones still running.
+  void _check_idle() const {
+    if (_queue && _queue->pending() > 0)
+      throw std::runtime_error(
+          "The resampler has pending asynchronous calls.");
+  }
+
+  void _set_starting_ratio(double new_ratio) {
+    error_handler(_state ? _state->set_ratio(new_ratio) : SRC_ERR_BAD_STATE);
+    _ratio = new_ratio;
+  }
+
+  // Skip the part of a new input block the silence fast path allows, see
+  // SilenceSkipper, and queue the zero frames standing for it. Returns the
+  // number of frames skipped.
+  long _skip_silence(const float *data, long frames, double ratio) {
+    const bool silent = _skipper.silent(
+        kernels.peak(data, static_cast<size_t>(frames) * _channels));
+    const long history =
+        2 * converter_history_frames(src_converter_type(_converter_type),
+                                     ratio) +
+        2;
+    long skipped = 0;
+    if (silent && _skipper.ready(history, ratio)) {
+      long zeros = 0;
+      skipped = _skipper.plan(frames, ratio, &zeros);
+      _skipper.skip(skipped, zeros, ratio);
+      _pending_zeros += zeros;
+    }
+    _skipper.count(frames, silent);
+    return skipped;
+  }
+
+  // libsamplerate's src_callback_read at `ratio`, on top of src_process so
+  // that the silence fast path can skip input blocks, whose zero frames come
+  // first. Returns the number of frames read, and sets `error` to the
+  // converter's error code.
+  long _callback_read(double ratio, long frames, float *data_out,
+                      int *error) {
+    static float dummy[1] = {0.0f};
+    SRC_DATA src_data = {_saved_data, nullptr, _saved_frames, 0, 0, 0, 0,
+                         ratio};
+    long gen = 0;
+    while (gen < frames) {
+      if (_pending_zeros > 0) {
+        const long count = std::min(_pending_zeros, frames - gen);
+        std::fill(data_out + gen * _channels,
+                  data_out + (gen + count) * _channels, 0.0f);
+        gen += count;
+        _pending_zeros -= count;
+        continue;
+      }
+      if (src_data.input_frames == 0) {
+        float *ptr = dummy;
+        src_data.input_frames = the_callback_func(this, &ptr);
+        src_data.data_in = ptr;
+        if (src_data.input_frames == 0) {
+          src_data.end_of_input = 1;
+        } else if (_skipper.enabled()) {
+          const long skipped =
+              _skip_silence(ptr, src_data.input_frames, ratio);
+          src_data.data_in += skipped * _channels;
+          src_data.input_frames -= skipped;
+          if (_pending_zeros > 0) continue;
+        }
+      }
+      src_data.data_out = data_out + gen * _channels;
+      src_data.output_frames = frames - gen;
+      *error = _state->process(&src_data);
+      if (*error != 0) break;
+      _skipper.converted(ratio,
+                         src_data.output_frames_gen >= src_data.output_frames);
+      src_data.data_in += src_data.input_frames_used * _channels;
+      src_data.input_frames -= src_data.input_frames_used;
+      gen += src_data.output_frames_gen;
+      if (src_data.end_of_input && src_data.output_frames_gen == 0) break;
+    }
+    _saved_data = src_data.data_in;
+    _saved_frames = src_data.input_frames;
+    return gen;
+  }
+
+  // Run _callback_read into a raw buffer following `schedule`, or at the
+  // current ratio if it is null. The frame offsets of a ratio schedule count
+  // output frames. Does not touch any Python object, the callback acquires
+  // the GIL itself. Returns the number of frames read and the converter's
+  // error code.
+  std::pair<size_t, int> _read_frames(float *data_out, size_t frames,
+                                      const RatioSchedule *schedule,
+                                      bool released) {
+    const RatioSchedule current(_ratio);
+    if (schedule == nullptr) schedule = &current;
+    if (!schedule->constant() && _ratio != schedule->front())
+      _set_starting_ratio(schedule->front());
+
+    // clear any previous callback error
+    clear_callback_error();
+
+    // A schedule is read in steps of RATIO_STEP_FRAMES frames, libsamplerate
+    // ramps the ratio linearly over each step.
+    const uint64_t callback_ns =
+        _stats.callback_ns.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    size_t gen = 0;
+    int error = 0;
+    do {
+      const size_t step = schedule->constant()
+                              ? frames
+                              : std::min<size_t>(RATIO_STEP_FRAMES, frames - gen);
+      _ratio = schedule->at(static_cast<double>(gen + step));
+      const long step_gen =
+          _callback_read(_ratio, static_cast<long>(step),
+                         data_out + gen * _channels, &error);
+      if (step_gen <= 0) break;
+      gen += static_cast<size_t>(step_gen);
+      if (static_cast<size_t>(step_gen) < step) break;
+    } while (gen < frames);
+    const int err_code = gen == 0 ? error : 0;
+
+    // the time spent in the Python callback is counted separately
+    const uint64_t ns = elapsed_ns(start);
+    const uint64_t waited =
+        _stats.callback_ns.load(std::memory_order_relaxed) - callback_ns;
+    _stats.count_call();
+    _stats.record(0, static_cast<long>(gen), ns > waited ? ns - waited : 0,
+                  released);
+    return std::make_pair(gen, err_code);
+  }
+
+  // Outcome of a read, with the callback error and the input dimensions
+  // copied while the lock is held. An asynchronous read checks it after the
+  // next read may have started, see `read_async`.
+  struct ReadResult {
+    size_t frames;
+    int error;
+    std::string callback_error;
+    size_t ndim;
+  };
+
+  // The outcome of a read from the result of _read_frames. Called with the
+  // lock held.
+  ReadResult _read_result(const std::pair<size_t, int> &result) const {
+    return ReadResult{result.first, result.second, _callback_error_msg,
+                      _buffer_ndim};
+  }
+
+  // Raise the errors of a read, or return its number of frames.
+  static size_t _check_read(const ReadResult &result) {
+    // check if callback had an error
+    if (!result.callback_error.empty()) {
+      throw std::domain_error(result.callback_error);
+    }
+
+    // check error status
+    if (result.frames == 0) {
+      error_handler(result.error);
+    }
+
+    return result.frames;
+  }
+
+  // Run _callback_read into a raw buffer, shared by `read` and
+  // `read_into`.
+  ReadResult _read(float *data_out, size_t frames,
+                   const py::object &release_gil, const py::object &ratio) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    if (_state == nullptr) _create();
+    _start_prefetch();
+
+    std::unique_ptr<RatioSchedule> schedule;
+    if (!ratio.is_none())
+      schedule.reset(new RatioSchedule(ratio, static_cast<long>(frames)));
+
+    // Perform callback resampling with optional GIL release.
+    // Note: the_callback_func will acquire GIL when calling Python callback.
+    const bool released = should_release_gil(
+        release_gil, (long)frames, _converter_type, static_cast<int>(_channels));
+    std::pair<size_t, int> result;
+    if (released) {
+      py::gil_scoped_release release;
+      result = _read_frames(data_out, frames, schedule.get(), released);
+    } else {
+      result = _read_frames(data_out, frames, schedule.get(), released);
+    }
+    return _read_result(result);
+  }
+
+  // Shape the output of `read`: 1D for a single channel read from 1D
+  // input blocks, and only the frames generated.
+  py::array_t<float, py::array::c_style> _read_output(
+      py::array_t<float, py::array::c_style> output,
+      const ReadResult &result) const {
+    const size_t output_frames_gen = _check_read(result);
+    std::vector<size_t> out_shape{static_cast<size_t>(output.shape(0)),
+                                  _channels};
+    // if there is only one channel and the input array had only on dimension
+    // we also output a 1D array
+    if (_channels == 1 && result.ndim == 1) {
+      out_shape.pop_back();
+      output = py::array_t<float, py::array::c_style>(out_shape,
+                                                      output.data());
+    }
+
+    // create a shorter view of the array
+    if (output_frames_gen < out_shape[0]) {
+      out_shape[0] = output_frames_gen;
+      output.resize(out_shape);
+    }
+
+    return output;
+  }
+
+ public:
+  CallbackResampler(const py::function &callback_func, double ratio,
+                    const py::object &converter_type, size_t channels,
+                    int prefetch = 0,
+                    const py::object &silence_threshold = py::none())
+      : _callback(callback_func.cast<callback_t>()),
+        _callback_object(callback_func),
+        _skipper(get_silence_threshold(silence_threshold)),
+        _ratio(ratio),
+        _converter_type(get_converter_type(converter_type)),
+        _channels(channels) {
+    if (prefetch < 0)
+      throw std::domain_error("prefetch must be at least 0.");
+    _prefetch = static_cast<size_t>(prefetch);
+    _create();
+  }
+
+  // copy constructor, see `clone`. The copy fetches its own blocks ahead,
+  // and keeps its own copy of the input left over from the last read.
+  CallbackResampler(const CallbackResampler &r)
+      : _callback(r._callback),
+        _callback_object(r._callback_object),
+        _prefetch(r._prefetch),
+        _prime_frames(r._prime_frames),
+        _saved_frames(r._saved_frames),
+        _skipper(r._skipper),
+        _pending_zeros(r._pending_zeros),
+        _ratio(r._ratio),
+        _converter_type(r._converter_type),
+        _channels(r._channels) {
+    _skipper.reset_stats();
+    _staging.assign(r._saved_data, r._saved_data + _saved_frames * _channels);
+    _saved_data = _staging.data();
+    int _err_num = 0;
+    if (!r._state) error_handler(SRC_ERR_BAD_STATE);
+    _state.reset(r._state->clone(&_err_num));
+    if (!_state) error_handler(_err_num);
+  }
+
+  // move constructor
+  CallbackResampler(CallbackResampler &&r)
+      : _state(std::move(r._state)),
+        _callback(r._callback),
+        _callback_object(std::move(r._callback_object)),
+        _current_buffer(std::move(r._current_buffer)),
+        _buffer_ndim(r._buffer_ndim),
+        _callback_error_msg(std::move(r._callback_error_msg)),
+        _prefetch(r._prefetch),
+        _prefetcher(std::move(r._prefetcher)),
+        _prefetched(std::move(r._prefetched)),
+        _prime_frames(r._prime_frames),
+        _silence(std::move(r._silence)),
+        _saved_data(r._saved_data),
+        _saved_frames(r._saved_frames),
+        _skipper(r._skipper),
+        _pending_zeros(r._pending_zeros),
+        _ratio(r._ratio),
+        _converter_type(r._converter_type),
+        _channels(r._channels) {
+    r._callback = nullptr;
+    r._saved_data = nullptr;
+    r._saved_frames = 0;
+    r._buffer_ndim = 0;
+    r._ratio = 0.0;
+    r._converter_type = 0;
+    r._channels = 0;
+  }
+
+  ~CallbackResampler() { _destroy(); }
+
+  // Hold on to a new input block and point `data` at its interleaved
+  // frames, copying them to the staging buffer if they are not contiguous.
+  // Called with the GIL held. Returns the number of frames.
+  long set_buffer(std::unique_ptr<InputBuffer> new_buf, float **data) {
+    _current_buffer = std::move(new_buf);
+    const InputBuffer &input = *_current_buffer;
+    if (_buffer_ndim == 0) _buffer_ndim = input.ndim;
+    if (input.contiguous()) {
+      *data = const_cast<float *>(input.data());
+    } else {
+      _staging.resize(static_cast<size_t>(input.frames * input.channels));
+      input.gather(0, input.frames, _staging.data());
+      *data = _staging.data();
+    }
+    return input.frames;
+  }
+  // Point `data` at the next prefetched block, waiting for it if needed.
+  // Returns its number of frames, or 0 at the end of input or on an error.
+  long next_prefetched(float **data) {
+    if (!_prefetcher) return 0;
+    // the wait for the block is part of the time spent on the callback
+    const auto start = std::chrono::steady_clock::now();
+    CallbackPrefetcher::Block block;
+    if (!_prefetcher->pop(&block)) return 0;
+    record_callback(elapsed_ns(start), block.frames);
+    if (!block.error.empty()) set_callback_error(block.error);
+    if (block.end) return 0;
+    if (_buffer_ndim == 0) _buffer_ndim = block.ndim;
+    _prefetched = std::move(block.samples);
+    *data = _prefetched.data();
+    return block.frames;
+  }
+  bool prefetching() const { return _prefetch > 0; }
+  // Point `data` at the silence queued by `prime`, fed before the next
+  // input block. Returns its number of frames.
+  long next_silence(float **data) {
+    _silence.assign(static_cast<size_t>(_prime_frames) * _channels, 0.0f);
+    *data = _silence.data();
+    const long frames = _prime_frames;
+    _prime_frames = 0;
+    return frames;
+  }
+  bool priming() const { return _prime_frames > 0; }
+  size_t get_channels() { return _channels; }
+  void set_callback_error(const std::string &error_msg) {
+    _callback_error_msg = error_msg;
+  }
+  std::string get_callback_error() const { return _callback_error_msg; }
+  void clear_callback_error() { _callback_error_msg = ""; }
+
+  py::object callback(void) { return _callback(); }
+
+  // Account for one call of the Python callback and its input frames.
+  void record_callback(uint64_t ns, long frames) {
+    _stats.record_callback(ns);
+    _stats.input_frames.fetch_add(static_cast<uint64_t>(frames),
+                                  std::memory_order_relaxed);
+  }
+
+  // Also reports the input frames skipped by the silence fast path, if
+  // enabled.
+  py::dict stats() const {
+    py::dict stats = _stats.to_dict(true);
+    if (_skipper.enabled()) {
+      ObjectLock lock(_mutex);
+      stats["silent_frames"] = _skipper.skipped();
+    }
+    return stats;
+  }
+
+  void reset_stats() {
+    _stats.reset();
+    ObjectLock lock(_mutex);
+    _skipper.reset_stats();
+  }
+
+  py::object silence_threshold() const {
+    if (!_skipper.enabled()) return py::none();
+    return py::float_(_skipper.threshold());
+  }
+
+  py::array read(size_t frames, const py::object &release_gil = py::none(),
+                 const py::object &ratio = py::none(),
+                 const py::object &post = py::none()) {
+    const std::unique_ptr<Mixer> mixer =
+        get_mixer(post, static_cast<int>(_channels));
+    // allocate output array
+    std::vector<size_t> out_shape{frames, _channels};
+    auto output = py::array_t<float, py::array::c_style>(out_shape);
+
+    const ReadResult result =
+        _read(output.mutable_data(), frames, release_gil, ratio);
+    if (!mixer) return _read_output(output, result);
+    return finish_output(_read_output(output, result),
+                         SampleFormat::float32, false, mixer.get());
+  }
+
+  // Asynchronous `read`, returning an asyncio future of its output. The
+  // read runs on the thread pool after the earlier asynchronous calls of
+  // this resampler, and the Python callback is called from there, `self`
+  // keeps the resampler alive meanwhile.
+  py::object read_async(const py::object &self, size_t frames,
+                        const py::object &ratio) {
+    ObjectLock lock(_mutex);
+    if (_state == nullptr) _create();
+    _start_prefetch();
+    std::shared_ptr<RatioSchedule> schedule;
+    if (!ratio.is_none())
+      schedule = std::make_shared<RatioSchedule>(ratio, static_cast<long>(frames));
+    std::vector<size_t> out_shape{frames, _channels};
+    auto output = py::array_t<float, py::array::c_style>(out_shape);
+    float *data_out = output.mutable_data();
+    auto result = std::make_shared<ReadResult>();
+    if (!_queue) _queue = std::make_shared<SerialQueue>();
+
+    // the next read may run as soon as this one is done, so the outcome is
+    // copied before the lock is released
+    return run_async(
+        [this, data_out, frames, schedule, result]() {
+          ObjectLock lock(_mutex);
+          *result = _read_result(
+              _read_frames(data_out, frames, schedule.get(), true));
+        },
+        [this, self, output, result]() -> py::object {
+          return _read_output(output, *result);
+        },
+        _queue);
+  }
+
+  size_t read_into(py::array_t<float, py::array::c_style> out,
+                   const py::object &release_gil = py::none(),
+                   const py::object &ratio = py::none()) {
+    size_t frames = static_cast<size_t>(check_output_array(out, _channels));
+    return _check_read(_read(out.mutable_data(), frames, release_gil, ratio));
+  }
+
+  void set_starting_ratio(double new_ratio) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    _set_starting_ratio(new_ratio);
+  }
+
+  // The `ratio` property, which asynchronous reads update.
+  double ratio() const {
+    ObjectLock lock(_mutex);
+    return _ratio;
+  }
+
+  void set_ratio(double new_ratio) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    _ratio = new_ratio;
+  }
+
+  // Also drops the blocks fetched ahead, a new prefetch thread starts with
+  // the next read.
+  void reset() {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    _prefetcher.reset();
+    _prime_frames = 0;
+    _saved_data = nullptr;
+    _saved_frames = 0;
+    _pending_zeros = 0;
+    _skipper.reset();
+    error_handler(_state ? _state->reset() : SRC_ERR_BAD_STATE);
+  }
+
+  long latency_frames(const py::object &ratio) const {
+    ObjectLock lock(_mutex);
+    return converter_latency_frames(src_converter_type(_converter_type),
+                                    ratio.is_none() ? _ratio
+                                                    : ratio.cast<double>());
+  }
+
+  // Queue `frames` frames of silence, by default the latency at the current
+  // ratio, fed to the converter before the next input block. Reads then
+  // pull input from the callback at a steady rate from the first one on.
+  // Returns the number of frames queued.
+  long prime(const py::object &frames) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    const long count =
+        frames.is_none()
+            ? converter_latency_frames(src_converter_type(_converter_type),
+                                       _ratio)
+            : frames.cast<long>();
+    if (count < 0) throw std::domain_error("frames must be at least 0.");
+    _prime_frames += count;
+    return count;
+  }
+
+  CallbackResampler clone() const {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    return CallbackResampler(*this);
+  }
+
+  // Save the state into `saved`, without the stats. The callback, and the
+  // blocks it returned before or fetched ahead, are not part of it.
+  void snapshot(CallbackResamplerSnapshot &saved) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    if (_state == nullptr) _create();
+    StateWriter out(saved.data);
+    out.put<uint32_t>(RESAMPLER_SNAPSHOT_VERSION);
+    out.put<int32_t>(static_cast<int32_t>(_channels));
+    out.put<int32_t>(_converter_type);
+    out.put(_ratio);
+    out.put<uint8_t>(static_cast<uint8_t>(_buffer_ndim));
+    out.put<int64_t>(_prime_frames);
+    out.put<int64_t>(_pending_zeros);
+    _skipper.save(out);
+    out.put<int64_t>(_saved_frames);
+    out.put_samples(_saved_data, _saved_frames * (long)_channels);
+    _state->save(saved.state);
+  }
+
+  // Restore the state saved by a resampler of the same converter type and
+  // channels, keeping the stats. A snapshot that does not decode leaves the
+  // resampler as it was, one its converter rejects resets the resampler.
+  void restore(const CallbackResamplerSnapshot &saved) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    if (_state == nullptr) _create();
+    StateReader in(saved.data);
+    if (in.get<uint32_t>() != RESAMPLER_SNAPSHOT_VERSION ||
+        in.get<int32_t>() != static_cast<int32_t>(_channels) ||
+        in.get<int32_t>() != _converter_type)
+      invalid_snapshot();
+    const double ratio = in.get<double>();
+    const size_t buffer_ndim = in.get<uint8_t>();
+    const long prime_frames = static_cast<long>(in.get<int64_t>());
+    const long pending_zeros = static_cast<long>(in.get<int64_t>());
+    if (buffer_ndim > 2 || prime_frames < 0 || pending_zeros < 0)
+      invalid_snapshot();
+    SilenceSkipper skipper(_skipper);
+    skipper.restore(in);
+    // decoded aside, as _saved_data may point into _staging
+    const long frames = in.get_count(_channels * sizeof(float));
+    std::vector<float> staging(static_cast<size_t>(frames) * _channels);
+    in.get_samples(staging.data(), frames * (long)_channels);
+    in.finish();
+
+    try {
+      _state->restore(saved.state);
+    } catch (...) {
+      _saved_data = nullptr;
+      _saved_frames = 0;
+      _pending_zeros = 0;
+      _skipper.reset();
+      _state->reset();
+      throw;
+    }
+    _ratio = ratio;
+    if (buffer_ndim != 0) _buffer_ndim = buffer_ndim;
+    _prime_frames = prime_frames;
+    _pending_zeros = pending_zeros;
+    _skipper = skipper;
+    _staging.swap(staging);
+    _saved_data = frames > 0 ? _staging.data() : nullptr;
+    _saved_frames = frames;
+  }
+
+  // Pickled as the constructor arguments, with the callback, and a
+  // serialized snapshot.
+  py::tuple getstate() {
+    CallbackResamplerSnapshot saved;
+    snapshot(saved);
+    return py::make_tuple(_callback_object, _ratio, _converter_type,
+                          _channels, _prefetch, silence_threshold(),
+                          saved.serialize());
+  }
+
+  static CallbackResampler setstate(const py::tuple &state) {
+    if (state.size() != 7)
+      throw std::domain_error("Invalid pickled CallbackResampler state.");
+    CallbackResampler resampler(state[0].cast<py::function>(),
+                                state[1].cast<double>(), state[2],
+                                state[3].cast<size_t>(), state[4].cast<int>(),
+                                state[5]);
+    CallbackResamplerSnapshot saved;
+    saved.deserialize(state[6].cast<py::bytes>());
+    resampler.restore(saved);
+    return resampler;
+  }
+  CallbackResampler &__enter__() { return *this; }
+  void __exit__(const py::object &/*exc_type*/, const py::object &/*exc*/,
+                const py::object &/*exc_tb*/) {
+    ObjectLock lock(_mutex);
+    _check_idle();
+    _destroy();
+  }
+};
+
+namespace {
+
+long the_callback_func(void *cb_data, float **data) {
+  CallbackResampler *cb = static_cast<CallbackResampler *>(cb_data);
+  if (cb->priming()) return cb->next_silence(data);
+  if (cb->prefetching()) return cb->next_prefetched(data);
+  int cb_channels = cb->get_channels();
+
+  // the wait for the GIL is part of the time spent on the callback
+  const auto start = std::chrono::steady_clock::now();
+  py::gil_scoped_acquire acquire;
+
+  // end of stream is signaled by a None
+  py::object input = cb->callback();
+  if (input.is_none()) {
+    cb->record_callback(elapsed_ns(start), 0);
+    return 0;
+  }
+
+  std::unique_ptr<InputBuffer> inbuf;
+  try {
+    inbuf.reset(new InputBuffer(input));
+  } catch (const std::exception &e) {
+    // Cannot throw exception in C callback - store error and return 0
+    cb->set_callback_error(e.what());
+    return 0;
+  }
+
+  if (inbuf->channels != cb_channels || inbuf->channels == 0) {
+    // Cannot throw exception in C callback - store error and return 0
+    cb->set_callback_error("Invalid number of channels in input data.");
+    return 0;
+  }
+
+  const long frames = cb->set_buffer(std::move(inbuf), data);
+  cb->record_callback(elapsed_ns(start), frames);
+  return frames;
+}
+
+}  // namespace
+
+// Resampler fed through a bounded single-producer, single-consumer ring
+// buffer of input frames. One thread writes input while another reads
+// resampled output, without locks and without calling into Python. The
+// producer only advances `_write_pos` and the consumer only `_read_pos`;
+// both count frames since the last reset and are published with
+// release/acquire ordering, so each side sees the frames the other one has
+// finished with. The converter only runs on the consumer side.
+class StreamResampler {
+ private:
+  std::unique_ptr<Converter> _state;
+  std::vector<float> _ring;
+  size_t _capacity;
+  alignas(64) std::atomic<size_t> _write_pos{0};
+  alignas(64) std::atomic<size_t> _read_pos{0};
+  std::atomic<bool> _end_of_input{false};
+  // dimensions of the last input array, used for the shape of the output
+  std::atomic<int> _input_ndim{1};
+  // set by the consumer, read by both sides
+  std::atomic<double> _ratio{0.0};
+  // serialize the producers and the consumers among themselves, see
+  // ObjectLock
+  ObjectMutex _write_mutex;
+  ObjectMutex _read_mutex;
+
+  // Copy frames into the ring, producer side. Does not touch any Python
+  // object. Returns the number of frames written.
+  size_t _write(const InputBuffer &input) {
+    const size_t write_pos = _write_pos.load(std::memory_order_relaxed);
+    const size_t read_pos = _read_pos.load(std::memory_order_acquire);
+    const size_t frames = std::min(static_cast<size_t>(input.frames),
+                                   _capacity - (write_pos - read_pos));
+    const size_t index = write_pos % _capacity;
+    const size_t first = std::min(frames, _capacity - index);
+    input.gather(0, static_cast<long>(first), _ring.data() + index * _channels);
+    input.gather(static_cast<long>(first), static_cast<long>(frames - first),
+                 _ring.data());
+    _write_pos.store(write_pos + frames, std::memory_order_release);
+    return frames;
+  }
+
+  // Resample frames from the ring into `data_out`, consumer side. Does not
+  // touch any Python object. Returns the number of frames generated.
+  size_t _read(float *data_out, size_t frames) {
+    size_t gen = 0;
+    while (gen < frames) {
+      // the end of input flag is published after the last frame
+      const bool end_of_input = _end_of_input.load(std::memory_order_acquire);
+      const size_t read_pos = _read_pos.load(std::memory_order_relaxed);
+      const size_t avail =
+          _write_pos.load(std::memory_order_acquire) - read_pos;
+      const size_t index = read_pos % _capacity;
+      const size_t chunk = std::min(avail, _capacity - index);
+
+      SRC_DATA src_data = {
+          _ring.data() + index * _channels,  // data_in
+          data_out + gen * _channels,        // data_out
+          static_cast<long>(chunk),          // input_frames
+          static_cast<long>(frames - gen),   // output_frames
+          0,  // input_frames_used, filled by the converter
+          0,  // output_frames_gen, filled by the converter
+          end_of_input && chunk == avail,  // end_of_input
+          _ratio.load(std::memory_order_relaxed)  // src_ratio
+      };
+      error_handler(_state->process(&src_data));
+      _read_pos.store(read_pos + src_data.input_frames_used,
+                      std::memory_order_release);
+      gen += src_data.output_frames_gen;
+      if (src_data.output_frames_gen == 0 && src_data.input_frames_used == 0)
+        break;
+    }
+    return gen;
+  }
+
+ public:
+  int _converter_type = 0;
+  size_t _channels = 0;
+
+ public:
+  StreamResampler(double ratio, const py::object &converter_type,
+                  size_t channels, size_t capacity)
+      : _capacity(capacity),
+        _ratio(ratio),
+        _converter_type(get_converter_type(converter_type)),
+        _channels(channels) {
+    if (channels == 0)
+      throw std::domain_error("Invalid number of channels (0).");
+    if (capacity == 0)
+      throw std::domain_error("The ring buffer capacity must be positive.");
+    if (!src_is_valid_ratio(ratio))
+      throw std::domain_error("Invalid conversion ratio.");
+    int _err_num = 0;
+    _state.reset(
+        converter_new(_converter_type, static_cast<int>(channels), &_err_num));
+    if (!_state) error_handler(_err_num);
+    _ring.resize(capacity * channels);
+  }
+
+  size_t write(const py::object &input, bool end_of_input,
+               const py::object &release_gil = py::none()) {
+    ObjectLock lock(_write_mutex);
+    InputBuffer inbuf(input);
+    if (static_cast<size_t>(inbuf.channels) != _channels)
+      throw std::domain_error("Invalid number of channels in input data.");
+    if (_end_of_input.load(std::memory_order_relaxed))
+      throw std::domain_error("Cannot write after the end of input.");
+    _input_ndim.store(inbuf.ndim, std::memory_order_relaxed);
+
+    const size_t frames = static_cast<size_t>(inbuf.frames);
+    size_t written;
+    if (should_release_gil(release_gil, inbuf.frames, _converter_type,
+                           static_cast<int>(_channels))) {
+      py::gil_scoped_release release;
+      written = _write(inbuf);
+    } else {
+      written = _write(inbuf);
+    }
+
+    // only the end of the whole input ends the stream
+    if (end_of_input && written == frames)
+      _end_of_input.store(true, std::memory_order_release);
+    return written;
+  }
+
+  py::array_t<float, py::array::c_style> read(
+      size_t frames, const py::object &release_gil = py::none()) {
+    std::vector<size_t> out_shape{frames};
+    if (_channels > 1 || _input_ndim.load(std::memory_order_relaxed) == 2)
+      out_shape.push_back(_channels);
+    auto output = py::array_t<float, py::array::c_style>(out_shape);
+
+    ObjectLock lock(_read_mutex);
+    size_t output_frames_gen;
+    if (should_release_gil(release_gil, static_cast<long>(frames),
+                           _converter_type, static_cast<int>(_channels))) {
+      py::gil_scoped_release release;
+      output_frames_gen = _read(output.mutable_data(), frames);
+    } else {
+      output_frames_gen = _read(output.mutable_data(), frames);
+    }
+
+    // create a shorter view of the array
+    if (output_frames_gen < frames) {
+      out_shape[0] = output_frames_gen;
+      output.resize(out_shape);
+    }
+    return output;
+  }
+
+  size_t read_into(py::array_t<float, py::array::c_style> out,
+                   const py::object &release_gil = py::none()) {
+    size_t frames = static_cast<size_t>(check_output_array(out, _channels));
+    ObjectLock lock(_read_mutex);
+    if (should_release_gil(release_gil, static_cast<long>(frames),
+                           _converter_type, static_cast<int>(_channels))) {
+      py::gil_scoped_release release;
+      return _read(out.mutable_data(), frames);
+    }
+    return _read(out.mutable_data(), frames);
+  }
+
+  // Input frames waiting in the ring buffer.
+  size_t fill_level() const {
+    return _write_pos.load(std::memory_order_acquire) -
+           _read_pos.load(std::memory_order_acquire);
+  }
+
+  // Input frames that can be written without overflowing the ring buffer.
+  size_t write_available() const { return _capacity - fill_level(); }
+
+  // Estimate of the output frames the buffered input resamples to.
+  size_t read_available() const {
+    return static_cast<size_t>(std::floor(fill_level() * ratio()));
+  }
+
+  double ratio() const { return _ratio.load(std::memory_order_relaxed); }
+
+  size_t capacity() const { return _capacity; }
+
+  bool end_of_input() const {
+    return _end_of_input.load(std::memory_order_acquire);
+  }
+
+  void set_ratio(double new_ratio) {
+    ObjectLock lock(_read_mutex);
+    error_handler(_state->set_ratio(new_ratio));
+    _ratio = new_ratio;
+  }
+
+  // Waits for a running write and read to finish.
+  void reset() {
+    ObjectLock read_lock(_read_mutex);
+    ObjectLock write_lock(_write_mutex);
+    error_handler(_state->reset());
+    _write_pos.store(0);
+    _read_pos.store(0);
+    _end_of_input.store(false);
+  }
+};
+
+// A one-shot conversion of a whole signal. It is prepared while holding the
+// GIL and run by run_resample_job() without touching any Python object, so
+// it can run with the GIL released or on a worker thread.
+struct ResampleJob {
+  const InputBuffer *input;
+  float *data_out;
+  long input_frames;
+  long output_frames;
+  double ratio;
+  int converter_type;
+  int channels;
+  size_t num_threads;      // threads converting groups of channels
+  long input_frames_used;  // filled by run_resample_job
+  long output_frames_gen;  // filled by run_resample_job
+};
+
+// Minimum number of input frames per segment for the segmented conversion
+// of long signals, see run_segmented_job.
+#define MIN_SEGMENT_FRAMES 16384
+
+// Convert a long signal as overlapping segments running in parallel. Every
+// segment starts and ends at an input frame whose output position is an
+// integer, so its output samples fall exactly on the output grid of the
+// sequential conversion. Each segment is converted with a preroll and
+// postroll of at least the filter length, and only the output between its
+// boundaries is kept, so the stitched result matches the sequential one to
+// within float rounding. Returns false, without converting anything, if the
+// signal is too short or the ratio is not a rational number with a small
+// enough denominator.
+bool run_segmented_job(ResampleJob &job) {
+  const long n = job.input_frames;
+  const long max_segments = std::min(static_cast<long>(job.num_threads),
+                                     n / MIN_SEGMENT_FRAMES);
+  long p, q;
+  if (max_segments < 2 ||
+      !rational_ratio(job.ratio, n, n / (4 * max_segments), &p, &q))
+    return false;
+
+  // overlap with the neighbouring segments, a multiple of q
+  const long history =
+      converter_history_frames(job.converter_type, job.ratio) + 2;
+  const long overlap = (history + q - 1) / q * q;
+
+  // segment boundaries on multiples of q, output boundary = input * p / q
+  std::vector<long> bounds{0};
+  for (long k = 1; k < max_segments; ++k) {
+    const long bound = n * k / max_segments / q * q;
+    if (bound > bounds.back() + overlap) bounds.push_back(bound);
+  }
+  bounds.push_back(n);
+  if (bounds.size() < 3) return false;
+  const size_t segments = bounds.size() - 1;
+
+  const int channels = job.channels;
+  std::vector<long> segment_gen(segments, 0);
+  parallel_for(segments, segments, [&](size_t s) {
+    const long first = std::max(0L, bounds[s] - overlap);
+    const long last = std::min(n, bounds[s + 1] + overlap);
+    const bool end_of_input = last == n;
+    const long out_start = bounds[s] / q * p;
+    // number of output frames to keep, all the rest for the last segment
+    const long out_frames = s + 1 < segments
+                                ? bounds[s + 1] / q * p - out_start
+                                : job.output_frames - out_start;
+
+    CachedState cached(job.converter_type, channels);
+    long position = first;
+    auto step = [&](float *data_out, long output_frames) {
+      long gen = 0;
+      position += feed_input(
+          *job.input, position, last, end_of_input,
+          [&](const float *data_in, long frames, bool chunk_end_of_input) {
+            SRC_DATA src_data = {data_in, data_out + gen * channels, frames,
+                                 output_frames - gen, 0, 0,
+                                 chunk_end_of_input, job.ratio};
+            error_handler(cached.get()->process(&src_data));
+            gen += src_data.output_frames_gen;
+            return src_data.input_frames_used;
+          });
+      return gen;
+    };
+
+    // drop the output of the preroll
+    thread_local std::vector<float> preroll;
+    long skip = (bounds[s] - first) / q * p;
+    preroll.resize(static_cast<size_t>(std::min(skip, 4096L) * channels));
+    while (skip > 0) {
+      long gen = step(preroll.data(), std::min(skip, 4096L));
+      if (gen == 0) break;
+      skip -= gen;
+    }
+
+    // write the kept output directly into place
+    float *data_out = job.data_out + out_start * channels;
+    long kept = 0;
+    while (skip == 0 && kept < out_frames) {
+      long gen = step(data_out + kept * channels, out_frames - kept);
+      if (gen == 0) break;
+      kept += gen;
+    }
+
+    if (s + 1 < segments && kept != out_frames)
+      throw std::runtime_error("Segment generated fewer output samples than "
+                               "expected!");
+    if (s + 1 == segments && kept >= out_frames)
+      // This means our output bound is too small.
+      throw std::runtime_error("Generated more output samples than expected!");
+    segment_gen[s] = kept;
+  });
+
+  job.input_frames_used = n;
+  job.output_frames_gen = bounds[segments - 1] / q * p + segment_gen.back();
+  return true;
+}
+
+void run_resample_job(ResampleJob &job) {
+  // Long signals with fewer channels than threads are split in time instead
+  if (job.num_threads > 1 && job.channels < static_cast<int>(job.num_threads) &&
+      run_segmented_job(job))
+    return;
+
+  // Same as src_simple, but reusing converter states from the cache, one
+  // per group of channels
+  std::vector<int> offsets = split_channels(job.channels, job.num_threads);
+  std::vector<std::unique_ptr<CachedState>> cached;
+  std::vector<Converter *> states;
+  for (size_t g = 0; g + 1 < offsets.size(); ++g) {
+    cached.emplace_back(new CachedState(job.converter_type,
+                                        offsets[g + 1] - offsets[g]));
+    states.push_back(cached.back()->get());
+  }
+  // the whole signal is converted at once
+  job.output_frames_gen = 0;
+  job.input_frames_used = feed_input(
+      *job.input, 0, job.input_frames, true,
+      [&](const float *data_in, long frames, bool end_of_input) {
+        // libsamplerate struct
+        SRC_DATA src_data = {
+            data_in,                                           // data_in
+            job.data_out + job.output_frames_gen * job.channels,  // data_out
+            frames,                                  // input_frames
+            job.output_frames - job.output_frames_gen,  // output_frames
+            0,  // input_frames_used, filled by libsamplerate
+            0,  // output_frames_gen, filled by libsamplerate
+            end_of_input,  // end_of_input
+            job.ratio      // src_ratio, sampling rate conversion ratio
+        };
+        src_data = process_channel_groups(states.data(), offsets, src_data);
+        job.output_frames_gen += src_data.output_frames_gen;
+        return src_data.input_frames_used;
+      });
+  if (job.output_frames_gen >= job.output_frames) {
+    // This means our output bound is too small.
+    throw std::runtime_error("Generated more output samples than expected!");
+  }
+}
+
+// Check the channels of an input for the one-shot functions and return
+// their number.
+int get_input_channels(const InputBuffer &inbuf) {
+  if (inbuf.channels == 0)
+    throw std::domain_error("Invalid number of channels (0) in input data.");
+  return inbuf.channels;
+}
+
+// A one-shot conversion prepared with the GIL held, shared by `resample`
+// and `resample_async`.
+struct ResampleCall {
+  std::unique_ptr<InputBuffer> input;
+  py::array_t<float, py::array::c_style> output;
+  ResampleJob job;
+  SampleFormat format;
+  bool planar;
+  std::unique_ptr<Mixer> mixer;
+
+  ResampleCall(const py::object &input_data, double sr_ratio,
+               const py::object &converter_type, const py::object &num_threads,
+               const std::string &layout, const py::object &dtype,
+               const py::object &post = py::none()) {
+    // input array has shape (n_samples, n_channels), or the transpose
+    int converter_type_int = get_converter_type(converter_type);
+    planar = is_planar(layout);
+    format = get_sample_format(dtype);
+
+    // view of the input
+    input.reset(new InputBuffer(input_data, planar));
+    int channels = get_input_channels(*input);
+    mixer = get_mixer(post, channels);
+
+    // Size the output to match Resampler.process() behavior with
+    // end_of_input=True. src_simple internally behaves like
+    // end_of_input=True, so it may generate extra samples from buffer
+    // flushing.
+    const auto new_size = static_cast<size_t>(max_output_frames(
+        input->frames, sr_ratio, 0.0, converter_type_int, true));
+
+    // allocate output array
+    std::vector<size_t> out_shape{new_size};
+    if (input->ndim == 2) out_shape.push_back(static_cast<size_t>(channels));
+    output = py::array_t<float, py::array::c_style>(out_shape);
+
+    job = {
+        input.get(),                   // input
+        output.mutable_data(),         // data_out
+        input->frames,                 // input_frames
+        long(new_size),                // output_frames
+        sr_ratio,                      // ratio
+        converter_type_int,            // converter_type
+        channels,                      // channels
+        get_num_threads(num_threads),  // num_threads
+        0,  // input_frames_used, filled by run_resample_job
+        0   // output_frames_gen, filled by run_resample_job
+    };
+  }
+
+  // Run the conversion without touching any Python object.
+  void run(bool released) {
+    const auto start = std::chrono::steady_clock::now();
+    run_resample_job(job);
+    global_stats.count_call();
+    global_stats.record(job.input_frames_used, job.output_frames_gen,
+                        elapsed_ns(start), released);
+  }
+
+  // The converted signal, in the requested layout and format.
+  py::array result() {
+    // create a shorter view of the array
+    std::vector<size_t> out_shape(output.shape(),
+                                  output.shape() + output.ndim());
+    out_shape[0] = static_cast<size_t>(job.output_frames_gen);
+    output.resize(out_shape);
+    return finish_output(output, format, planar, mixer.get());
+  }
+};
+
+py::array resample(const py::object &input, double sr_ratio,
+                   const py::object &converter_type, bool verbose,
+                   const py::object &release_gil = py::none(),
+                   const py::object &num_threads = py::none(),
+                   const std::string &layout = "interleaved",
+                   const py::object &dtype = py::none(),
+                   const py::object &post = py::none()) {
+  ResampleCall call(input, sr_ratio, converter_type, num_threads, layout,
+                    dtype, post);
+
+  // Perform resampling with optional GIL release. Parallel conversions run
+  // on worker threads.
+  const bool released = should_release_gil_parallel(
+      release_gil, call.job.num_threads, call.input->frames,
+      call.job.converter_type, call.job.channels);
+  if (released) {
+    py::gil_scoped_release release;
+    call.run(released);
+  } else {
+    call.run(released);
+  }
+
+  if (verbose) {
+    py::print("samplerate info:");
+    py::print(call.job.input_frames_used, " input frames used");
+    py::print(call.job.output_frames_gen, " output frames generated");
+  }
+
+  return call.result();
+}
+
+// Asynchronous `resample`, returning an asyncio future of its output.
+py::object resample_async(const py::object &input, double sr_ratio,
+                          const py::object &converter_type,
+                          const py::object &num_threads,
+                          const std::string &layout,
+                          const py::object &dtype) {
+  auto call = std::make_shared<ResampleCall>(input, sr_ratio, converter_type,
+                                             num_threads, layout, dtype);
+  return run_async([call]() { call->run(true); },
+                   [call]() -> py::object { return call->result(); });
+}
+
+py::list resample_batch(const std::vector<py::object> &inputs,
+                        const py::object &ratio,
+                        const py::object &converter_type,
+                        const py::object &num_threads = py::none(),
+                        const py::object &release_gil = py::none()) {
+  int converter_type_int = get_converter_type(converter_type);
+  const size_t n = inputs.size();
+  const size_t threads = get_num_threads(num_threads);
+
+  std::vector<double> ratios = get_ratios(ratio, n);
+
+  // validate all inputs and allocate all outputs up front, so the
+  // conversions can run without the GIL
+  std::vector<InputBuffer> buffers;
+  std::vector<py::array_t<float, py::array::c_style>> outputs;
+  std::vector<ResampleJob> jobs;
+  buffers.reserve(n);
+  outputs.reserve(n);
+  jobs.reserve(n);
+  long total_frames = 0;
+  for (size_t i = 0; i < n; ++i) {
+    buffers.emplace_back(inputs[i]);
+    const InputBuffer &inbuf = buffers.back();
+    int channels = get_input_channels(inbuf);
+    const long input_frames = inbuf.frames;
+    const long new_size = max_output_frames(input_frames, ratios[i], 0.0,
+                                            converter_type_int, true);
+
+    std::vector<size_t> out_shape{static_cast<size_t>(new_size)};
+    if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(channels));
+    outputs.emplace_back(out_shape);
+
+    jobs.push_back({&inbuf, outputs.back().mutable_data(), input_frames,
+                    new_size,
+                    ratios[i], converter_type_int, channels, 1, 0, 0});
+    total_frames += input_frames;
+  }
+
+  auto run_jobs = [&]() {
+    parallel_for(n, threads, [&](size_t i) { run_resample_job(jobs[i]); });
+  };
+
+  const bool released = should_release_gil_parallel(release_gil, threads,
+                                                   total_frames,
+                                                   converter_type_int);
+  const auto start = std::chrono::steady_clock::now();
+  if (released) {
+    py::gil_scoped_release release;
+    run_jobs();
+  } else {
+    run_jobs();
+  }
+  long input_frames_used = 0;
+  long output_frames_gen = 0;
+  for (const auto &job : jobs) {
+    input_frames_used += job.input_frames_used;
+    output_frames_gen += job.output_frames_gen;
+  }
+  global_stats.count_call();
+  global_stats.record(input_frames_used, output_frames_gen, elapsed_ns(start),
+                      released);
+
+  py::list result;
+  for (size_t i = 0; i < n; ++i) {
+    std::vector<size_t> out_shape{static_cast<size_t>(jobs[i].output_frames_gen)};
+    if (outputs[i].ndim() == 2)
+      out_shape.push_back(static_cast<size_t>(jobs[i].channels));
+    outputs[i].resize(out_shape);
+    result.append(outputs[i]);
+  }
+  return result;
+}
+
+py::list resample_multi(const py::object &input,
+                        const std::vector<double> &ratios,
+                        const py::object &converter_type,
+                        const py::object &num_threads = py::none(),
+                        const py::object &release_gil = py::none()) {
+  int converter_type_int = get_converter_type(converter_type);
+  check_multi_ratios(ratios);
+  const size_t n = ratios.size();
+  const size_t threads = get_num_threads(num_threads);
+
+  // the input is validated once, and converted to float32 at most once
+  InputBuffer inbuf(input);
+  const int channels = get_input_channels(inbuf);
+  std::vector<py::array_t<float, py::array::c_style>> outputs;
+  std::vector<ResampleJob> jobs;
+  outputs.reserve(n);
+  jobs.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const long new_size = max_output_frames(inbuf.frames, ratios[i], 0.0,
+                                            converter_type_int, true);
+    std::vector<size_t> out_shape{static_cast<size_t>(new_size)};
+    if (inbuf.ndim == 2) out_shape.push_back(static_cast<size_t>(channels));
+    outputs.emplace_back(out_shape);
+    // threads left over by few ratios convert within each ratio
+    jobs.push_back({nullptr, outputs.back().mutable_data(), inbuf.frames,
+                    new_size, ratios[i], converter_type_int, channels,
+                    std::max<size_t>(1, threads / n), 0, 0});
+  }
+
+  std::vector<float> storage;
+  auto run_jobs = [&]() {
+    const InputBuffer view(shared_input(inbuf, storage), inbuf.frames,
+                           channels, inbuf.ndim);
+    parallel_for(n, threads, [&](size_t i) {
+      jobs[i].input = &view;
+      run_resample_job(jobs[i]);
+    });
+  };
+
+  const bool released = should_release_gil_parallel(
+      release_gil, threads, inbuf.frames * n, converter_type_int, channels);
+  const auto start = std::chrono::steady_clock::now();
+  if (released) {
+    py::gil_scoped_release release;
+    run_jobs();
+  } else {
+    run_jobs();
+  }
+  long output_frames_gen = 0;
+  for (const auto &job : jobs) output_frames_gen += job.output_frames_gen;
+  global_stats.count_call();
+  global_stats.record(inbuf.frames, output_frames_gen, elapsed_ns(start),
+                      released);
+
+  py::list result;
+  for (size_t i = 0; i < n; ++i) {
+    std::vector<size_t> out_shape{static_cast<size_t>(jobs[i].output_frames_gen)};
+    if (outputs[i].ndim() == 2) out_shape.push_back(static_cast<size_t>(channels));
+    outputs[i].resize(out_shape);
+    result.append(outputs[i]);
+  }
+  return result;
+}
+
+// Input frames read, converted and written per step by `resample_file`.
+#define FILE_BLOCK_FRAMES 8192
+
+#ifdef _WIN32
+// UTF-8 `path` as a wide string for the Windows file APIs.
+std::wstring wide_path(const std::string &path) {
+  const int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  std::vector<wchar_t> wide(static_cast<size_t>(std::max(n, 1)), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide.data(), n);
+  return std::wstring(wide.data());
+}
+#endif
+
+// Raise OSError for the last failed system call on `path`. Needs the GIL.
+[[noreturn]] void raise_os_error(const std::string &path, bool windows_error) {
+#ifdef _WIN32
+  if (windows_error)
+    PyErr_SetExcFromWindowsErrWithFilename(PyExc_OSError, 0, path.c_str());
+  else
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+#else
+  (void)windows_error;
+  PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+#endif
+  throw py::error_already_set();
+}
+
+// Read-only memory map of a whole file. Pages are read on first access and
+// can be dropped again by the OS, so the resident memory of a sequential
+// pass stays small whatever the file size.
+class MappedFile {
+ private:
+  const uint8_t *_data = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  HANDLE _file = INVALID_HANDLE_VALUE;
+  HANDLE _mapping = nullptr;
+#endif
+
+ public:
+  // Map `path`, raising OSError on failure. Needs the GIL.
+  explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+    _file = CreateFileW(wide_path(path).c_str(), GENERIC_READ,
+                        FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size))
+      _fail(path);
+    _size = static_cast<size_t>(size.QuadPart);
+    if (_size == 0) return;
+    _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr) _fail(path);
+    _data = static_cast<const uint8_t *>(
+        MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (_data == nullptr) _fail(path);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      const int err = errno;
+      if (fd >= 0) close(fd);
+      errno = err;
+      raise_os_error(path, false);
+    }
+    _size = static_cast<size_t>(st.st_size);
+    if (_size > 0) {
+      void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        const int err = errno;
+        close(fd);
+        errno = err;
+        raise_os_error(path, false);
+      }
+      _data = static_cast<const uint8_t *>(data);
+      madvise(data, _size, MADV_SEQUENTIAL);
+    }
+    close(fd);  // the mapping keeps the file open
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() { _close(); }
+
+  const uint8_t *data() const { return _data; }
+  size_t size() const { return _size; }
+
+ private:
+  void _close() {
+#ifdef _WIN32
+    if (_data != nullptr) UnmapViewOfFile(_data);
+    if (_mapping != nullptr) CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+    if (_data != nullptr) munmap(const_cast<uint8_t *>(_data), _size);
+#endif
+  }
+
+#ifdef _WIN32
+  // the destructor does not run if the constructor throws
+  [[noreturn]] void _fail(const std::string &path) {
+    const DWORD err = GetLastError();
+    _close();
+    SetLastError(err);
+    raise_os_error(path, true);
+  }
+#endif
+};
+
+// Layout of the samples of an audio file: a WAV file, or raw interleaved
+// samples if `samplerate` is 0.
+struct AudioFileFormat {
+  SampleFormat format;
+  int channels;
+  long samplerate;
+  size_t data_offset;  // of the first sample, in bytes
+  size_t data_bytes;
+};
+
+size_t sample_bytes(SampleFormat format) {
+  return format == SampleFormat::int16 ? 2 : 4;
+}
+
+uint32_t read_le32(const uint8_t *p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+uint16_t read_le16(const uint8_t *p) { return uint16_t(p[0] | p[1] << 8); }
+
+bool is_wav(const uint8_t *data, size_t size) {
+  return size >= 12 && std::memcmp(data, "RIFF", 4) == 0 &&
+         std::memcmp(data + 8, "WAVE", 4) == 0;
+}
+
+// Parse the header of a WAV file with 16 or 32-bit integer or 32-bit float
+// samples. A data chunk running past the end of the file, e.g. of a
+// recording that was not closed properly, is cut to the file size.
+AudioFileFormat parse_wav(const uint8_t *data, size_t size) {
+  AudioFileFormat wav = {SampleFormat::float32, 0, 0, 0, 0};
+  bool have_format = false;
+  size_t pos = 12;
+  while (pos + 8 <= size) {
+    const uint8_t *chunk = data + pos;
+    const size_t length = read_le32(chunk + 4);
+    pos += 8;
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && length >= 16 &&
+        pos + length <= size) {
+      uint16_t tag = read_le16(chunk + 8);
+      const int bits = read_le16(chunk + 22);
+      // WAVE_FORMAT_EXTENSIBLE, the tag starts the subformat GUID
+      if (tag == 0xFFFE && length >= 40) tag = read_le16(chunk + 32);
+      if (tag == 1 && bits == 16)
+        wav.format = SampleFormat::int16;
+      else if (tag == 1 && bits == 32)
+        wav.format = SampleFormat::int32;
+      else if (tag == 3 && bits == 32)
+        wav.format = SampleFormat::float32;
+      else
+        throw std::domain_error(
+            "Unsupported WAV sample format. Use 16 or 32-bit integer or "
+            "32-bit float samples.");
+      wav.channels = read_le16(chunk + 10);
+      wav.samplerate = read_le32(chunk + 12);
+      have_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!have_format) break;
+      wav.data_offset = pos;
+      wav.data_bytes = std::min(length, size - pos);
+      return wav;
+    }
+    pos += length + (length & 1);  // chunks are padded to an even size
+  }
+  throw std::domain_error("Invalid WAV file.");
+}
+
+// Write the 44 byte header of a WAV file with `frames` frames.
+bool write_wav_header(std::FILE *file, const AudioFileFormat &wav,
+                      uint64_t frames) {
+  const uint32_t block_align =
+      static_cast<uint32_t>(wav.channels * sample_bytes(wav.format));
+  const uint32_t data_bytes = static_cast<uint32_t>(frames * block_align);
+  uint8_t header[44];
+  auto put = [&header](size_t pos, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+      header[pos + i] = static_cast<uint8_t>(value >> (8 * i));
+  };
+  std::memcpy(header, "RIFF", 4);
+  put(4, 36 + data_bytes, 4);
+  std::memcpy(header + 8, "WAVEfmt ", 8);
+  put(16, 16, 4);
+  put(20, wav.format == SampleFormat::float32 ? 3 : 1, 2);
+  put(22, static_cast<uint32_t>(wav.channels), 2);
+  put(24, static_cast<uint32_t>(wav.samplerate), 4);
+  put(28, static_cast<uint32_t>(wav.samplerate) * block_align, 4);
+  put(32, block_align, 2);
+  put(34, static_cast<uint32_t>(8 * sample_bytes(wav.format)), 2);
+  std::memcpy(header + 36, "data", 4);
+  put(40, data_bytes, 4);
+  return std::fseek(file, 0, SEEK_SET) == 0 &&
+         std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+// Convert `count` samples of `format` at `src` to float.
+void pcm_to_float(SampleFormat format, const void *src, float *dst,
+                  size_t count) {
+  if (format == SampleFormat::int16)
+    kernels.int16_to_float(static_cast<const int16_t *>(src), dst, count);
+  else if (format == SampleFormat::int32)
+    kernels.int32_to_float(static_cast<const int32_t *>(src), dst, count);
+  else
+    std::copy_n(static_cast<const float *>(src), count, dst);
+}
+
+uint64_t resample_file(const py::object &src_path, const py::object &dst_path,
+                       double ratio, const py::object &converter_type,
+                       const py::object &channels, const py::object &dtype,
+                       long block_frames) {
+  const int converter_type_int = get_converter_type(converter_type);
+  if (block_frames < 1)
+    throw std::domain_error("block_frames must be at least 1.");
+  // paths in the encoding of the file system, as open() takes them
+  auto os = py::module_::import("os");
+  const auto src = os.attr("fsencode")(src_path).cast<std::string>();
+  const auto dst = os.attr("fsencode")(dst_path).cast<std::string>();
+
+  const MappedFile input(src);
+  if (os.attr("path").attr("exists")(dst_path).cast<bool>() &&
+      os.attr("path").attr("samefile")(src_path, dst_path).cast<bool>())
+    throw std::domain_error("The input and output must be different files.");
+
+  AudioFileFormat format;
+  if (is_wav(input.data(), input.size())) {
+    format = parse_wav(input.data(), input.size());
+    if (!channels.is_none() && channels.cast<int>() != format.channels)
+      throw std::domain_error("Invalid number of channels for the WAV file.");
+    if (!dtype.is_none() && get_sample_format(dtype) != format.format)
+      throw std::domain_error("Invalid dtype for the WAV file.");
+  } else {
+    format = {get_sample_format(dtype),
+              channels.is_none() ? 1 : channels.cast<int>(), 0, 0,
+              input.size()};
+  }
+  if (format.channels < 1)
+    throw std::domain_error("Invalid number of channels.");
+  const size_t channel_count = static_cast<size_t>(format.channels);
+  const size_t frame_bytes = channel_count * sample_bytes(format.format);
+  const long frames = static_cast<long>(format.data_bytes / frame_bytes);
+  const long max_frames = max_output_frames(block_frames, ratio, 0.0,
+                                            converter_type_int, true);
+
+  AudioFileFormat output_format = format;
+  if (format.samplerate > 0) {
+    output_format.samplerate =
+        std::max(1L, std::lround(format.samplerate * ratio));
+    const double output_bytes =
+        (frames * std::min(ratio, SRC_MAX_RATIO) + max_frames) * frame_bytes;
+    if (output_bytes > 0xFFFFFFFF - 36)
+      throw std::domain_error(
+          "The output is too large for a WAV file, use raw files.");
+  }
+
+  int err_num = 0;
+  std::unique_ptr<Converter> state(
+      converter_new(converter_type_int, format.channels, &err_num));
+  if (!state) error_handler(err_num);
+
+#ifdef _WIN32
+  std::FILE *file = _wfopen(wide_path(dst).c_str(), L"wb");
+#else
+  std::FILE *file = std::fopen(dst.c_str(), "wb");
+#endif
+  if (file == nullptr) raise_os_error(dst, false);
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> output(file, &std::fclose);
+
+  // one block of input and output in memory, whatever the file size
+  std::vector<int32_t> samples_in(
+      static_cast<size_t>(block_frames) * frame_bytes / 4 + 1);
+  std::vector<float> block_in(static_cast<size_t>(block_frames) *
+                              channel_count);
+  std::vector<float> block_out(static_cast<size_t>(max_frames) *
+                               channel_count);
+  std::vector<int16_t> samples_out16;
+  std::vector<int32_t> samples_out32;
+  if (format.format == SampleFormat::int16)
+    samples_out16.resize(block_out.size());
+  if (format.format == SampleFormat::int32)
+    samples_out32.resize(block_out.size());
+
+  uint64_t output_frames = 0;
+  auto write = [&](long count) {
+    const size_t samples = static_cast<size_t>(count) * channel_count;
+    const void *data = block_out.data();
+    if (format.format == SampleFormat::int16) {
+      float_to_pcm(block_out.data(), samples_out16.data(), samples);
+      data = samples_out16.data();
+    } else if (format.format == SampleFormat::int32) {
+      float_to_pcm(block_out.data(), samples_out32.data(), samples);
+      data = samples_out32.data();
+    }
+    output_frames += static_cast<uint64_t>(count);
+    return std::fwrite(data, frame_bytes, static_cast<size_t>(count),
+                       output.get()) == static_cast<size_t>(count);
+  };
+
+  // returns false with errno set on a write error
+  auto run = [&]() {
+    if (output_format.samplerate > 0 &&
+        !write_wav_header(output.get(), output_format, 0))
+      return false;
+    long first = 0;
+    do {
+      const long count = std::min(block_frames, frames - first);
+      if (count > 0)
+        std::memcpy(samples_in.data(),
+                    input.data() + format.data_offset + first * frame_bytes,
+                    static_cast<size_t>(count) * frame_bytes);
+      pcm_to_float(format.format, samples_in.data(), block_in.data(),
+                   static_cast<size_t>(count) * channel_count);
+      first += count;
+
+      long used = 0;
+      while (true) {
+        SRC_DATA src_data = {block_in.data() + used * format.channels,
+                             block_out.data(),
+                             count - used,
+                             max_frames,
+                             0,
+                             0,
+                             first >= frames,
+                             ratio};
+        error_handler(state->process(&src_data));
+        used += src_data.input_frames_used;
+        if (!write(src_data.output_frames_gen)) return false;
+        if (used >= count && src_data.output_frames_gen < max_frames) break;
+      }
+    } while (first < frames);
+    if (output_format.samplerate > 0 &&
+        !write_wav_header(output.get(), output_format, output_frames))
+      return false;
+    return std::fflush(output.get()) == 0;
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  bool ok;
+  {
+    py::gil_scoped_release release;
+    ok = run();
+  }
+  global_stats.count_call();
+  global_stats.record(frames, static_cast<long>(output_frames),
+                      elapsed_ns(start), true);
+  if (!ok || std::fclose(output.release()) != 0) raise_os_error(dst, false);
+  return output_frames;
+}
+
+// Frames of the input and of the output buffer of a SharedMemoryResampler.
+#define SHARED_CAPACITY_FRAMES 16384
+
+// Interval at which a process waiting for the other side of a
+// SharedMemoryResampler checks that it is still running, in milliseconds.
+#define SHARED_WAIT_MS 100
+
+// Layout version of the shared memory segment of a SharedMemoryResampler.
+#define SHARED_MAGIC 0x53524d31u
+
+enum class SharedCommand : uint32_t { process, set_ratio, reset, stop };
+
+enum class SharedError : int32_t { none, resampling, other };
+
+// Header of the shared memory segment of a SharedMemoryResampler, followed
+// by the input and the output buffer of `capacity` interleaved float32
+// frames each. The client posts a command by filling in its fields and
+// incrementing `request`, the worker answers by filling in the response
+// fields and setting `response` to the same count. Both counters are
+// stored with release and loaded with acquire ordering, so each side sees
+// the fields and samples the other one wrote before.
+struct SharedHeader {
+  uint32_t magic;
+  int32_t converter_type;
+  int32_t channels;
+  uint32_t client_pid;
+  int64_t capacity;
+  std::atomic<uint32_t> worker_pid;  // 0 until a worker attached
+  alignas(64) std::atomic<uint32_t> request;
+  alignas(64) std::atomic<uint32_t> response;
+  // command, convert input frames [input_first, input_frames) if `process`
+  uint32_t command;
+  int32_t end_of_input;
+  double ratio;
+  int64_t input_first;
+  int64_t input_frames;
+  // response
+  int64_t input_frames_used;
+  int64_t output_frames_gen;
+  int32_t error;  // see SharedError
+  char message[256];
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futexes need plain 32-bit atomics");
+
+// Offset of the input buffer in the segment, and its total size.
+size_t shared_header_bytes() { return (sizeof(SharedHeader) + 63) / 64 * 64; }
+
+size_t shared_segment_bytes(int channels, long capacity) {
+  return shared_header_bytes() +
+         2 * static_cast<size_t>(capacity) * channels * sizeof(float);
+}
+
+uint32_t current_pid() {
+#ifdef _WIN32
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// Whether process `pid` is still running.
+bool process_alive(uint32_t pid) {
+#ifdef _WIN32
+  HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+  if (process == nullptr) return GetLastError() == ERROR_ACCESS_DENIED;
+  const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  CloseHandle(process);
+  return alive;
+#else
+  return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+// A new name for a shared memory segment, unique on this machine.
+std::string shared_segment_name() {
+  static std::atomic<uint32_t> counter{0};
+#ifdef _WIN32
+  std::string name = "Local\\samplerate-";
+#else
+  std::string name = "/samplerate-";
+#endif
+  return name + std::to_string(current_pid()) + "-" +
+         std::to_string(counter.fetch_add(1));
+}
+
+// One direction of the signalling between the processes of a
+// SharedMemoryResampler: a counter in shared memory, waited on with a futex
+// on Linux and with a named event on Windows. Other systems poll it.
+class SharedSignal {
+ private:
+  std::atomic<uint32_t> *_word;
+#ifdef _WIN32
+  HANDLE _event = nullptr;
+#endif
+
+ public:
+  // Needs the GIL, raises OSError.
+  SharedSignal(std::atomic<uint32_t> *word, const std::string &name)
+      : _word(word) {
+#ifdef _WIN32
+    _event = CreateEventW(nullptr, FALSE, FALSE, wide_path(name).c_str());
+    if (_event == nullptr) raise_os_error(name, true);
+#else
+    (void)name;
+#endif
+  }
+
+  SharedSignal(const SharedSignal &) = delete;
+  SharedSignal &operator=(const SharedSignal &) = delete;
+
+  ~SharedSignal() {
+#ifdef _WIN32
+    CloseHandle(_event);
+#endif
+  }
+
+  uint32_t load() const { return _word->load(std::memory_order_acquire); }
+
+  // Publish `value` and wake the other process.
+  void post(uint32_t value) {
+    _word->store(value, std::memory_order_release);
+#if defined(_WIN32)
+    SetEvent(_event);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(_word), FUTEX_WAKE,
+            std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+#endif
+  }
+
+  // Wait up to about `timeout_ms` for the counter to change from `value`,
+  // spinning briefly first. Returns whether it changed.
+  bool wait(uint32_t value, int timeout_ms) const {
+    for (int i = 0; i < 1000; ++i)
+      if (load() != value) return true;
+#if defined(_WIN32)
+    WaitForSingleObject(_event, static_cast<DWORD>(timeout_ms));
+#elif defined(__linux__)
+    const timespec timeout = {timeout_ms / 1000,
+                              (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(_word), FUTEX_WAIT, value,
+            &timeout, nullptr, 0);
+#else
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(timeout_ms);
+    while (load() == value && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+    return load() != value;
+  }
+};
+
+// A named shared memory segment, created by a SharedMemoryResampler and
+// opened by its worker. The creator removes the name on destruction, the
+// memory is freed once both processes unmapped it.
+class SharedSegment {
+ private:
+  std::string _name;
+  uint8_t *_data = nullptr;
+  size_t _size = 0;
+  bool _owner = false;
+#ifdef _WIN32
+  HANDLE _mapping = nullptr;
+#endif
+
+ public:
+  // Create a zeroed segment of `size` bytes, or open an existing one if
+  // `size` is 0. Needs the GIL, raises OSError.
+  SharedSegment(const std::string &name, size_t size)
+      : _name(name), _size(size), _owner(size > 0) {
+#ifdef _WIN32
+    const std::wstring wide = wide_path(name);
+    if (_owner) {
+      _mapping = CreateFileMappingW(
+          INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+          static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+          static_cast<DWORD>(size), wide.c_str());
+      if (_mapping != nullptr && GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+        SetLastError(ERROR_ALREADY_EXISTS);
+      }
+    } else {
+      _mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, wide.c_str());
+    }
+    if (_mapping == nullptr) raise_os_error(name, true);
+    _data = static_cast<uint8_t *>(
+        MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (_data == nullptr) {
+      const DWORD err = GetLastError();
+      _close();
+      SetLastError(err);
+      raise_os_error(name, true);
+    }
+    if (!_owner) {
+      MEMORY_BASIC_INFORMATION info;
+      _size = VirtualQuery(_data, &info, sizeof(info)) ? info.RegionSize : 0;
+    }
+#else
+    const int fd = _owner ? shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL,
+                                     0600)
+                          : shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) raise_os_error(name, false);
+    struct stat st;
+    void *data = MAP_FAILED;
+    if ((!_owner || ftruncate(fd, static_cast<off_t>(size)) == 0) &&
+        fstat(fd, &st) == 0) {
+      _size = static_cast<size_t>(st.st_size);
+      data = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int err = errno;
+    close(fd);  // the mapping keeps the segment open
+    if (data == MAP_FAILED) {
+      _close();
+      errno = err;
+      raise_os_error(name, false);
+    }
+    _data = static_cast<uint8_t *>(data);
+#endif
+  }
+
+  SharedSegment(const SharedSegment &) = delete;
+  SharedSegment &operator=(const SharedSegment &) = delete;
+
+  ~SharedSegment() { _close(); }
+
+  SharedHeader *header() const {
+    return reinterpret_cast<SharedHeader *>(_data);
+  }
+  float *input() const {
+    return reinterpret_cast<float *>(_data + shared_header_bytes());
+  }
+  float *output() const {
+    return input() + header()->capacity * header()->channels;
+  }
+  size_t size() const { return _size; }
+
+ private:
+  void _close() {
+#ifdef _WIN32
+    if (_data != nullptr) UnmapViewOfFile(_data);
+    if (_mapping != nullptr) CloseHandle(_mapping);
+#else
+    if (_data != nullptr) munmap(_data, _size);
+    if (_owner) shm_unlink(_name.c_str());
+#endif
+    _data = nullptr;
+  }
+};
+
+// Serve the SharedMemoryResampler that created the shared memory segment
+// `name` until it is closed or its process exits, with a Resampler of its
+// converter type and channels. The GIL is released while serving.
+void run_shared_worker(const std::string &name) {
+  SharedSegment segment(name, 0);
+  SharedHeader *header = segment.header();
+  const bool valid =
+      segment.size() >= shared_header_bytes() &&
+      header->magic == SHARED_MAGIC && header->channels >= 1 &&
+      header->capacity >= 1 &&
+      segment.size() >= shared_segment_bytes(
+                            header->channels,
+                            static_cast<long>(header->capacity));
+  if (!valid)
+    throw std::domain_error("Not a SharedMemoryResampler segment: " + name);
+  Resampler resampler(py::int_(header->converter_type), header->channels,
+                      py::int_(1));
+  SharedSignal request(&header->request, name + "-request");
+  SharedSignal response(&header->response, name + "-response");
+  const int channels = header->channels;
+  const long capacity = static_cast<long>(header->capacity);
+
+  py::gil_scoped_release release;
+  header->worker_pid.store(current_pid(), std::memory_order_release);
+  uint32_t served = response.load();
+  while (true) {
+    if (request.load() == served) {
+      if (!request.wait(served, SHARED_WAIT_MS) &&
+          !process_alive(header->client_pid))
+        return;
+      continue;
+    }
+    const auto command = static_cast<SharedCommand>(header->command);
+    header->error = static_cast<int32_t>(SharedError::none);
+    header->input_frames_used = 0;
+    header->output_frames_gen = 0;
+    try {
+      if (command == SharedCommand::process) {
+        const InputBuffer input(segment.input(),
+                                static_cast<long>(header->input_frames),
+                                channels, 2);
+        const SRC_DATA src_data = resampler.process_input(
+            input, static_cast<long>(header->input_first), segment.output(),
+            capacity, header->ratio, header->end_of_input != 0);
+        header->input_frames_used = src_data.input_frames_used;
+        header->output_frames_gen = src_data.output_frames_gen;
+      } else if (command == SharedCommand::set_ratio) {
+        resampler.set_ratio(header->ratio);
+      } else if (command == SharedCommand::reset) {
+        resampler.reset();
+      }
+    } catch (const std::exception &e) {
+      header->error = static_cast<int32_t>(
+          dynamic_cast<const ResamplingException *>(&e) != nullptr
+              ? SharedError::resampling
+              : SharedError::other);
+      std::strncpy(header->message, e.what(), sizeof(header->message) - 1);
+      header->message[sizeof(header->message) - 1] = '\0';
+    }
+    served = request.load();
+    response.post(served);
+    if (command == SharedCommand::stop) return;
+  }
+}
+
+// Resampler running in a worker process, fed through shared memory, see
+// run_shared_worker. Each call copies its input to the shared input buffer
+// in pieces whose output fits in the shared output buffer, posts them to
+// the worker and waits for its answer without holding the GIL.
+class SharedMemoryResampler {
+ private:
+  std::unique_ptr<SharedSegment> _segment;
+  std::unique_ptr<SharedSignal> _request;
+  std::unique_ptr<SharedSignal> _response;
+  SharedHeader *_header = nullptr;
+  py::object _process;     // the worker started by the constructor, or None
+  uint32_t _sequence = 0;  // of the last command posted
+  std::shared_ptr<SerialQueue> _queue;  // asynchronous calls
+  mutable ObjectMutex _mutex;           // see ObjectLock
+
+  void _check_open() const {
+    if (!_segment)
+      throw std::runtime_error("The SharedMemoryResampler is closed.");
+  }
+
+  // Synchronous calls would race with the asynchronous ones still running.
+  void _check_idle() const {
+    if (_queue && _queue->pending() > 0)
+      throw std::runtime_error(
+          "The resampler has pending asynchronous calls.");
+  }
+
+  // Wait for the answer to the command `sequence`, without the GIL. Raises
+  // if the worker exited, or a signal handler raised, e.g. on Ctrl-C. The
+  // next command waits for the answer of an interrupted one.
+  void _wait(uint32_t sequence) const {
+    while (true) {
+      const uint32_t answered = _response->load();
+      if (answered == sequence) return;
+      if (_response->wait(answered, SHARED_WAIT_MS)) continue;
+      const uint32_t pid = _header->worker_pid.load(std::memory_order_acquire);
+      const bool exited = pid != 0 && !process_alive(pid);
+      py::gil_scoped_acquire acquire;
+      if (PyErr_CheckSignals() != 0) throw py::error_already_set();
+      // a worker started by the constructor may fail before attaching
+      if (exited || (pid == 0 && !_process.is_none() &&
+                     !_process.attr("poll")().is_none()))
+        throw std::runtime_error(
+            "The worker process of the SharedMemoryResampler exited.");
+    }
+  }
+
+  // Post `command` once the previous one is answered, and wait for its
+  // answer. Raises the errors of the worker. Does not need the GIL.
+  void _call(SharedCommand command) {
+    _wait(_sequence);
+    _header->command = static_cast<uint32_t>(command);
+    _request->post(++_sequence);
+    _wait(_sequence);
+    const auto error = static_cast<SharedError>(_header->error);
+    if (error == SharedError::resampling)
+      throw ResamplingException(std::string(_header->message));
+    if (error == SharedError::other) throw std::runtime_error(_header->message);
+  }
+
+  // Convert all of `input` at `ratio` in the worker, appending to `output`.
+  // Does not touch any Python object.
+  void _process_all(const InputBuffer &input, double ratio, bool end_of_input,
+                    std::vector<float> &output) {
+    const long capacity = static_cast<long>(_header->capacity);
+    const long piece_frames =
+        ratio > 0.0 ? std::max<long>(
+                          1, std::min<long>(
+                                 capacity,
+                                 static_cast<long>(
+                                     (capacity - OUTPUT_FRAMES_SLACK) / ratio)))
+                    : capacity;
+    const float *shared_output = _segment->output();
+    long position = 0;
+    do {
+      const long frames = std::min(piece_frames, input.frames - position);
+      _wait(_sequence);
+      input.gather(position, frames, _segment->input());
+      _header->ratio = ratio;
+      _header->end_of_input = end_of_input && position + frames == input.frames;
+      _header->input_frames = frames;
+      long first = 0;
+      // drains the output left pending when the output buffer is full
+      while (true) {
+        _header->input_first = first;
+        _call(SharedCommand::process);
+        const long used = static_cast<long>(_header->input_frames_used);
+        const long gen = static_cast<long>(_header->output_frames_gen);
+        output.insert(output.end(), shared_output,
+                      shared_output + gen * _channels);
+        first += used;
+        if (gen < capacity && (first >= frames || used == 0)) break;
+      }
+      position += frames;
+    } while (position < input.frames);
+  }
+
+ public:
+  int _converter_type = 0;
+  int _channels = 0;
+  long _capacity = 0;
+  std::string _name;
+
+  SharedMemoryResampler(const py::object &converter_type, int channels,
+                        long capacity, bool spawn)
+      : _converter_type(get_converter_type(converter_type)),
+        _channels(channels),
+        _capacity(capacity) {
+    if (channels < 1)
+      throw std::domain_error("Invalid number of channels.");
+    if (capacity < 1) throw std::domain_error("capacity must be at least 1.");
+    _name = shared_segment_name();
+    _segment.reset(
+        new SharedSegment(_name, shared_segment_bytes(channels, capacity)));
+    // the segment is zeroed, so are the counters
+    _header = _segment->header();
+    _header->converter_type = _converter_type;
+    _header->channels = channels;
+    _header->capacity = capacity;
+    _header->client_pid = current_pid();
+    _header->magic = SHARED_MAGIC;
+    _request.reset(new SharedSignal(&_header->request, _name + "-request"));
+    _response.reset(new SharedSignal(&_header->response, _name + "-response"));
+    _process = py::none();
+    if (spawn) {
+      // the worker imports this module from where this process found it
+      auto os = py::module_::import("os");
+      py::dict env = os.attr("environ").attr("copy")();
+      py::list path;
+      path.append(os.attr("path").attr("dirname")(
+          py::module_::import("samplerate").attr("__file__")));
+      if (env.contains("PYTHONPATH")) path.append(env["PYTHONPATH"]);
+      env["PYTHONPATH"] = py::str(os.attr("pathsep")).attr("join")(path);
+      py::list args;
+      args.append(py::module_::import("sys").attr("executable"));
+      args.append("-c");
+      args.append(
+          "import sys, samplerate; samplerate.run_shared_worker(sys.argv[1])");
+      args.append(_name);
+      _process = py::module_::import("subprocess")
+                     .attr("Popen")(args, "env"_a = env);
+    }
+  }
+
+  SharedMemoryResampler(const SharedMemoryResampler &) = delete;
+  SharedMemoryResampler &operator=(const SharedMemoryResampler &) = delete;
+
+  // Stops the worker, without raising.
+  ~SharedMemoryResampler() {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+
+  py::array process(const py::object &input, double ratio, bool end_of_input,
+                    const std::string &layout = "interleaved",
+                    const py::object &dtype = py::none()) {
+    ObjectLock lock(_mutex);
+    _check_open();
+    _check_idle();
+    const bool planar = is_planar(layout);
+    const SampleFormat format = get_sample_format(dtype);
+    InputBuffer inbuf(input, planar);
+    if (inbuf.channels != _channels)
+      throw std::domain_error("Invalid number of channels in input data.");
+    std::vector<float> output;
+    {
+      py::gil_scoped_release release;
+      _process_all(inbuf, ratio, end_of_input, output);
+    }
+    return finish_output(vector_array(std::move(output), _channels, inbuf.ndim),
+                         format, planar);
+  }
+
+  // Asynchronous `process`, returning an asyncio future of its output. The
+  // calls of one resampler run one after the other on the thread pool,
+  // whose thread waits for the worker, `self` keeps the resampler alive
+  // meanwhile.
+  py::object process_async(const py::object &self, const py::object &input,
+                           double ratio, bool end_of_input,
+                           const std::string &layout,
+                           const py::object &dtype) {
+    const bool planar = is_planar(layout);
+    const SampleFormat format = get_sample_format(dtype);
+    auto inbuf = std::make_shared<InputBuffer>(input, planar);
+    if (inbuf->channels != _channels)
+      throw std::domain_error("Invalid number of channels in input data.");
+    auto output = std::make_shared<std::vector<float>>();
+    ObjectLock lock(_mutex);
+    _check_open();
+    if (!_queue) _queue = std::make_shared<SerialQueue>();
+
+    const int channels = _channels;
+    return run_async(
+        [this, inbuf, ratio, end_of_input, output]() {
+          ObjectLock lock(_mutex);
+          _check_open();
+          _process_all(*inbuf, ratio, end_of_input, *output);
+        },
+        [self, inbuf, output, channels, format, planar]() {
+          return finish_output(
+              vector_array(std::move(*output), channels, inbuf->ndim), format,
+              planar);
+        },
+        _queue);
+  }
+
+  void set_ratio(double new_ratio) {
+    ObjectLock lock(_mutex);
+    _check_open();
+    _check_idle();
+    py::gil_scoped_release release;
+    _header->ratio = new_ratio;
+    _call(SharedCommand::set_ratio);
+  }
+
+  void reset() {
+    ObjectLock lock(_mutex);
+    _check_open();
+    _check_idle();
+    py::gil_scoped_release release;
+    _call(SharedCommand::reset);
+  }
+
+  // Stop the worker and free the shared memory. Does nothing if closed.
+  void close() {
+    ObjectLock lock(_mutex);
+    if (!_segment) return;
+    _check_idle();
+    // a worker started by hand may not have attached yet
+    if (!_process.is_none() ||
+        _header->worker_pid.load(std::memory_order_acquire) != 0) {
+      try {
+        py::gil_scoped_release release;
+        _call(SharedCommand::stop);
+      } catch (const std::runtime_error &) {
+        // the worker exited already
+      }
+    }
+    if (!_process.is_none()) _process.attr("wait")();
+    _process = py::none();
+    _request.reset();
+    _response.reset();
+    _segment.reset();
+    _header = nullptr;
+  }
+
+  py::object worker_pid() const {
+    if (!_segment) return py::none();
+    const uint32_t pid = _header->worker_pid.load(std::memory_order_acquire);
+    if (pid == 0) return py::none();
+    return py::int_(pid);
+  }
+
+  SharedMemoryResampler &__enter__() { return *this; }
+  void __exit__(const py::object & /*exc_type*/, const py::object & /*exc*/,
+                const py::object & /*exc_tb*/) {
+    close();
+  }
+};
+
+// Number of input frames converted per timing run of
+// calibrate_gil_thresholds.
+#define CALIBRATION_FRAMES 8192
+
+// Measure, for each converter type, the number of frames whose conversion
+// takes 100 times as long as releasing and re-acquiring the GIL, so that
+// the release costs less than 1% of the call, and use it as the GIL release
+// threshold of that type. With `channels` set, the thresholds are measured
+// and set for that channel count only. Must be called with the GIL held.
+py::dict calibrate_gil_thresholds(const py::object &channels_obj) {
+  const int channels = channels_obj.is_none() ? 1 : channels_obj.cast<int>();
+  if (channels < 1 || channels > GIL_THRESHOLD_CHANNELS)
+    throw std::domain_error("Calibrated channel counts must be within 1 and " +
+                            std::to_string(GIL_THRESHOLD_CHANNELS) + ".");
+
+  // cost of one release and re-acquire, without contention
+  const int gil_rounds = 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < gil_rounds; ++i) {
+    py::gil_scoped_release release;
+  }
+  const double gil_ns = static_cast<double>(elapsed_ns(start)) / gil_rounds;
+
+  // white noise at a common ratio, with every converter on the same data
+  std::vector<float> input(static_cast<size_t>(CALIBRATION_FRAMES * channels));
+  fill_noise(input);
+  const double ratio = 48000.0 / 44100.0;
+  std::vector<float> output(static_cast<size_t>(
+      (CALIBRATION_FRAMES * ratio + 64) * channels));
+
+  py::dict thresholds;
+  for (int type = 0; type < NUM_CONVERTER_TYPES; ++type) {
+    int err = 0;
+    std::unique_ptr<Converter> state(converter_new(type, channels, &err));
+    if (!state) error_handler(err ? err : SRC_ERR_MALLOC_FAILED);
+    // the half-band cascades would only time their fallback at `ratio`
+    const double type_ratio = is_halfband(type) ? 0.5 : ratio;
+
+    // the first run builds filters and warms up caches
+    uint64_t best_ns = std::numeric_limits<uint64_t>::max();
+    for (int run = 0; run < 4; ++run) {
+      SRC_DATA data = {input.data(),
+                       output.data(),
+                       CALIBRATION_FRAMES,
+                       static_cast<long>(output.size()) / channels,
+                       0,
+                       0,
+                       0,
+                       type_ratio};
+      start = std::chrono::steady_clock::now();
+      error_handler(state->process(&data));
+      if (run > 0) best_ns = std::min(best_ns, elapsed_ns(start));
+    }
+
+    const double frame_ns =
+        std::max(static_cast<double>(best_ns), 1.0) / CALIBRATION_FRAMES;
+    const long threshold = static_cast<long>(
+        std::min(std::ceil(100.0 * gil_ns / frame_ns), 1e9));
+    gil_release_thresholds[type][channels_obj.is_none() ? 0 : channels].store(
+        std::max(threshold, 1L), std::memory_order_relaxed);
+    thresholds[converter_type_names[type]] = std::max(threshold, 1L);
+  }
+  return thresholds;
+}
+
+// Time per call of `call` in nanoseconds, the best of 3 runs of at least 3
+// calls and `min_time` seconds each.
+template <typename Call>
+double time_per_call(Call call, double min_time) {
+  double best = std::numeric_limits<double>::infinity();
+  for (int run = 0; run < 3; ++run) {
+    long calls = 0;
+    uint64_t ns = 0;
+    const auto start = std::chrono::steady_clock::now();
+    do {
+      call();
+      ++calls;
+      ns = elapsed_ns(start);
+    } while (calls < 3 || ns < min_time * 1e9);
+    best = std::min(best, static_cast<double>(ns) / calls);
+  }
+  return best;
+}
+
+// Measure the cost of the bindings on top of the converters: for each
+// converter type, channel count and block size, the time per block of the
+// bare converter and of the Python level calls, which add argument
+// parsing, input conversion, output allocation and GIL handling.
+py::object benchmark(const py::object &converter_types,
+                     const std::vector<int> &channels_list,
+                     const std::vector<long> &block_frames_list, double ratio,
+                     double min_time, bool as_json) {
+  std::vector<int> types;
+  if (converter_types.is_none()) {
+    for (int type = 0; type < NUM_CONVERTER_TYPES; ++type)
+      types.push_back(type);
   } else {
-    err_code = do_resample();
+    // a single converter type, or a sequence of them
+    const bool single = py::isinstance<py::str>(converter_types) ||
+                        py::isinstance<py::int_>(converter_types) ||
+                        py::isinstance<ConverterType>(converter_types);
+    for (const auto &obj :
+         single ? std::vector<py::object>{converter_types}
+                : converter_types.cast<std::vector<py::object>>()) {
+      const int type = get_converter_type(obj);
+      if (type < 0 || type >= NUM_CONVERTER_TYPES)
+        throw std::domain_error("Unsupported converter type");
+      types.push_back(type);
+    }
+  }
+
+  auto module = py::module_::import("samplerate");
+  py::object resample_func = module.attr("resample");
+  py::object resampler_class = module.attr("Resampler");
+
+  py::list results;
+  for (int type : types) {
+    const py::str name(converter_type_names[type]);
+    for (int channels : channels_list) {
+      for (long frames : block_frames_list) {
+        if (channels < 1 || frames < 1)
+          throw std::domain_error(
+              "Channel counts and block sizes must be positive.");
+
+        // white noise blocks, 1D for a single channel
+        std::vector<size_t> shape{static_cast<size_t>(frames)};
+        if (channels > 1) shape.push_back(static_cast<size_t>(channels));
+        std::vector<float> noise(static_cast<size_t>(frames * channels));
+        fill_noise(noise);
+        auto block = py::array_t<float, py::array::c_style>(shape);
+        std::copy(noise.begin(), noise.end(), block.mutable_data());
+        py::object block64 = block.attr("astype")("float64");
+
+        // the bare converter, streaming
+        int err = 0;
+        std::unique_ptr<Converter> state(converter_new(type, channels, &err));
+        if (!state) error_handler(err ? err : SRC_ERR_MALLOC_FAILED);
+        const long max_frames = static_cast<long>(frames * ratio) + 64;
+        std::vector<float> output(static_cast<size_t>(max_frames * channels));
+        const double native_ns = time_per_call(
+            [&]() {
+              SRC_DATA data = {noise.data(), output.data(), frames, max_frames,
+                               0,            0,             0,      ratio};
+              error_handler(state->process(&data));
+            },
+            min_time);
+
+        py::object resampler = resampler_class(name, channels);
+        py::object process = resampler.attr("process");
+        py::object process_into = resampler.attr("process_into");
+        shape[0] = static_cast<size_t>(max_frames);
+        auto out = py::array_t<float, py::array::c_style>(shape);
+
+        py::dict result;
+        result["converter_type"] = name;
+        result["channels"] = channels;
+        result["block_frames"] = frames;
+        result["native_ns"] = native_ns;
+        result["resample_ns"] = time_per_call(
+            [&]() { resample_func(block, ratio, name, "release_gil"_a = false); },
+            min_time);
+        result["resample_float64_ns"] = time_per_call(
+            [&]() {
+              resample_func(block64, ratio, name, "release_gil"_a = false);
+            },
+            min_time);
+        const double process_ns = time_per_call(
+            [&]() { process(block, ratio, "release_gil"_a = false); }, min_time);
+        result["process_ns"] = process_ns;
+        result["process_release_gil_ns"] = time_per_call(
+            [&]() { process(block, ratio, "release_gil"_a = true); }, min_time);
+        result["process_into_ns"] = time_per_call(
+            [&]() { process_into(block, out, ratio, "release_gil"_a = false); },
+            min_time);
+        result["overhead_ns"] = process_ns - native_ns;
+        result["native_frames_per_second"] = frames * 1e9 / native_ns;
+        results.append(result);
+      }
+    }
   }
-  long output_frames_gen = src_data.output_frames_gen;
-  long input_frames_used = src_data.input_frames_used;
-  error_handler(err_code);
 
-  // create a shorter view of the array
-  if ((size_t)output_frames_gen < new_size) {
-    out_shape[0] = output_frames_gen;
-    output.resize(out_shape);
-  } else if ((size_t)output_frames_gen >= new_size) {
-    // This means our fudge factor is too small.
-    throw std::runtime_error("Generated more output samples than expected!");
-  }
+  py::dict report;
+  report["build_info"] = module.attr("get_build_info")();
+  report["ratio"] = ratio;
+  report["min_time"] = min_time;
+  report["results"] = results;
+  if (as_json)
+    return py::module_::import("json").attr("dumps")(report, "indent"_a = 2);
+  return std::move(report);
+}
+
+}  // namespace samplerate
+
+namespace sr = samplerate;
+
+PYBIND11_MODULE(samplerate, m, py::mod_gil_not_used()) {
+  m.doc() =
+      "A simple python wrapper library around libsamplerate";  // optional
+                                                               // module
+                                                               // docstring
+  m.attr("__version__") = VERSION_INFO;
+  m.attr("__libsamplerate_version__") = LIBSAMPLERATE_VERSION;
+
+  sr::clear_gil_release_thresholds();
+  py::module_::import("atexit").attr("register")(
+      py::cpp_function(&sr::CallbackPrefetcher::stop_all));
+  const char *simd = std::getenv("SAMPLERATE_SIMD");
+  const auto simd_warning = sr::select_kernels(simd ? simd : "");
+  if (!simd_warning.empty() &&
+      PyErr_WarnEx(PyExc_RuntimeWarning, simd_warning.c_str(), 1) < 0)
+    throw py::error_already_set();
+
+  m.def("set_gil_release_threshold", [](long threshold,
+                                        const py::object &converter_type,
+                                        const py::object &channels) {
+    if (converter_type.is_none() && channels.is_none()) {
+      gil_release_threshold_frames.store(threshold);
+      sr::clear_gil_release_thresholds();
+      return;
+    }
+    if (threshold < 0)
+      throw std::domain_error("Threshold must be non-negative.");
+    const int c = channels.is_none() ? 0 : channels.cast<int>();
+    if (c < 0 || c > GIL_THRESHOLD_CHANNELS)
+      throw std::domain_error("Channel specific thresholds are limited to 1 to " +
+                              std::to_string(GIL_THRESHOLD_CHANNELS) +
+                              " channels.");
+    if (converter_type.is_none()) {
+      for (auto &per_type : sr::gil_release_thresholds) per_type[c] = threshold;
+      return;
+    }
+    const int type = sr::get_converter_type(converter_type);
+    if (type < 0 || type >= NUM_CONVERTER_TYPES)
+      throw std::domain_error("Unsupported converter type");
+    sr::gil_release_thresholds[type][c] = threshold;
+  }, R"doc(
+Set the minimum number of frames required to release the GIL in 'auto' mode.
+
+Without `converter_type` and `channels`, sets the threshold of all converter
+types and channel counts, dropping any specific or calibrated threshold.
+Otherwise only sets the threshold of `converter_type` (all types if `None`)
+for `channels` channels (1 to 8, any number if `None`). Specific thresholds
+take precedence over the general ones.
+)doc", "threshold"_a, "converter_type"_a = py::none(), "channels"_a = py::none());
+
+  m.def("get_gil_release_threshold", [](const py::object &converter_type,
+                                        const py::object &channels) {
+    return sr::gil_release_threshold(
+        converter_type.is_none() ? -1 : sr::get_converter_type(converter_type),
+        channels.is_none() ? 0 : channels.cast<int>());
+  }, R"doc(
+Get the minimum number of frames required to release the GIL in 'auto' mode.
+
+Returns the threshold applied to `converter_type` and `channels` channels, or
+the general threshold when both are `None`.
+)doc", "converter_type"_a = py::none(), "channels"_a = py::none());
+
+  m.def("calibrate_gil_thresholds", &sr::calibrate_gil_thresholds, R"doc(
+Tune the GIL release thresholds of each converter type to this machine.
+
+Times the release and re-acquisition of the GIL and the conversion of white
+noise with every converter type, and sets each threshold to the number of
+frames whose conversion takes 100 times as long as the GIL round trip.
+Takes a few tens of milliseconds, and is best called once at startup.
+
+Parameters
+----------
+channels : int or None
+    Calibrate the thresholds for this channel count (1 to 8) only. By
+    default, one channel is timed and the thresholds apply to any channel
+    count.
+
+Returns
+-------
+thresholds : dict
+    The new threshold of each converter type, by name.
+)doc", "channels"_a = py::none());
+
+  m.def("set_num_threads", [](const py::object &num_threads) {
+    sr::default_num_threads = sr::get_num_threads(num_threads);
+  }, R"doc(
+Set the default number of threads for `num_threads` arguments.
 
-  if (verbose) {
-    py::print("samplerate info:");
-    py::print(input_frames_used, " input frames used");
-    py::print(output_frames_gen, " output frames generated");
-  }
+Used by `resample`, `resample_batch`, `Resampler` and `ResamplerBank` when
+their `num_threads` argument is `None`. Use 0 for one thread per CPU core.
+The threads come from a persistent native pool shared by all resamplers.
+)doc", "num_threads"_a);
 
-  return output;
-}
+  m.def("get_num_threads", []() {
+    return sr::default_num_threads.load();
+  }, "Get the default number of threads for `num_threads` arguments.");
 
-}  // namespace samplerate
+  m.def("set_state_cache_size", [](size_t size) {
+    sr::state_cache_size = size;
+  }, R"doc(
+Set the maximum number of converter states cached per thread by `resample`.
 
-namespace sr = samplerate;
+`resample` reuses converter states keyed by converter type and number of
+channels instead of allocating a new one on every call. Set to 0 to disable
+the cache.
+)doc", "size"_a);
 
-PYBIND11_MODULE(samplerate, m) {
-  m.doc() =
-      "A simple python wrapper library around libsamplerate";  // optional
-                                                               // module
-                                                               // docstring
-  m.attr("__version__") = VERSION_INFO;
-  m.attr("__libsamplerate_version__") = LIBSAMPLERATE_VERSION;
+  m.def("get_state_cache_size", []() {
+    return sr::state_cache_size.load();
+  }, "Get the maximum number of converter states cached per thread by `resample`.");
+
+  m.def("clear_state_cache", []() {
+    sr::state_cache.clear();
+    ++sr::state_cache_generation;
+  }, R"doc(
+Free the converter states cached by `resample`.
+
+The cache of the calling thread is freed immediately, the caches of other
+threads are freed on their next call to `resample`.
+)doc");
+
+  m.def("get_filter_cache_info", []() {
+    const auto info = sr::polyphase_filter_cache().info();
+    py::dict result;
+    result["designs"] = info.first;
+    result["cached"] = info.second;
+    return result;
+  }, R"doc(
+Get the state of the polyphase filter bank cache.
+
+Returns a dict with the number of filter banks designed since import,
+`designs`, and the number of banks currently held by the cache, `cached`.
+Converters with the same design and ratio share one bank, and the most
+recently used banks stay cached after their last converter is gone.
+)doc");
+
+  m.def("set_strict_input", [](bool strict) {
+    sr::strict_input = strict;
+  }, R"doc(
+Forbid implicit copies of input data.
+
+When enabled, inputs that are not 32-bit float, int16 or int32 (such as
+float64 arrays or Python lists) raise a `ValueError` instead of being
+converted to a new array. Strided, planar and foreign buffers of these
+types are always read in place and are not affected.
+)doc", "strict"_a);
+
+  m.def("get_strict_input", []() {
+    return sr::strict_input.load();
+  }, "Get whether implicit copies of input data raise a `ValueError`.");
+
+  m.def("get_stats", []() {
+    return sr::global_stats.to_dict();
+  }, R"doc(
+Get the performance counters of `resample` and `resample_batch`.
 
-  m.def("set_gil_release_threshold", [](long threshold) {
-    gil_release_threshold_frames = threshold;
-  }, "Set the minimum number of frames required to release the GIL in 'auto' mode.");
+Returns a dict with the number of `calls`, the `input_frames` used and
+`output_frames` generated, the total and longest time spent converting
+(`process_ns`, `max_process_ns`) and the number of conversions run with the
+GIL released (`gil_released`) or held (`gil_held`). `Resampler.stats()` and
+`CallbackResampler.stats()` return the same counters per instance.
+)doc");
+
+  m.def("reset_stats", []() {
+    sr::global_stats.reset();
+  }, "Reset the performance counters of `resample` and `resample_batch`.");
+
+  m.def("benchmark", &sr::benchmark, R"doc(
+Measure the overhead of the bindings on top of the converters.
+
+For each converter type, channel count and block size, times a block of
+white noise through the bare converter (`native_ns`, as `src_process`) and
+through `resample` with float32 and float64 input (`resample_ns`,
+`resample_float64_ns`, which include allocation, conversion and flushing),
+`Resampler.process` with the GIL kept or released (`process_ns`,
+`process_release_gil_ns`) and `Resampler.process_into` (`process_into_ns`).
+Times are the best per call time over 3 runs, in nanoseconds.
 
-  m.def("get_gil_release_threshold", []() {
-    return gil_release_threshold_frames;
-  }, "Get the minimum number of frames required to release the GIL in 'auto' mode.");
+Parameters
+----------
+converter_types : sequence of ConverterType, str, or int, or None
+    Converters to measure, all by default.
+channels : sequence of int
+    Channel counts (default: 1 and 2).
+block_frames : sequence of int
+    Block sizes in frames (default: 64, 512 and 4096).
+ratio : float
+    Conversion ratio (default: 48000 / 44100).
+min_time : float
+    Minimum duration of each timing run, in seconds (default: 0.05).
+as_json : bool
+    Return the report as a JSON string rather than a dict.
+
+Returns
+-------
+report : dict or str
+    `build_info`, `ratio`, `min_time` and one `results` entry per
+    measurement, with `overhead_ns` = `process_ns` - `native_ns`.
+)doc", "converter_types"_a = py::none(),
+        "channels"_a = std::vector<int>{1, 2},
+        "block_frames"_a = std::vector<long>{64, 512, 4096},
+        "ratio"_a = 48000.0 / 44100.0, "min_time"_a = 0.05,
+        "as_json"_a = false);
 
   m.def("get_build_info", []() {
     py::dict info;
@@ -635,7 +7688,23 @@ PYBIND11_MODULE(samplerate, m) {
     info["pointer_size_bits"] = sizeof(void*) * 8;
     // Float size sanity check
     info["float_size_bytes"] = sizeof(float);
-    info["gil_release_threshold"] = gil_release_threshold_frames;
+    info["gil_release_threshold"] = gil_release_threshold_frames.load();
+    py::dict thresholds;
+    for (int type = 0; type < NUM_CONVERTER_TYPES; ++type)
+      thresholds[sr::converter_type_names[type]] =
+          sr::gil_release_threshold(type, 0);
+    info["gil_release_thresholds"] = thresholds;
+    info["simd_isa"] = sr::simd_isa_names[static_cast<int>(sr::kernels.isa)];
+    py::list isas;
+    for (auto isa : sr::available_simd_isas())
+      isas.append(sr::simd_isa_names[static_cast<int>(isa)]);
+    info["simd_isas"] = isas;
+    info["sinc_isa"] = sr::sinc_avx2_selected() ? "avx2" : "baseline";
+#ifdef Py_GIL_DISABLED
+    info["free_threaded"] = true;
+#else
+    info["free_threaded"] = false;
+#endif
     return info;
   }, R"doc(
 Get detailed build information for debugging purposes.
@@ -658,6 +7727,14 @@ dict
     - pointer_size_bits: Pointer size (32 or 64)
     - float_size_bytes: Size of float type (should be 4)
     - gil_release_threshold: Current GIL release threshold
+    - gil_release_thresholds: GIL release threshold of each converter type
+    - simd_isa: Instruction set of the kernels in use (scalar, sse, neon,
+      avx2 or avx512), see the SAMPLERATE_SIMD environment variable
+    - simd_isas: Instruction sets with kernels supported by this CPU
+    - sinc_isa: Build of the sinc converters in use, avx2 with the AVX2 or
+      AVX-512 kernels on x86 builds, baseline otherwise
+    - free_threaded: Whether the module was built for a free-threaded
+      (GIL-free) Python, where it does not enable the GIL on import
 )doc");
 
   auto m_exceptions = m.def_submodule(
@@ -672,101 +7749,759 @@ dict
       "Convert python object to integer of converter tpe or raise an error "
       "if illegal");
 
-  m_internals.def(
-      "error_handler", &sr::error_handler,
-      "A function to translate libsamplerate error codes into exceptions");
+  m_internals.def(
+      "error_handler", &sr::error_handler,
+      "A function to translate libsamplerate error codes into exceptions");
+
+  py::register_exception<sr::ResamplingException>(
+      m_exceptions, "ResamplingError", PyExc_RuntimeError);
+
+  py::class_<sr::PostProcess>(m_converters, "PostProcess", R"mydelimiter(
+    Gain, channel mapping and downmix applied to the resampled frames.
+
+    Pass it as the `post` argument of `resample`, `Resampler.process` or
+    `CallbackResampler.read` to get the output in its final form from the
+    native output loop, without extra passes over the output in numpy. The
+    gain is applied first, then `channel_map` picks the output channels and
+    `downmix` averages them to one channel. For integer outputs the mixed
+    samples are rounded and saturated in the same pass.
+
+    Parameters
+    ----------
+    gain : float or sequence of float
+        Linear gain of all channels (default: 1.0), or one gain per input
+        channel.
+    channel_map : sequence of int or None
+        Input channel of each output channel, e.g. `[1, 0]` to swap a stereo
+        pair or `[0]` to keep the left channel only. Channels can be repeated
+        or left out. `None` (default) keeps all channels in order.
+    downmix : bool
+        If `True`, average the (mapped) channels to a single output channel
+        of shape (`num_frames`, 1), or (`num_frames`,) for 1D input.
+  )mydelimiter")
+      .def(py::init<const py::object &, const py::object &, bool>(),
+           "gain"_a = 1.0, "channel_map"_a = py::none(), "downmix"_a = false)
+      .def_property_readonly(
+          "gain", [](const sr::PostProcess &p) { return p.gain; },
+          "Gain of all channels, or of each input channel.")
+      .def_property_readonly(
+          "channel_map",
+          [](const sr::PostProcess &p) -> py::object {
+            if (p.channel_map.empty()) return py::none();
+            return py::cast(p.channel_map);
+          },
+          "Input channel of each output channel, or None for all channels.")
+      .def_readonly("downmix", &sr::PostProcess::downmix,
+                    "Whether the channels are averaged to one.");
+
+  m_converters.def("resample", &sr::resample, R"mydelimiter(
+    Resample the signal in `input_data` at once.
+
+    Parameters
+    ----------
+    input_data : ndarray
+        Input data.
+        Input data with one or more channels is represented as a 2D array of shape
+        (`num_frames`, `num_channels`).
+        A single channel can be provided as a 1D array of `num_frames` length.
+        Any object exposing the buffer protocol or DLPack is accepted. 32-bit
+        float, 16-bit and 32-bit integer inputs are read in place, whatever
+        their strides, and integer samples keep their values; other inputs
+        are converted to 32-bit float first (see `set_strict_input`).
+    ratio : float
+        Conversion ratio = output sample rate / input sample rate.
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    verbose : bool
+        If `True`, print additional information about the conversion.
+    release_gil : bool, str, or None
+        Controls GIL release during resampling for multi-threading:
+        - `None` or `"auto"` (default): Release GIL only for at least
+          `get_gil_release_threshold()` frames of the converter type and channel
+          count (see `calibrate_gil_thresholds`)
+        - `True`: Always release GIL (best for multi-threaded applications)
+        - `False`: Never release GIL (best for single-threaded, small data)
+        The GIL is always released when converting in parallel.
+    num_threads : int or None
+        Number of threads converting in parallel, the calling thread included.
+        Use 0 for one thread per CPU core, or `None` (default) for the value
+        set with `set_num_threads` (initially 1). Signals with at least as
+        many channels as threads are converted as groups of channels. Longer
+        signals (>= 16384 frames per thread) with fewer channels are split into
+        overlapping segments on the time axis instead, if the ratio is a
+        rational number p / q with a small q (such as 48000 / 44100). The
+        stitched result matches the sequential conversion to within float
+        rounding (about 1e-6 for full scale signals).
+    layout : str
+        Memory layout of 2D `input_data` and of the output: `"interleaved"`
+        (default) for shape (`num_frames`, `num_channels`), or `"planar"` for
+        shape (`num_channels`, `num_frames`).
+    dtype : str or numpy.dtype
+        Data type of the output: `float32` (default), `int16` or `int32`.
+        Integer outputs are rounded and saturated from the float samples,
+        without scaling, so integer PCM input converts back to the same
+        range.
+    post : PostProcess or None
+        Gain, channel mapping and downmix applied to the output (default:
+        `None`), see `PostProcess`.
+
+    Returns
+    -------
+    output_data : ndarray
+        Resampled input data.
+
+    Note
+    ----
+    If samples are to be processed in chunks, `Resampler` and
+    `CallbackResampler` will provide better results and allow for variable
+    conversion ratios.
+  )mydelimiter",
+                   "input"_a, "ratio"_a, "converter_type"_a = "sinc_best",
+                   "verbose"_a = false, "release_gil"_a = py::none(),
+                   "num_threads"_a = py::none(), "layout"_a = "interleaved",
+                   "dtype"_a = "float32", "post"_a = py::none());
+
+  m_converters.def("resample_async", &sr::resample_async, R"mydelimiter(
+    Resample the signal in `input_data` at once, on a native worker thread.
+
+    Must be called from a coroutine or callback of the running asyncio event
+    loop. The input is checked and the output allocated right away, then the
+    conversion runs on the internal thread pool without the GIL, and the
+    returned future is completed on the event loop with a single
+    `call_soon_threadsafe`, without any executor or Python thread:
+
+        output = await samplerate.resample_async(data, ratio, 'sinc_fastest')
+
+    Parameters
+    ----------
+    input_data : ndarray
+        Input data, as for `resample`. It must not be modified until the
+        future is done.
+    ratio : float
+        Conversion ratio = output sample rate / input sample rate.
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    num_threads : int or None
+        Number of threads converting in parallel, as for `resample`.
+    layout : str
+        Memory layout of 2D `input_data` and of the output, as for `resample`.
+    dtype : str or numpy.dtype
+        Data type of the output, as for `resample`.
+
+    Returns
+    -------
+    future : asyncio.Future
+        Future of the resampled input data.
+    )mydelimiter",
+                   "input"_a, "ratio"_a, "converter_type"_a = "sinc_best",
+                   "num_threads"_a = py::none(), "layout"_a = "interleaved",
+                   "dtype"_a = "float32");
+
+  m_converters.def("resample_batch", &sr::resample_batch, R"mydelimiter(
+    Resample each signal in `inputs` at once, in a single call.
+
+    All inputs are validated and all outputs are allocated before the
+    conversions start, so the GIL is released only once for the whole batch.
+
+    Parameters
+    ----------
+    inputs : list of ndarray
+        Input signals, each represented as for `resample`. The signals may
+        have different lengths and numbers of channels.
+    ratio : float or sequence of float
+        Conversion ratio = output sample rate / input sample rate, either one
+        for all inputs or one per input.
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    num_threads : int or None
+        Number of threads converting the inputs in parallel, the calling
+        thread included. Use 0 for one thread per CPU core, or `None`
+        (default) for the value set with `set_num_threads` (initially 1).
+    release_gil : bool, str, or None
+        Controls GIL release during resampling for multi-threading:
+        - `None` or `"auto"` (default): Release GIL only when the frames in total
+          reach `get_gil_release_threshold()` for the converter type and channel
+          count (see `calibrate_gil_thresholds`), or when `num_threads` is not 1
+        - `True`: Always release GIL (best for multi-threaded applications)
+        - `False`: Never release GIL, unless `num_threads` is not 1
+
+    Returns
+    -------
+    output_data : list of ndarray
+        Resampled input signals, in the order of `inputs`.
+  )mydelimiter",
+                   "inputs"_a, "ratio"_a, "converter_type"_a = "sinc_best",
+                   "num_threads"_a = py::none(), "release_gil"_a = py::none());
+
+  m_converters.def("resample_multi", &sr::resample_multi, R"mydelimiter(
+    Resample the signal in `input_data` to several conversion ratios at once.
+
+    The input is validated and converted to 32-bit float only once, and
+    shared by the conversions to all ratios, which run in a single call.
+
+    Parameters
+    ----------
+    input_data : ndarray
+        Input data, as for `resample`.
+    ratios : sequence of float
+        Conversion ratios = output sample rate / input sample rate.
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    num_threads : int or None
+        Number of threads converting in parallel, the calling thread included,
+        shared among the ratios first. Use 0 for one thread per CPU core, or
+        `None` (default) for the value set with `set_num_threads` (initially 1).
+    release_gil : bool, str, or None
+        Controls GIL release during resampling for multi-threading:
+        - `None` or `"auto"` (default): Release GIL only when the frames over all
+          ratios reach `get_gil_release_threshold()` for the converter type and
+          channel count (see `calibrate_gil_thresholds`), or when `num_threads`
+          is not 1
+        - `True`: Always release GIL (best for multi-threaded applications)
+        - `False`: Never release GIL, unless `num_threads` is not 1
+
+    Returns
+    -------
+    output_data : list of ndarray
+        Resampled signals, one per ratio, in the order of `ratios`. Each is
+        the same as `resample(input_data, ratio, converter_type)`.
+  )mydelimiter",
+                   "input"_a, "ratios"_a, "converter_type"_a = "sinc_best",
+                   "num_threads"_a = py::none(), "release_gil"_a = py::none());
+
+  m_converters.def("resample_file", &sr::resample_file, R"mydelimiter(
+    Resample a WAV or raw PCM file into another file with bounded memory.
+
+    The input is memory-mapped and streamed through one converter in blocks
+    of `block_frames` frames, the output is written block by block. Memory
+    use depends on the block size, not on the file size, and the GIL is
+    released for the whole conversion.
+
+    Parameters
+    ----------
+    src_path : str or os.PathLike
+        Input file. A WAV file with 16 or 32-bit integer or 32-bit float
+        samples, or raw interleaved samples in native byte order.
+    dst_path : str or os.PathLike
+        Output file, overwritten. It has the format of the input: a WAV file
+        at the converted sample rate, or raw samples.
+    ratio : float
+        Conversion ratio = output sample rate / input sample rate.
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    channels : int or None
+        Number of channels of a raw input (default: 1). Read from the header
+        of a WAV input, and checked against it if given.
+    dtype : numpy dtype or None
+        Sample type of a raw input, float32 (default), int16 or int32. Read
+        from the header of a WAV input, and checked against it if given.
+    block_frames : int
+        Input frames converted per step (default: 8192).
+
+    Returns
+    -------
+    output_frames : int
+        Number of frames written.
+  )mydelimiter",
+                   "src_path"_a, "dst_path"_a, "ratio"_a,
+                   "converter_type"_a = "sinc_best", "channels"_a = py::none(),
+                   "dtype"_a = py::none(),
+                   "block_frames"_a = FILE_BLOCK_FRAMES);
+
+  py::class_<sr::ResamplerSnapshot>(m_converters, "ResamplerSnapshot",
+                                    R"mydelimiter(
+    State of a `Resampler` saved by `Resampler.snapshot`.
+
+    Create one up front and pass it as `into` to reuse its buffers on every
+    snapshot. Every converter copies its filter history and position into
+    it. Snapshots can be pickled.
+  )mydelimiter")
+      .def(py::init<>())
+      .def(py::pickle(
+          [](const sr::ResamplerSnapshot &saved) { return saved.serialize(); },
+          [](const py::bytes &serialized) {
+            sr::ResamplerSnapshot saved;
+            saved.deserialize(serialized);
+            return saved;
+          }));
+
+  py::class_<sr::CallbackResamplerSnapshot>(
+      m_converters, "CallbackResamplerSnapshot", R"mydelimiter(
+    State of a `CallbackResampler` saved by `CallbackResampler.snapshot`,
+    with the input left over from the last read.
+
+    Create one up front and pass it as `into` to reuse its buffers on every
+    snapshot. Snapshots can be pickled.
+  )mydelimiter")
+      .def(py::init<>())
+      .def(py::pickle(
+          [](const sr::CallbackResamplerSnapshot &saved) {
+            return saved.serialize();
+          },
+          [](const py::bytes &serialized) {
+            sr::CallbackResamplerSnapshot saved;
+            saved.deserialize(serialized);
+            return saved;
+          }));
+
+  py::class_<sr::Resampler>(m_converters, "Resampler", R"mydelimiter(
+    Resampler.
+
+    Parameters
+    ----------
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`), or `"adaptive"` to step
+        between `sinc_best`, `sinc_medium` and `sinc_fastest` to keep each
+        `process` call within `budget_us`.
+    num_channels : int
+        Number of channels.
+    num_threads : int or None
+        Number of threads converting groups of channels in parallel, the
+        calling thread included. Each group of channels gets its own converter
+        state. Use 0 for one thread per CPU core, or `None` (default) for the
+        value set with `set_num_threads` (initially 1). The GIL is always
+        released when channels are converted in parallel.
+    budget_us : float or None
+        Time budget of one call in microseconds, required by and only used
+        with `converter_type="adaptive"`. The resampler starts with
+        `sinc_best`, steps down to a faster converter while the moving
+        average of the time spent converting exceeds the budget, and back up
+        when it stays under a quarter of it, 32 calls after a switch at the
+        earliest. Each switch
+        crossfades from the previous converter to the next one over 256
+        output frames, started on the recent input so both line up, and the
+        stream latency follows the converter in use (see `latency_frames`),
+        so the call after a switch returns a few frames more or less.
+        `converter_type` and `stats()` report the converter in use.
+    silence_threshold : float or None
+        Enable the silence fast path (default: `None`, disabled). Input
+        blocks whose samples are all within `silence_threshold` in magnitude,
+        e.g. 0.0 for digital silence, skip the converter once its filter
+        history is silent too, and are replaced by the zero frames they would
+        have produced. With a conversion ratio p / q of small integers (q up
+        to 1024, e.g. 48000 / 44100) the output is the same as without the
+        fast path, up to the quiet samples set to zero. With other ratios,
+        the signal after a silence may be shifted by less than one frame.
+        `stats()` reports the `silent_frames` skipped.
+  )mydelimiter")
+      .def(py::init<const py::object &, int, const py::object &,
+                    const py::object &, const py::object &>(),
+           "converter_type"_a = "sinc_best", "channels"_a = 1,
+           "num_threads"_a = py::none(), "budget_us"_a = py::none(),
+           "silence_threshold"_a = py::none())
+      .def(py::init([](const sr::Resampler &r) { return r.clone(); }))
+      .def("process", &sr::Resampler::process, R"mydelimiter(
+        Resample the signal in `input_data`.
+
+        Parameters
+        ----------
+        input_data : ndarray
+            Input data.
+            Input data with one or more channels is represented as a 2D array of shape
+            (`num_frames`, `num_channels`).
+            A single channel can be provided as a 1D array of `num_frames` length.
+            Any object exposing the buffer protocol or DLPack is accepted. 32-bit
+            float, 16-bit and 32-bit integer inputs are read in place, whatever
+            their strides, and integer samples keep their values; other inputs
+            are converted to 32-bit float first (see `set_strict_input`).
+        ratio : float, (float, float), or ndarray
+            Conversion ratio = output sample rate / input sample rate. A
+            `(start, end)` pair ramps the ratio linearly from `start` at the
+            first input frame to `end` at the last one. An array of shape
+            (`num_breakpoints`, 2) of (`frame_offset`, `ratio`) rows, with
+            offsets counted in input frames from the first frame of this call,
+            interpolates linearly between the breakpoints. Schedules start at
+            their first ratio and are followed in steps of 128 output frames,
+            over which `libsamplerate` ramps smoothly.
+        end_of_input : int
+            Set to `True` if no more data is available, or to `False` otherwise.
+        release_gil : bool, str, or None
+            Controls GIL release during resampling for multi-threading:
+            - `None` or `"auto"` (default): Release GIL only for at least
+              `get_gil_release_threshold()` frames of the converter type and channel
+              count (see `calibrate_gil_thresholds`)
+            - `True`: Always release GIL (best for multi-threaded applications)
+            - `False`: Never release GIL (best for single-threaded, small data)
+        layout : str
+            Memory layout of 2D `input_data` and of the output: `"interleaved"`
+            (default) for shape (`num_frames`, `num_channels`), or `"planar"` for
+            shape (`num_channels`, `num_frames`).
+        dtype : str or numpy.dtype
+            Data type of the output: `float32` (default), `int16` or `int32`.
+            Integer outputs are rounded and saturated from the float samples,
+            without scaling, and converted in small chunks.
+        post : PostProcess or None
+            Gain, channel mapping and downmix applied to the output (default:
+            `None`), see `PostProcess`.
+
+        Returns
+        -------
+        output_data : ndarray
+            Resampled input data.
+      )mydelimiter",
+           "input"_a, "ratio"_a, "end_of_input"_a = false, "release_gil"_a = py::none(),
+           "layout"_a = "interleaved", "dtype"_a = "float32",
+           "post"_a = py::none())
+      .def("process_into", &sr::Resampler::process_into, R"mydelimiter(
+        Resample the signal in `input_data` into a preallocated output array.
+
+        Parameters
+        ----------
+        input_data : ndarray
+            Input data, as for `process`.
+        out : ndarray
+            Writable, C-contiguous 32-bit float array receiving the resampled
+            frames, of shape (`max_frames`, `num_channels`), or (`max_frames`,)
+            for a single channel. It is never copied or converted.
+        ratio : float, (float, float), or ndarray
+            Conversion ratio or ratio schedule, as for `process`.
+        end_of_input : int
+            Set to `True` if no more data is available, or to `False` otherwise.
+        release_gil : bool, str, or None
+            Controls GIL release during resampling for multi-threading:
+            - `None` or `"auto"` (default): Release GIL only for at least
+              `get_gil_release_threshold()` frames of the converter type and channel
+              count (see `calibrate_gil_thresholds`)
+            - `True`: Always release GIL (best for multi-threaded applications)
+            - `False`: Never release GIL (best for single-threaded, small data)
+
+        Returns
+        -------
+        (output_frames_gen, input_frames_used) : tuple of int
+            Number of frames written to `out` and number of input frames
+            consumed. If `out` is too small, not all input frames are used and
+            the remaining frames should be passed again on the next call.
+      )mydelimiter",
+           "input"_a, "out"_a.noconvert(), "ratio"_a, "end_of_input"_a = false,
+           "release_gil"_a = py::none())
+      .def("process_async",
+           [](const py::object &self, const py::object &input,
+              const py::object &ratio, bool end_of_input,
+              const std::string &layout, const py::object &dtype) {
+             return self.cast<sr::Resampler &>().process_async(
+                 self, input, ratio, end_of_input, layout, dtype);
+           },
+           R"mydelimiter(
+        Resample the signal in `input_data` on a native worker thread.
+
+        Must be called from a coroutine or callback of the running asyncio event
+        loop. The conversion runs on the internal thread pool without the GIL,
+        after the earlier asynchronous calls of this resampler, and the returned
+        future is completed on the event loop, so many streams can be resampled
+        concurrently without an executor:
+
+            output = await resampler.process_async(block, ratio)
+
+        Synchronous methods that change the resampler state raise a
+        `RuntimeError` while asynchronous calls are still converting.
+
+        Parameters
+        ----------
+        input_data : ndarray
+            Input data, as for `process`. It must not be modified until the
+            future is done.
+        ratio : float, (float, float), or ndarray
+            Conversion ratio or ratio schedule, as for `process`.
+        end_of_input : int
+            Set to `True` if no more data is available, or to `False` otherwise.
+        layout : str
+            Memory layout of 2D `input_data` and of the output, as for `process`.
+        dtype : str or numpy.dtype
+            Data type of the output, as for `process`.
+
+        Returns
+        -------
+        future : asyncio.Future
+            Future of the resampled input data.
+      )mydelimiter",
+           "input"_a, "ratio"_a, "end_of_input"_a = false,
+           "layout"_a = "interleaved", "dtype"_a = "float32")
+      .def("max_output_frames", &sr::Resampler::max_output_frames,
+           R"mydelimiter(
+        Upper bound on the number of frames the next `process` call can return.
+
+        The bound is computed from the conversion ratio, the ratio of the
+        previous call, the filter length of the converter, and whether the
+        call flushes the end of input. Use it to size the output buffers
+        passed to `process_into`.
+
+        Parameters
+        ----------
+        num_frames : int
+            Number of input frames.
+        ratio : float
+            Conversion ratio = output sample rate / input sample rate.
+        end_of_input : bool
+            Set to `True` if the call will flush the end of input.
+
+        Returns
+        -------
+        max_frames : int
+            Maximum number of output frames.
+      )mydelimiter",
+           "num_frames"_a, "ratio"_a, "end_of_input"_a = false)
+      .def("latency_frames", &sr::Resampler::latency_frames,
+           R"mydelimiter(
+        Number of input frames the converter holds back at `ratio`.
+
+        This is the lookahead of the filter: while a stream starts, `process`
+        returns that many input frames' worth of output less than its share,
+        and the output lags the input by as much afterwards. It is measured
+        on a fresh converter, for the converter type and the ratio.
+
+        Parameters
+        ----------
+        ratio : float
+            Conversion ratio = output sample rate / input sample rate.
+
+        Returns
+        -------
+        latency_frames : int
+            Latency in input frames, `latency_frames * ratio` in output
+            frames.
+      )mydelimiter",
+           "ratio"_a)
+      .def("prime", &sr::Resampler::prime, R"mydelimiter(
+        Fill the filter history with silence.
+
+        Feeds `num_frames` frames of silence and drops their output, so that
+        from the first `process` call on each block returns its full share of
+        output frames, starting with the silence. Call it at stream start or
+        after `reset`.
+
+        Parameters
+        ----------
+        ratio : float
+            Conversion ratio of the stream.
+        num_frames : int or None
+            Number of silent input frames, or `None` (default) for
+            `latency_frames(ratio)`.
+
+        Returns
+        -------
+        num_frames : int
+            Number of silent frames fed.
+      )mydelimiter",
+           "ratio"_a, "num_frames"_a = py::none())
+      .def("reset", &sr::Resampler::reset, "Reset internal state.")
+      .def("set_ratio", &sr::Resampler::set_ratio,
+           "Set a new conversion ratio immediately.")
+      .def("clone", &sr::Resampler::clone,
+           "Creates a copy of the resampler object with the same internal "
+           "state.")
+      .def(
+          "snapshot",
+          [](const sr::Resampler &r, sr::ResamplerSnapshot *into) {
+            if (into != nullptr) {
+              r.snapshot(*into);
+              return py::cast(into, py::return_value_policy::reference);
+            }
+            sr::ResamplerSnapshot saved;
+            r.snapshot(saved);
+            return py::cast(std::move(saved));
+          },
+          R"mydelimiter(
+        Save the internal state, to go back to it with `restore`.
+
+        Unlike `clone`, no converter is created: the converters copy their
+        filter history and position into the buffers of the snapshot, which
+        are reused when it is passed as `into` again. The stats are not
+        saved.
+
+        Parameters
+        ----------
+        into : ResamplerSnapshot or None
+            Snapshot to overwrite (default: `None`, a new one).
+
+        Returns
+        -------
+        snapshot : ResamplerSnapshot
+            `into`, or the new snapshot.
+      )mydelimiter",
+          "into"_a = nullptr)
+      .def("restore", &sr::Resampler::restore, R"mydelimiter(
+        Go back to the internal state saved by `snapshot`.
+
+        The snapshot may come from any resampler of the same converter type,
+        channels and number of threads, and can be restored many times.
+
+        Parameters
+        ----------
+        snapshot : ResamplerSnapshot
+            The saved state.
+
+        Raises
+        ------
+        ValueError
+            If the snapshot is from another kind of resampler.
+      )mydelimiter",
+           "snapshot"_a)
+      .def(py::pickle(
+          [](const sr::Resampler &r) { return r.getstate(); },
+          [](const py::tuple &state) {
+            return sr::Resampler::setstate(state);
+          }))
+      .def("stats", &sr::Resampler::stats, R"mydelimiter(
+        Performance counters of this resampler, see `samplerate.get_stats`.
 
-  py::register_exception<sr::ResamplingException>(
-      m_exceptions, "ResamplingError", PyExc_RuntimeError);
+        `calls` counts `process` and `process_into` calls. Clones start with
+        zeroed counters. Adaptive resamplers also report the `converter_type`
+        in use and the number of `converter_switches`, and resamplers with a
+        `silence_threshold` the number of `silent_frames` of input that
+        skipped the converter.
+      )mydelimiter")
+      .def("reset_stats", &sr::Resampler::reset_stats,
+           "Reset the performance counters.")
+      .def_readonly("converter_type", &sr::Resampler::_converter_type,
+                    "Converter type, the one in use if adaptive.")
+      .def_property_readonly("budget_us", &sr::Resampler::budget_us,
+                             "Time budget of one call of an adaptive "
+                             "resampler, None otherwise.")
+      .def_property_readonly("silence_threshold",
+                             &sr::Resampler::silence_threshold,
+                             "Threshold of the silence fast path, None if "
+                             "disabled.")
+      .def_readonly("channels", &sr::Resampler::_channels,
+                    "Number of channels.")
+      .def_property_readonly("num_threads", &sr::Resampler::num_threads,
+                             "Number of groups of channels converted in "
+                             "parallel.");
 
-  m_converters.def("resample", &sr::resample, R"mydelimiter(
-    Resample the signal in `input_data` at once.
+  py::class_<sr::ResamplerBank>(m_converters, "ResamplerBank", R"mydelimiter(
+    Bank of independent streaming resamplers, stepped in a single call.
+
+    Each stream is a separate `Resampler`, with its own converter state,
+    statistics and silence skipping, allocated apart from the others. The
+    bank saves a Python call per stream: all streams are processed by one
+    native call, optionally on several threads.
 
     Parameters
     ----------
-    input_data : ndarray
-        Input data.
-        Input data with one or more channels is represented as a 2D array of shape
-        (`num_frames`, `num_channels`).
-        A single channel can be provided as a 1D array of `num_frames` length.
-        For use with `libsamplerate`, `input_data`
-        is converted to 32-bit float and C (row-major) memory order.
-    ratio : float
-        Conversion ratio = output sample rate / input sample rate.
+    num_streams : int
+        Number of streams.
     converter_type : ConverterType, str, or int
         Sample rate converter (default: `sinc_best`).
-    verbose : bool
-        If `True`, print additional information about the conversion.
-    release_gil : bool, str, or None
-        Controls GIL release during resampling for multi-threading:
-        - `None` or `"auto"` (default): Release GIL only for large data (>= 1000 frames)
-        - `True`: Always release GIL (best for multi-threaded applications)
-        - `False`: Never release GIL (best for single-threaded, small data)
+    channels : int
+        Number of channels of every stream.
+  )mydelimiter")
+      .def(py::init<size_t, const py::object &, int>(), "num_streams"_a,
+           "converter_type"_a = "sinc_best", "channels"_a = 1)
+      .def(py::init([](const sr::ResamplerBank &b) { return b.clone(); }))
+      .def("process", &sr::ResamplerBank::process, R"mydelimiter(
+        Resample one block of input data for every stream.
 
-    Returns
-    -------
-    output_data : ndarray
-        Resampled input data.
+        Parameters
+        ----------
+        inputs : ndarray or list of ndarray
+            Either a 3D array of shape (`num_streams`, `num_frames`,
+            `num_channels`), or a 2D array of shape (`num_streams`,
+            `num_frames`) for single channel streams, or a list with one input
+            array per stream, each represented as for `Resampler.process`.
+        ratio : float or sequence of float
+            Conversion ratio = output sample rate / input sample rate, either
+            one for all streams or one per stream.
+        end_of_input : bool
+            Set to `True` if no more data is available, or to `False` otherwise.
+        num_threads : int or None
+            Number of threads processing the streams in parallel, the calling
+            thread included. Use 0 for one thread per CPU core, or `None`
+            (default) for the value set with `set_num_threads` (initially 1).
+        release_gil : bool, str, or None
+            Controls GIL release during resampling for multi-threading:
+            - `None` or `"auto"` (default): Release GIL only when the frames in total
+              reach `get_gil_release_threshold()` for the converter type and channel
+              count (see `calibrate_gil_thresholds`), or when `num_threads` is not 1
+            - `True`: Always release GIL (best for multi-threaded applications)
+            - `False`: Never release GIL, unless `num_threads` is not 1
 
-    Note
-    ----
-    If samples are to be processed in chunks, `Resampler` and
-    `CallbackResampler` will provide better results and allow for variable
-    conversion ratios.
-  )mydelimiter",
-                   "input"_a, "ratio"_a, "converter_type"_a = "sinc_best",
-                   "verbose"_a = false, "release_gil"_a = py::none());
+        Returns
+        -------
+        output_data : list of ndarray
+            Resampled data of every stream. Streams may generate different
+            numbers of frames.
+      )mydelimiter",
+           "inputs"_a, "ratio"_a, "end_of_input"_a = false,
+           "num_threads"_a = py::none(), "release_gil"_a = py::none())
+      .def("reset", &sr::ResamplerBank::reset, "Reset the state of all streams.")
+      .def("reset_stream", &sr::ResamplerBank::reset_stream,
+           "Reset the state of a single stream.", "index"_a)
+      .def("set_ratio", &sr::ResamplerBank::set_ratio,
+           "Set new conversion ratios immediately, either one for all streams "
+           "or one per stream.")
+      .def("clone", &sr::ResamplerBank::clone,
+           "Creates a copy of the bank with the same internal state.")
+      .def("__len__", &sr::ResamplerBank::num_streams)
+      .def_property_readonly("num_streams", &sr::ResamplerBank::num_streams,
+                             "Number of streams.")
+      .def_readonly("converter_type", &sr::ResamplerBank::_converter_type,
+                    "Converter type.")
+      .def_readonly("channels", &sr::ResamplerBank::_channels,
+                    "Number of channels.");
 
-  py::class_<sr::Resampler>(m_converters, "Resampler", R"mydelimiter(
-    Resampler.
+  py::class_<sr::MultiRateResampler>(m_converters, "MultiRateResampler",
+                                     R"mydelimiter(
+    Streaming resampler converting one input to several conversion ratios.
+
+    Every input block is validated and converted to 32-bit float only once,
+    then resampled to all ratios by one native call, each ratio with its own
+    converter state, e.g. a 48 kHz capture to 44.1 kHz, 16 kHz and 8 kHz
+    outputs.
 
     Parameters
     ----------
+    ratios : sequence of float
+        Conversion ratios = output sample rate / input sample rate, one per
+        output.
     converter_type : ConverterType, str, or int
         Sample rate converter (default: `sinc_best`).
-    num_channels : int
+    channels : int
         Number of channels.
+    num_threads : int or None
+        Number of threads converting the outputs in parallel, the calling
+        thread included. Use 0 for one thread per CPU core, or `None`
+        (default) for the value set with `set_num_threads` (initially 1).
   )mydelimiter")
-      .def(py::init<const py::object &, int>(),
-           "converter_type"_a = "sinc_best", "channels"_a = 1)
-      .def(py::init<sr::Resampler>())
-      .def("process", &sr::Resampler::process, R"mydelimiter(
-        Resample the signal in `input_data`.
+      .def(py::init<const std::vector<double> &, const py::object &, int,
+                    const py::object &>(),
+           "ratios"_a, "converter_type"_a = "sinc_best", "channels"_a = 1,
+           "num_threads"_a = py::none())
+      .def(py::init([](const sr::MultiRateResampler &r) { return r.clone(); }))
+      .def("process", &sr::MultiRateResampler::process, R"mydelimiter(
+        Resample one block of input data to every ratio.
 
         Parameters
         ----------
         input_data : ndarray
-            Input data.
-            Input data with one or more channels is represented as a 2D array of shape
-            (`num_frames`, `num_channels`).
-            A single channel can be provided as a 1D array of `num_frames` length.
-            For use with `libsamplerate`, `input_data` is converted to 32-bit float and
-            C (row-major) memory order.
-        ratio : float
-            Conversion ratio = output sample rate / input sample rate.
-        end_of_input : int
+            Input data, as for `Resampler.process`.
+        end_of_input : bool
             Set to `True` if no more data is available, or to `False` otherwise.
         release_gil : bool, str, or None
             Controls GIL release during resampling for multi-threading:
-            - `None` or `"auto"` (default): Release GIL only for large data (>= 1000 frames)
+            - `None` or `"auto"` (default): Release GIL only when the frames over all
+              outputs reach `get_gil_release_threshold()` for the converter type and
+              channel count (see `calibrate_gil_thresholds`), or when `num_threads`
+              is not 1
             - `True`: Always release GIL (best for multi-threaded applications)
-            - `False`: Never release GIL (best for single-threaded, small data)
+            - `False`: Never release GIL, unless `num_threads` is not 1
 
         Returns
         -------
-        output_data : ndarray
-            Resampled input data.
+        output_data : list of ndarray
+            Resampled data, one array per ratio, in the order of `ratios`.
       )mydelimiter",
-           "input"_a, "ratio"_a, "end_of_input"_a = false, "release_gil"_a = py::none())
-      .def("reset", &sr::Resampler::reset, "Reset internal state.")
-      .def("set_ratio", &sr::Resampler::set_ratio,
-           "Set a new conversion ratio immediately.")
-      .def("clone", &sr::Resampler::clone,
-           "Creates a copy of the resampler object with the same internal "
-           "state.")
-      .def_readonly("converter_type", &sr::Resampler::_converter_type,
+           "input"_a, "end_of_input"_a = false, "release_gil"_a = py::none())
+      .def("reset", &sr::MultiRateResampler::reset,
+           "Reset the state of all outputs.")
+      .def("set_ratios", &sr::MultiRateResampler::set_ratios,
+           "Set new conversion ratios immediately, one per output.", "ratios"_a)
+      .def("clone", &sr::MultiRateResampler::clone,
+           "Creates a copy of the resampler with the same internal state.")
+      .def("__len__", &sr::MultiRateResampler::num_outputs)
+      .def_property_readonly("ratios", &sr::MultiRateResampler::ratios,
+                             "Conversion ratios, one per output.")
+      .def_readonly("converter_type", &sr::MultiRateResampler::_converter_type,
                     "Converter type.")
-      .def_readonly("channels", &sr::Resampler::_channels,
+      .def_readonly("channels", &sr::MultiRateResampler::_channels,
                     "Number of channels.");
 
   py::class_<sr::CallbackResampler>(m_converters, "CallbackResampler",
@@ -788,11 +8523,23 @@ dict
         Sample rate converter.
     channels : int
         Number of channels.
+    prefetch : int
+        Number of input blocks fetched ahead (default: 0, disabled). If
+        positive, `callback` is called on a background thread that keeps up
+        to `prefetch` blocks ready, so reading does not wait for the GIL
+        and the callback. The thread stops when `callback` returns `None`
+        or fails, and restarts after `reset`.
+    silence_threshold : float or None
+        Enable the silence fast path (default: `None`, disabled), see
+        `Resampler`. It applies to whole input blocks returned by
+        `callback`.
     )mydelimiter")
-      .def(py::init<const callback_t &, double, const py::object &, int>(),
+      .def(py::init<const py::function &, double, const py::object &, int,
+                    int, const py::object &>(),
            "callback"_a, "ratio"_a, "converter_type"_a = "sinc_best",
-           "channels"_a = 1)
-      .def(py::init<sr::CallbackResampler>())
+           "channels"_a = 1, "prefetch"_a = 0,
+           "silence_threshold"_a = py::none())
+      .def(py::init([](const sr::CallbackResampler &r) { return r.clone(); }))
       .def("read", &sr::CallbackResampler::read, R"mydelimiter(
             Read a number of frames from the resampler.
 
@@ -802,9 +8549,19 @@ dict
                 Number of frames to read.
             release_gil : bool, str, or None
                 Controls GIL release during resampling for multi-threading:
-                - `None` or `"auto"` (default): Release GIL only for large data (>= 1000 frames)
+                - `None` or `"auto"` (default): Release GIL only for at least
+                  `get_gil_release_threshold()` frames of the converter type and channel
+                  count (see `calibrate_gil_thresholds`)
                 - `True`: Always release GIL (best for multi-threaded applications)
                 - `False`: Never release GIL (best for single-threaded, small data)
+            ratio : float, (float, float), ndarray, or None
+                New conversion ratio, or a schedule as for `Resampler.process`
+                with frame offsets counted in output frames of this call. The
+                last ratio reached is kept for the following reads. `None`
+                (default) keeps the current `ratio`.
+            post : PostProcess or None
+                Gain, channel mapping and downmix applied to the output
+                (default: `None`), see `PostProcess`.
 
             Returns
             -------
@@ -813,40 +8570,566 @@ dict
                 (`num_output_frames`,) array. Note that this may return fewer frames
                 than requested, for example when no more input is available.
            )mydelimiter",
-           "num_frames"_a, "release_gil"_a = py::none())
+           "num_frames"_a, "release_gil"_a = py::none(), "ratio"_a = py::none(),
+           "post"_a = py::none())
+      .def("read_into", &sr::CallbackResampler::read_into, R"mydelimiter(
+            Read frames from the resampler into a preallocated output array.
+
+            Parameters
+            ----------
+            out : ndarray
+                Writable, C-contiguous 32-bit float array of shape
+                (`num_frames`, `num_channels`), or (`num_frames`,) for a single
+                channel. Up to `num_frames` frames are read. It is never copied
+                or converted.
+            release_gil : bool, str, or None
+                Controls GIL release during resampling for multi-threading:
+                - `None` or `"auto"` (default): Release GIL only for at least
+                  `get_gil_release_threshold()` frames of the converter type and channel
+                  count (see `calibrate_gil_thresholds`)
+                - `True`: Always release GIL (best for multi-threaded applications)
+                - `False`: Never release GIL (best for single-threaded, small data)
+            ratio : float, (float, float), ndarray, or None
+                Conversion ratio or ratio schedule, as for `read`.
+
+            Returns
+            -------
+            output_frames_gen : int
+                Number of frames written to `out`. This may be fewer than
+                requested, for example when no more input is available.
+           )mydelimiter",
+           "out"_a.noconvert(), "release_gil"_a = py::none(), "ratio"_a = py::none())
+      .def("read_async",
+           [](const py::object &self, size_t frames, const py::object &ratio) {
+             return self.cast<sr::CallbackResampler &>().read_async(
+                 self, frames, ratio);
+           },
+           R"mydelimiter(
+            Read a number of frames on a native worker thread.
+
+            Must be called from a coroutine or callback of the running asyncio
+            event loop. The read runs on the internal thread pool after the
+            earlier asynchronous reads of this resampler, and the returned future
+            is completed on the event loop. The callback is called from the worker
+            thread, with the GIL held, so it must not use the event loop:
+
+                output = await resampler.read_async(num_frames)
+
+            Synchronous methods raise a `RuntimeError` while asynchronous reads
+            are still running.
+
+            Parameters
+            ----------
+            num_frames : int
+                Number of frames to read.
+            ratio : float, (float, float), ndarray, or None
+                Conversion ratio or ratio schedule, as for `read`.
+
+            Returns
+            -------
+            future : asyncio.Future
+                Future of the resampled frames, as returned by `read`.
+           )mydelimiter",
+           "num_frames"_a, "ratio"_a = py::none())
       .def("reset", &sr::CallbackResampler::reset, "Reset state.")
       .def("set_starting_ratio", &sr::CallbackResampler::set_starting_ratio,
            "Set the starting conversion ratio for the next `read` call.")
+      .def("latency_frames", &sr::CallbackResampler::latency_frames,
+           R"mydelimiter(
+        Number of input frames the converter holds back, see
+        `Resampler.latency_frames`.
+
+        While a stream starts, reads pull that many input frames from the
+        callback more than their share.
+
+        Parameters
+        ----------
+        ratio : float or None
+            Conversion ratio, or `None` (default) for the current `ratio`.
+
+        Returns
+        -------
+        latency_frames : int
+            Latency in input frames.
+      )mydelimiter",
+           "ratio"_a = py::none())
+      .def("prime", &sr::CallbackResampler::prime, R"mydelimiter(
+        Queue silence to fill the filter history.
+
+        The silent frames are fed to the converter before the next block of
+        the callback, so that reads pull input at a steady rate from the
+        first one on, starting with the silence. Call it at stream start or
+        after `reset`.
+
+        Parameters
+        ----------
+        num_frames : int or None
+            Number of silent input frames, or `None` (default) for
+            `latency_frames()`.
+
+        Returns
+        -------
+        num_frames : int
+            Number of silent frames queued.
+      )mydelimiter",
+           "num_frames"_a = py::none())
       .def("clone", &sr::CallbackResampler::clone,
            "Create a copy of the resampler object.")
+      .def(
+          "snapshot",
+          [](sr::CallbackResampler &r, sr::CallbackResamplerSnapshot *into) {
+            if (into != nullptr) {
+              r.snapshot(*into);
+              return py::cast(into, py::return_value_policy::reference);
+            }
+            sr::CallbackResamplerSnapshot saved;
+            r.snapshot(saved);
+            return py::cast(std::move(saved));
+          },
+          R"mydelimiter(
+        Save the internal state, to go back to it with `restore`.
+
+        The state includes the input left over from the last read, copied
+        into the buffers of the snapshot, which are reused when it is passed
+        as `into` again. The callback is not rewound by `restore`: the blocks
+        it returned before, or fetched ahead with `prefetch`, are not part of
+        the snapshot.
+
+        Parameters
+        ----------
+        into : CallbackResamplerSnapshot or None
+            Snapshot to overwrite (default: `None`, a new one).
+
+        Returns
+        -------
+        snapshot : CallbackResamplerSnapshot
+            `into`, or the new snapshot.
+      )mydelimiter",
+          "into"_a = nullptr)
+      .def("restore", &sr::CallbackResampler::restore, R"mydelimiter(
+        Go back to the internal state saved by `snapshot`.
+
+        Parameters
+        ----------
+        snapshot : CallbackResamplerSnapshot
+            The state saved by a resampler of the same converter type and
+            channels.
+
+        Raises
+        ------
+        ValueError
+            If the snapshot is from another kind of resampler.
+      )mydelimiter",
+           "snapshot"_a)
+      .def(py::pickle(
+          [](sr::CallbackResampler &r) { return r.getstate(); },
+          [](const py::tuple &state) {
+            return sr::CallbackResampler::setstate(state);
+          }))
+      .def("stats", &sr::CallbackResampler::stats, R"mydelimiter(
+        Performance counters of this resampler, see `samplerate.get_stats`.
+
+        `calls` counts `read` and `read_into` calls, and `input_frames` the
+        frames returned by the callback. `callback_calls` and `callback_ns`
+        count the calls of the callback and the time spent in them, waiting
+        for the GIL included, which is not part of `process_ns`. Resamplers
+        with a `silence_threshold` also report the number of `silent_frames`
+        of input that skipped the converter.
+      )mydelimiter")
+      .def("reset_stats", &sr::CallbackResampler::reset_stats,
+           "Reset the performance counters.")
       .def("__enter__", &sr::CallbackResampler::__enter__,
            py::return_value_policy::reference_internal)
       .def("__exit__", &sr::CallbackResampler::__exit__)
-      .def_readwrite(
-          "ratio", &sr::CallbackResampler::_ratio,
+      .def_property(
+          "ratio", &sr::CallbackResampler::ratio,
+          &sr::CallbackResampler::set_ratio,
           "Conversion ratio = output sample rate / input sample rate.")
       .def_readonly("converter_type", &sr::CallbackResampler::_converter_type,
                     "Converter type.")
+      .def_property_readonly("silence_threshold",
+                             &sr::CallbackResampler::silence_threshold,
+                             "Threshold of the silence fast path, None if "
+                             "disabled.")
       .def_readonly("channels", &sr::CallbackResampler::_channels,
                     "Number of channels.");
 
+  py::class_<sr::SharedMemoryResampler>(m_converters, "SharedMemoryResampler",
+                                        R"mydelimiter(
+    Streaming resampler running in a separate worker process.
+
+    Input and output go through buffers in shared memory, so samples are
+    copied once each way instead of being pickled through a pipe, and the
+    worker converts natively with its own interpreter, outside the GIL of
+    this one. Each call waits for the worker on a futex (Linux), a named
+    event (Windows) or by polling, with the GIL released, so one orchestrator
+    can drive streams on all cores, e.g. with `process_async`. The output is
+    the same as that of a `Resampler` fed the same calls.
+
+    Parameters
+    ----------
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    channels : int
+        Number of channels.
+    capacity : int
+        Frames of the shared input and output buffers (default: 16384).
+        Longer inputs are converted in several round trips.
+    spawn : bool
+        Start the worker process, `sys.executable` running
+        `samplerate.run_shared_worker(name)` (default: `True`). Otherwise
+        start a worker for `name` yourself; calls wait until it attached.
+  )mydelimiter")
+      .def(py::init<const py::object &, int, long, bool>(),
+           "converter_type"_a = "sinc_best", "channels"_a = 1,
+           "capacity"_a = SHARED_CAPACITY_FRAMES, "spawn"_a = true)
+      .def("process", &sr::SharedMemoryResampler::process, R"mydelimiter(
+        Resample the signal in `input_data` in the worker process.
+
+        Parameters
+        ----------
+        input_data : ndarray
+            Input data, as for `Resampler.process`.
+        ratio : float
+            Conversion ratio = output sample rate / input sample rate.
+        end_of_input : int
+            Set to `True` if no more data is available, or to `False` otherwise.
+        layout : str
+            Memory layout of 2D `input_data` and of the output, as for
+            `Resampler.process`.
+        dtype : str or numpy.dtype
+            Data type of the output, as for `Resampler.process`.
+
+        Returns
+        -------
+        output_data : ndarray
+            Resampled input data.
+      )mydelimiter",
+           "input"_a, "ratio"_a, "end_of_input"_a = false,
+           "layout"_a = "interleaved", "dtype"_a = "float32")
+      .def("process_async",
+           [](const py::object &self, const py::object &input, double ratio,
+              bool end_of_input, const std::string &layout,
+              const py::object &dtype) {
+             return self.cast<sr::SharedMemoryResampler &>().process_async(
+                 self, input, ratio, end_of_input, layout, dtype);
+           },
+           R"mydelimiter(
+        Resample the signal in `input_data` in the worker process, returning
+        an asyncio future of the output.
+
+        Must be called from a coroutine or callback of the running asyncio
+        event loop. A thread of the internal pool waits for the worker, after
+        the earlier asynchronous calls of this resampler, so the streams of
+        many workers are converted concurrently. The arguments are those of
+        `process`, `input_data` must not be modified until the future is done.
+      )mydelimiter",
+           "input"_a, "ratio"_a, "end_of_input"_a = false,
+           "layout"_a = "interleaved", "dtype"_a = "float32")
+      .def("reset", &sr::SharedMemoryResampler::reset,
+           "Reset the internal state of the worker's resampler.")
+      .def("set_ratio", &sr::SharedMemoryResampler::set_ratio,
+           "Set a new conversion ratio immediately.")
+      .def("close", &sr::SharedMemoryResampler::close,
+           "Stop the worker process and free the shared memory.")
+      .def("__enter__", &sr::SharedMemoryResampler::__enter__,
+           py::return_value_policy::reference_internal)
+      .def("__exit__", &sr::SharedMemoryResampler::__exit__)
+      .def_readonly("name", &sr::SharedMemoryResampler::_name,
+                    "Name of the shared memory segment.")
+      .def_property_readonly("worker_pid",
+                             &sr::SharedMemoryResampler::worker_pid,
+                             "Process id of the worker, None until it "
+                             "attached or once closed.")
+      .def_readonly("converter_type",
+                    &sr::SharedMemoryResampler::_converter_type,
+                    "Converter type.")
+      .def_readonly("channels", &sr::SharedMemoryResampler::_channels,
+                    "Number of channels.")
+      .def_readonly("capacity", &sr::SharedMemoryResampler::_capacity,
+                    "Frames of the shared input and output buffers.");
+
+  m_converters.def("run_shared_worker", &sr::run_shared_worker,
+                   R"mydelimiter(
+    Serve the `SharedMemoryResampler` whose shared memory segment is `name`.
+
+    Runs the worker side of a `SharedMemoryResampler` created with
+    `spawn=False` in the calling process, with the GIL released, until the
+    resampler is closed or its process exits.
+
+    Parameters
+    ----------
+    name : str
+        `SharedMemoryResampler.name`.
+  )mydelimiter",
+                   "name"_a);
+
+  py::class_<sr::FixedBlockResampler>(m_converters, "FixedBlockResampler",
+                                      R"mydelimiter(
+    Resampler returning exactly `block_size` frames per call.
+
+    Output beyond the last complete block is queued internally and returned
+    by the following calls, so a render loop gets fixed size blocks without
+    accumulating them in Python.
+
+    Parameters
+    ----------
+    block_size : int
+        Number of output frames per block.
+    converter_type : ConverterType, str, or int
+        Sample rate converter (default: `sinc_best`).
+    channels : int
+        Number of channels (default: 1).
+    num_threads : int or None
+        Number of threads converting groups of channels in parallel, as for
+        `Resampler`.
+    )mydelimiter")
+      .def(py::init<size_t, const py::object &, int, const py::object &>(),
+           "block_size"_a, "converter_type"_a = "sinc_best", "channels"_a = 1,
+           "num_threads"_a = py::none())
+      .def("process", &sr::FixedBlockResampler::process, R"mydelimiter(
+        Resample `input_data` and return the next block of output.
+
+        Parameters
+        ----------
+        input_data : ndarray
+            Input data. Data with one or more channels is represented as a 2D
+            array of shape (`num_frames`, `num_channels`). A single channel
+            can be provided as a 1D array of `num_frames` length. It may be
+            empty to fetch queued blocks.
+        ratio : float
+            Conversion ratio = output sample rate / input sample rate.
+        end_of_input : bool
+            Set to `True` if no more data is available. The last partial
+            block is then padded with zeros.
+        release_gil : bool, str, or None
+            Controls GIL release during resampling for multi-threading:
+            - `None` or `"auto"` (default): Release GIL only for at least
+              `get_gil_release_threshold()` frames of the converter type and channel
+              count (see `calibrate_gil_thresholds`)
+            - `True`: Always release GIL (best for multi-threaded applications)
+            - `False`: Never release GIL (best for single-threaded, small data)
+
+        Returns
+        -------
+        output_data : ndarray or None
+            Exactly `block_size` resampled frames, or `None` if fewer are
+            available yet.
+      )mydelimiter",
+           "input"_a, "ratio"_a, "end_of_input"_a = false,
+           "release_gil"_a = py::none())
+      .def("process_into", &sr::FixedBlockResampler::process_into,
+           R"mydelimiter(
+        Resample `input_data` and write the next block into `out`.
+
+        Parameters
+        ----------
+        input_data : ndarray
+            Input data, as for `process`.
+        out : ndarray
+            Writable, C-contiguous 32-bit float array of shape
+            (`block_size`, `num_channels`), or (`block_size`,) for a single
+            channel. It is never copied or converted.
+        ratio : float
+            Conversion ratio = output sample rate / input sample rate.
+        end_of_input : bool
+            Set to `True` if no more data is available.
+        release_gil : bool, str, or None
+            Controls GIL release during resampling, as for `process`.
+
+        Returns
+        -------
+        written : bool
+            Whether a block was written to `out`.
+      )mydelimiter",
+           "input"_a, "out"_a.noconvert(), "ratio"_a, "end_of_input"_a = false,
+           "release_gil"_a = py::none())
+      .def("available", &sr::FixedBlockResampler::available,
+           "Number of queued output frames.")
+      .def("reset", &sr::FixedBlockResampler::reset,
+           "Reset internal state and drop the queued output.")
+      .def("set_ratio", &sr::FixedBlockResampler::set_ratio,
+           "Set a new conversion ratio immediately.")
+      .def_readonly("block_size", &sr::FixedBlockResampler::_block_size,
+                    "Number of output frames per block.")
+      .def_readonly("converter_type", &sr::FixedBlockResampler::_converter_type,
+                    "Converter type.")
+      .def_readonly("channels", &sr::FixedBlockResampler::_channels,
+                    "Number of channels.");
+
+  py::class_<sr::StreamResampler>(m_converters, "StreamResampler",
+                                  R"mydelimiter(
+    Resampler fed through an internal ring buffer.
+
+    A producer thread pushes input with `write` while a consumer thread pulls
+    resampled output with `read`. The ring buffer is lock-free for a single
+    producer and a single consumer, and the conversion runs on `read` without
+    calling back into Python.
+
+    Parameters
+    ----------
+    ratio : float
+        Conversion ratio = output sample rate / input sample rate.
+    converter_type : ConverterType, str, or int
+        Sample rate converter.
+    channels : int
+        Number of channels.
+    capacity : int
+        Size of the ring buffer in input frames.
+    )mydelimiter")
+      .def(py::init<double, const py::object &, size_t, size_t>(), "ratio"_a,
+           "converter_type"_a = "sinc_best", "channels"_a = 1,
+           "capacity"_a = 16384)
+      .def("write", &sr::StreamResampler::write, R"mydelimiter(
+            Append input frames to the ring buffer, producer side.
+
+            Parameters
+            ----------
+            input_data : ndarray
+                Input data. Data with one or more channels is represented as
+                a 2D array of shape (`num_frames`, `num_channels`). A single
+                channel can be provided as a 1D array of `num_frames` length.
+            end_of_input : bool
+                Set if this is the last block of input. Once all of it has been
+                written, `read` flushes the converter.
+            release_gil : bool, str, or None
+                Controls GIL release during the copy for multi-threading:
+                - `None` or `"auto"` (default): Release GIL only for at least
+                  `get_gil_release_threshold()` frames of the converter type and channel
+                  count (see `calibrate_gil_thresholds`)
+                - `True`: Always release GIL (best for multi-threaded applications)
+                - `False`: Never release GIL (best for single-threaded, small data)
+
+            Returns
+            -------
+            frames_written : int
+                Number of frames copied, fewer than given if the ring buffer
+                is full. Write the rest again later.
+           )mydelimiter",
+           "input_data"_a, "end_of_input"_a = false,
+           "release_gil"_a = py::none())
+      .def("read", &sr::StreamResampler::read, R"mydelimiter(
+            Resample up to a number of frames from the buffered input,
+            consumer side.
+
+            Parameters
+            ----------
+            num_frames : int
+                Number of frames to read.
+            release_gil : bool, str, or None
+                Controls GIL release during resampling for multi-threading:
+                - `None` or `"auto"` (default): Release GIL only for at least
+                  `get_gil_release_threshold()` frames of the converter type and channel
+                  count (see `calibrate_gil_thresholds`)
+                - `True`: Always release GIL (best for multi-threaded applications)
+                - `False`: Never release GIL (best for single-threaded, small data)
+
+            Returns
+            -------
+            output_data : ndarray
+                Resampled frames as a (`num_output_frames`, `num_channels`) or
+                (`num_output_frames`,) array. This returns fewer frames than
+                requested when the buffered input runs out.
+           )mydelimiter",
+           "num_frames"_a, "release_gil"_a = py::none())
+      .def("read_into", &sr::StreamResampler::read_into, R"mydelimiter(
+            Resample buffered input into a preallocated output array,
+            consumer side.
+
+            Parameters
+            ----------
+            out : ndarray
+                Writable, C-contiguous 32-bit float array of shape
+                (`num_frames`, `num_channels`), or (`num_frames`,) for a single
+                channel. It is never copied or converted.
+            release_gil : bool, str, or None
+                Controls GIL release during resampling for multi-threading:
+                - `None` or `"auto"` (default): Release GIL only for at least
+                  `get_gil_release_threshold()` frames of the converter type and channel
+                  count (see `calibrate_gil_thresholds`)
+                - `True`: Always release GIL (best for multi-threaded applications)
+                - `False`: Never release GIL (best for single-threaded, small data)
+
+            Returns
+            -------
+            output_frames_gen : int
+                Number of frames written to `out`.
+           )mydelimiter",
+           "out"_a.noconvert(), "release_gil"_a = py::none())
+      .def("fill_level", &sr::StreamResampler::fill_level,
+           "Number of input frames waiting in the ring buffer.")
+      .def("write_available", &sr::StreamResampler::write_available,
+           "Number of input frames that can be written without overflow.")
+      .def("read_available", &sr::StreamResampler::read_available,
+           "Estimated number of output frames the buffered input yields.")
+      .def("set_ratio", &sr::StreamResampler::set_ratio,
+           "Set the conversion ratio for the next `read`, consumer side.",
+           "new_ratio"_a)
+      .def("reset", &sr::StreamResampler::reset, R"mydelimiter(
+            Reset the converter and empty the ring buffer. Must not be
+            called while another thread writes or reads.
+           )mydelimiter")
+      .def_property_readonly("ratio", &sr::StreamResampler::ratio,
+                             "Conversion ratio = output sample rate / input "
+                             "sample rate.")
+      .def_property_readonly("capacity", &sr::StreamResampler::capacity,
+                             "Size of the ring buffer in input frames.")
+      .def_property_readonly("end_of_input",
+                             &sr::StreamResampler::end_of_input,
+                             "Whether the end of input has been written.")
+      .def_readonly("converter_type", &sr::StreamResampler::_converter_type,
+                    "Converter type.")
+      .def_readonly("channels", &sr::StreamResampler::_channels,
+                    "Number of channels.");
+
   py::enum_<sr::ConverterType>(m_converters, "ConverterType", R"mydelimiter(
       Enum of samplerate converter types.
 
       Pass any of the members, or their string or value representation, as
       ``converter_type`` in the resamplers.
+
+      ``polyphase_best`` and ``polyphase_fast`` are precomputed polyphase
+      filter banks for fixed rational ratios such as 48000 / 44100, with
+      a passband of 90% and 80% of the Nyquist frequency. They are several
+      times faster than the sinc converters. For any other ratio they fall
+      back to ``sinc_best`` and ``sinc_fastest``, which the callback API
+      always uses.
+
+      ``halfband_best`` and ``halfband_fast`` convert power of two ratios
+      from 1 / 16 to 16, e.g. 48 kHz to 12 kHz, with a cascade of half-band
+      filters of the same quality as the polyphase converters, at a fraction
+      of their cost. For any other ratio, such as 3, they fall back to
+      ``polyphase_best`` and ``polyphase_fast``.
     )mydelimiter")
       .value("sinc_best", sr::ConverterType::sinc_best)
       .value("sinc_medium", sr::ConverterType::sinc_medium)
       .value("sinc_fastest", sr::ConverterType::sinc_fastest)
       .value("zero_order_hold", sr::ConverterType::zero_order_hold)
       .value("linear", sr::ConverterType::linear)
+      .value("polyphase_best", sr::ConverterType::polyphase_best)
+      .value("polyphase_fast", sr::ConverterType::polyphase_fast)
+      .value("halfband_best", sr::ConverterType::halfband_best)
+      .value("halfband_fast", sr::ConverterType::halfband_fast)
       .export_values();
 
   // Convenience imports
   m.attr("ResamplingError") = m_exceptions.attr("ResamplingError");
   m.attr("resample") = m_converters.attr("resample");
+  m.attr("resample_async") = m_converters.attr("resample_async");
+  m.attr("resample_batch") = m_converters.attr("resample_batch");
+  m.attr("resample_file") = m_converters.attr("resample_file");
+  m.attr("resample_multi") = m_converters.attr("resample_multi");
   m.attr("CallbackResampler") = m_converters.attr("CallbackResampler");
   m.attr("Resampler") = m_converters.attr("Resampler");
+  m.attr("ResamplerSnapshot") = m_converters.attr("ResamplerSnapshot");
+  m.attr("CallbackResamplerSnapshot") =
+      m_converters.attr("CallbackResamplerSnapshot");
+  m.attr("ResamplerBank") = m_converters.attr("ResamplerBank");
+  m.attr("MultiRateResampler") = m_converters.attr("MultiRateResampler");
+  m.attr("StreamResampler") = m_converters.attr("StreamResampler");
+  m.attr("FixedBlockResampler") = m_converters.attr("FixedBlockResampler");
+  m.attr("SharedMemoryResampler") = m_converters.attr("SharedMemoryResampler");
+  m.attr("run_shared_worker") = m_converters.attr("run_shared_worker");
   m.attr("ConverterType") = m_converters.attr("ConverterType");
+  m.attr("PostProcess") = m_converters.attr("PostProcess");
 }
@@ -1,4 +1,6 @@
-from typing import Optional, Union, Callable, Iterator, Tuple, overload, TypedDict
+import asyncio
+import os
+from typing import Dict, Optional, Union, Callable, Iterator, List, Sequence, Tuple, overload, TypedDict
 import numpy as np
 import numpy.typing as npt
 
@@ -17,6 +19,38 @@ class BuildInfo(TypedDict):
     pointer_size_bits: int
     float_size_bytes: int
     gil_release_threshold: int
+    gil_release_thresholds: Dict[str, int]
+    simd_isa: str
+    simd_isas: List[str]
+    sinc_isa: str
+    free_threaded: bool
+
+class Stats(TypedDict):
+    calls: int
+    input_frames: int
+    output_frames: int
+    process_ns: int
+    max_process_ns: int
+    gil_released: int
+    gil_held: int
+
+class AdaptiveStats(Stats, total=False):
+    converter_type: int
+    converter_switches: int
+
+class ResamplerStats(AdaptiveStats, total=False):
+    silent_frames: int
+
+class CallbackStats(Stats):
+    callback_calls: int
+    callback_ns: int
+
+class CallbackResamplerStats(CallbackStats, total=False):
+    silent_frames: int
+
+class FilterCacheInfo(TypedDict):
+    designs: int
+    cached: int
 
 class ConverterType:
     sinc_best: int
@@ -24,58 +58,355 @@ class ConverterType:
     sinc_fastest: int
     zero_order_hold: int
     linear: int
+    polyphase_best: int
+    polyphase_fast: int
+    halfband_best: int
+    halfband_fast: int
 
 class ResamplingError(RuntimeError): ...
 
-def set_gil_release_threshold(threshold: int) -> None: ...
-def get_gil_release_threshold() -> int: ...
+class PostProcess:
+    gain: List[float]
+    channel_map: Optional[List[int]]
+    downmix: bool
+    def __init__(
+        self,
+        gain: Union[float, Sequence[float]] = 1.0,
+        channel_map: Optional[Sequence[int]] = None,
+        downmix: bool = False,
+    ) -> None: ...
+
+_RatioSchedule = Union[float, Tuple[float, float], npt.ArrayLike]
+
+def set_gil_release_threshold(
+    threshold: int,
+    converter_type: Optional[Union[ConverterType, str, int]] = None,
+    channels: Optional[int] = None,
+) -> None: ...
+def get_gil_release_threshold(
+    converter_type: Optional[Union[ConverterType, str, int]] = None,
+    channels: Optional[int] = None,
+) -> int: ...
+def calibrate_gil_thresholds(channels: Optional[int] = None) -> Dict[str, int]: ...
+def set_num_threads(num_threads: int) -> None: ...
+def get_num_threads() -> int: ...
+def set_state_cache_size(size: int) -> None: ...
+def get_state_cache_size() -> int: ...
+def clear_state_cache() -> None: ...
+def get_filter_cache_info() -> FilterCacheInfo: ...
+def set_strict_input(strict: bool) -> None: ...
+def get_strict_input() -> bool: ...
+def get_stats() -> Stats: ...
+def reset_stats() -> None: ...
+def benchmark(
+    converter_types: Optional[Union[Sequence[Union[ConverterType, str, int]], ConverterType, str, int]] = None,
+    channels: Sequence[int] = (1, 2),
+    block_frames: Sequence[int] = (64, 512, 4096),
+    ratio: float = 48000 / 44100,
+    min_time: float = 0.05,
+    as_json: bool = False,
+) -> Union[dict, str]: ...
 def get_build_info() -> BuildInfo: ...
 
 def resample(
-    input_data: npt.NDArray[np.float32],
+    input_data: npt.ArrayLike,
     ratio: float,
     converter_type: Union[ConverterType, str, int] = "sinc_best",
     verbose: bool = False,
     release_gil: Optional[Union[bool, str]] = None,
-) -> npt.NDArray[np.float32]: ...
+    num_threads: Optional[int] = None,
+    layout: str = "interleaved",
+    dtype: npt.DTypeLike = "float32",
+    post: Optional[PostProcess] = None,
+) -> npt.NDArray[Union[np.float32, np.int16, np.int32]]: ...
+
+def resample_async(
+    input_data: npt.ArrayLike,
+    ratio: float,
+    converter_type: Union[ConverterType, str, int] = "sinc_best",
+    num_threads: Optional[int] = None,
+    layout: str = "interleaved",
+    dtype: npt.DTypeLike = "float32",
+) -> asyncio.Future[npt.NDArray[Union[np.float32, np.int16, np.int32]]]: ...
+
+def resample_batch(
+    inputs: Sequence[npt.ArrayLike],
+    ratio: Union[float, Sequence[float]],
+    converter_type: Union[ConverterType, str, int] = "sinc_best",
+    num_threads: Optional[int] = None,
+    release_gil: Optional[Union[bool, str]] = None,
+) -> List[npt.NDArray[np.float32]]: ...
+
+def resample_multi(
+    input_data: npt.ArrayLike,
+    ratios: Sequence[float],
+    converter_type: Union[ConverterType, str, int] = "sinc_best",
+    num_threads: Optional[int] = None,
+    release_gil: Optional[Union[bool, str]] = None,
+) -> List[npt.NDArray[np.float32]]: ...
+
+def resample_file(
+    src_path: Union[str, "os.PathLike[str]"],
+    dst_path: Union[str, "os.PathLike[str]"],
+    ratio: float,
+    converter_type: Union[ConverterType, str, int] = "sinc_best",
+    channels: Optional[int] = None,
+    dtype: Optional[npt.DTypeLike] = None,
+    block_frames: int = 8192,
+) -> int: ...
+
+class ResamplerSnapshot:
+    def __init__(self) -> None: ...
+
+class CallbackResamplerSnapshot:
+    def __init__(self) -> None: ...
 
 class Resampler:
     converter_type: int
     channels: int
+    num_threads: int
+    budget_us: Optional[float]
+    silence_threshold: Optional[float]
     def __init__(
         self,
         converter_type: Union[ConverterType, str, int] = "sinc_best",
         channels: int = 1,
+        num_threads: Optional[int] = None,
+        budget_us: Optional[float] = None,
+        silence_threshold: Optional[float] = None,
     ) -> None: ...
     def process(
         self,
-        input_data: npt.NDArray[np.float32],
-        ratio: float,
+        input_data: npt.ArrayLike,
+        ratio: _RatioSchedule,
         end_of_input: bool = False,
         release_gil: Optional[Union[bool, str]] = None,
-    ) -> npt.NDArray[np.float32]: ...
+        layout: str = "interleaved",
+        dtype: npt.DTypeLike = "float32",
+        post: Optional[PostProcess] = None,
+    ) -> npt.NDArray[Union[np.float32, np.int16, np.int32]]: ...
+    def process_into(
+        self,
+        input_data: npt.ArrayLike,
+        out: npt.NDArray[np.float32],
+        ratio: _RatioSchedule,
+        end_of_input: bool = False,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> Tuple[int, int]: ...
+    def process_async(
+        self,
+        input_data: npt.ArrayLike,
+        ratio: _RatioSchedule,
+        end_of_input: bool = False,
+        layout: str = "interleaved",
+        dtype: npt.DTypeLike = "float32",
+    ) -> asyncio.Future[npt.NDArray[Union[np.float32, np.int16, np.int32]]]: ...
+    def max_output_frames(
+        self, num_frames: int, ratio: float, end_of_input: bool = False
+    ) -> int: ...
+    def latency_frames(self, ratio: float) -> int: ...
+    def prime(self, ratio: float, num_frames: Optional[int] = None) -> int: ...
     def reset(self) -> None: ...
     def set_ratio(self, new_ratio: float) -> None: ...
     def clone(self) -> "Resampler": ...
+    def snapshot(self, into: Optional[ResamplerSnapshot] = None) -> ResamplerSnapshot: ...
+    def restore(self, snapshot: ResamplerSnapshot) -> None: ...
+    def __getstate__(self) -> tuple: ...
+    def __setstate__(self, state: tuple) -> None: ...
+    def stats(self) -> ResamplerStats: ...
+    def reset_stats(self) -> None: ...
+
+class ResamplerBank:
+    converter_type: int
+    channels: int
+    num_streams: int
+    def __init__(
+        self,
+        num_streams: int,
+        converter_type: Union[ConverterType, str, int] = "sinc_best",
+        channels: int = 1,
+    ) -> None: ...
+    def process(
+        self,
+        inputs: Union[npt.ArrayLike, Sequence[npt.ArrayLike]],
+        ratio: Union[float, Sequence[float]],
+        end_of_input: bool = False,
+        num_threads: Optional[int] = None,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> List[npt.NDArray[np.float32]]: ...
+    def reset(self) -> None: ...
+    def reset_stream(self, index: int) -> None: ...
+    def set_ratio(self, ratio: Union[float, Sequence[float]]) -> None: ...
+    def clone(self) -> "ResamplerBank": ...
+    def __len__(self) -> int: ...
+
+class MultiRateResampler:
+    ratios: List[float]
+    converter_type: int
+    channels: int
+    def __init__(
+        self,
+        ratios: Sequence[float],
+        converter_type: Union[ConverterType, str, int] = "sinc_best",
+        channels: int = 1,
+        num_threads: Optional[int] = None,
+    ) -> None: ...
+    def process(
+        self,
+        input_data: npt.ArrayLike,
+        end_of_input: bool = False,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> List[npt.NDArray[np.float32]]: ...
+    def reset(self) -> None: ...
+    def set_ratios(self, ratios: Sequence[float]) -> None: ...
+    def clone(self) -> "MultiRateResampler": ...
+    def __len__(self) -> int: ...
 
 class CallbackResampler:
     ratio: float
     converter_type: int
     channels: int
+    silence_threshold: Optional[float]
     def __init__(
         self,
-        callback: Callable[[], Optional[npt.NDArray[np.float32]]],
+        callback: Callable[[], Optional[npt.ArrayLike]],
         ratio: float,
         converter_type: Union[ConverterType, str, int] = "sinc_best",
         channels: int = 1,
+        prefetch: int = 0,
+        silence_threshold: Optional[float] = None,
     ) -> None: ...
     def read(
         self,
         num_frames: int,
         release_gil: Optional[Union[bool, str]] = None,
+        ratio: Optional[_RatioSchedule] = None,
+        post: Optional[PostProcess] = None,
     ) -> npt.NDArray[np.float32]: ...
+    def read_into(
+        self,
+        out: npt.NDArray[np.float32],
+        release_gil: Optional[Union[bool, str]] = None,
+        ratio: Optional[_RatioSchedule] = None,
+    ) -> int: ...
+    def read_async(
+        self,
+        num_frames: int,
+        ratio: Optional[_RatioSchedule] = None,
+    ) -> asyncio.Future[npt.NDArray[np.float32]]: ...
     def reset(self) -> None: ...
     def set_starting_ratio(self, new_ratio: float) -> None: ...
+    def latency_frames(self, ratio: Optional[float] = None) -> int: ...
+    def prime(self, num_frames: Optional[int] = None) -> int: ...
     def clone(self) -> "CallbackResampler": ...
+    def snapshot(self, into: Optional[CallbackResamplerSnapshot] = None) -> CallbackResamplerSnapshot: ...
+    def restore(self, snapshot: CallbackResamplerSnapshot) -> None: ...
+    def __getstate__(self) -> tuple: ...
+    def __setstate__(self, state: tuple) -> None: ...
+    def stats(self) -> CallbackResamplerStats: ...
+    def reset_stats(self) -> None: ...
     def __enter__(self) -> "CallbackResampler": ...
     def __exit__(self, exc_type, exc, exc_tb) -> None: ...
+
+class StreamResampler:
+    ratio: float
+    capacity: int
+    end_of_input: bool
+    converter_type: int
+    channels: int
+    def __init__(
+        self,
+        ratio: float,
+        converter_type: Union[ConverterType, str, int] = "sinc_best",
+        channels: int = 1,
+        capacity: int = 16384,
+    ) -> None: ...
+    def write(
+        self,
+        input_data: npt.ArrayLike,
+        end_of_input: bool = False,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> int: ...
+    def read(
+        self,
+        num_frames: int,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> npt.NDArray[np.float32]: ...
+    def read_into(
+        self,
+        out: npt.NDArray[np.float32],
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> int: ...
+    def fill_level(self) -> int: ...
+    def write_available(self) -> int: ...
+    def read_available(self) -> int: ...
+    def set_ratio(self, new_ratio: float) -> None: ...
+    def reset(self) -> None: ...
+
+class SharedMemoryResampler:
+    name: str
+    converter_type: int
+    channels: int
+    capacity: int
+    def __init__(
+        self,
+        converter_type: Union[ConverterType, str, int] = "sinc_best",
+        channels: int = 1,
+        capacity: int = 16384,
+        spawn: bool = True,
+    ) -> None: ...
+    @property
+    def worker_pid(self) -> Optional[int]: ...
+    def process(
+        self,
+        input_data: npt.ArrayLike,
+        ratio: float,
+        end_of_input: bool = False,
+        layout: str = "interleaved",
+        dtype: npt.DTypeLike = "float32",
+    ) -> npt.NDArray[Union[np.float32, np.int16, np.int32]]: ...
+    def process_async(
+        self,
+        input_data: npt.ArrayLike,
+        ratio: float,
+        end_of_input: bool = False,
+        layout: str = "interleaved",
+        dtype: npt.DTypeLike = "float32",
+    ) -> asyncio.Future[npt.NDArray[Union[np.float32, np.int16, np.int32]]]: ...
+    def reset(self) -> None: ...
+    def set_ratio(self, new_ratio: float) -> None: ...
+    def close(self) -> None: ...
+    def __enter__(self) -> "SharedMemoryResampler": ...
+    def __exit__(self, exc_type, exc, exc_tb) -> None: ...
+
+def run_shared_worker(name: str) -> None: ...
+
+class FixedBlockResampler:
+    block_size: int
+    converter_type: int
+    channels: int
+    def __init__(
+        self,
+        block_size: int,
+        converter_type: Union[ConverterType, str, int] = "sinc_best",
+        channels: int = 1,
+        num_threads: Optional[int] = None,
+    ) -> None: ...
+    def process(
+        self,
+        input: npt.ArrayLike,
+        ratio: float,
+        end_of_input: bool = False,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> Optional[npt.NDArray[np.float32]]: ...
+    def process_into(
+        self,
+        input: npt.ArrayLike,
+        out: npt.NDArray[np.float32],
+        ratio: float,
+        end_of_input: bool = False,
+        release_gil: Optional[Union[bool, str]] = None,
+    ) -> bool: ...
+    def available(self) -> int: ...
+    def reset(self) -> None: ...
+    def set_ratio(self, new_ratio: float) -> None: ...
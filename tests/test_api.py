@@ -1,3 +1,6 @@
+import pickle
+import threading
+
 import numpy as np
 import pytest
 
@@ -35,7 +38,7 @@ def data(request):
     )
 
 
-@pytest.fixture(params=[0, 1, 2, 3, 4])
+@pytest.fixture(params=[0, 1, 2, 3, 4, 5, 6, 7, 8])
 def converter_type(request):
     return request.param
 
@@ -141,6 +144,77 @@ def test_CallbackResampler_clone(data, converter_type, ratio=2.0):
     new_resampler = resampler.clone()
 
 
+class _Blocks:
+    """Picklable callback returning the blocks of a signal in turn."""
+
+    def __init__(self, signal, frames):
+        self.signal, self.frames, self.position = signal, frames, 0
+
+    def __call__(self):
+        if self.position >= len(self.signal):
+            return None
+        block = self.signal[self.position : self.position + self.frames]
+        self.position += self.frames
+        return block
+
+
+def test_snapshot_restore(converter_type):
+    np.random.seed(0)
+    x = np.random.randn(6000, 2).astype(np.float32)
+    ratio = 1.5
+    resampler = samplerate.Resampler(converter_type, 2)
+    resampler.process(x[:2000], ratio)
+    snapshot = resampler.snapshot()
+    expected = resampler.process(x[2000:4000], ratio)
+    for _ in range(2):
+        resampler.restore(snapshot)
+        assert np.array_equal(resampler.process(x[2000:4000], ratio), expected)
+
+    # reusing the snapshot, and restoring it into another resampler
+    assert resampler.snapshot(into=snapshot) is snapshot
+    other = samplerate.Resampler(converter_type, 2)
+    other.restore(snapshot)
+    y = other.process(x[4000:], ratio, end_of_input=True)
+    assert np.array_equal(y, resampler.process(x[4000:], ratio, end_of_input=True))
+
+    # pickling, fresh and mid-stream, and pickled snapshots
+    fresh = pickle.loads(pickle.dumps(samplerate.Resampler(converter_type, 2)))
+    assert np.array_equal(fresh.process(x, ratio), samplerate.Resampler(converter_type, 2).process(x, ratio))
+    copy = pickle.loads(pickle.dumps(fresh))
+    assert np.array_equal(copy.process(x, ratio), fresh.process(x, ratio))
+    other = samplerate.Resampler(converter_type, 2)
+    other.restore(pickle.loads(pickle.dumps(fresh.snapshot())))
+    assert np.array_equal(other.process(x, ratio, True), fresh.process(x, ratio, True))
+
+    halfband = samplerate.Resampler("halfband_best", 2, num_threads=2)
+    halfband.process(x[:3000], 0.5)
+    copy = pickle.loads(pickle.dumps(halfband))
+    assert copy.num_threads == halfband.num_threads
+    assert np.array_equal(copy.process(x[3000:], 0.5, True), halfband.process(x[3000:], 0.5, True))
+
+
+def test_callback_snapshot_restore(converter_type):
+    np.random.seed(0)
+    x = np.random.randn(8000, 2).astype(np.float32)
+    blocks = _Blocks(x, 1000)
+    resampler = samplerate.CallbackResampler(blocks, 1.5, converter_type, 2)
+    resampler.read(1234)
+    snapshot, position = resampler.snapshot(), blocks.position
+    expected = resampler.read(3000)
+    for _ in range(2):
+        resampler.restore(snapshot)
+        blocks.position = position  # the callback is rewound by the caller
+        assert np.array_equal(resampler.read(3000), expected)
+    assert resampler.snapshot(into=snapshot) is snapshot
+
+    # pickled with the callback, fresh and mid-stream
+    copy = pickle.loads(pickle.dumps(samplerate.CallbackResampler(_Blocks(x, 1000), 1.5, converter_type, 2)))
+    reference = samplerate.CallbackResampler(_Blocks(x, 1000), 1.5, converter_type, 2)
+    assert np.array_equal(copy.read(2000), reference.read(2000))
+    copy = pickle.loads(pickle.dumps(resampler))
+    assert np.array_equal(copy.read(3000), resampler.read(3000))
+
+
 @pytest.mark.parametrize(
     "input_obj,expected_type",
     [
@@ -154,13 +228,1160 @@ def test_CallbackResampler_clone(data, converter_type, ratio=2.0):
         ("sinc_fastest", 2),
         ("zero_order_hold", 3),
         ("linear", 4),
+        ("polyphase_best", 5),
+        ("polyphase_fast", 6),
+        ("halfband_best", 7),
+        ("halfband_fast", 8),
         (samplerate.ConverterType.sinc_best, 0),
         (samplerate.ConverterType.sinc_medium, 1),
         (samplerate.ConverterType.sinc_fastest, 2),
         (samplerate.ConverterType.zero_order_hold, 3),
         (samplerate.ConverterType.linear, 4),
+        (samplerate.ConverterType.polyphase_best, 5),
+        (samplerate.ConverterType.polyphase_fast, 6),
+        (samplerate.ConverterType.halfband_best, 7),
+        (samplerate.ConverterType.halfband_fast, 8),
     ],
 )
 def test_converter_type(input_obj, expected_type):
     ret = samplerate._internals.get_converter_type(input_obj)
     assert ret == expected_type
+
+
+@pytest.mark.parametrize(
+    "polyphase,sinc", [("polyphase_best", "sinc_best"), ("polyphase_fast", "sinc_fastest")]
+)
+def test_polyphase_fallback(data, polyphase, sinc):
+    _, input_data = data
+    # not a small rational, converted by the sinc converter
+    ratio = np.pi / 3
+    expected = samplerate.resample(input_data, ratio, sinc)
+    assert np.array_equal(samplerate.resample(input_data, ratio, polyphase), expected)
+
+
+def test_polyphase_streaming(data):
+    num_channels, input_data = data
+    ratio = 48000 / 44100
+    expected = samplerate.resample(input_data, ratio, "polyphase_best")
+    resampler = samplerate.Resampler("polyphase_best", num_channels)
+    blocks = np.array_split(input_data, 9)
+    output = np.concatenate(
+        [resampler.process(b, ratio, end_of_input=i == 8) for i, b in enumerate(blocks)]
+    )
+    assert np.allclose(output, expected)
+
+    # switching to another rational ratio keeps streaming
+    resampler.reset()
+    output = resampler.process(input_data[:500], ratio)
+    output = resampler.process(input_data[500:], 0.5, end_of_input=True)
+    assert output.shape[0] > 0
+
+
+@pytest.mark.parametrize(
+    "halfband,polyphase",
+    [("halfband_best", "polyphase_best"), ("halfband_fast", "polyphase_fast")],
+)
+def test_halfband_fallback(data, halfband, polyphase):
+    _, input_data = data
+    # not a power of two, converted by the polyphase converter
+    for ratio in [3.0, 1 / 3, np.pi / 3]:
+        expected = samplerate.resample(input_data, ratio, polyphase)
+        assert np.array_equal(samplerate.resample(input_data, ratio, halfband), expected)
+
+
+@pytest.mark.parametrize("ratio", [0.5, 0.25, 1 / 16, 2.0, 8.0])
+def test_halfband_streaming(data, ratio):
+    num_channels, input_data = data
+    expected = samplerate.resample(input_data, ratio, "halfband_best")
+    assert len(expected) == np.ceil(len(input_data) * ratio)
+    resampler = samplerate.Resampler("halfband_best", num_channels)
+    blocks = np.array_split(input_data, 9)
+    output = np.concatenate(
+        [resampler.process(b, ratio, end_of_input=i == 8) for i, b in enumerate(blocks)]
+    )
+    assert np.array_equal(output, expected)
+
+    # a ratio change switches to the polyphase converter
+    resampler.reset()
+    output = resampler.process(input_data[:500], ratio)
+    output = resampler.process(input_data[500:], 3.0, end_of_input=True)
+    assert output.shape[0] > 0
+
+
+def test_polyphase_shared_filters(data):
+    num_channels, input_data = data
+    ratio = 44100 / 48000
+    # instances and clones with the same ratio share one filter bank
+    resamplers = [samplerate.Resampler("polyphase_fast", num_channels) for _ in range(8)]
+    first = [r.process(input_data[:400], ratio) for r in resamplers]
+    clones = [r.clone() for r in resamplers]
+    del resamplers[1:]
+    rest = resamplers[0].process(input_data[400:], ratio, end_of_input=True)
+    for out, clone in zip(first, clones):
+        assert np.array_equal(out, first[0])
+        assert np.array_equal(clone.process(input_data[400:], ratio, end_of_input=True), rest)
+
+
+def test_polyphase_filter_reuse():
+    # a filter bank outlives its converters, a new stream at the same ratio
+    # reuses it without designing it again
+    x = np.random.randn(1000).astype(np.float32)
+    expected = samplerate.Resampler("polyphase_best", 1).process(x, 48000 / 32000)
+    designs = samplerate.get_filter_cache_info()["designs"]
+    for _ in range(10):
+        resampler = samplerate.Resampler("polyphase_best", 1)
+        assert np.array_equal(resampler.process(x, 48000 / 32000), expected)
+        del resampler
+    info = samplerate.get_filter_cache_info()
+    assert info["designs"] == designs
+    assert info["cached"] >= 1
+
+
+def test_process_into(data, converter_type, ratio=2.0):
+    num_channels, input_data = data
+    expected = samplerate.Resampler(converter_type, num_channels).process(
+        input_data, ratio, end_of_input=True
+    )
+
+    resampler = samplerate.Resampler(converter_type, num_channels)
+    out = np.zeros((expected.shape[0] + 100,) + expected.shape[1:], dtype=np.float32)
+    gen, used = resampler.process_into(input_data, out, ratio, end_of_input=True)
+    assert used == input_data.shape[0]
+    assert gen == expected.shape[0]
+    assert np.allclose(out[:gen], expected)
+
+
+def test_process_into_small_output(data, converter_type, ratio=2.0):
+    num_channels, input_data = data
+    expected = samplerate.Resampler(converter_type, num_channels).process(
+        input_data, ratio, end_of_input=True
+    )
+
+    # feed the unused input again until everything has been consumed
+    resampler = samplerate.Resampler(converter_type, num_channels)
+    out = np.zeros((64,) + input_data.shape[1:], dtype=np.float32)
+    chunks = []
+    remaining = input_data
+    while True:
+        gen, used = resampler.process_into(remaining, out, ratio, end_of_input=True)
+        if gen == 0 and used == 0:
+            break
+        chunks.append(out[:gen].copy())
+        remaining = remaining[used:]
+    assert np.allclose(np.concatenate(chunks), expected)
+
+
+def test_read_into(data, converter_type, ratio=2.0):
+    num_channels, input_data = data
+
+    def make_callback():
+        def producer():
+            yield input_data
+            while True:
+                yield None
+
+        return lambda p=producer(): next(p)
+
+    num_frames = int(ratio) * input_data.shape[0]
+    expected = samplerate.CallbackResampler(
+        make_callback(), ratio, converter_type, num_channels
+    ).read(num_frames)
+
+    resampler = samplerate.CallbackResampler(
+        make_callback(), ratio, converter_type, num_channels
+    )
+    out = np.zeros((num_frames,) + input_data.shape[1:], dtype=np.float32)
+    gen = resampler.read_into(out)
+    assert gen == expected.shape[0]
+    assert np.allclose(out[:gen], expected)
+
+
+def test_state_cache(data, converter_type, ratio=2.0):
+    _, input_data = data
+    default_size = samplerate.get_state_cache_size()
+    try:
+        samplerate.set_state_cache_size(0)
+        assert samplerate.get_state_cache_size() == 0
+        expected = samplerate.resample(input_data, ratio, converter_type)
+
+        samplerate.set_state_cache_size(2)
+        # the second and third calls reuse the cached state
+        for _ in range(3):
+            output = samplerate.resample(input_data, ratio, converter_type)
+            assert np.array_equal(output, expected)
+
+        samplerate.clear_state_cache()
+        output = samplerate.resample(input_data, ratio, converter_type)
+        assert np.array_equal(output, expected)
+    finally:
+        samplerate.set_state_cache_size(default_size)
+
+
+def test_state_cache_threads(converter_type):
+    from concurrent.futures import ThreadPoolExecutor
+
+    np.random.seed(0)
+    inputs = [np.random.randn(512, c).astype(np.float32) for c in (1, 2, 3)] * 4
+    expected = [samplerate.resample(x, 0.5, converter_type) for x in inputs]
+
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        outputs = list(
+            executor.map(
+                lambda x: samplerate.resample(x, 0.5, converter_type, release_gil=True),
+                inputs,
+            )
+        )
+    for output, ref in zip(outputs, expected):
+        assert np.array_equal(output, ref)
+
+
+@pytest.mark.parametrize("num_threads", [1, 2, 0])
+def test_resample_batch(converter_type, num_threads):
+    np.random.seed(0)
+    inputs = [
+        np.random.randn(100).astype(np.float32),
+        np.random.randn(2000, 2).astype(np.float32),
+        np.random.randn(0, 1).astype(np.float32),
+        np.random.randn(513, 3),
+    ]
+    ratios = [0.5, 2.0, 1.5, 44100 / 48000]
+
+    outputs = samplerate.resample_batch(
+        inputs, ratios, converter_type, num_threads=num_threads
+    )
+    assert len(outputs) == len(inputs)
+    for x, ratio, y in zip(inputs, ratios, outputs):
+        assert np.array_equal(y, samplerate.resample(x, ratio, converter_type))
+
+    outputs = samplerate.resample_batch(inputs, 0.5, converter_type, num_threads)
+    for x, y in zip(inputs, outputs):
+        assert np.array_equal(y, samplerate.resample(x, 0.5, converter_type))
+
+
+def test_resample_batch_empty():
+    assert samplerate.resample_batch([], 2.0) == []
+
+
+@pytest.mark.parametrize("num_threads", [1, 3])
+@pytest.mark.parametrize("num_channels", [1, 2])
+def test_resampler_bank(converter_type, num_channels, num_threads):
+    np.random.seed(0)
+    num_streams, num_blocks, block_size = 5, 4, 256
+    ratios = [0.5, 1.0, 2.0, 44100 / 48000, 48000 / 44100]
+    x = np.random.randn(num_blocks, num_streams, block_size, num_channels).astype(
+        np.float32
+    )
+
+    resamplers = [samplerate.Resampler(converter_type, num_channels) for _ in ratios]
+    bank = samplerate.ResamplerBank(num_streams, converter_type, num_channels)
+    assert len(bank) == bank.num_streams == num_streams
+
+    for b in range(num_blocks):
+        end_of_input = b == num_blocks - 1
+        outputs = bank.process(x[b], ratios, end_of_input, num_threads=num_threads)
+        assert len(outputs) == num_streams
+        for s, (resampler, ratio) in enumerate(zip(resamplers, ratios)):
+            expected = resampler.process(x[b, s], ratio, end_of_input)
+            assert np.array_equal(outputs[s], expected)
+
+
+def test_resampler_bank_inputs():
+    np.random.seed(0)
+    x = np.random.randn(3, 100).astype(np.float32)
+
+    # 2D input for single channel streams, outputs are 1D
+    outputs = samplerate.ResamplerBank(3, "sinc_fastest").process(x, 2.0, True)
+    assert all(y.ndim == 1 for y in outputs)
+
+    # list input with arrays of different lengths
+    blocks = [x[0], x[1, :50], x[2, :10, np.newaxis]]
+    outputs = samplerate.ResamplerBank(3, "sinc_fastest").process(blocks, 2.0, True)
+    for block, y in zip(blocks, outputs):
+        assert np.array_equal(y, samplerate.resample(block, 2.0, "sinc_fastest"))
+
+
+def test_resampler_bank_reset_clone():
+    np.random.seed(0)
+    x = np.random.randn(2, 100, 1).astype(np.float32)
+    bank = samplerate.ResamplerBank(2, "sinc_fastest", 1)
+    first = bank.process(x, 2.0)
+    clone = bank.clone()
+    assert all(
+        np.array_equal(a, b) for a, b in zip(bank.process(x, 2.0), clone.process(x, 2.0))
+    )
+    bank.reset()
+    assert all(np.array_equal(a, b) for a, b in zip(bank.process(x, 2.0), first))
+
+
+@pytest.mark.parametrize("num_threads", [1, 3])
+@pytest.mark.parametrize("num_channels", [1, 2])
+def test_resample_multi(converter_type, num_channels, num_threads):
+    np.random.seed(0)
+    ratios = [44100 / 48000, 1 / 3, 1 / 6, 2.0]
+    x = np.random.randn(2000, num_channels).astype(np.float32)
+    for data in [x, (x * 32767).astype(np.int16), np.asfortranarray(x)]:
+        outputs = samplerate.resample_multi(data, ratios, converter_type, num_threads)
+        assert len(outputs) == len(ratios)
+        for ratio, y in zip(ratios, outputs):
+            assert np.array_equal(y, samplerate.resample(data, ratio, converter_type))
+    assert samplerate.resample_multi(x[:, 0], ratios, converter_type)[0].ndim == 1
+
+
+@pytest.mark.parametrize("num_threads", [1, 3])
+def test_multi_rate_resampler(converter_type, num_threads):
+    np.random.seed(0)
+    ratios = [44100 / 48000, 1 / 3, 2.0]
+    x = np.random.randn(4, 256, 2).astype(np.float32)
+
+    resamplers = [samplerate.Resampler(converter_type, 2) for _ in ratios]
+    fan_out = samplerate.MultiRateResampler(ratios, converter_type, 2, num_threads)
+    assert len(fan_out) == len(ratios) and fan_out.ratios == ratios
+
+    for b in range(len(x)):
+        end_of_input = b == len(x) - 1
+        outputs = fan_out.process(x[b], end_of_input)
+        for resampler, ratio, y in zip(resamplers, ratios, outputs):
+            assert np.array_equal(y, resampler.process(x[b], ratio, end_of_input))
+
+    fan_out.reset()
+    first = fan_out.process(x[0])
+    clone = fan_out.clone()
+    for a, b in zip(fan_out.process(x[1]), clone.process(x[1])):
+        assert np.array_equal(a, b)
+    fan_out.set_ratios([1.0, 1.0, 1.0])
+    assert fan_out.ratios == [1.0, 1.0, 1.0]
+    fan_out.reset()
+    fan_out.set_ratios(ratios)
+    assert all(np.array_equal(a, b) for a, b in zip(fan_out.process(x[0]), first))
+
+
+def test_fan_out_flush_after_ratio_change(converter_type):
+    # a flush after a ratio change may generate more output than the bound
+    # of the new ratio, the rest is drained as Resampler.process does
+    np.random.seed(0)
+    x = np.random.randn(2000, 2).astype(np.float32)
+    low, high = 1 / 8, 8.0
+    for flushes in ([x[:0]], [x[:1], x[:0]]):
+        reference = samplerate.Resampler(converter_type, 2)
+        fan_out = samplerate.MultiRateResampler([low], converter_type, 2)
+        bank = samplerate.ResamplerBank(1, converter_type, 2)
+        expected = reference.process(x, low)
+        assert np.array_equal(fan_out.process(x)[0], expected)
+        assert np.array_equal(bank.process([x], low)[0], expected)
+        fan_out.set_ratios([high])
+        for i, block in enumerate(flushes):
+            end_of_input = i == len(flushes) - 1
+            expected = reference.process(block, high, end_of_input)
+            assert np.array_equal(fan_out.process(block, end_of_input)[0], expected)
+            assert np.array_equal(bank.process([block], high, end_of_input)[0], expected)
+
+
+def test_adaptive_resampler(ratio=1.5):
+    f = 0.01
+    x = np.sin(2 * np.pi * f * np.arange(20 * 512)).astype(np.float32)
+    x = np.stack([x, 0.5 * x], axis=1)
+
+    # a generous budget keeps sinc_best, with the same output
+    relaxed = samplerate.Resampler("adaptive", 2, budget_us=1e9)
+    reference = samplerate.Resampler("sinc_best", 2)
+    for block in np.split(x, 20):
+        assert np.array_equal(relaxed.process(block, ratio), reference.process(block, ratio))
+    assert relaxed.converter_type == 0 and relaxed.budget_us == 1e9
+    assert relaxed.stats()["converter_switches"] == 0
+
+    # an impossible budget steps down to sinc_fastest without glitches
+    resampler = samplerate.Resampler("adaptive", 2, budget_us=1e-3)
+    outputs = [resampler.process(block, ratio) for block in np.split(x, 20)]
+    outputs.append(resampler.process(x[:0], ratio, end_of_input=True))
+    y = np.concatenate(outputs)
+    assert resampler.converter_type == 2  # sinc_fastest
+    stats = resampler.stats()
+    assert stats["converter_type"] == 2 and stats["converter_switches"] == 2
+    assert abs(len(y) - len(x) * ratio) <= 2
+    expected = np.sin(2 * np.pi * f * np.arange(len(y)) / ratio)
+    assert np.abs(y[200:-200, 0] - expected[200:-200]).max() < 0.05
+    assert np.allclose(y[:, 1], 0.5 * y[:, 0], atol=1e-6)
+
+    clone = resampler.clone()
+    assert clone.converter_type == resampler.converter_type
+
+    # pickled mid-stream, crossfades included
+    resampler = samplerate.Resampler("adaptive", 2, budget_us=1e-3)
+    blocks = np.split(x, 20)
+    for block in blocks[:3]:
+        resampler.process(block, ratio)
+    copy = pickle.loads(pickle.dumps(resampler))
+    for block in blocks[3:]:
+        assert np.array_equal(copy.process(block, ratio), resampler.process(block, ratio))
+    assert copy.converter_type == resampler.converter_type
+    assert "converter_switches" not in samplerate.Resampler("sinc_best").stats()
+
+
+def test_latency_and_prime(converter_type, ratio=1.5):
+    np.random.seed(0)
+    x = np.random.randn(4, 512, 2).astype(np.float32)
+    resampler = samplerate.Resampler(converter_type, 2)
+    latency = resampler.latency_frames(ratio)
+    assert latency >= 0
+
+    # once primed, every block returns its full share of output
+    assert resampler.prime(ratio) == latency
+    for block in x:
+        assert abs(len(resampler.process(block, ratio)) - len(block) * ratio) <= 1
+    resampler.reset()
+    assert resampler.prime(ratio, num_frames=0) == 0
+
+    blocks = iter(np.array_split(x.reshape(-1, 2), 128))
+    callback = samplerate.CallbackResampler(lambda: next(blocks, None), ratio, converter_type, 2)
+    latency = callback.latency_frames()
+    assert latency == callback.latency_frames(ratio)
+    assert callback.prime() == latency
+    assert len(callback.read(768)) == 768
+    # the callback is not asked for the lookahead frames
+    assert callback.stats()["input_frames"] <= 768 / ratio + 16 + 1
+
+
+@pytest.mark.parametrize("ratio", [48000 / 44100, 0.5])
+def test_silence_fast_path(converter_type, ratio):
+    np.random.seed(0)
+    blocks = [np.zeros((1024, 2), dtype=np.float32) for _ in range(12)]
+    for b in (0, 1, 6, 7):
+        blocks[b][:] = np.random.randn(1024, 2)
+
+    plain = samplerate.Resampler(converter_type, 2)
+    fast = samplerate.Resampler(converter_type, 2, silence_threshold=0.0)
+    assert plain.silence_threshold is None and fast.silence_threshold == 0.0
+    outputs = {}
+    for name, resampler in (("plain", plain), ("fast", fast)):
+        y = [resampler.process(block, ratio) for block in blocks]
+        y.append(resampler.process(blocks[0][:0], ratio, end_of_input=True))
+        outputs[name] = np.concatenate(y)
+    assert outputs["fast"].shape == outputs["plain"].shape
+    assert np.allclose(outputs["fast"], outputs["plain"], atol=1e-5)
+    assert fast.stats()["silent_frames"] > 0
+    assert "silent_frames" not in plain.stats()
+
+    # the same for whole callback blocks
+    def read_all(**kwargs):
+        it = iter(blocks)
+        callback = samplerate.CallbackResampler(lambda: next(it, None), ratio, converter_type, 2, **kwargs)
+        chunks = [callback.read(700)]
+        while len(chunks[-1]):
+            chunks.append(callback.read(700))
+        return np.concatenate(chunks), callback
+
+    expected, _ = read_all()
+    y, callback = read_all(silence_threshold=0.0)
+    assert y.shape == expected.shape
+    assert np.allclose(y, expected, atol=1e-5)
+    assert callback.stats()["silent_frames"] > 0
+
+
+def test_shared_memory_resampler(converter_type):
+    np.random.seed(0)
+    blocks = [np.random.randn(n, 2).astype(np.float32) for n in (300, 2500, 0, 700)]
+    ratio = 1.5
+
+    def expected(dtype="float32"):
+        resampler = samplerate.Resampler(converter_type, 2)
+        y = [resampler.process(block, ratio, dtype=dtype) for block in blocks]
+        y.append(resampler.process(blocks[0][:0], ratio, end_of_input=True, dtype=dtype))
+        return y
+
+    with samplerate.SharedMemoryResampler(converter_type, 2, capacity=1000) as worker:
+        assert worker.channels == 2 and worker.capacity == 1000
+        for _ in range(2):
+            y = [worker.process(block, ratio) for block in blocks]
+            y.append(worker.process(blocks[0][:0], ratio, end_of_input=True))
+            for a, b in zip(y, expected()):
+                assert a.shape == b.shape
+                assert np.allclose(a, b, atol=1e-6)
+            worker.reset()
+        pcm = [worker.process(block * 1000, ratio, dtype="int16") for block in blocks]
+        resampler = samplerate.Resampler(converter_type, 2)
+        for a, block in zip(pcm, blocks):
+            assert a.dtype == np.int16
+            assert np.abs(a - resampler.process(block * 1000, ratio, dtype="int16")).max(initial=0) <= 1
+        assert worker.worker_pid is not None
+    assert worker.worker_pid is None
+
+    # a worker started by the caller, here on a thread of this process
+    worker = samplerate.SharedMemoryResampler(converter_type, 2, spawn=False)
+    thread = threading.Thread(target=samplerate.run_shared_worker, args=(worker.name,))
+    thread.start()
+    y = worker.process(blocks[1], ratio, end_of_input=True)
+    expected = samplerate.Resampler(converter_type, 2).process(blocks[1], ratio, end_of_input=True)
+    assert y.shape == expected.shape
+    assert np.allclose(y, expected, atol=1e-6)
+    worker.close()
+    thread.join(5)
+    assert not thread.is_alive()
+
+
+def test_post_process(converter_type):
+    np.random.seed(0)
+    x = np.random.randn(2000, 3).astype(np.float32)
+    plain = samplerate.resample(x, 1.5, converter_type)
+    posts = [
+        (samplerate.PostProcess(0.5), plain * 0.5),
+        (samplerate.PostProcess([1.0, 2.0, -1.0]), plain * [1.0, 2.0, -1.0]),
+        (samplerate.PostProcess(channel_map=[2, 0, 0, 1]), plain[:, [2, 0, 0, 1]]),
+        (samplerate.PostProcess(2.0, downmix=True), 2.0 * plain.mean(axis=1, keepdims=True)),
+        (
+            samplerate.PostProcess([1.0, 0.5, 0.25], [2, 1], downmix=True),
+            (plain[:, 2] * 0.25 + plain[:, 1] * 0.5)[:, None] / 2,
+        ),
+    ]
+    for post, expected in posts:
+        y = samplerate.resample(x, 1.5, converter_type, post=post)
+        assert y.shape == expected.shape
+        assert np.allclose(y, expected, atol=1e-6)
+        pcm = samplerate.resample(x * 1000, 1.5, converter_type, dtype="int16", post=post)
+        assert pcm.dtype == np.int16
+        assert np.abs(pcm - np.clip(np.rint(expected * 1000), -32768, 32767)).max() <= 1
+        planar = samplerate.resample(x.T, 1.5, converter_type, layout="planar", post=post)
+        assert np.allclose(planar, expected.T, atol=1e-6)
+
+    post = samplerate.PostProcess(0.5, [1, 0])
+    assert post.gain == [0.5] and post.channel_map == [1, 0] and not post.downmix
+    assert samplerate.PostProcess().channel_map is None
+
+    # 1D input, mixed to one channel or duplicated to two
+    mono = samplerate.resample(x[:, 0], 1.5, converter_type)
+    y = samplerate.resample(x[:, 0], 1.5, converter_type, post=samplerate.PostProcess(0.5))
+    assert y.ndim == 1 and np.allclose(y, mono * 0.5)
+    y = samplerate.resample(x[:, 0], 1.5, converter_type, post=samplerate.PostProcess(channel_map=[0, 0]))
+    assert y.shape == (len(mono), 2) and np.array_equal(y[:, 1], mono)
+
+
+def test_post_process_streaming(converter_type):
+    np.random.seed(0)
+    x = (np.random.randn(4, 256, 2) * 1000).astype(np.float32)
+    post = samplerate.PostProcess([0.5, 0.25], downmix=True)
+    reference = samplerate.Resampler(converter_type, 2)
+    resampler = samplerate.Resampler(converter_type, 2)
+    for b in range(len(x)):
+        expected = reference.process(x[b], 1.5, b == len(x) - 1)
+        y = resampler.process(x[b], 1.5, b == len(x) - 1, dtype="int32", post=post)
+        assert y.dtype == np.int32 and y.shape == (len(expected), 1)
+        assert np.abs(y[:, 0] - np.rint(expected @ [0.25, 0.125])).max() <= 1
+
+    # float outputs are mixed chunk by chunk too
+    long_input = np.random.randn(20000, 2).astype(np.float32)
+    expected = samplerate.Resampler(converter_type, 2).process(long_input, 1.5, True)
+    expected = expected[:, [1, 0, 1]] * [1.0, 2.0, 1.0]
+    post = samplerate.PostProcess([2.0, 1.0], [1, 0, 1])
+    y = samplerate.Resampler(converter_type, 2).process(long_input, 1.5, True, post=post)
+    assert y.dtype == np.float32 and np.allclose(y, expected, atol=1e-6)
+    y = samplerate.Resampler(converter_type, 2).process(
+        long_input.T, 1.5, True, layout="planar", post=post
+    )
+    assert np.allclose(y, expected.T, atol=1e-6)
+
+    blocks = iter(np.array_split(x.reshape(-1, 2), 8))
+    reference_blocks = iter(np.array_split(x.reshape(-1, 2), 8))
+    callback = samplerate.CallbackResampler(lambda: next(blocks, None), 1.5, converter_type, 2)
+    reference = samplerate.CallbackResampler(lambda: next(reference_blocks, None), 1.5, converter_type, 2)
+    swap = samplerate.PostProcess(channel_map=[1, 0])
+    for _ in range(4):
+        assert np.array_equal(callback.read(300, post=swap), reference.read(300)[:, ::-1])
+
+
+@pytest.mark.parametrize("block_frames", [1000, 8192])
+def test_resample_file(tmp_path, block_frames):
+    import wave
+
+    np.random.seed(0)
+    x = np.random.uniform(-0.5, 0.5, (20000, 2)).astype(np.float32)
+    ratio = 22050 / 48000
+
+    # raw float32
+    x.tofile(tmp_path / "in.raw")
+    frames = samplerate.resample_file(
+        tmp_path / "in.raw", tmp_path / "out.raw", ratio, "sinc_fastest",
+        channels=2, block_frames=block_frames,
+    )
+    expected = samplerate.resample(x, ratio, "sinc_fastest")
+    y = np.fromfile(tmp_path / "out.raw", dtype=np.float32).reshape(-1, 2)
+    assert frames == len(y) == len(expected)
+    assert np.allclose(y, expected, atol=1e-6)
+
+    # 16-bit WAV, written at the converted sample rate
+    pcm = (x * 32767).astype(np.int16)
+    with wave.open(str(tmp_path / "in.wav"), "wb") as f:
+        f.setnchannels(2)
+        f.setsampwidth(2)
+        f.setframerate(48000)
+        f.writeframes(pcm.tobytes())
+    frames = samplerate.resample_file(
+        str(tmp_path / "in.wav"), str(tmp_path / "out.wav"), ratio, "sinc_fastest",
+        block_frames=block_frames,
+    )
+    with wave.open(str(tmp_path / "out.wav"), "rb") as f:
+        assert f.getnchannels() == 2 and f.getsampwidth() == 2
+        assert f.getframerate() == 22050 and f.getnframes() == frames
+        y = np.frombuffer(f.readframes(frames), dtype=np.int16).reshape(-1, 2)
+    expected = samplerate.resample(pcm, ratio, "sinc_fastest", dtype="int16")
+    assert len(y) == len(expected)
+    assert np.max(np.abs(y.astype(np.int32) - expected)) <= 1
+
+
+def test_resample_file_empty(tmp_path):
+    (tmp_path / "in.raw").write_bytes(b"")
+    assert samplerate.resample_file(tmp_path / "in.raw", tmp_path / "out.raw", 2.0) == 0
+    assert (tmp_path / "out.raw").read_bytes() == b""
+
+
+@pytest.mark.parametrize("num_threads", [2, 3, 0])
+@pytest.mark.parametrize("num_channels", [1, 2, 7, 16])
+def test_parallel_channels(converter_type, num_channels, num_threads):
+    np.random.seed(0)
+    x = np.random.randn(3000, num_channels).astype(np.float32)
+
+    expected = samplerate.resample(x, 0.75, converter_type, num_threads=1)
+    output = samplerate.resample(x, 0.75, converter_type, num_threads=num_threads)
+    assert output.shape == expected.shape
+    assert np.allclose(output, expected, atol=1e-6)
+
+    sequential = samplerate.Resampler(converter_type, num_channels, num_threads=1)
+    parallel = samplerate.Resampler(converter_type, num_channels, num_threads=num_threads)
+    assert 1 <= parallel.num_threads <= num_channels
+    for block in np.array_split(x, 7):
+        expected = sequential.process(block, 1.5)
+        output = parallel.process(block, 1.5)
+        assert output.shape == expected.shape
+        assert np.allclose(output, expected, atol=1e-6)
+
+
+def test_default_num_threads():
+    default = samplerate.get_num_threads()
+    try:
+        samplerate.set_num_threads(4)
+        assert samplerate.get_num_threads() == 4
+        assert samplerate.Resampler("sinc_fastest", channels=8).num_threads == 4
+        assert samplerate.Resampler("sinc_fastest", channels=2).num_threads == 2
+        # an explicit argument overrides the default
+        assert samplerate.Resampler("sinc_fastest", 8, num_threads=1).num_threads == 1
+        samplerate.set_num_threads(0)
+        assert samplerate.get_num_threads() >= 1
+    finally:
+        samplerate.set_num_threads(default)
+
+
+def test_stream_resampler(data, converter_type, ratio=2.0):
+    num_channels, input_data = data
+    expected = samplerate.Resampler(converter_type, num_channels).process(
+        input_data, ratio, end_of_input=True
+    )
+
+    # a small ring buffer, so writes wrap around and fill up
+    stream = samplerate.StreamResampler(ratio, converter_type, num_channels, capacity=300)
+    assert stream.capacity == 300
+    chunks = []
+    remaining = input_data
+    while True:
+        if len(remaining) > 0:
+            written = stream.write(remaining, end_of_input=True)
+            assert stream.fill_level() <= 300
+            assert stream.write_available() == 300 - stream.fill_level()
+            remaining = remaining[written:]
+        out = stream.read(128)
+        if len(out) == 0 and len(remaining) == 0:
+            break
+        chunks.append(out)
+    assert stream.end_of_input
+    output = np.concatenate(chunks)
+    assert output.shape == expected.shape
+    assert np.allclose(output, expected, atol=1e-5)
+
+    stream.reset()
+    assert stream.fill_level() == 0 and not stream.end_of_input
+
+
+def test_stream_resampler_threads():
+    import threading
+
+    np.random.seed(0)
+    x = np.random.randn(50000, 2).astype(np.float32)
+    expected = samplerate.resample(x, 0.5, "sinc_fastest")
+
+    stream = samplerate.StreamResampler(0.5, "sinc_fastest", 2, capacity=4096)
+
+    def produce():
+        for block in np.array_split(x, 100):
+            while len(block) > 0:
+                written = stream.write(block, release_gil=True)
+                block = block[written:]
+        stream.write(x[:0], end_of_input=True)
+
+    producer = threading.Thread(target=produce)
+    producer.start()
+    out = np.empty((1000, 2), dtype=np.float32)
+    chunks = []
+    while True:
+        gen = stream.read_into(out, release_gil=True)
+        if gen == 0 and stream.end_of_input and stream.fill_level() == 0:
+            gen = stream.read_into(out)
+            if gen == 0:
+                break
+        chunks.append(out[:gen].copy())
+    producer.join()
+    assert np.allclose(np.concatenate(chunks), expected, atol=1e-5)
+
+
+@pytest.mark.parametrize("block_size", [1, 64, 735])
+def test_fixed_block_resampler(data, converter_type, block_size, ratio=2.0):
+    num_channels, input_data = data
+    expected = samplerate.Resampler(converter_type, num_channels).process(
+        input_data, ratio, end_of_input=True
+    )
+
+    resampler = samplerate.FixedBlockResampler(block_size, converter_type, num_channels)
+    blocks = []
+    chunks = np.array_split(input_data, 13)
+    for i, chunk in enumerate(chunks):
+        block = resampler.process(chunk, ratio, end_of_input=i == len(chunks) - 1)
+        while block is not None:
+            assert block.shape == (block_size,) + input_data.shape[1:]
+            blocks.append(block)
+            block = resampler.process(chunk[:0], ratio)
+        assert resampler.available() < block_size
+    assert resampler.available() == 0
+
+    output = np.concatenate(blocks)
+    # the last block is padded with zeros
+    assert len(output) == -(-len(expected) // block_size) * block_size
+    assert np.allclose(output[: len(expected)], expected)
+    assert np.all(output[len(expected) :] == 0)
+
+
+def test_fixed_block_resampler_into():
+    x = np.random.randn(4000, 2).astype(np.float32)
+    resampler = samplerate.FixedBlockResampler(256, "sinc_fastest", 2)
+    reference = samplerate.FixedBlockResampler(256, "sinc_fastest", 2)
+    out = np.empty((256, 2), dtype=np.float32)
+    for chunk in np.array_split(x, 40):
+        block = reference.process(chunk, 1.5)
+        assert resampler.process_into(chunk, out, 1.5) == (block is not None)
+        if block is not None:
+            assert np.array_equal(out, block)
+    resampler.reset()
+    assert resampler.available() == 0
+
+
+def test_strided_input(converter_type, ratio=1.5):
+    np.random.seed(0)
+    x = np.random.randn(3000, 4).astype(np.float32)
+    expected = samplerate.resample(x[:, ::2].copy(), ratio, converter_type)
+
+    # strided views and Fortran order are read in place
+    strided = x[:, ::2]
+    assert np.array_equal(samplerate.resample(strided, ratio, converter_type), expected)
+    fortran = np.asfortranarray(x[:, ::2])
+    assert np.array_equal(samplerate.resample(fortran, ratio, converter_type), expected)
+    output = samplerate.Resampler(converter_type, 2).process(strided, ratio, True)
+    assert np.array_equal(output, expected)
+
+    # single column of an interleaved signal
+    expected = samplerate.resample(x[:, 1].copy(), ratio, converter_type)
+    assert np.array_equal(samplerate.resample(x[:, 1], ratio, converter_type), expected)
+
+
+def test_planar_layout(data, converter_type, ratio=2.0):
+    num_channels, input_data = data
+    expected = samplerate.resample(input_data, ratio, converter_type)
+    planar = np.ascontiguousarray(input_data.T)
+
+    output = samplerate.resample(planar, ratio, converter_type, layout="planar")
+    assert output.shape == expected.T.shape
+    assert output.flags.c_contiguous
+    assert np.allclose(output, expected.T)
+
+    resampler = samplerate.Resampler(converter_type, num_channels)
+    output = resampler.process(planar, ratio, end_of_input=True, layout="planar")
+    assert np.allclose(output, expected.T)
+
+
+def test_buffer_input():
+    import array
+
+    x = np.random.randn(1000).astype(np.float32)
+    expected = samplerate.resample(x, 2.0, "sinc_fastest")
+    assert np.array_equal(samplerate.resample(memoryview(x), 2.0, "sinc_fastest"), expected)
+    buffer = array.array("f", x.tobytes())
+    assert np.array_equal(samplerate.resample(buffer, 2.0, "sinc_fastest"), expected)
+    assert np.array_equal(samplerate.resample(list(x), 2.0, "sinc_fastest"), expected)
+
+    # strided blocks from a callback
+    stereo = np.stack([x, -x], axis=1)
+    blocks = iter([stereo[:500, 0], stereo[500:, 0]])
+    resampler = samplerate.CallbackResampler(
+        lambda: next(blocks, None), 2.0, "sinc_fastest"
+    )
+    output = resampler.read(4000)
+    assert np.allclose(output, samplerate.resample(x, 2.0, "sinc_fastest"), atol=1e-6)
+
+
+def test_strict_input():
+    x = np.random.randn(1000, 2)
+    try:
+        samplerate.set_strict_input(True)
+        assert samplerate.get_strict_input()
+        with pytest.raises(ValueError):
+            samplerate.resample(x, 2.0, "sinc_fastest")
+        with pytest.raises(ValueError):
+            samplerate.Resampler("sinc_fastest", 2).process(x, 2.0)
+        # float32 views are never copied
+        x32 = x.astype(np.float32)
+        samplerate.resample(x32[:, 0], 2.0, "sinc_fastest")
+        samplerate.resample(np.asfortranarray(x32), 2.0, "sinc_fastest")
+    finally:
+        samplerate.set_strict_input(False)
+    assert not samplerate.get_strict_input()
+
+
+@pytest.mark.parametrize("dtype", [np.int16, np.int32])
+def test_pcm_input_output(data, converter_type, dtype, ratio=1.5):
+    num_channels, input_data = data
+    pcm = np.round(input_data * 20000).astype(dtype)
+    expected = samplerate.resample(pcm.astype(np.float32), ratio, converter_type)
+
+    # integer samples keep their values
+    output = samplerate.resample(pcm, ratio, converter_type)
+    assert output.dtype == np.float32
+    assert np.allclose(output, expected, atol=1e-2)
+
+    output = samplerate.resample(pcm, ratio, converter_type, dtype=dtype)
+    assert output.dtype == dtype and output.shape == expected.shape
+    assert np.max(np.abs(output - expected)) <= 0.51
+
+    resampler = samplerate.Resampler(converter_type, num_channels)
+    output = resampler.process(pcm, ratio, end_of_input=True, dtype=dtype)
+    assert output.dtype == dtype and output.shape == expected.shape
+    assert np.max(np.abs(output - expected)) <= 0.51
+
+
+def test_pcm_output_saturation():
+    x = np.array([0.0, 1e6, -1e6] * 2000, dtype=np.float32)
+    output = samplerate.resample(x, 1.0, "zero_order_hold", dtype="int16")
+    assert output.max() == 32767 and output.min() == -32768
+
+
+def test_ratio_schedule(data, converter_type):
+    num_channels, input_data = data
+
+    # a flat schedule matches a constant ratio
+    expected = samplerate.Resampler(converter_type, num_channels).process(
+        input_data, 1.5, end_of_input=True
+    )
+    for schedule in [(1.5, 1.5), np.array([[0, 1.5], [500, 1.5]])]:
+        resampler = samplerate.Resampler(converter_type, num_channels)
+        output = resampler.process(input_data, schedule, end_of_input=True)
+        assert output.shape == expected.shape
+        assert np.allclose(output, expected, atol=1e-4)
+
+    # a ramp produces as many frames as its mean ratio, and the next call
+    # continues from its last ratio
+    resampler = samplerate.Resampler(converter_type, num_channels)
+    first = resampler.process(input_data, (1.0, 2.0))
+    second = resampler.process(input_data, 2.0, end_of_input=True)
+    total = len(first) + len(second)
+    assert abs(total - 3.5 * len(input_data)) < 0.05 * len(input_data)
+
+
+def test_callback_ratio_schedule():
+    x = np.random.randn(20000).astype(np.float32)
+    blocks = iter(np.array_split(x, 20))
+    callback = lambda: next(blocks, None)
+    resampler = samplerate.CallbackResampler(callback, 1.0, "sinc_fastest")
+    output = resampler.read(4000, ratio=(1.0, 2.0))
+    assert len(output) == 4000
+    assert resampler.ratio == 2.0
+    breakpoints = np.array([[0, 2.0], [1000, 0.5]])
+    out = np.empty(4000, dtype=np.float32)
+    assert resampler.read_into(out, ratio=breakpoints) == 4000
+    assert resampler.ratio == 0.5
+
+
+def test_callback_reentry():
+    import asyncio
+
+    x = np.random.randn(20000).astype(np.float32)
+    blocks = iter(np.array_split(x, 20))
+    errors = []
+
+    def callback():
+        # the read holds the resampler: raises instead of deadlocking
+        for method in (resampler.stats, resampler.latency_frames):
+            try:
+                method()
+            except RuntimeError as e:
+                errors.append(e)
+        return next(blocks, None)
+
+    resampler = samplerate.CallbackResampler(callback, 1.5, "sinc_fastest", silence_threshold=0.0)
+    assert len(resampler.read(4000)) == 4000
+    assert len(errors) >= 2 and all("busy" in str(e) for e in errors)
+    assert "silent_frames" in resampler.stats()
+
+    # also from the pool thread of an asynchronous read
+    errors.clear()
+
+    async def main():
+        return await resampler.read_async(4000)
+
+    assert len(asyncio.run(main())) == 4000
+    assert errors and all("busy" in str(e) for e in errors)
+
+
+@pytest.mark.parametrize("release_gil", [False, True])
+@pytest.mark.parametrize("prefetch", [1, 4])
+def test_callback_prefetch(data, converter_type, prefetch, release_gil):
+    num_channels, input_data = data
+
+    def make_callback():
+        blocks = iter(np.array_split(input_data, 10))
+        return lambda: next(blocks, None)
+
+    reference = samplerate.CallbackResampler(make_callback(), 1.5, converter_type, num_channels)
+    expected = np.concatenate([reference.read(100) for _ in range(20)])
+    resampler = samplerate.CallbackResampler(
+        make_callback(), 1.5, converter_type, num_channels, prefetch=prefetch
+    )
+    output = np.concatenate(
+        [resampler.read(100, release_gil=release_gil) for _ in range(20)]
+    )
+    assert np.array_equal(output, expected)
+    assert resampler.stats()["callback_calls"] == 11
+    assert len(resampler.read(100)) == 0
+
+    # a reset starts fetching again
+    resampler.reset()
+    assert resampler.read(100).shape[0] == 0
+
+
+def test_callback_prefetch_at_exit():
+    import subprocess
+    import sys
+
+    # the prefetch thread of a resampler alive at exit is stopped before
+    # the interpreter is finalized
+    script = (
+        "import numpy as np, samplerate\n"
+        "block = np.zeros(256, dtype=np.float32)\n"
+        "resampler = samplerate.CallbackResampler(\n"
+        "    lambda: block, 1.5, 'sinc_fastest', 1, prefetch=4)\n"
+        "resampler.read(100)\n"
+    )
+    proc = subprocess.run([sys.executable, "-c", script], capture_output=True, timeout=60)
+    assert proc.returncode == 0, proc.stderr
+
+
+def test_stats(data, converter_type, ratio=2.0):
+    num_channels, input_data = data
+
+    samplerate.reset_stats()
+    output = samplerate.resample(input_data, ratio, converter_type, release_gil=True)
+    stats = samplerate.get_stats()
+    assert stats["calls"] == 1 and stats["gil_released"] == 1
+    assert stats["input_frames"] == len(input_data)
+    assert stats["output_frames"] == len(output)
+    assert 0 < stats["max_process_ns"] <= stats["process_ns"]
+    samplerate.reset_stats()
+    assert samplerate.get_stats()["calls"] == 0
+
+    resampler = samplerate.Resampler(converter_type, num_channels)
+    output = resampler.process(input_data, ratio, release_gil=False)
+    stats = resampler.stats()
+    assert stats["calls"] == 1 and stats["gil_held"] >= 1
+    assert stats["input_frames"] == len(input_data)
+    assert stats["output_frames"] == len(output)
+    assert resampler.clone().stats()["calls"] == 0
+    resampler.reset_stats()
+    assert resampler.stats()["process_ns"] == 0
+
+    blocks = iter([input_data])
+    cb_resampler = samplerate.CallbackResampler(
+        lambda: next(blocks, None), ratio, converter_type, num_channels
+    )
+    output = cb_resampler.read(4 * len(input_data))
+    stats = cb_resampler.stats()
+    assert stats["calls"] == 1 and stats["callback_calls"] >= 2
+    assert stats["input_frames"] == len(input_data)
+    assert stats["output_frames"] == len(output)
+    assert stats["callback_ns"] > 0
+
+
+def test_gil_release_thresholds():
+    default = samplerate.get_gil_release_threshold()
+    try:
+        samplerate.set_gil_release_threshold(5000, "zero_order_hold")
+        samplerate.set_gil_release_threshold(300, "sinc_best", channels=2)
+        assert samplerate.get_gil_release_threshold("zero_order_hold") == 5000
+        assert samplerate.get_gil_release_threshold("zero_order_hold", 2) == 5000
+        assert samplerate.get_gil_release_threshold("sinc_best", 2) == 300
+        assert samplerate.get_gil_release_threshold("sinc_best", 1) == default
+        info = samplerate.get_build_info()["gil_release_thresholds"]
+        assert info["zero_order_hold"] == 5000 and info["sinc_best"] == default
+
+        # the auto mode follows the converter specific threshold
+        resampler = samplerate.Resampler("zero_order_hold", 1)
+        resampler.process(np.zeros(2000, dtype=np.float32), 2.0)
+        assert resampler.stats()["gil_held"] == 1
+
+        thresholds = samplerate.calibrate_gil_thresholds()
+        assert set(thresholds) == set(info)
+        for name, threshold in thresholds.items():
+            assert threshold >= 1
+            assert samplerate.get_gil_release_threshold(name) == threshold
+        # the general setter drops specific thresholds
+        samplerate.set_gil_release_threshold(default)
+        assert samplerate.get_gil_release_threshold("zero_order_hold") == default
+        assert samplerate.get_gil_release_threshold("sinc_best", 2) == default
+    finally:
+        samplerate.set_gil_release_threshold(default)
+
+
+def test_benchmark():
+    import json
+
+    report = samplerate.benchmark(
+        ["sinc_fastest", samplerate.ConverterType.polyphase_fast],
+        channels=[1, 2],
+        block_frames=[256],
+        min_time=0.001,
+    )
+    assert report["build_info"]["version"] == samplerate.__version__
+    assert len(report["results"]) == 4
+    for result in report["results"]:
+        assert result["converter_type"] in ("sinc_fastest", "polyphase_fast")
+        assert result["block_frames"] == 256
+        assert result["native_ns"] > 0 and result["process_ns"] > 0
+        assert result["overhead_ns"] == result["process_ns"] - result["native_ns"]
+
+    report = json.loads(samplerate.benchmark("linear", [1], [64], min_time=0.001, as_json=True))
+    assert len(report["results"]) == 1
+
+
+def test_simd_kernels(tmp_path):
+    import os
+    import subprocess
+    import sys
+
+    info = samplerate.get_build_info()
+    assert info["simd_isas"][0] == "scalar"
+    assert info["simd_isa"] == info["simd_isas"][-1] or "SAMPLERATE_SIMD" in os.environ
+
+    # every kernel set gives the same integer samples and nearly the same
+    # polyphase output
+    script = (
+        "import numpy as np, samplerate, sys\n"
+        "x = (np.sin(np.arange(4410) * 0.05) * 20000).astype(np.int16)\n"
+        "y = samplerate.resample(x, 48000 / 44100, 'polyphase_fast')\n"
+        "z = samplerate.resample(x, 0.5, 'linear', dtype='int16')\n"
+        "s = samplerate.resample(x / 32768, 48000 / 44100, 'sinc_medium')\n"
+        "info = samplerate.get_build_info()\n"
+        "np.savez(sys.argv[1], isa=info['simd_isa'], sinc_isa=info['sinc_isa'],\n"
+        "         y=y, z=z, s=s)\n"
+    )
+    results = {}
+    for isa in info["simd_isas"] + ["unknown"]:
+        env = dict(os.environ, SAMPLERATE_SIMD=isa)
+        path = str(tmp_path / (isa + ".npz"))
+        proc = subprocess.run(
+            [sys.executable, "-W", "always", "-c", script, path],
+            env=env,
+            capture_output=True,
+            text=True,
+            check=True,
+        )
+        with np.load(path) as result:
+            results[isa] = (str(result["isa"]), result["y"], result["z"], result["s"])
+            sinc_isa = str(result["sinc_isa"])
+        # the sinc converters have an AVX2 build on x86
+        if results[isa][0] in ("avx2", "avx512"):
+            assert sinc_isa in ("avx2", "baseline")
+        else:
+            assert sinc_isa == "baseline"
+        if isa == "unknown":
+            assert "RuntimeWarning" in proc.stderr
+            assert results[isa][0] == info["simd_isas"][-1]
+        else:
+            assert results[isa][0] == isa
+    _, y, z, sinc = results["scalar"]
+    for isa, (_, other_y, other_z, other_sinc) in results.items():
+        assert np.allclose(other_y, y, atol=1e-2)
+        assert np.array_equal(other_z, z)
+        assert np.allclose(other_sinc, sinc, atol=1e-4)
+
+
+def test_async_api():
+    import asyncio
+
+    rng = np.random.default_rng(0)
+    signal = rng.standard_normal((20000, 2)).astype(np.float32)
+    blocks = np.array_split(signal, 7)
+    expected_resample = samplerate.resample(signal, 0.75, "sinc_fastest")
+    resampler = samplerate.Resampler("sinc_fastest", 2)
+    expected_process = [resampler.process(b, 1.5) for b in blocks]
+
+    def make_callback():
+        pending = iter(blocks)
+        return lambda: next(pending, None)
+
+    expected_read = samplerate.CallbackResampler(make_callback(), 1.5, "sinc_fastest", 2).read(
+        30000
+    )
+
+    async def main():
+        output = await samplerate.resample_async(signal, 0.75, "sinc_fastest")
+        assert np.array_equal(output, expected_resample)
+        output = await samplerate.resample_async(signal[:, 0], 2.0, "linear", dtype="int16")
+        assert output.dtype == np.int16 and output.ndim == 1
+
+        # calls on one resampler run in order, several resamplers concurrently
+        resamplers = [samplerate.Resampler("sinc_fastest", 2) for _ in range(4)]
+        futures = [[r.process_async(b, 1.5) for b in blocks] for r in resamplers]
+        for stream in futures:
+            outputs = await asyncio.gather(*stream)
+            for output, expected in zip(outputs, expected_process):
+                assert np.array_equal(output, expected)
+
+        cb_resampler = samplerate.CallbackResampler(make_callback(), 1.5, "sinc_fastest", 2)
+        output = await cb_resampler.read_async(30000)
+        assert np.array_equal(output, expected_read)
+        assert cb_resampler.stats()["calls"] == 1
+
+    asyncio.run(main())
+
+
+def test_shared_resampler_threads():
+    import sys
+    import sysconfig
+    import threading
+
+    # identical blocks give the same sequence of outputs whatever the order
+    # of the threads, as long as the calls do not interleave
+    block = np.sin(np.arange(4000, dtype=np.float32) * 0.01)
+    reference = samplerate.Resampler("sinc_fastest", 1)
+    expected = sum(len(reference.process(block, 1.5)) for _ in range(32))
+
+    resampler = samplerate.Resampler("sinc_fastest", 1)
+    lengths = []
+
+    def worker():
+        for _ in range(8):
+            lengths.append(len(resampler.process(block, 1.5, release_gil=True)))
+
+    threads = [threading.Thread(target=worker) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert sum(lengths) == expected
+
+    free_threaded = bool(sysconfig.get_config_var("Py_GIL_DISABLED"))
+    assert samplerate.get_build_info()["free_threaded"] == free_threaded
+    if free_threaded:
+        # importing the module did not enable the GIL
+        assert not sys._is_gil_enabled()
@@ -1,3 +1,5 @@
+import sys
+
 import numpy as np
 import pytest
 
@@ -112,3 +114,341 @@ def test_callback_resampler_zero_channels():
     with pytest.raises(ValueError):
         # fails because we defined the converter for 1 channel
         cb_resampler.read(len(data))
+
+
+def test_callback_resampler_prefetch_errors():
+    with pytest.raises(ValueError):
+        samplerate.CallbackResampler(lambda: None, 0.5, "sinc_fastest", 1, prefetch=-1)
+
+    callback = lambda: np.zeros((1000, 2), dtype=np.float32)
+    cb_resampler = samplerate.CallbackResampler(callback, 0.5, "sinc_fastest", 1, prefetch=2)
+    with pytest.raises(ValueError):
+        # fails because we defined the converter for 1 channel
+        cb_resampler.read(100)
+
+    def failing():
+        raise ZeroDivisionError("no input")
+
+    cb_resampler = samplerate.CallbackResampler(failing, 0.5, "sinc_fastest", 1, prefetch=2)
+    with pytest.raises(ValueError, match="no input"):
+        # raised on the prefetch thread, reported by read
+        cb_resampler.read(100)
+
+
+def test_process_into_invalid_output():
+    data = np.zeros(1000, dtype=np.float32)
+    resampler = samplerate.Resampler("sinc_fastest", 1)
+    with pytest.raises(TypeError):
+        # output buffers are never converted
+        resampler.process_into(data, np.zeros(1000, dtype=np.float64), 0.5)
+    with pytest.raises(TypeError):
+        resampler.process_into(data, np.zeros((1000, 2), dtype=np.float32)[:, 0], 0.5)
+    with pytest.raises(ValueError):
+        resampler.process_into(data, np.zeros((1000, 2), dtype=np.float32), 0.5)
+    out = np.zeros(1000, dtype=np.float32)
+    out.flags.writeable = False
+    with pytest.raises(ValueError):
+        resampler.process_into(data, out, 0.5)
+
+
+def test_read_into_incorrect_channel_number():
+    callback = lambda: np.zeros(1000, dtype=np.float32)
+    cb_resampler = samplerate.CallbackResampler(callback, 0.5, "sinc_fastest", 1)
+    with pytest.raises(ValueError):
+        cb_resampler.read_into(np.zeros((100, 2), dtype=np.float32))
+
+
+def test_resample_batch_invalid_input():
+    good = np.zeros(100, dtype=np.float32)
+    with pytest.raises(ValueError):
+        samplerate.resample_batch([good, np.zeros((100, 1, 1))], 0.5)
+    with pytest.raises(ValueError):
+        samplerate.resample_batch([good, np.zeros((100, 0))], 0.5)
+    with pytest.raises(ValueError):
+        # one ratio per input
+        samplerate.resample_batch([good, good], [0.5, 1.0, 2.0])
+
+
+@pytest.mark.parametrize("num_threads", [1, 4])
+def test_resample_batch_invalid_ratio(num_threads):
+    data = [np.zeros(100, dtype=np.float32)] * 4
+    with pytest.raises(samplerate.ResamplingError):
+        samplerate.resample_batch(data, [0.5, 0.5, -1.0, 0.5], num_threads=num_threads)
+
+
+def test_resampler_bank_invalid_input():
+    bank = samplerate.ResamplerBank(2, "sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        # wrong number of streams
+        bank.process(np.zeros((3, 100, 2)), 0.5)
+    with pytest.raises(ValueError):
+        # wrong number of channels
+        bank.process(np.zeros((2, 100, 1)), 0.5)
+    with pytest.raises(ValueError):
+        bank.process([np.zeros((100, 2)), np.zeros((100, 1))], 0.5)
+    with pytest.raises(ValueError):
+        bank.process(np.zeros((2, 100, 2)), [0.5, 0.5, 0.5])
+    with pytest.raises(IndexError):
+        bank.reset_stream(2)
+
+
+def test_resample_multi_invalid_input():
+    data = np.zeros((100, 2), dtype=np.float32)
+    with pytest.raises(ValueError):
+        samplerate.resample_multi(data, [])
+    with pytest.raises(ValueError):
+        samplerate.resample_multi(np.zeros((100, 1, 1)), [0.5])
+    with pytest.raises(samplerate.ResamplingError):
+        samplerate.resample_multi(data, [0.5, -1.0])
+    with pytest.raises(ValueError):
+        samplerate.MultiRateResampler([])
+    fan_out = samplerate.MultiRateResampler([0.5, 2.0], "sinc_fastest", 1)
+    with pytest.raises(ValueError):
+        # wrong number of channels
+        fan_out.process(data)
+    with pytest.raises(ValueError):
+        # one ratio per output
+        fan_out.set_ratios([0.5])
+
+
+def test_resample_file_invalid_input(tmp_path):
+    import wave
+
+    with pytest.raises(FileNotFoundError):
+        samplerate.resample_file(tmp_path / "missing.raw", tmp_path / "out.raw", 0.5)
+    np.zeros(100, dtype=np.float32).tofile(tmp_path / "in.raw")
+    with pytest.raises(ValueError):
+        samplerate.resample_file(tmp_path / "in.raw", tmp_path / "in.raw", 0.5)
+    with pytest.raises(ValueError):
+        samplerate.resample_file(tmp_path / "in.raw", tmp_path / "out.raw", 0.5, channels=0)
+    with pytest.raises(ValueError):
+        samplerate.resample_file(tmp_path / "in.raw", tmp_path / "out.raw", 0.5, block_frames=0)
+
+    with wave.open(str(tmp_path / "in.wav"), "wb") as f:
+        f.setnchannels(1)
+        f.setsampwidth(1)  # 8-bit samples are not supported
+        f.setframerate(8000)
+        f.writeframes(bytes(100))
+    with pytest.raises(ValueError):
+        samplerate.resample_file(tmp_path / "in.wav", tmp_path / "out.wav", 0.5)
+
+
+def test_post_process_invalid_input():
+    data = np.zeros((100, 2), dtype=np.float32)
+    with pytest.raises(ValueError):
+        samplerate.PostProcess([])
+    with pytest.raises(ValueError):
+        samplerate.PostProcess(float("nan"))
+    with pytest.raises(ValueError):
+        samplerate.PostProcess(channel_map=[])
+    with pytest.raises(ValueError):
+        samplerate.PostProcess(channel_map=[0, -1])
+    with pytest.raises(ValueError):
+        # one gain per channel
+        samplerate.resample(data, 0.5, post=samplerate.PostProcess([1.0, 1.0, 1.0]))
+    with pytest.raises(ValueError):
+        samplerate.resample(data, 0.5, post=samplerate.PostProcess(channel_map=[2]))
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_fastest", 2).process(data, 0.5, post=0.5)
+    callback = samplerate.CallbackResampler(lambda: data, 0.5, "sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        callback.read(10, post=samplerate.PostProcess(channel_map=[0, 2]))
+
+
+def test_adaptive_invalid_input():
+    with pytest.raises(ValueError):
+        samplerate.Resampler("adaptive", 2)
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_best", 2, budget_us=1000)
+    with pytest.raises(ValueError):
+        samplerate.Resampler("adaptive", 2, budget_us=0)
+    with pytest.raises(ValueError):
+        samplerate.resample(np.zeros(100), 0.5, "adaptive")
+
+
+def test_prime_invalid_input():
+    resampler = samplerate.Resampler("sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        resampler.prime(0.5, num_frames=-1)
+    with pytest.raises(samplerate.ResamplingError):
+        resampler.latency_frames(-1.0)
+    callback = samplerate.CallbackResampler(lambda: None, 0.5, "sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        callback.prime(-1)
+
+
+def test_silence_threshold_invalid_input():
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_fastest", 2, silence_threshold=-1.0)
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_fastest", 2, silence_threshold=float("nan"))
+    with pytest.raises(ValueError):
+        samplerate.CallbackResampler(lambda: None, 0.5, "sinc_fastest", 2, silence_threshold=-1.0)
+
+
+def test_shared_memory_resampler_invalid_input():
+    with pytest.raises(ValueError):
+        samplerate.SharedMemoryResampler("sinc_fastest", 0)
+    with pytest.raises(ValueError):
+        samplerate.SharedMemoryResampler("sinc_fastest", 2, capacity=0)
+    with samplerate.SharedMemoryResampler("sinc_fastest", 2) as worker:
+        with pytest.raises(ValueError):
+            worker.process(np.zeros((100, 3), dtype=np.float32), 1.5)
+    with pytest.raises(RuntimeError):
+        worker.process(np.zeros((100, 2), dtype=np.float32), 1.5)
+
+
+def test_snapshot_invalid_input():
+    resampler = samplerate.Resampler("sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        resampler.restore(samplerate.Resampler("sinc_fastest", 1).snapshot())
+    with pytest.raises(ValueError):
+        resampler.restore(samplerate.Resampler("linear", 2).snapshot())
+    with pytest.raises(ValueError):
+        resampler.restore(samplerate.ResamplerSnapshot())
+    with pytest.raises(TypeError):
+        resampler.snapshot(into=samplerate.CallbackResamplerSnapshot())
+    callback = samplerate.CallbackResampler(lambda: None, 0.5, "sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        callback.restore(samplerate.CallbackResamplerSnapshot())
+
+    state = samplerate.Resampler("polyphase_fast", 2).__getstate__()
+    corrupt = samplerate.Resampler.__new__(samplerate.Resampler)
+    with pytest.raises(ValueError):
+        corrupt.__setstate__(state[:5] + (state[5][:-1],))
+
+
+def test_callback_snapshot_corrupted():
+    np.random.seed(0)
+    block = np.random.randn(1000, 2).astype(np.float32)
+    resampler = samplerate.CallbackResampler(lambda: block, 1.5, "sinc_fastest", 2)
+    resampler.read(1234)
+    reference = resampler.clone()
+    state = resampler.snapshot().__getstate__()
+    # the resampler's own state, then that of its converter: type, channels...
+    size = int.from_bytes(state[:8], sys.byteorder)
+
+    def restore(serialized):
+        snapshot = samplerate.CallbackResamplerSnapshot.__new__(samplerate.CallbackResamplerSnapshot)
+        snapshot.__setstate__(serialized)
+        with pytest.raises(ValueError):
+            resampler.restore(snapshot)
+
+    # a snapshot that does not decode leaves the stream as it was
+    restore((size + 1).to_bytes(8, sys.byteorder) + state[8 : 8 + size] + b"\0" + state[8 + size :])
+    assert np.array_equal(resampler.read(2000), reference.read(2000))
+
+    # one the converter rejects resets it
+    channels = 8 + size + 8 + 4
+    restore(state[:channels] + (3).to_bytes(4, sys.byteorder, signed=True) + state[channels + 4 :])
+    fresh = samplerate.CallbackResampler(lambda: block, 1.5, "sinc_fastest", 2)
+    assert np.array_equal(resampler.read(2000), fresh.read(2000))
+
+
+def test_negative_num_threads():
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_fastest", 2, num_threads=-1)
+    with pytest.raises(ValueError):
+        samplerate.resample(np.zeros((100, 2)), 0.5, num_threads=-1)
+
+
+def test_stream_resampler_invalid_input():
+    with pytest.raises(ValueError):
+        samplerate.StreamResampler(0.5, "sinc_fastest", 0)
+    with pytest.raises(ValueError):
+        samplerate.StreamResampler(0.5, "sinc_fastest", 1, capacity=0)
+    stream = samplerate.StreamResampler(0.5, "sinc_fastest", 1)
+    with pytest.raises(ValueError):
+        stream.write(np.zeros((100, 2), dtype=np.float32))
+    with pytest.raises(ValueError):
+        stream.write(np.zeros((100, 1, 1), dtype=np.float32))
+    stream.write(np.zeros(100, dtype=np.float32), end_of_input=True)
+    with pytest.raises(ValueError):
+        stream.write(np.zeros(100, dtype=np.float32))
+
+
+def test_fixed_block_resampler_invalid_input():
+    with pytest.raises(ValueError):
+        samplerate.FixedBlockResampler(0, "sinc_fastest", 1)
+    resampler = samplerate.FixedBlockResampler(64, "sinc_fastest", 2)
+    with pytest.raises(ValueError):
+        resampler.process(np.zeros((100, 1), dtype=np.float32), 0.5)
+    with pytest.raises(ValueError):
+        # the output must hold exactly one block
+        resampler.process_into(
+            np.zeros((100, 2), dtype=np.float32), np.zeros((65, 2), dtype=np.float32), 0.5
+        )
+
+
+def test_invalid_layout():
+    data = np.zeros((2, 100), dtype=np.float32)
+    with pytest.raises(ValueError):
+        samplerate.resample(data, 0.5, "sinc_fastest", layout="columns")
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_fastest", 2).process(data, 0.5, layout="columns")
+
+
+def test_invalid_dtype():
+    data = np.zeros(100, dtype=np.float32)
+    with pytest.raises(ValueError):
+        samplerate.resample(data, 0.5, "sinc_fastest", dtype="float64")
+    with pytest.raises(ValueError):
+        samplerate.Resampler("sinc_fastest", 1).process(data, 0.5, dtype="uint8")
+
+
+def test_invalid_ratio_schedule():
+    data = np.zeros(100, dtype=np.float32)
+    resampler = samplerate.Resampler("sinc_fastest", 1)
+    with pytest.raises(ValueError):
+        resampler.process(data, (0.5, 1.0, 2.0))
+    with pytest.raises(ValueError):
+        # breakpoints must be sorted
+        resampler.process(data, np.array([[50, 0.5], [10, 1.0]]))
+    with pytest.raises(samplerate.ResamplingError):
+        resampler.process(data, (0.5, -1.0))
+
+
+def test_invalid_gil_release_threshold():
+    with pytest.raises(ValueError):
+        samplerate.set_gil_release_threshold(100, "sinc_best", channels=9)
+    with pytest.raises(ValueError):
+        samplerate.set_gil_release_threshold(-1, "sinc_best")
+    with pytest.raises(ValueError):
+        samplerate.calibrate_gil_thresholds(channels=0)
+
+
+def test_async_errors():
+    import asyncio
+
+    data = np.zeros(1000, dtype=np.float32)
+    with pytest.raises(RuntimeError):
+        # no running event loop
+        samplerate.resample_async(data, 0.5)
+
+    async def main():
+        with pytest.raises(samplerate.ResamplingError):
+            await samplerate.resample_async(data, -1.0, "sinc_fastest")
+        with pytest.raises(ValueError):
+            # checked before the call returns
+            samplerate.Resampler("sinc_fastest", 2).process_async(data, 0.5)
+
+        callback = lambda: np.zeros((1000, 2), dtype=np.float32)
+        cb_resampler = samplerate.CallbackResampler(callback, 0.5, "sinc_fastest", 1)
+        with pytest.raises(ValueError):
+            # wrong number of channels in the callback's input
+            await cb_resampler.read_async(100)
+
+        # the error of a read is raised by its own future, even when the
+        # next read already started
+        blocks = iter([np.zeros((1000, 2), dtype=np.float32)])
+        callback = lambda: next(blocks, np.zeros(1000, dtype=np.float32))
+        cb_resampler = samplerate.CallbackResampler(callback, 0.5, "sinc_fastest", 1)
+        first, second = await asyncio.gather(
+            cb_resampler.read_async(100),
+            cb_resampler.read_async(100),
+            return_exceptions=True,
+        )
+        assert isinstance(first, ValueError)
+        assert isinstance(second, np.ndarray) and second.ndim == 1
+
+    asyncio.run(main())
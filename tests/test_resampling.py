@@ -81,6 +81,10 @@ def make_sweep(T, fs, f_lo=0.0, f_hi=None, fade=None, ascending=False):
         (samplerate.ConverterType.sinc_best, 1e-6),
         (samplerate.ConverterType.sinc_medium, 1e-5),
         (samplerate.ConverterType.sinc_fastest, 1e-4),
+        (samplerate.ConverterType.polyphase_best, 1e-6),
+        (samplerate.ConverterType.polyphase_fast, 1e-5),
+        (samplerate.ConverterType.halfband_best, 1e-6),
+        (samplerate.ConverterType.halfband_fast, 1e-5),
     ],
 )
 def test_quality_sine(sr_orig, sr_new, fil, rms):
@@ -104,6 +108,10 @@ def test_quality_sine(sr_orig, sr_new, fil, rms):
         (samplerate.ConverterType.sinc_best, 1e-6),
         (samplerate.ConverterType.sinc_medium, 1e-5),
         (samplerate.ConverterType.sinc_fastest, 1e-4),
+        (samplerate.ConverterType.polyphase_best, 1e-6),
+        (samplerate.ConverterType.polyphase_fast, 1e-5),
+        (samplerate.ConverterType.halfband_best, 1e-6),
+        (samplerate.ConverterType.halfband_fast, 1e-5),
     ],
 )
 def test_quality_sweep(sr_orig, sr_new, fil, rms):
@@ -123,3 +131,34 @@ def test_quality_sweep(sr_orig, sr_new, fil, rms):
     err = np.mean(np.abs(y[idx] - y_pred[idx]))
 
     assert err <= rms, "{:g} > {:g}".format(err, rms)
+
+
+@pytest.mark.parametrize("num_threads", [2, 5])
+@pytest.mark.parametrize("ratio", [0.5, 2.0, 44100 / 48000, 48000 / 44100, 1 / 3])
+@pytest.mark.parametrize(
+    "fil",
+    [
+        samplerate.ConverterType.sinc_best,
+        samplerate.ConverterType.sinc_fastest,
+        samplerate.ConverterType.linear,
+        samplerate.ConverterType.polyphase_fast,
+        samplerate.ConverterType.halfband_fast,
+    ],
+)
+def test_segmented_matches_sequential(num_threads, ratio, fil):
+    x, _ = make_sweep(5.0, 44100, 0.0, 8000, fade=0.1)
+    x = np.stack([x, x[::-1]], axis=1).astype(np.float32)
+
+    expected = samplerate.resample(x, ratio, fil, num_threads=1)
+    output = samplerate.resample(x, ratio, fil, num_threads=num_threads)
+    assert output.shape == expected.shape
+    assert np.max(np.abs(output - expected)) < 1e-5
+
+
+def test_segmented_irrational_ratio():
+    # falls back to the sequential conversion
+    x, _ = make_tone(512.0, 44100, 2.0)
+    ratio = np.pi / 3
+    expected = samplerate.resample(x, ratio, "sinc_fastest", num_threads=1)
+    output = samplerate.resample(x, ratio, "sinc_fastest", num_threads=4)
+    assert np.array_equal(output, expected)
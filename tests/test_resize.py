@@ -1,4 +1,5 @@
 import numpy as np
+import pytest
 import samplerate
 
 
@@ -10,3 +11,43 @@ def test_resize():
     # ceil(167 * 0.9) = 151, which will be resized to 150
     y = samplerate.resample(x, 0.9)
     assert y.shape[0] == 150
+
+
+@pytest.mark.parametrize("converter_type", [0, 1, 2, 3, 4])
+@pytest.mark.parametrize("ratio", [0.25, 0.9, 1.0, 44100 / 48000, 2.0, 6.0])
+@pytest.mark.parametrize("block_size", [1, 64, 256, 1000])
+def test_max_output_frames(converter_type, ratio, block_size):
+    np.random.seed(0)
+    x = np.random.randn(20 * block_size, 2).astype(np.float32)
+    resampler = samplerate.Resampler(converter_type, channels=2)
+    for start in range(0, x.shape[0], block_size):
+        block = x[start : start + block_size]
+        end_of_input = start + block_size >= x.shape[0]
+        bound = resampler.max_output_frames(block.shape[0], ratio, end_of_input)
+        y = resampler.process(block, ratio, end_of_input)
+        assert y.shape[0] <= bound
+        # the bound stays proportional to the block size
+        assert bound <= np.ceil((block_size + 2000) * ratio)
+
+
+def test_max_output_frames_ratio_change():
+    np.random.seed(0)
+    x = np.random.randn(256).astype(np.float32)
+    resampler = samplerate.Resampler("sinc_best", channels=1)
+    for ratio in [0.5, 0.5, 1.0, 1.0, 0.25, 3.0, 3.0]:
+        bound = resampler.max_output_frames(x.shape[0], ratio)
+        y = resampler.process(x, ratio)
+        assert y.shape[0] <= bound
+
+
+def test_process_after_truncated_process_into():
+    np.random.seed(0)
+    x = np.random.randn(1000).astype(np.float32)
+    expected = samplerate.Resampler("sinc_fastest").process(x, 2.0, True)
+
+    resampler = samplerate.Resampler("sinc_fastest")
+    out = np.zeros(10, dtype=np.float32)
+    gen, used = resampler.process_into(x, out, 2.0)
+    # output left pending inside the converter is returned by process()
+    y = resampler.process(x[used:], 2.0, True)
+    assert np.allclose(np.concatenate([out[:gen], y]), expected)